@@ -0,0 +1,43 @@
+// benchmark: Tokenize compared with loading the same stream back from a TokenCache, for growing file sizes
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/cache_bench.cpp Lexer/*.cpp Support/*.cpp -o cache_bench
+// usage: cache_bench [directory] (defaults to /tmp/ilys-cache-bench, its entries are left there)
+#include "../Lexer/token_cache.h"
+#include "corpus.h"
+
+#include <chrono>
+
+int main(int argc, char* argv[]) {
+    std::string error;
+    std::unique_ptr<TokenCache> cache = TokenCache::Open(argc > 1 ? argv[1] : "/tmp/ilys-cache-bench", &error);
+    if (!cache) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (size_t size : {size_t(64) << 10, size_t(1) << 20, size_t(16) << 20}) {
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(GenerateCorpus(CorpusMix::MIXED, size));
+
+        auto start = std::chrono::steady_clock::now();
+        TokenStream tokens = Tokenize(source);
+        double lexed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!cache->Store(tokens, &error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        TokenStream cached;
+        start = std::chrono::steady_clock::now();
+        bool hit = cache->Load(source, std::make_shared<SymbolTable>(), cached);
+        double loaded = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!hit || cached.Tokens.size() != tokens.Tokens.size()) {
+            std::cerr << "Error: the stream stored for " << size << " bytes didn't come back" << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(6) << size / 1024 << " KB: Tokenize " << std::setw(8) << lexed << " ms, cache hit "
+                  << std::setw(8) << loaded << " ms (" << std::setprecision(1) << lexed / loaded << "x)" << std::setprecision(2) << std::endl;
+    }
+    std::cout << cache->GetHits() << " hits, " << cache->GetMisses() << " misses, " << cache->GetStores() << " stores" << std::endl;
+    return 0;
+}
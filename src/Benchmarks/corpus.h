@@ -0,0 +1,201 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+// deterministic generator of synthetic .ilys sources for the benchmarks (the same mix, size and seed always give
+// the same bytes, so numbers from two runs or two machines are measured on the same input)
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// which kind of token dominates the generated source
+enum class CorpusMix {
+    OPERATORS,    // arithmetic, comparisons and compound assignments, few letters
+    IDENTIFIERS,  // declarations, calls and keywords with long names
+    NUMBERS,      // integer and decimal literals, including negative ones
+    STRINGS,      // long string literals (with escapes) and wide indentation
+    MIXED         // a bit of everything, roughly what a program looks like
+};
+
+// every mix, in the order the benchmarks report them
+inline const std::vector<CorpusMix>& GetCorpusMixes() {
+    static const std::vector<CorpusMix> mixes = {CorpusMix::OPERATORS, CorpusMix::IDENTIFIERS, CorpusMix::NUMBERS, CorpusMix::STRINGS, CorpusMix::MIXED};
+    return mixes;
+}
+
+// name of a mix, also used as its key in JSON results and as the file name of a written corpus
+inline std::string GetCorpusMixName(CorpusMix mix) {
+    switch (mix) {
+        case CorpusMix::OPERATORS: return "operators";
+        case CorpusMix::IDENTIFIERS: return "identifiers";
+        case CorpusMix::NUMBERS: return "numbers";
+        case CorpusMix::STRINGS: return "strings";
+        case CorpusMix::MIXED: return "mixed";
+    }
+    return "unknown";
+}
+
+// small linear congruential generator, good enough to pick fragments and portable across standard libraries
+class CorpusRandom {
+    public:
+        explicit CorpusRandom(unsigned int seed) : State(seed) {}
+
+        // returns a number in [0, bound)
+        unsigned int Next(unsigned int bound) {
+            State = State * 1103515245u + 12345u;
+            return (State >> 16) % bound;
+        }
+
+        // returns one of the strings
+        const std::string& Pick(const std::vector<std::string>& strings) {
+            return strings[Next(strings.size())];
+        }
+
+    private:
+        unsigned int State;
+};
+
+// appends every piece in order (each piece is its own statement, so the random picks happen in a fixed order:
+// the operands of a + b are evaluated in an unspecified order and would make the output compiler dependent)
+inline void appendPieces(std::string& source, std::initializer_list<const char*> pieces) {
+    for (const char* piece : pieces) {
+        source += piece;
+    }
+}
+
+// appends one line (a statement or a small block) of the given mix
+inline void appendCorpusLine(std::string& source, CorpusMix mix, CorpusRandom& random) {
+    static const std::vector<std::string> shortNames = {"a", "b", "i", "j", "n", "x", "y", "z", "total", "count"};
+    static const std::vector<std::string> longNames = {
+        "user_account_balance", "previousValue", "request_handler", "maxRetryCount", "parsed_header_fields",
+        "currentIndex", "temporary_buffer_size", "isConnectionOpen", "shoppingCartItems", "last_error_message"
+    };
+    static const std::vector<std::string> binary = {"+", "-", "*", "/", "%", "==", "!=", "<", "<=", ">", ">=", "&&", "||"};
+    static const std::vector<std::string> compound = {"=", "+=", "-="};
+    static const std::vector<std::string> words = {"hello", "world", "value", "error", "the", "quick", "brown", "fox", "path", "line"};
+
+    switch (mix) {
+        case CorpusMix::OPERATORS: {
+            source += random.Pick(shortNames);
+            source += " ";
+            source += random.Pick(compound);
+            source += " ";
+            unsigned int terms = 3 + random.Next(6);
+            for (unsigned int i = 0; i < terms; i++) {
+                if (i > 0) {
+                    source += " ";
+                    source += random.Pick(binary);
+                    source += " ";
+                }
+                switch (random.Next(4)) {
+                    case 0:
+                        source += "(";
+                        source += random.Pick(shortNames);
+                        source += " ";
+                        source += random.Pick(binary);
+                        source += " ";
+                        source += std::to_string(random.Next(10));
+                        source += ")";
+                        break;
+                    case 1:
+                        source += "!";
+                        source += random.Pick(shortNames);
+                        break;
+                    case 2:
+                        source += random.Pick(shortNames);
+                        source += "[";
+                        source += random.Pick(shortNames);
+                        source += "]";
+                        break;
+                    default:
+                        source += random.Pick(shortNames);
+                        break;
+                }
+            }
+            source += ";";
+            if (random.Next(4) == 0) {
+                source += " ";
+                source += random.Pick(shortNames);
+                source += random.Next(2) ? "++;" : "--;";
+            }
+            source += "\n";
+            break;
+        }
+        case CorpusMix::IDENTIFIERS: {
+            // one name per slot, picked up front in a fixed order
+            const std::string* names[4];
+            for (const std::string*& name : names) {
+                name = &random.Pick(longNames);
+            }
+            switch (random.Next(5)) {
+                case 0: appendPieces(source, {"let ", names[0]->c_str(), " = ", names[1]->c_str(), ".", names[2]->c_str(), ";\n"}); break;
+                case 1: appendPieces(source, {"func ", names[0]->c_str(), "(", names[1]->c_str(), ", ", names[2]->c_str(), ") { ", names[3]->c_str(), "; }\n"}); break;
+                case 2: appendPieces(source, {"const ", names[0]->c_str(), " = new ", names[1]->c_str(), "(", names[2]->c_str(), ");\n"}); break;
+                case 3: appendPieces(source, {"forevery ", names[0]->c_str(), " in ", names[1]->c_str(), " { ", names[2]->c_str(), "; }\n"}); break;
+                default: appendPieces(source, {"if typeof ", names[0]->c_str(), " == ", names[1]->c_str(), " { } else { }\n"}); break;
+            }
+            break;
+        }
+        case CorpusMix::NUMBERS: {
+            source += "let ";
+            source += random.Pick(shortNames);
+            source += " = [";
+            unsigned int count = 4 + random.Next(8);
+            for (unsigned int i = 0; i < count; i++) {
+                if (i > 0) {
+                    source += ", ";
+                }
+                switch (random.Next(3)) {
+                    case 0:
+                        source += std::to_string(random.Next(100000));
+                        break;
+                    case 1:
+                        source += std::to_string(random.Next(1000));
+                        source += ".";
+                        source += std::to_string(random.Next(10000));
+                        break;
+                    default:
+                        source += "-";
+                        source += std::to_string(random.Next(500));
+                        break;
+                }
+            }
+            source += "];\n";
+            break;
+        }
+        case CorpusMix::STRINGS: {
+            source.append(4 * (1 + random.Next(6)), ' ');
+            source += "let ";
+            source += random.Pick(shortNames);
+            source += " = \"";
+            unsigned int count = 6 + random.Next(24);
+            for (unsigned int i = 0; i < count; i++) {
+                source += random.Pick(words);
+                source += random.Next(8) == 0 ? "\\\" " : " ";
+            }
+            source += "\";\n";
+            if (random.Next(3) == 0) {
+                source += "\n";
+            }
+            break;
+        }
+        case CorpusMix::MIXED: {
+            // any of the mixes above, one line at a time
+            appendCorpusLine(source, GetCorpusMixes()[random.Next(GetCorpusMixes().size() - 1)], random);
+            break;
+        }
+    }
+}
+
+// returns a source of about size bytes (whole lines only, so it may be a line longer) made of the given mix
+inline std::string GenerateCorpus(CorpusMix mix, size_t size, unsigned int seed = 1) {
+    CorpusRandom random(seed);
+    std::string source;
+    source.reserve(size + 256);
+    while (source.size() < size) {
+        appendCorpusLine(source, mix, random);
+    }
+    return source;
+}
+
+#endif
@@ -0,0 +1,69 @@
+// microbenchmark: keyword recognition with the compile-time perfect hash vs a std::unordered_map
+// build from src/: g++ -std=c++17 -O2 Benchmarks/keyword_bench.cpp -o keyword_bench
+#include "../Lexer/keywords.h"
+
+#include <chrono>
+#include <unordered_map>
+
+// builds a list of words where roughly half are keywords and half are identifiers, some of them keyword look-alikes
+std::vector<std::string> buildWords(size_t count) {
+    static const std::vector<std::string> identifiers = {
+        "x", "i", "index", "value", "fore", "form", "iff", "lett", "newer", "classy", "count", "total", "whilst", "result", "_tmp", "elsewhere"
+    };
+    std::vector<std::string> words;
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) & 1) {
+            words.emplace_back(Keywords[(seed >> 17) % KeywordCount].Text);
+        }
+        else {
+            words.push_back(identifiers[(seed >> 17) % identifiers.size()]);
+        }
+    }
+    return words;
+}
+
+// runs classify over every word a few times and returns nanoseconds per lookup (sum is returned so nothing gets optimized away)
+template <typename Classify>
+double timeLookups(const std::vector<std::string_view>& words, int rounds, Classify classify, size_t* sum) {
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (std::string_view word : words) {
+            *sum += static_cast<size_t>(classify(word));
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / (static_cast<double>(words.size()) * rounds);
+}
+
+int main() {
+    std::vector<std::string> storage = buildWords(1 << 16);
+    std::vector<std::string_view> words(storage.begin(), storage.end());
+
+    std::unordered_map<std::string_view, TokenType> map;
+    for (const Keyword& keyword : Keywords) {
+        map.emplace(keyword.Text, keyword.Type);
+    }
+
+    const int rounds = 200;
+    size_t perfectSum = 0;
+    size_t mapSum = 0;
+    double perfect = timeLookups(words, rounds, [](std::string_view word) {
+        return ClassifyIdentifier(word);
+    }, &perfectSum);
+    double naive = timeLookups(words, rounds, [&map](std::string_view word) {
+        auto found = map.find(word);
+        return found == map.end() ? TokenType::IDENTIFIER : found->second;
+    }, &mapSum);
+
+    if (perfectSum != mapSum) {
+        std::cerr << "Error: the perfect hash and the map disagree" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "perfect hash:       " << perfect << " ns/lookup" << std::endl;
+    std::cout << "std::unordered_map: " << naive << " ns/lookup" << std::endl;
+    std::cout << "speedup:            " << naive / perfect << "x" << std::endl;
+    return 0;
+}
\ No newline at end of file
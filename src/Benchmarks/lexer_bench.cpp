@@ -0,0 +1,285 @@
+// benchmark: Tokenize throughput, allocations and peak memory on generated corpora of every mix (see corpus.h)
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/lexer_bench.cpp Lexer/*.cpp Support/*.cpp -o lexer_bench
+// usage: lexer_bench [--size MB] [--runs N] [--mix name] [--json path] [--baseline path] [--write-corpus directory]
+//   --json writes the results (default lexer_bench.json), --baseline prints the change against an older results
+//   file, --write-corpus only saves the generated sources as <directory>/<mix>.ilys and exits
+#include "../Lexer/lexer.h"
+#include "corpus.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// every allocation made by the process goes through these, so counting them here counts the lexer's too
+static std::atomic<size_t> allocationCount(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// returns the peak resident set size in KB, or 0 if the system doesn't say
+static size_t getPeakMemory() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+// what one mix measured
+struct BenchResult {
+    std::string Mix;
+    size_t Bytes;
+    size_t Tokens;
+    double Seconds;      // fastest run
+    size_t Allocations;  // during one run
+    size_t AllocatedBytes;
+    size_t PeakMemory;   // KB, source buffer included (the whole process, see runMixIsolated)
+
+    double MegabytesPerSecond() const {
+        return Bytes / Seconds / (1 << 20);
+    }
+    double TokensPerSecond() const {
+        return Tokens / Seconds;
+    }
+    double AllocationsPerToken() const {
+        return Tokens > 0 ? double(Allocations) / Tokens : 0;
+    }
+};
+
+static BenchResult runMix(CorpusMix mix, size_t size, int runs) {
+    BenchResult result;
+    result.Mix = GetCorpusMixName(mix);
+    result.Seconds = 1e30;
+
+    for (int run = 0; run < runs; run++) {
+        // a fresh buffer every run, so the peak memory covers the source as well as the tokens
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(GenerateCorpus(mix, size));
+        size_t allocations = allocationCount.load();
+        size_t bytes = allocatedBytes.load();
+
+        auto start = std::chrono::steady_clock::now();
+        TokenStream tokens = Tokenize(source);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        result.Allocations = allocationCount.load() - allocations;
+        result.AllocatedBytes = allocatedBytes.load() - bytes;
+        result.PeakMemory = getPeakMemory();
+        result.Bytes = source->View().size();
+        result.Tokens = tokens.Tokens.size();
+        result.Seconds = std::min(result.Seconds, seconds);
+    }
+    return result;
+}
+
+// the numbers of a BenchResult, as they go through the pipe
+struct BenchNumbers {
+    size_t Bytes;
+    size_t Tokens;
+    double Seconds;
+    size_t Allocations;
+    size_t AllocatedBytes;
+    size_t PeakMemory;
+};
+
+// runs runMix in a child process, so every mix starts from a fresh heap and the peak RSS is its own rather than
+// the largest of every mix so far (runs in this process if the child can't be started)
+static BenchResult runMixIsolated(CorpusMix mix, size_t size, int runs) {
+    int descriptors[2];
+    if (pipe(descriptors) != 0) {
+        return runMix(mix, size, runs);
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        close(descriptors[0]);
+        close(descriptors[1]);
+        return runMix(mix, size, runs);
+    }
+
+    if (child == 0) {
+        close(descriptors[0]);
+        BenchResult result = runMix(mix, size, runs);
+        BenchNumbers numbers = {result.Bytes, result.Tokens, result.Seconds, result.Allocations, result.AllocatedBytes, result.PeakMemory};
+        ssize_t written = write(descriptors[1], &numbers, sizeof(numbers));
+        _exit(written == sizeof(numbers) ? 0 : 1);
+    }
+
+    close(descriptors[1]);
+    BenchNumbers numbers = {};
+    size_t received = 0;
+    while (received < sizeof(numbers)) {
+        ssize_t count = read(descriptors[0], reinterpret_cast<char*>(&numbers) + received, sizeof(numbers) - received);
+        if (count <= 0) {
+            break;
+        }
+        received += count;
+    }
+    close(descriptors[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (received != sizeof(numbers)) {
+        std::cerr << "Error: the benchmark of " << GetCorpusMixName(mix) << " failed, running it in this process" << std::endl;
+        return runMix(mix, size, runs);
+    }
+
+    BenchResult result;
+    result.Mix = GetCorpusMixName(mix);
+    result.Bytes = numbers.Bytes;
+    result.Tokens = numbers.Tokens;
+    result.Seconds = numbers.Seconds;
+    result.Allocations = numbers.Allocations;
+    result.AllocatedBytes = numbers.AllocatedBytes;
+    result.PeakMemory = numbers.PeakMemory;
+    return result;
+}
+
+static void writeJson(const std::string& path, const std::vector<BenchResult>& results, size_t size, int runs) {
+    std::ofstream out(path);
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"benchmark\": \"lexer\",\n  \"size_bytes\": " << size << ",\n  \"runs\": " << runs
+        << ",\n  \"scan_level\": \"" << GetScanLevelName(GetScanLevel()) << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        out << "    {\"mix\": \"" << result.Mix << "\", \"bytes\": " << result.Bytes << ", \"tokens\": " << result.Tokens
+            << ", \"seconds\": " << std::setprecision(6) << result.Seconds << std::setprecision(3)
+            << ", \"mb_per_s\": " << result.MegabytesPerSecond() << ", \"tokens_per_s\": " << result.TokensPerSecond()
+            << ", \"allocations\": " << result.Allocations << ", \"allocations_per_token\": " << result.AllocationsPerToken()
+            << ", \"allocated_bytes\": " << result.AllocatedBytes << ", \"peak_rss_kb\": " << result.PeakMemory << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+// reads one number of one mix back from a results file written by writeJson (returns 0 if it isn't there)
+static double readBaseline(const std::string& json, const std::string& mix, const std::string& field) {
+    size_t entry = json.find("\"mix\": \"" + mix + "\"");
+    if (entry == std::string::npos) {
+        return 0;
+    }
+    size_t end = json.find('}', entry);
+    size_t value = json.find("\"" + field + "\": ", entry);
+    if (value == std::string::npos || value > end) {
+        return 0;
+    }
+    return std::strtod(json.c_str() + value + field.size() + 4, nullptr);
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = size_t(8) << 20;
+    int runs = 3;
+    std::string only;
+    std::string jsonPath = "lexer_bench.json";
+    std::string baselinePath;
+    std::string corpusDirectory;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--size") {
+            size = static_cast<size_t>(std::stod(argv[i + 1]) * (1 << 20));
+        }
+        else if (option == "--runs") {
+            runs = std::max(1, std::stoi(argv[i + 1]));
+        }
+        else if (option == "--mix") {
+            only = argv[i + 1];
+        }
+        else if (option == "--json") {
+            jsonPath = argv[i + 1];
+        }
+        else if (option == "--baseline") {
+            baselinePath = argv[i + 1];
+        }
+        else if (option == "--write-corpus") {
+            corpusDirectory = argv[i + 1];
+        }
+        else {
+            std::cerr << "Error: unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<CorpusMix> mixes;
+    for (CorpusMix mix : GetCorpusMixes()) {
+        if (only.empty() || only == GetCorpusMixName(mix)) {
+            mixes.push_back(mix);
+        }
+    }
+    if (mixes.empty()) {
+        std::cerr << "Error: unknown mix " << only << std::endl;
+        return 1;
+    }
+
+    if (!corpusDirectory.empty()) {
+        for (CorpusMix mix : mixes) {
+            std::string path = corpusDirectory + "/" + GetCorpusMixName(mix) + ".ilys";
+            std::ofstream out(path, std::ios::binary);
+            out << GenerateCorpus(mix, size);
+            if (!out) {
+                std::cerr << "Error: could not write " << path << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    std::string baseline;
+    if (!baselinePath.empty()) {
+        std::ifstream in(baselinePath);
+        if (!in) {
+            std::cerr << "Error: could not read " << baselinePath << std::endl;
+            return 1;
+        }
+        baseline.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<BenchResult> results;
+    std::cout << std::fixed;
+    for (CorpusMix mix : mixes) {
+        results.push_back(runMixIsolated(mix, size, runs));
+        const BenchResult& result = results.back();
+        std::cout << std::left << std::setw(12) << result.Mix << std::right << std::setprecision(1)
+                  << std::setw(8) << result.MegabytesPerSecond() << " MB/s" << std::setw(8) << result.TokensPerSecond() / 1e6 << " Mtokens/s"
+                  << std::setprecision(3) << std::setw(8) << result.AllocationsPerToken() << " allocs/token"
+                  << std::setw(8) << result.PeakMemory / 1024 << " MB peak RSS";
+        double previous = readBaseline(baseline, result.Mix, "mb_per_s");
+        if (previous > 0) {
+            std::cout << std::showpos << std::setprecision(1) << "  (" << (result.MegabytesPerSecond() / previous - 1) * 100 << "% vs baseline)" << std::noshowpos;
+        }
+        std::cout << std::endl;
+    }
+
+    writeJson(jsonPath, results, size, runs);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// benchmark: building graphs of generated modules (a chain, where every module imports the next one, a wide
+// graph, where the entry imports every other module, and a tree, where every module imports two) with 1 to N
+// threads: the time to build, the cpu time all of the modules took and the longest chain of imports, which is the
+// least a build can take however many threads it has
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/module_bench.cpp Driver/modules.cpp Lexer/*.cpp Parser/*.cpp Support/*.cpp VM/*.cpp -o module_bench
+// usage: module_bench [--modules N] [--functions N] [--threads N] [--runs N]
+#include "../Driver/modules.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+enum class GraphShape {
+    CHAIN,
+    WIDE,
+    TREE
+};
+
+static const char* graphShapeName(GraphShape shape) {
+    switch (shape) {
+        case GraphShape::CHAIN: return "chain";
+        case GraphShape::WIDE: return "wide";
+        case GraphShape::TREE: return "tree";
+    }
+    return "?";
+}
+
+// the modules that module i imports
+static std::vector<size_t> importsOf(GraphShape shape, size_t i, size_t count) {
+    switch (shape) {
+        case GraphShape::CHAIN:
+            return i + 1 < count ? std::vector<size_t>{i + 1} : std::vector<size_t>();
+        case GraphShape::WIDE: {
+            std::vector<size_t> imports;
+            for (size_t j = 1; i == 0 && j < count; j++) {
+                imports.push_back(j);
+            }
+            return imports;
+        }
+        case GraphShape::TREE: {
+            std::vector<size_t> imports;
+            for (size_t j = 2 * i + 1; j <= 2 * i + 2 && j < count; j++) {
+                imports.push_back(j);
+            }
+            return imports;
+        }
+    }
+    return {};
+}
+
+// writes the modules of a graph into folder: module i exports vi (one more than the sum of what it imports) and
+// has functions of arithmetic and loops to give it some size
+static void writeGraph(const std::filesystem::path& folder, GraphShape shape, size_t count, size_t functions) {
+    std::filesystem::create_directories(folder);
+    for (size_t i = 0; i < count; i++) {
+        std::ofstream out(folder / ("m" + std::to_string(i) + ".ilys"));
+        std::vector<size_t> imports = importsOf(shape, i, count);
+        for (size_t j : imports) {
+            out << "import v" << j << " from \"m" << j << "\"\n";
+        }
+        for (size_t f = 0; f < functions; f++) {
+            out << "func f" << f << "(n) {\n    let total = " << f << ";\n    for i in 0..n {\n        if i % 3 == 0 { total += i * " << f + 1
+                << "; } else { total -= i / 2; }\n    }\n    return total + " << f << " * 2 - 1;\n}\n";
+        }
+        out << "export const v" << i << " = 1";
+        for (size_t j : imports) {
+            out << " + v" << j;
+        }
+        out << ";\n";
+        if (i == 0) {
+            out << "print(v0);\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = 63;
+    size_t functions = 200;
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int runs = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--modules") == 0) {
+            count = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--functions") == 0) {
+            functions = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0) {
+            maxThreads = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--runs") == 0) {
+            runs = std::stoi(argv[i + 1]);
+        }
+    }
+
+    char directory[] = "/tmp/module-bench-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "could not create a directory for the modules" << std::endl;
+        return 1;
+    }
+    int status = 0;
+    for (GraphShape shape : {GraphShape::CHAIN, GraphShape::WIDE, GraphShape::TREE}) {
+        std::filesystem::path folder = std::filesystem::path(directory) / graphShapeName(shape);
+        writeGraph(folder, shape, count, functions);
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            ModuleStats best;
+            best.WallSeconds = 1e30;
+            for (int run = 0; run < runs; run++) {
+                ThreadPool pool(threads);
+                ModuleGraph graph(std::make_shared<SymbolTable>());
+                size_t entry = graph.Build({(folder / "m0.ilys").string()}, pool, ModuleOptions())[0];
+                if (!graph.GetModule(entry).Compiled) {
+                    std::cerr << graphShapeName(shape) << ": does not compile" << std::endl;
+                    status = 1;
+                    break;
+                }
+                if (graph.GetStats().WallSeconds < best.WallSeconds) {
+                    best = graph.GetStats();
+                }
+            }
+            std::cout << std::left << std::setw(6) << graphShapeName(shape) << std::right << " threads " << std::setw(2) << threads << std::fixed
+                      << std::setprecision(1) << "  built in " << std::setw(7) << best.WallSeconds * 1e3 << " ms  cpu " << std::setw(7)
+                      << (best.LoadSeconds + best.CompileSeconds) * 1e3 << " ms  longest chain " << std::setw(7) << best.CriticalSeconds * 1e3
+                      << " ms (" << best.Depth << " modules)  at most " << std::setprecision(2)
+                      << (best.LoadSeconds + best.CompileSeconds) / best.CriticalSeconds << "x faster" << std::endl;
+        }
+    }
+    std::filesystem::remove_all(directory);
+    return status;
+}
@@ -0,0 +1,191 @@
+// benchmark: what every optimizer pass costs at compile time (on the generated corpora of every mix, see corpus.h,
+// next to parsing them) and what it saves at run time (small programs run with every pass, with none and with each
+// one left out)
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/optimizer_bench.cpp Lexer/*.cpp Parser/*.cpp Support/*.cpp VM/*.cpp -o optimizer_bench
+// usage: optimizer_bench [--size MB] [--runs N] [--program name]
+#include "../Lexer/lexer.h"
+#include "../Parser/parser.h"
+#include "../VM/compiler.h"
+#include "../VM/optimizer.h"
+#include "../VM/vm.h"
+#include "corpus.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+struct BenchProgram {
+    const char* Name;
+    const char* Source;
+    // what the program prints, checked after every run
+    const char* Expected;
+};
+
+static const BenchProgram programs[] = {
+    {"constants", R"(
+        const width = 64;
+        const height = 48;
+        const scale = width * height / 16;
+        const offset = scale - 2 * width;
+        func run() {
+            let total = 0;
+            for y in 0..height * 100 - 1 {
+                for x in 0..width - 1 {
+                    total += (x * scale + y * width + offset) % 1000;
+                }
+            }
+            return total;
+        }
+        print(run());
+    )", "152373000\n"},
+    {"debug-flags", R"(
+        const debug = false;
+        const trace = debug && true;
+        func step(i) {
+            if debug { print("step", i); }
+            if trace { print("trace"); }
+            return debug ? 0 : i % 7;
+        }
+        func run() {
+            let total = 0;
+            for i in 0..999999 {
+                total += step(i);
+            }
+            return total;
+        }
+        print(run());
+    )", "2999997\n"},
+    {"range-loops", R"(
+        func run() {
+            let total = 0;
+            for i in 0..999 {
+                for j in 0..999 {
+                    total += i * j % 7;
+                }
+            }
+            return total;
+        }
+        print(run());
+    )", "2570569\n"},
+    {"identities", R"(
+        func run() {
+            let total = 0;
+            for i in 0..999999 {
+                let x = i * 2;
+                total += x * 1 - 0 + -(-x) / 1;
+                if !(x % 3 == 0) { total++; }
+            }
+            return total;
+        }
+        print(run());
+    )", "1999998666666\n"},
+};
+
+// runs fn a few times and keeps the fastest, in seconds
+template <typename Function>
+double bestOf(int runs, Function function) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = 8;
+    int runs = 3;
+    std::string only;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--size") == 0) {
+            size = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--runs") == 0) {
+            runs = std::stoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--program") == 0) {
+            only = argv[i + 1];
+        }
+    }
+
+    // the passes rewrite the tree, so every run parses a fresh one (the parse is timed apart)
+    for (CorpusMix mix : GetCorpusMixes()) {
+        if (!only.empty()) {
+            break;
+        }
+        TokenStream tokens = Tokenize(SourceBuffer::FromString(GenerateCorpus(mix, size << 20)));
+        double parsing = 1e30;
+        OptimizeStats best;
+        for (int run = 0; run < runs; run++) {
+            Ast ast;
+            std::vector<Diagnostic> diagnostics;
+            auto start = std::chrono::steady_clock::now();
+            Parse(tokens, ast, diagnostics);
+            parsing = std::min(parsing, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            OptimizeStats stats;
+            Optimize(tokens, ast, OptimizeOptions(), &stats);
+            for (size_t i = 0; i < PassCount; i++) {
+                best.Seconds[i] = run == 0 ? stats.Seconds[i] : std::min(best.Seconds[i], stats.Seconds[i]);
+                best.Rewrites[i] = stats.Rewrites[i];
+            }
+        }
+        double total = 0;
+        std::cout << std::left << std::setw(12) << GetCorpusMixName(mix) << std::right << std::fixed << std::setprecision(2)
+                  << " parse " << std::setw(7) << parsing * 1e3 << " ms  ";
+        for (size_t i = 0; i < PassCount; i++) {
+            std::cout << " " << PassNames[i] << " " << best.Seconds[i] * 1e3 << " ms (" << best.Rewrites[i] << ")";
+            total += best.Seconds[i];
+        }
+        std::cout << "   all " << total * 1e3 << " ms, " << std::setprecision(1) << total / parsing * 100 << "% of the parse" << std::endl;
+    }
+
+    // every pass, none, then each one left out
+    std::vector<OptimizeOptions> variants(2);
+    variants[1].Passes = 0;
+    for (size_t i = 0; i < PassCount; i++) {
+        variants.emplace_back();
+        variants.back().SetEnabled(static_cast<Pass>(i), false);
+    }
+    VirtualMachine vm;
+    for (const BenchProgram& bench : programs) {
+        if (!only.empty() && only != bench.Name) {
+            continue;
+        }
+        TokenStream tokens = Tokenize(std::string(bench.Source));
+        std::vector<double> seconds;
+        for (const OptimizeOptions& options : variants) {
+            Ast ast;
+            std::vector<Diagnostic> diagnostics;
+            Program program;
+            if (!Parse(tokens, ast, diagnostics)) {
+                std::cerr << bench.Name << ": does not parse" << std::endl;
+                return 1;
+            }
+            Optimize(tokens, ast, options);
+            if (!Compile(tokens, ast, program, diagnostics)) {
+                std::cerr << bench.Name << ": does not compile" << std::endl;
+                return 1;
+            }
+            bool failed = false;
+            seconds.push_back(bestOf(runs, [&]() {
+                std::string output;
+                Diagnostic error;
+                failed |= !vm.Run(program, output, &error) || output != bench.Expected;
+            }));
+            if (failed) {
+                std::cerr << bench.Name << ": wrong result" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << std::left << std::setw(12) << bench.Name << std::right << std::fixed << std::setprecision(1) << " optimized "
+                  << std::setw(6) << seconds[0] * 1e3 << " ms   unoptimized " << std::setw(6) << seconds[1] * 1e3 << " ms   "
+                  << std::setprecision(2) << seconds[1] / seconds[0] << "x   without:";
+        for (size_t i = 0; i < PassCount; i++) {
+            std::cout << " " << PassNames[i] << " " << std::setprecision(1) << seconds[i + 2] * 1e3 << " ms";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// benchmark: TokenizeParallel on one large generated file with 1..N threads
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/parallel_bench.cpp Lexer/*.cpp Support/*.cpp -o parallel_bench
+// usage: parallel_bench [max threads] (defaults to the number of hardware threads)
+#include "../Lexer/parallel.h"
+
+#include <chrono>
+
+// a mix of declarations, loops, strings and arithmetic, about size bytes
+std::string generateSource(size_t size) {
+    std::string source;
+    unsigned int seed = 11;
+    while (source.size() < size) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 16;
+        switch (r % 4) {
+            case 0: source += "let value_" + std::to_string(r % 977) + " = (" + std::to_string(r % 100) + " * 3.5) - count;\n"; break;
+            case 1: source += "for i in 0..10 { total += i % 3; }\n"; break;
+            case 2: source += "const message = \"value is \\\"" + std::to_string(r) + "\\\" here\";\n"; break;
+            default: source += "if (a >= b && c != d) { x = -5; } else { x++; }\n"; break;
+        }
+    }
+    return source;
+}
+
+// runs fn a few times and keeps the fastest, in seconds
+template <typename Function>
+double bestOf(int runs, Function function) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = argc > 1 ? std::stoul(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(generateSource(32 << 20));
+    double megabytes = source->View().size() / double(1 << 20);
+
+    size_t expected = 0;
+    double sequential = bestOf(3, [&]() {
+        expected = Tokenize(source).Tokens.size();
+    });
+    std::cout << "sequential: " << std::fixed << std::setprecision(1) << megabytes / sequential << " MB/s" << std::endl;
+
+    for (size_t threads = 1; threads <= maxThreads; threads++) {
+        ThreadPool pool(threads);
+        size_t count = 0;
+        double seconds = bestOf(3, [&]() {
+            count = TokenizeParallel(source, pool).Tokens.size();
+        });
+        if (count != expected) {
+            std::cerr << "Error: " << threads << " threads produced " << count << " tokens instead of " << expected << std::endl;
+            return 1;
+        }
+        std::cout << threads << " threads: " << megabytes / seconds << " MB/s (" << std::setprecision(2) << sequential / seconds << "x)" << std::setprecision(1) << std::endl;
+    }
+    return 0;
+}
\ No newline at end of file
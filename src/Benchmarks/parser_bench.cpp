@@ -0,0 +1,69 @@
+// benchmark: Parse throughput next to Tokenize on the generated corpora of every mix (see corpus.h), with the
+// size of the trees
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/parser_bench.cpp Lexer/*.cpp Parser/*.cpp Support/*.cpp -o parser_bench
+// usage: parser_bench [--size MB] [--runs N]
+#include "../Lexer/lexer.h"
+#include "../Parser/parser.h"
+#include "corpus.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// runs fn a few times and keeps the fastest, in seconds
+template <typename Function>
+double bestOf(int runs, Function function) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = 8;
+    int runs = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--size") == 0) {
+            size = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--runs") == 0) {
+            runs = std::stoi(argv[i + 1]);
+        }
+    }
+
+    for (CorpusMix mix : GetCorpusMixes()) {
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(GenerateCorpus(mix, size << 20));
+        double megabytes = source->View().size() / double(1 << 20);
+
+        TokenStream tokens;
+        double lexing = bestOf(runs, [&]() {
+            tokens = Tokenize(source);
+        });
+
+        // a fresh tree every run, so the allocation of the node array is measured too
+        size_t nodes = 0;
+        size_t errors = 0;
+        double parsing = bestOf(runs, [&]() {
+            Ast ast;
+            std::vector<Diagnostic> diagnostics;
+            Parse(tokens, ast, diagnostics);
+            nodes = ast.GetNodeCount();
+            errors = diagnostics.size();
+        });
+
+        std::cout << std::left << std::setw(12) << GetCorpusMixName(mix) << std::right << std::fixed << std::setprecision(1)
+                  << " lex " << std::setw(7) << megabytes / lexing << " MB/s   parse " << std::setw(7) << megabytes / parsing
+                  << " MB/s " << std::setw(7) << nodes / parsing / 1e6 << " Mnodes/s   " << std::setprecision(2)
+                  << double(nodes) / tokens.Tokens.size() << " nodes/token, " << nodes * sizeof(Node) / double(1 << 20)
+                  << " MB of nodes" << std::endl;
+        if (errors != 0) {
+            std::cerr << GetCorpusMixName(mix) << ": " << errors << " parse errors in a generated corpus" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
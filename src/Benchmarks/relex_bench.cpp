@@ -0,0 +1,58 @@
+// benchmark: per-edit latency of Relex on an IncrementalStream compared with lexing the whole file again, for
+// growing file sizes, fails if the latency grows with the file
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/relex_bench.cpp Lexer/*.cpp Support/*.cpp -o relex_bench
+#include "../Lexer/incremental.h"
+
+#include <chrono>
+
+// declarations and loops, about size bytes
+std::string generateSource(size_t size) {
+    std::string source;
+    unsigned int seed = 3;
+    while (source.size() < size) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 16;
+        source += (r & 1) ? "let value_" + std::to_string(r % 977) + " = (" + std::to_string(r % 100) + " * 3.5) - count;\n"
+                          : "for i in 0..10 { total += \"text\"; }\n";
+    }
+    return source;
+}
+
+int main() {
+    std::unique_ptr<Lexer> lexer(ConstructLexer(SourceBuffer::FromString("")));
+
+    std::vector<double> medians;
+    for (size_t size : {size_t(64) << 10, size_t(1) << 20, size_t(16) << 20}) {
+        std::string source = generateSource(size);
+        auto start = std::chrono::steady_clock::now();
+        TokenStream tokens = Tokenize(source);
+        double full = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        IncrementalStream document(tokens);
+
+        // typing: insert a character, then delete it again, all over the file
+        std::vector<double> latencies;
+        unsigned int seed = 5;
+        for (int i = 0; i < 200; i++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t offset = (seed >> 4) % document.GetSize();
+            start = std::chrono::steady_clock::now();
+            document.Relex(lexer.get(), {offset, 0, "z"});
+            document.Relex(lexer.get(), {offset, 1, ""});
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / 2);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        medians.push_back(latencies[latencies.size() / 2]);
+
+        std::cout << std::fixed << std::setprecision(1) << (size >> 10) << " KB: full Tokenize " << full << " us, Relex p50 "
+                  << latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us" << std::endl;
+    }
+
+    // an edit only re-lexes its chunk, so 256 times the file should cost about the same (a few times more
+    // leaves room for cache misses and a noisy machine, an O(file) edit is hundreds of times more)
+    if (medians.back() > 4 * medians.front() + 5) {
+        std::cout << "Relex p50 grew from " << medians.front() << " us to " << medians.back() << " us with the file" << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// benchmark: Tokenize on whitespace, string, identifier and non-ASCII (names and strings in other scripts) heavy
+// sources with every scan kernel level the CPU supports, and ValidateUtf8 on each of them
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/scan_bench.cpp Lexer/*.cpp Support/*.cpp -o scan_bench
+#include "../Lexer/lexer.h"
+#include "../Lexer/utf8.h"
+
+#include <chrono>
+
+// repeats generated lines until the source is about size bytes
+std::string generateSource(const std::string& kind, size_t size) {
+    std::string source;
+    unsigned int seed = 7;
+    while (source.size() < size) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 16;
+        if (kind == "whitespace") {
+            source += "let x = 1;";
+            source.append(32 + r % 256, ' ');
+            source.append(1 + r % 3, '\n');
+            source.append(r % 8, '\t');
+        }
+        else if (kind == "string") {
+            source += "let s = \"";
+            for (unsigned int i = 0; i < 64 + r % 512; i++) {
+                source += static_cast<char>('a' + (i * 7 + r) % 26);
+            }
+            source += (r & 1) ? "\\\"quoted\\\"" : " plain";
+            source += "\";\n";
+        }
+        else if (kind == "unicode") {
+            source += "let größe_";
+            source += std::to_string(r % 1000);
+            source += " = \"名前と値 ";
+            source.append(r % 64, 'a');
+            source += "\" + café_crème;\n";
+        }
+        else {
+            source += "let some_longer_identifier_";
+            source += std::to_string(r % 1000);
+            source += " = another_identifier_name + value_of_thing;\n";
+        }
+    }
+    return source;
+}
+
+int main() {
+    const size_t size = 16 << 20;
+    ScanLevel best = GetScanLevel();
+
+    for (const std::string kind : {"whitespace", "string", "identifier", "unicode"}) {
+        std::string source = generateSource(kind, size);
+        size_t expected = 0;
+
+        for (int level = 0; level <= static_cast<int>(best); level++) {
+            SetScanLevel(static_cast<ScanLevel>(level));
+            auto start = std::chrono::steady_clock::now();
+            TokenStream tokens = Tokenize(source);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (level == 0) {
+                expected = tokens.Tokens.size();
+            }
+            else if (tokens.Tokens.size() != expected) {
+                std::cerr << "Error: " << GetScanLevelName(static_cast<ScanLevel>(level)) << " produced a different token count" << std::endl;
+                return 1;
+            }
+
+            start = std::chrono::steady_clock::now();
+            size_t length;
+            if (ValidateUtf8(source, 0, &length) != source.size()) {
+                std::cerr << "Error: " << kind << " isn't valid UTF-8" << std::endl;
+                return 1;
+            }
+            double validation = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << std::left << std::setw(12) << kind << std::setw(8) << GetScanLevelName(static_cast<ScanLevel>(level))
+                      << std::fixed << std::setprecision(1) << (source.size() / seconds) / (1 << 20) << " MB/s, validated at "
+                      << (source.size() / validation) / (1 << 20) << " MB/s" << std::endl;
+        }
+    }
+    SetScanLevel(best);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+// benchmark: latency of a small script run through the compile server (a server on a thread of this process,
+// reached over its socket like a client process would) against the same run in a session of its own per run
+// (what a process pays past its own startup: the pool, the lexers, the symbols) and, given the binary, against
+// a process per run
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/server_bench.cpp Driver/*.cpp Lexer/*.cpp Parser/*.cpp Support/*.cpp VM/*.cpp -o server_bench
+// usage: server_bench [--runs N] [--jobs N] [--binary path to ilys]
+#include "../Driver/server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <spawn.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+
+extern char** environ;
+
+static const char* script = R"(
+    func fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2) }
+    let total = 0
+    for i in 0..9 { total += fib(i) }
+    print("total", total)
+)";
+
+// times every call of function, in microseconds, and prints their percentiles
+template <typename Function>
+static void measure(const char* name, int runs, Function function) {
+    std::vector<double> latencies;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!function()) {
+            std::cerr << name << ": a run failed" << std::endl;
+            std::exit(1);
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](size_t percent) {
+        return latencies[(latencies.size() - 1) * percent / 100];
+    };
+    std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(1) << " p50 " << std::setw(8) << percentile(50)
+              << " us  p90 " << std::setw(8) << percentile(90) << " us  p99 " << std::setw(8) << percentile(99) << " us" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 500;
+    size_t threads = 0;
+    std::string binary;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--runs") == 0) {
+            runs = std::stoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--jobs") == 0) {
+            threads = std::stoul(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--binary") == 0) {
+            binary = argv[i + 1];
+        }
+    }
+
+    char directory[] = "/tmp/server-bench-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "could not create a directory for the script" << std::endl;
+        return 1;
+    }
+    std::string file = std::string(directory) + "/script.ilys";
+    std::string socket = std::string(directory) + "/server.sock";
+    std::ofstream(file) << script;
+    std::vector<std::string> arguments = {"--run", file};
+    const std::string expected = "total 88\n";
+
+    DriverOptions options;
+    options.Threads = threads;
+    std::ostringstream log;
+    std::thread server([&]() {
+        RunServer(socket, options, log);
+    });
+    ServerReply reply;
+    std::string error;
+    for (int attempt = 0; attempt < 200 && !SendRequest(socket, RequestKind::RUN, arguments, reply, &error); attempt++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    measure("server", runs, [&]() {
+        return SendRequest(socket, RequestKind::RUN, arguments, reply, &error) && reply.Output == expected;
+    });
+    measure("session per run", runs, [&]() {
+        DriverOptions run;
+        ParseDriverOptions(arguments, run, &error);
+        run.Threads = threads;
+        std::unique_ptr<DriverSession> session = DriverSession::Open(run, false, &error);
+        std::ostringstream out;
+        std::ostringstream err;
+        return session->Run(run, out, err) == 0 && out.str() == expected;
+    });
+    if (!binary.empty()) {
+        std::string jobs = std::to_string(threads);
+        measure("process per run", std::min(runs, 200), [&]() {
+            const char* command[] = {binary.c_str(), "--quiet", "--run", file.c_str(), "--jobs", jobs.c_str(), nullptr};
+            pid_t child;
+            int status;
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+            bool spawned = posix_spawn(&child, binary.c_str(), &actions, nullptr, const_cast<char**>(command), environ) == 0;
+            posix_spawn_file_actions_destroy(&actions);
+            return spawned && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        });
+    }
+
+    SendRequest(socket, RequestKind::STOP, {}, reply, &error);
+    server.join();
+    std::cout << reply.Errors;
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,49 @@
+// benchmark: per-file cost of lexing a batch of small files, one Tokenize (new lexer) per file vs one lexer and
+// one stream reused for the whole batch
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/startup_bench.cpp Lexer/*.cpp Support/*.cpp -o startup_bench
+// usage: startup_bench [files] [bytes per file] (defaults to 2000 files of 400 bytes)
+#include "../Lexer/lexer.h"
+#include "corpus.h"
+
+#include <chrono>
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 2000;
+    size_t size = argc > 2 ? std::stoul(argv[2]) : 400;
+
+    std::vector<std::shared_ptr<const SourceBuffer>> files;
+    for (size_t i = 0; i < count; i++) {
+        files.push_back(SourceBuffer::FromString(GenerateCorpus(CorpusMix::MIXED, size, static_cast<unsigned int>(i + 1))));
+    }
+
+    // the rule set is built by the first lexer of the process, timed on its own
+    auto start = std::chrono::steady_clock::now();
+    RuleSet::GetDefault();
+    double rules = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t fresh = 0;
+    start = std::chrono::steady_clock::now();
+    for (const std::shared_ptr<const SourceBuffer>& file : files) {
+        fresh += Tokenize(file).Tokens.size();
+    }
+    double perFile = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / count;
+
+    size_t reused = 0;
+    std::unique_ptr<Lexer> lexer = ConstructLexer(SourceBuffer::FromString(""));
+    TokenStream stream;
+    start = std::chrono::steady_clock::now();
+    for (const std::shared_ptr<const SourceBuffer>& file : files) {
+        Tokenize(lexer.get(), file, stream);
+        reused += stream.Tokens.size();
+    }
+    double perFileReused = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / count;
+
+    if (fresh != reused) {
+        std::cerr << "Error: " << fresh << " tokens with a lexer per file but " << reused << " with one lexer" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1) << count << " files of " << size << " bytes, rules built once in " << rules << " ms\n"
+              << "Tokenize per file:      " << perFile << " us/file\n"
+              << "one lexer, Reset:       " << perFileReused << " us/file" << std::endl;
+    return 0;
+}
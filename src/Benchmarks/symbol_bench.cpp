@@ -0,0 +1,64 @@
+// benchmark: interning the identifiers of a generated corpus, memory per unique name vs per occurrence,
+// and SymbolTable::Intern from 1..N threads at once
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/symbol_bench.cpp Lexer/*.cpp Support/*.cpp -o symbol_bench
+// usage: symbol_bench [max threads] (defaults to the number of hardware threads)
+#include "../Lexer/lexer.h"
+#include "corpus.h"
+
+#include <chrono>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = argc > 1 ? std::stoul(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    TokenStream tokens = Tokenize(GenerateCorpus(CorpusMix::MIXED, 16 << 20));
+
+    std::vector<std::string_view> names;
+    size_t occurrenceBytes = 0;
+    for (const Token& token : tokens.Tokens) {
+        if (token.type == TokenType::IDENTIFIER || token.type == TokenType::STRING) {
+            names.push_back(tokens.Text(token));
+            occurrenceBytes += token.length;
+        }
+    }
+    std::cout << names.size() << " names (" << occurrenceBytes / 1024 << " KB as one string each), "
+              << tokens.Symbols->GetSymbolCount() << " symbols (" << tokens.Symbols->GetBytesUsed() / 1024 << " KB in the arenas)" << std::endl;
+
+    // one thread, straight into the table and through a lexer's cache
+    {
+        SymbolTable table;
+        auto start = std::chrono::steady_clock::now();
+        for (std::string_view name : names) {
+            table.Intern(name);
+        }
+        double direct = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / names.size();
+
+        SymbolTable cached;
+        SymbolCache cache;
+        start = std::chrono::steady_clock::now();
+        for (std::string_view name : names) {
+            cache.Intern(cached, name);
+        }
+        double withCache = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / names.size();
+        std::cout << std::fixed << std::setprecision(1) << "Intern: " << direct << " ns, with a SymbolCache: " << withCache << " ns" << std::endl;
+    }
+
+    // every thread interns its own slice of the names into one shared table
+    for (size_t threads = 1; threads <= maxThreads; threads++) {
+        SymbolTable table;
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                for (size_t i = t; i < names.size(); i += threads) {
+                    table.Intern(names[i]);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << threads << " threads: " << std::setprecision(1) << names.size() / seconds / 1e6 << " M interns/s" << std::endl;
+    }
+    return 0;
+}
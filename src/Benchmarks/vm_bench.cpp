@@ -0,0 +1,214 @@
+// benchmark: small Ilys programs (calls, loops, strings, arrays, objects) optimized, compiled and run by the VM, with
+// and without the superinstructions, the dispatch the VM was built with, what the garbage collector did and how
+// often the inline caches of field accesses hit
+// build from src/: g++ -std=c++17 -O2 -pthread Benchmarks/vm_bench.cpp Lexer/*.cpp Parser/*.cpp Support/*.cpp VM/*.cpp -o vm_bench
+//   (add -DILYS_COMPUTED_GOTO=0 for the switch dispatch)
+// usage: vm_bench [--runs N] [--program name]
+#include "../Lexer/lexer.h"
+#include "../Parser/parser.h"
+#include "../VM/compiler.h"
+#include "../VM/optimizer.h"
+#include "../VM/vm.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+struct BenchProgram {
+    const char* Name;
+    const char* Source;
+    // what the program prints, checked after every run
+    const char* Expected;
+};
+
+static const BenchProgram programs[] = {
+    {"fib", R"(
+        func fib(n) {
+            if n < 2 { return n; }
+            return fib(n - 1) + fib(n - 2);
+        }
+        print(fib(27));
+    )", "196418\n"},
+    {"range-loops", R"(
+        func run() {
+            let total = 0;
+            for i in 0..999 {
+                for j in 0..999 {
+                    total += i * j % 7;
+                }
+            }
+            return total;
+        }
+        print(run());
+    )", "2570569\n"},
+    {"while-loop", R"(
+        func run() {
+            let i = 0;
+            let count = 0;
+            while i < 3000000 {
+                if i % 3 == 0 && i != 7 { count++; }
+                i++;
+            }
+            return count;
+        }
+        print(run());
+    )", "1000000\n"},
+    {"string-concat", R"(
+        func run() {
+            let length = 0;
+            for i in 0..199999 {
+                let item = "item " + i;
+                length += len(item);
+            }
+            let line = "";
+            for i in 0..4999 {
+                line = line + "x";
+            }
+            return length + len(line);
+        }
+        print(run());
+    )", "2093890\n"},
+    {"arrays", R"(
+        func run() {
+            let values = [];
+            for i in 0..999999 {
+                push(values, i % 100);
+            }
+            let total = 0;
+            for value in values {
+                total += value;
+            }
+            return total;
+        }
+        print(run());
+    )", "49500000\n"},
+    {"temporaries", R"(
+        func run() {
+            let total = 0;
+            for i in 0..999999 {
+                let point = {x: i, y: i + 1};
+                let pair = [point, "label"];
+                total += pair[0].x + point.y;
+            }
+            return total;
+        }
+        print(run());
+    )", "1000000000000\n"},
+    {"fields", R"(
+        class Particle {
+            let x = 0;
+            let y = 0;
+            let dx = 1;
+            let dy = 2;
+            func step(p) { p.x += p.dx; p.y += p.dy; }
+        }
+        func run() {
+            let particles = [];
+            for i in 0..99 { let p = new Particle(); p.dx = i; push(particles, p); }
+            for t in 0..9999 {
+                for p in particles { p.step(p); }
+            }
+            let total = 0;
+            for p in particles { total += p.x + p.y; }
+            return total;
+        }
+        print(run());
+    )", "51500000\n"},
+    {"polymorphic", R"(
+        func area(s) { return s.w * s.h; }
+        func run() {
+            let shapes = [{w: 1, h: 2}, {h: 3, w: 4}, {name: "c", w: 5, h: 6}, {w: 7, depth: 0, h: 8}];
+            let total = 0;
+            for i in 0..249999 {
+                for s in shapes { total += area(s); }
+            }
+            return total;
+        }
+        print(run());
+    )", "25000000\n"},
+};
+
+// runs fn a few times and keeps the fastest, in seconds
+template <typename Function>
+double bestOf(int runs, Function function) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 3;
+    std::string only;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--runs") == 0) {
+            runs = std::stoi(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--program") == 0) {
+            only = argv[i + 1];
+        }
+    }
+
+    std::cout << "dispatch: " << VirtualMachine::GetDispatchName() << std::endl;
+    for (const BenchProgram& bench : programs) {
+        if (!only.empty() && only != bench.Name) {
+            continue;
+        }
+        TokenStream tokens = Tokenize(std::string(bench.Source));
+        Ast ast;
+        std::vector<Diagnostic> diagnostics;
+        if (!Parse(tokens, ast, diagnostics)) {
+            std::cerr << bench.Name << ": does not parse" << std::endl;
+            return 1;
+        }
+        Optimize(tokens, ast, OptimizeOptions());
+
+        VirtualMachine vm;
+        double seconds[2];
+        size_t instructions[2];
+        for (int super = 0; super < 2; super++) {
+            Program program;
+            CompileOptions options;
+            options.Superinstructions = super == 1;
+            if (!Compile(tokens, ast, program, diagnostics, options)) {
+                std::cerr << bench.Name << ": does not compile" << std::endl;
+                return 1;
+            }
+            instructions[super] = 0;
+            for (const std::unique_ptr<Function>& function : program.Functions) {
+                instructions[super] += function->Code.size();
+            }
+            bool failed = false;
+            seconds[super] = bestOf(runs, [&]() {
+                std::string output;
+                Diagnostic error;
+                failed |= !vm.Run(program, output, &error) || output != bench.Expected;
+            });
+            if (failed) {
+                std::cerr << bench.Name << ": wrong result" << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << std::left << std::setw(14) << bench.Name << std::right << std::fixed << std::setprecision(1)
+                  << " plain " << std::setw(7) << seconds[0] * 1e3 << " ms   superinstructions " << std::setw(7) << seconds[1] * 1e3
+                  << " ms   " << std::setprecision(2) << seconds[0] / seconds[1] << "x   (" << instructions[0] << " -> "
+                  << instructions[1] << " words of code)" << std::endl;
+        const GcStats& gc = vm.GetHeap().GetStats();
+        std::cout << std::setw(14) << "" << " gc: " << std::setprecision(1) << gc.AllocatedBytes / 1048576.0 << " MB allocated, "
+                  << gc.PromotedBytes / 1048576.0 << " MB promoted, " << gc.MinorCollections << " minor / " << gc.MajorCollections
+                  << " major collections, longest pause " << std::setprecision(3) << gc.LongestPause * 1e3 << " ms" << std::endl;
+        const ShapeStats& shapes = vm.GetShapeStats();
+        uint64_t accesses = shapes.MonomorphicHits + shapes.PolymorphicHits + shapes.Misses;
+        if (accesses > 0) {
+            std::cout << std::setw(14) << "" << " fields: " << accesses << " accesses, " << std::setprecision(2)
+                      << (shapes.MonomorphicHits + shapes.PolymorphicHits) * 100.0 / accesses << "% cache hits ("
+                      << shapes.PolymorphicHits * 100.0 / accesses << "% polymorphic), " << shapes.MegamorphicMisses << " megamorphic misses" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,547 @@
+#include "driver.h"
+#include "modules.h"
+#include "../Lexer/parallel.h"
+#include "../Parser/parser.h"
+#include "../VM/vm.h"
+
+#include "../Support/hash.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+
+// what lexing one file gave, kept until every file before it was printed
+struct FileResult {
+    std::string Output;
+    std::string Error;
+    std::string Diagnostics;  // already formatted, see AppendDiagnostics
+    std::string Warnings;     // same, for the session's err stream (see lexSource)
+    size_t Errors = 0;
+    size_t Bytes = 0;
+    size_t Tokens = 0;
+    double Seconds = 0;  // cpu time of the worker, waiting for a core doesn't count
+    GcStats Gc;          // of the run, if the file was run
+    ShapeStats Shapes;   // same
+    OptimizeStats Optimizer;
+    bool Imported = false;  // a module only imported, nothing of it is printed but its diagnostics
+};
+
+// idle lexers, taken by a task for one file and given back after, so a run builds about one lexer per worker
+// and every file is lexed by a Reset lexer (see Lexer::Reset) that already has its buffers
+class LexerPool {
+    public:
+        LexerPool(std::shared_ptr<SymbolTable> symbols, bool stats) : Symbols(std::move(symbols)), Stats(stats) {
+        }
+
+        std::unique_ptr<Lexer> Acquire() {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!Idle.empty()) {
+                    std::unique_ptr<Lexer> lexer = std::move(Idle.back());
+                    Idle.pop_back();
+                    return lexer;
+                }
+            }
+            std::unique_ptr<Lexer> lexer = ConstructLexer(SourceBuffer::FromString(""));
+            lexer->SetSymbols(Symbols);
+            if (Stats) {
+                lexer->EnableStats();
+            }
+            return lexer;
+        }
+
+        void Release(std::unique_ptr<Lexer> lexer) {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Idle.push_back(std::move(lexer));
+        }
+
+        // adds up the counters of every idle lexer (all of them once the run is over), null without stats. a lexer
+        // whose rules differ from the first one's can't be added, those are counted in mismatched instead
+        std::unique_ptr<LexerStats> MergeStats(size_t* mismatched) {
+            std::lock_guard<std::mutex> lock(Mutex);
+            std::unique_ptr<LexerStats> merged;
+            *mismatched = 0;
+            for (const std::unique_ptr<Lexer>& lexer : Idle) {
+                if (!lexer->GetStats()) {
+                    continue;
+                }
+                if (!merged) {
+                    merged = std::make_unique<LexerStats>(*lexer->GetStats());
+                }
+                else if (!merged->Merge(*lexer->GetStats())) {
+                    (*mismatched)++;
+                }
+            }
+            return merged;
+        }
+
+    private:
+        std::shared_ptr<SymbolTable> Symbols;
+        bool Stats;
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<Lexer>> Idle;
+};
+
+// idle virtual machines, like the lexers: a run takes one for a file and gives it back after, so a session
+// allocates the stack and the nursery of about one machine per worker instead of one per file run
+class MachinePool {
+    public:
+        std::unique_ptr<VirtualMachine> Acquire() {
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                if (!Idle.empty()) {
+                    std::unique_ptr<VirtualMachine> vm = std::move(Idle.back());
+                    Idle.pop_back();
+                    return vm;
+                }
+            }
+            return std::make_unique<VirtualMachine>();
+        }
+
+        void Release(std::unique_ptr<VirtualMachine> vm) {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Idle.push_back(std::move(vm));
+        }
+
+    private:
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<VirtualMachine>> Idle;
+};
+
+// the tokens of the sources a session lexed, by the hash of their content: a source is compared in full before
+// its tokens are used (the hash only finds it), and everything is dropped once it holds more than MaxBytes of
+// source, which a server only reaches over a lot of edits. the memo keeps a copy of every source it holds: a
+// mapped file rewritten in place (a shell's >, an editor that doesn't rename) changes the pages of its mapping
+// under the tokens, and once it is truncated reading them is a SIGBUS
+class SourceMemo {
+    public:
+        static constexpr size_t MaxBytes = 256 << 20;
+
+        // fills tokens with the ones kept for a source with the same content, false if there are none
+        bool Load(const std::shared_ptr<const SourceBuffer>& source, TokenStream& tokens) {
+            std::string_view text = source->View();
+            std::lock_guard<std::mutex> lock(Mutex);
+            auto found = Streams.find(HashBytes(text.data(), text.size()));
+            if (found == Streams.end() || found->second.GetSource() != text) {
+                return false;
+            }
+            tokens = found->second;
+            Hits++;
+            return true;
+        }
+
+        void Store(const TokenStream& tokens) {
+            std::string_view text = tokens.GetSource();
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (Bytes + text.size() > MaxBytes) {
+                Streams.clear();
+                Bytes = 0;
+            }
+            uint64_t hash = HashBytes(text.data(), text.size());
+            if (Streams.count(hash) == 0) {
+                TokenStream& kept = Streams.emplace(hash, tokens).first->second;
+                if (tokens.Source->IsMapped()) {
+                    kept.Source = SourceBuffer::FromString(std::string(text));
+                }
+                Bytes += text.size();
+            }
+        }
+
+        size_t GetHits() const {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return Hits;
+        }
+
+    private:
+        mutable std::mutex Mutex;
+        std::unordered_map<uint64_t, TokenStream> Streams;
+        size_t Bytes = 0;
+        size_t Hits = 0;
+};
+
+// the pass a --no-<pass> option turns off, false if the option isn't one
+static bool passOfOption(const std::string& argument, Pass& pass) {
+    for (size_t i = 0; i < PassCount; i++) {
+        if (argument == "--no-" + std::string(PassNames[i])) {
+            pass = static_cast<Pass>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseDriverOptions(const std::vector<std::string>& arguments, DriverOptions& options, std::string* error) {
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const std::string& argument = arguments[i];
+        if ((argument == "--jobs" || argument == "--cache") && i + 1 >= arguments.size()) {
+            *error = argument + " needs a value";
+            return false;
+        }
+        if (argument == "--jobs") {
+            options.Threads = std::strtoul(arguments[++i].c_str(), nullptr, 10);
+        }
+        else if (argument == "--cache") {
+            options.CacheDirectory = arguments[++i];
+        }
+        else if (argument == "--quiet") {
+            options.PrintTokens = false;
+        }
+        else if (argument == "--ast") {
+            options.PrintAst = true;
+        }
+        else if (argument == "--bytecode") {
+            options.PrintBytecode = true;
+        }
+        else if (argument == "--run") {
+            options.Run = true;
+        }
+        else if (argument == "--no-superinstructions") {
+            options.Superinstructions = false;
+        }
+        else if (argument == "--runtime-stats") {
+            options.RuntimeStats = true;
+        }
+        else if (argument == "--no-optimize") {
+            options.Optimize.Passes = 0;
+        }
+        else if (argument == "--optimizer-stats") {
+            options.OptimizerStats = true;
+        }
+        else if (argument == "--module-stats") {
+            options.ModuleStats = true;
+        }
+        else if (argument == "--stats" || argument == "--stats-json") {
+            if (!LexerStats::Enabled) {
+                *error = argument + " needs a build with -DILYS_LEXER_STATS=1";
+                return false;
+            }
+            options.Stats = argument == "--stats" ? StatsFormat::TEXT : StatsFormat::JSON;
+        }
+        else if (Pass pass; passOfOption(argument, pass)) {
+            options.Optimize.SetEnabled(pass, false);
+        }
+        else if (argument.size() > 1 && argument[0] == '-') {
+            *error = "unknown option " + argument;
+            return false;
+        }
+        else {
+            options.Paths.push_back(argument);
+        }
+    }
+    return true;
+}
+
+bool CollectSources(const std::vector<std::string>& paths, std::vector<std::string>& files, std::string* error) {
+    for (const std::string& path : paths) {
+        std::error_code code;
+        if (path == "-" || !std::filesystem::is_directory(path, code)) {
+            if (path != "-" && !std::filesystem::exists(path, code)) {
+                *error = path + ": no such file or directory";
+                return false;
+            }
+            files.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> found;
+        for (auto entry = std::filesystem::recursive_directory_iterator(path, code); !code && entry != std::filesystem::recursive_directory_iterator(); entry.increment(code)) {
+            if (entry->path().extension() == ".ilys" && entry->is_regular_file(code)) {
+                found.push_back(entry->path().string());
+            }
+        }
+        if (code) {
+            *error = path + ": " + code.message();
+            return false;
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return true;
+}
+
+// lexes a source, or takes the tokens a session kept for it or loads them from the cache if there is one (and
+// stores them there if they weren't). it runs on the workers, so a store that fails is added to warnings for
+// the thread printing the results to write to the session's err stream (the server sends that to the client)
+static void lexSource(const std::shared_ptr<const SourceBuffer>& source, const std::string& path, LexerPool& lexers, const std::shared_ptr<SymbolTable>& symbols,
+                      TokenCache* cache, SourceMemo* memo, ThreadPool& pool, TokenStream& tokens, std::string& warnings) {
+    if (memo && memo->Load(source, tokens)) {
+        return;
+    }
+    if (!cache || !cache->Load(source, symbols, tokens)) {
+        // a file with room for two chunks is cut up and lexed on the pool (this worker lexes chunks too while it
+        // waits for the others, see ThreadPool::Wait), anything smaller isn't worth more than one lexer
+        if (source->View().size() >= 2 * DefaultParallelChunkSize && pool.GetThreadCount() > 1) {
+            tokens = TokenizeParallel(source, symbols, pool);
+        }
+        else {
+            std::unique_ptr<Lexer> lexer = lexers.Acquire();
+            Tokenize(lexer.get(), source, tokens);
+            lexers.Release(std::move(lexer));
+        }
+        std::string error;
+        if (cache && !cache->Store(tokens, &error)) {
+            warnings += "Warning: could not cache the tokens of " + path + ": " + error + "\n";
+        }
+    }
+    if (memo) {
+        memo->Store(tokens);
+    }
+}
+
+// loads and lexes one file and formats its tokens, or parses it and formats its tree
+static FileResult lexFile(const std::string& path, LexerPool& lexers, const std::shared_ptr<SymbolTable>& symbols, TokenCache* cache, SourceMemo* memo,
+                          ThreadPool& pool, const DriverOptions& options) {
+    FileResult result;
+    double start = ThreadSeconds();
+
+    std::string error;
+    std::shared_ptr<const SourceBuffer> source = path == "-" ? SourceBuffer::FromDescriptor(0, &error) : SourceBuffer::FromFile(path, &error);
+    if (!source) {
+        result.Error = error;
+        return result;
+    }
+    TokenStream tokens;
+    lexSource(source, path, lexers, symbols, cache, memo, pool, tokens, result.Warnings);
+
+    // a clean ASCII file (the lexer saw nothing CollectDiagnostics could report) skips the UTF-8 pass, and only
+    // a file with errors pays for the line table
+    std::vector<Diagnostic> diagnostics;
+    if (tokens.NeedsDiagnostics()) {
+        diagnostics = CollectDiagnostics(tokens);
+    }
+    Ast ast;
+    if (options.PrintAst && !Parse(tokens, ast, diagnostics)) {
+        std::stable_sort(diagnostics.begin(), diagnostics.end(), [](const Diagnostic& left, const Diagnostic& right) {
+            return left.Offset < right.Offset;
+        });
+    }
+    if (!diagnostics.empty()) {
+        AppendDiagnostics(result.Diagnostics, path, LineTable(tokens.GetSource()), diagnostics);
+        result.Errors = diagnostics.size();
+    }
+    if (options.PrintTokens && options.PrintAst) {
+        ast.AppendDebug(result.Output, tokens);
+    }
+    else if (options.PrintTokens) {
+        for (const Token& token : tokens.Tokens) {
+            Token::AppendDebug(result.Output, token, tokens.GetSource());
+        }
+    }
+    result.Bytes = tokens.GetSource().size();
+    result.Tokens = tokens.Tokens.size();
+    result.Seconds = ThreadSeconds() - start;
+    return result;
+}
+
+// what a build gave for one of its modules: its diagnostics, and for a file given its bytecode or what it printed
+// when it ran with everything it imports (a runtime error in a function of another module is reported in that
+// module's file). only a module without any error runs, with the modules it imports
+static FileResult buildFile(const ModuleGraph& graph, size_t index, bool imported, MachinePool& machines, const DriverOptions& options) {
+    FileResult result;
+    const Module& module = graph.GetModule(index);
+    result.Imported = imported;
+    if (!module.Error.empty()) {
+        result.Error = module.Error;
+        return result;
+    }
+    double start = ThreadSeconds();
+    if (!module.Diagnostics.empty()) {
+        AppendDiagnostics(result.Diagnostics, module.Path, LineTable(module.Tokens.GetSource()), module.Diagnostics);
+        result.Errors = module.Diagnostics.size();
+    }
+    if (!imported && options.Run && module.Compiled) {
+        std::vector<size_t> order = graph.GetRunOrder(index);
+        std::vector<const Program*> programs;
+        for (size_t i : order) {
+            programs.push_back(&graph.GetModule(i).Code);
+        }
+        std::unique_ptr<VirtualMachine> vm = machines.Acquire();
+        vm->ResetStats();
+        Diagnostic error;
+        size_t failed = 0;
+        if (!vm->RunModules(programs, result.Output, &error, &failed)) {
+            const Module& where = graph.GetModule(order[failed]);
+            AppendDiagnostics(result.Diagnostics, where.Path, LineTable(where.Tokens.GetSource()), {error});
+            result.Errors++;
+        }
+        result.Gc = vm->GetHeap().GetStats();
+        result.Shapes = vm->GetShapeStats();
+        machines.Release(std::move(vm));
+    }
+    // (a run has its output already)
+    if (!imported && options.PrintTokens && !options.Run) {
+        module.Code.AppendDisassembly(result.Output);
+    }
+    result.Bytes = module.Tokens.GetSource().size();
+    result.Tokens = module.Tokens.Tokens.size();
+    result.Seconds = module.LoadSeconds + module.CompileSeconds + ThreadSeconds() - start;
+    result.Optimizer = module.Optimizer;
+    return result;
+}
+
+int RunDriver(const DriverOptions& options) {
+    std::string error;
+    std::unique_ptr<DriverSession> session = DriverSession::Open(options, false, &error);
+    if (!session) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    return session->Run(options, std::cout, std::cerr);
+}
+
+std::unique_ptr<DriverSession> DriverSession::Open(const DriverOptions& options, bool keepTokens, std::string* error) {
+    std::unique_ptr<TokenCache> cache;
+    if (!options.CacheDirectory.empty()) {
+        cache = TokenCache::Open(options.CacheDirectory, error);
+        if (!cache) {
+            return nullptr;
+        }
+    }
+    return std::unique_ptr<DriverSession>(new DriverSession(options, std::move(cache), keepTokens));
+}
+
+// every file of a session interns into one table, like the files of one compilation
+DriverSession::DriverSession(const DriverOptions& options, std::unique_ptr<TokenCache> cache, bool keepTokens)
+    : Symbols(std::make_shared<SymbolTable>()), Lexers(std::make_unique<LexerPool>(Symbols, options.Stats != StatsFormat::NONE)),
+      Machines(std::make_unique<MachinePool>()), Pool(options.Threads), Cache(std::move(cache)), Memo(keepTokens ? std::make_unique<SourceMemo>() : nullptr) {
+}
+
+DriverSession::~DriverSession() = default;
+
+size_t DriverSession::GetKeptHits() const {
+    return Memo ? Memo->GetHits() : 0;
+}
+
+int DriverSession::Run(const DriverOptions& options, std::ostream& out, std::ostream& err) {
+    std::vector<std::string> files;
+    std::string error;
+    if (!CollectSources(options.Paths, files, &error)) {
+        err << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t steals = Pool.GetStealCount();
+    size_t hits = Cache ? Cache->GetHits() : 0;
+    size_t misses = Cache ? Cache->GetMisses() : 0;
+    LexerPool& lexers = *Lexers;
+    MachinePool& machines = *Machines;
+    std::shared_ptr<SymbolTable>& symbols = Symbols;
+    ThreadPool& pool = Pool;
+    TokenCache* cache = Cache.get();
+    SourceMemo* memo = Memo.get();
+
+    std::vector<std::future<FileResult>> results;
+    results.reserve(files.size());
+    ModuleGraph graph(symbols);
+    if (options.PrintBytecode || options.Run) {
+        // the files and what they import are built first (see modules.h), then every file given is printed or run
+        // and the modules only imported are there for their diagnostics (one that can't be read is reported by its
+        // importers)
+        ModuleOptions moduleOptions;
+        moduleOptions.Optimize = options.Optimize;
+        moduleOptions.Compile.Superinstructions = options.Superinstructions;
+        std::mutex warningsMutex;
+        std::string warnings;
+        moduleOptions.Lex = [&lexers, &symbols, cache, memo, &pool, &warningsMutex, &warnings](const std::string& path,
+                                                                                               std::shared_ptr<const SourceBuffer> source, TokenStream& tokens) {
+            std::string warning;
+            lexSource(source, path, lexers, symbols, cache, memo, pool, tokens, warning);
+            if (!warning.empty()) {
+                std::lock_guard<std::mutex> lock(warningsMutex);
+                warnings += warning;
+            }
+        };
+        std::vector<size_t> entries = graph.Build(files, pool, moduleOptions);
+        // (every module is lexed by now, nothing adds to warnings anymore)
+        err << warnings;
+        std::vector<bool> imported(graph.GetModuleCount(), true);
+        for (size_t entry : entries) {
+            imported[entry] = false;
+        }
+        for (size_t i = 0; i < entries.size() + graph.GetModuleCount(); i++) {
+            bool entry = i < entries.size();
+            size_t index = entry ? entries[i] : i - entries.size();
+            if (!entry && (!imported[index] || !graph.GetModule(index).Error.empty())) {
+                continue;
+            }
+            results.push_back(pool.Submit([&graph, index, entry, &machines, &options]() {
+                return buildFile(graph, index, !entry, machines, options);
+            }));
+        }
+    }
+    else {
+        for (const std::string& path : files) {
+            results.push_back(pool.Submit([&path, &lexers, &symbols, cache, memo, &pool, &options]() {
+                return lexFile(path, lexers, symbols, cache, memo, pool, options);
+            }));
+        }
+    }
+
+    // printed in the order of the files as soon as each one is done, whatever order the workers finish in
+    int failures = 0;
+    size_t errors = 0;
+    size_t printed = 0;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    double work = 0;
+    GcStats gc;
+    ShapeStats shapes;
+    OptimizeStats optimizer;
+    for (size_t i = 0; i < results.size(); i++) {
+        FileResult result = results[i].get();
+        if (!result.Error.empty()) {
+            err << "Error: " << result.Error << std::endl;
+            failures++;
+            continue;
+        }
+        err << result.Warnings << result.Diagnostics;
+        errors += result.Errors;
+        if (options.PrintTokens && !result.Imported) {
+            if (printed++ > 0) {
+                out << '\n';
+            }
+            out.write(result.Output.data(), result.Output.size());
+        }
+        bytes += result.Bytes;
+        tokens += result.Tokens;
+        work += result.Seconds;
+        gc.Merge(result.Gc);
+        shapes.Merge(result.Shapes);
+        optimizer.Merge(result.Optimizer);
+    }
+    out.flush();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    err << std::fixed << std::setprecision(1) << "Lexed " << results.size() - failures << "/" << results.size() << " files ("
+        << bytes / 1024 << " KB, " << tokens << " tokens) in " << wall * 1e3 << " ms on " << pool.GetThreadCount()
+        << " threads (" << work * 1e3 << " ms of cpu, " << (wall > 0 ? work / wall : 0) << "x, " << pool.GetStealCount() - steals << " steals), " << errors << " errors";
+    if (cache) {
+        err << ", token cache: " << cache->GetHits() - hits << " hits, " << cache->GetMisses() - misses << " misses";
+    }
+    err << std::endl;
+    size_t mismatched;
+    std::unique_ptr<LexerStats> stats = lexers.MergeStats(&mismatched);
+    if (mismatched > 0) {
+        err << "Warning: " << mismatched << " lexers had other rules, their counters are left out of the stats" << std::endl;
+    }
+    if (stats) {
+        if (options.Stats == StatsFormat::JSON) {
+            stats->PrintJson(err);
+        }
+        else {
+            stats->PrintText(err);
+        }
+    }
+    if (options.OptimizerStats) {
+        optimizer.PrintText(err);
+    }
+    if (options.ModuleStats && (options.PrintBytecode || options.Run)) {
+        graph.GetStats().PrintText(err);
+    }
+    if (options.RuntimeStats) {
+        gc.PrintText(err);
+        shapes.PrintText(err);
+    }
+    return failures == 0 && errors == 0 ? 0 : 1;
+}
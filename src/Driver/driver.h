@@ -0,0 +1,99 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "../Lexer/diagnostics.h"
+#include "../Lexer/token_cache.h"
+#include "../Support/thread_pool.h"
+#include "../VM/optimizer.h"
+
+// how the lexer stats are printed after the totals (see lexer_stats.h)
+enum class StatsFormat {
+    NONE,
+    TEXT,
+    JSON
+};
+
+// what the command line asked the driver to do
+struct DriverOptions {
+    // files, directories (searched for .ilys files) or "-" for stdin
+    std::vector<std::string> Paths;
+    // 0 means one per hardware thread
+    size_t Threads = 0;
+    // empty for no token cache (see token_cache.h)
+    std::string CacheDirectory;
+    // false only lexes the files (--quiet), the totals are still printed
+    bool PrintTokens = true;
+    // parses every file and prints its tree instead of its tokens (--ast), the parse errors are reported with the
+    // lexing ones
+    bool PrintAst = false;
+    // compiles every file that parsed and prints its bytecode instead (--bytecode)
+    bool PrintBytecode = false;
+    // compiles and runs every file that parsed and prints what it printed instead (--run), a runtime error is
+    // reported like the other errors
+    bool Run = false;
+    // prints what the build of the modules did after the totals (--module-stats, only with --bytecode or --run,
+    // which load what the files import too, see modules.h)
+    bool ModuleStats = false;
+    // compare-and-branch and range loop instructions (--no-superinstructions turns them off, see CompileOptions)
+    bool Superinstructions = true;
+    // the optimizer passes run on every file before it is compiled (--no-optimize turns them all off, --no-fold
+    // and the like one of them)
+    OptimizeOptions Optimize;
+    // prints what every optimizer pass rewrote and the time it took, added up over every file compiled, after the
+    // totals (--optimizer-stats)
+    bool OptimizerStats = false;
+    // prints what the runtime did (the garbage collector and the inline caches of field accesses, added up over
+    // every file run) after the totals (--runtime-stats, only with --run)
+    bool RuntimeStats = false;
+    // anything but NONE needs a build with ILYS_LEXER_STATS (files loaded from the token cache aren't lexed, so
+    // they don't count)
+    StatsFormat Stats = StatsFormat::NONE;
+};
+
+// fills options from the command line (every argument but the program, --help and --differential, which main
+// handles), returns false and fills error on an option it doesn't know or one missing its value
+bool ParseDriverOptions(const std::vector<std::string>& arguments, DriverOptions& options, std::string* error);
+
+// expands the paths into the files to lex: directories are walked recursively for .ilys files, sorted so the
+// order never depends on the file system, returns false and fills error if a path doesn't exist
+bool CollectSources(const std::vector<std::string>& paths, std::vector<std::string>& files, std::string* error);
+
+// lexes every file on a work stealing pool, prints their tokens in the order of the files (a blank line between
+// two files), their diagnostics and the totals on stderr, returns 0 if every file could be read and lexed
+// without errors. with --bytecode or --run the files and every module they import are built as one graph of
+// modules on the pool first (see ModuleGraph), the diagnostics of a module only imported come after the files
+int RunDriver(const DriverOptions& options);
+
+class LexerPool;
+class MachinePool;
+class SourceMemo;
+
+// what RunDriver keeps for one run, kept between the runs of a server (see server.h): the symbols every file is
+// interned into, the idle lexers and virtual machines, the pool and the token cache, and with keepTokens the tokens of every source
+// lexed (by content, so a file is lexed again only once it changed)
+class DriverSession {
+    public:
+        // takes the threads, the token cache and the lexer stats of options (a run can't change them), returns
+        // nullptr and fills error if the cache can't be opened
+        static std::unique_ptr<DriverSession> Open(const DriverOptions& options, bool keepTokens, std::string* error);
+        ~DriverSession();
+
+        // a run like RunDriver's, printing into out and err instead of stdout and stderr (the counters in the
+        // totals are the run's), returns its exit status
+        int Run(const DriverOptions& options, std::ostream& out, std::ostream& err);
+
+        // sources whose tokens were kept from an earlier run so far
+        size_t GetKeptHits() const;
+
+    private:
+        DriverSession(const DriverOptions& options, std::unique_ptr<TokenCache> cache, bool keepTokens);
+
+        std::shared_ptr<SymbolTable> Symbols;
+        std::unique_ptr<LexerPool> Lexers;
+        std::unique_ptr<MachinePool> Machines;
+        ThreadPool Pool;
+        std::unique_ptr<TokenCache> Cache;
+        std::unique_ptr<SourceMemo> Memo;
+};
+
+#endif
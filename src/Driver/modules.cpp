@@ -0,0 +1,313 @@
+#include "modules.h"
+#include "../Parser/parser.h"
+#include "../VM/natives.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+// the key of a module in the cache: its canonical path (the file doesn't have to exist, it is reported when it
+// is read)
+static std::string keyOf(const std::string& path) {
+    if (path == "-") {
+        return path;
+    }
+    std::error_code code;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, code);
+    return code ? std::filesystem::path(path).lexically_normal().string() : canonical.string();
+}
+
+// the file an import names: its path taken from the directory of the importing file, with .ilys if it has no
+// extension
+static std::string resolveImport(const std::string& importer, std::string_view literal) {
+    std::filesystem::path path = importer == "-" ? std::filesystem::path() : std::filesystem::path(importer).parent_path();
+    path /= DecodeString(literal);
+    if (!path.has_extension()) {
+        path += ".ilys";
+    }
+    return path.lexically_normal().string();
+}
+
+void ModuleStats::PrintText(std::ostream& out) const {
+    out << std::fixed << std::setprecision(1) << "Module stats: " << Modules << " modules, " << Imports << " imports (" << Shared
+        << " of a module loaded already), longest chain of imports " << Depth << " modules\n"
+        << "  loading " << LoadSeconds * 1e3 << " ms and compiling " << CompileSeconds * 1e3 << " ms of cpu, built in " << WallSeconds * 1e3
+        << " ms, longest chain " << CriticalSeconds * 1e3 << " ms" << std::endl;
+}
+
+ModuleGraph::ModuleGraph(std::shared_ptr<SymbolTable> symbols) : Symbols(std::move(symbols)) {
+    Pending = 0;
+}
+
+size_t ModuleGraph::GetModuleCount() const {
+    return Modules.size();
+}
+
+const Module& ModuleGraph::GetModule(size_t index) const {
+    return *Modules[index];
+}
+
+const ModuleStats& ModuleGraph::GetStats() const {
+    return Stats;
+}
+
+std::vector<size_t> ModuleGraph::Build(const std::vector<std::string>& paths, ThreadPool& pool, const ModuleOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    // every entry is known before anything loads, so an entry another one imports keeps the path it was given
+    std::vector<size_t> entries;
+    std::vector<size_t> added;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        for (const std::string& path : paths) {
+            auto [index, loading] = Find(path);
+            entries.push_back(index);
+            if (loading) {
+                added.push_back(index);
+            }
+        }
+    }
+    for (size_t index : added) {
+        Submit(index, pool, options);
+    }
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        Loaded.wait(lock, [this]() {
+            return Pending == 0;
+        });
+    }
+
+    std::vector<size_t> order = Link(entries);
+    CompileAll(order, pool, options);
+    for (const std::unique_ptr<Module>& module : Modules) {
+        std::stable_sort(module->Diagnostics.begin(), module->Diagnostics.end(), [](const Diagnostic& left, const Diagnostic& right) {
+            return left.Offset < right.Offset;
+        });
+    }
+    Stats.Modules = Modules.size();
+    Stats.WallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return entries;
+}
+
+// the module of path and true if it was just added (and has to be loaded), Mutex has to be held
+std::pair<size_t, bool> ModuleGraph::Find(const std::string& path) {
+    auto [found, added] = Index.emplace(keyOf(path), Modules.size());
+    if (added) {
+        Modules.push_back(std::make_unique<Module>());
+        Modules.back()->Path = path;
+        Pending++;
+    }
+    return {found->second, added};
+}
+
+void ModuleGraph::Submit(size_t index, ThreadPool& pool, const ModuleOptions& options) {
+    Module* module;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        module = Modules[index].get();
+    }
+    pool.Submit([this, module, &pool, &options]() {
+        Load(*module, pool, options);
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (--Pending == 0) {
+            Loaded.notify_all();
+        }
+    });
+}
+
+// reads, lexes and parses a module, queues what it imports (even with errors, so theirs are reported too) and
+// optimizes it if it has no errors
+void ModuleGraph::Load(Module& module, ThreadPool& pool, const ModuleOptions& options) {
+    double start = ThreadSeconds();
+    std::string error;
+    std::shared_ptr<const SourceBuffer> source = module.Path == "-" ? SourceBuffer::FromDescriptor(0, &error) : SourceBuffer::FromFile(module.Path, &error);
+    if (!source) {
+        module.Error = error;
+        module.LoadSeconds = ThreadSeconds() - start;
+        return;
+    }
+    if (options.Lex) {
+        options.Lex(module.Path, source, module.Tokens);
+    }
+    else {
+        module.Tokens = Tokenize(source, Symbols);
+    }
+    if (module.Tokens.NeedsDiagnostics()) {
+        module.Diagnostics = CollectDiagnostics(module.Tokens);
+    }
+    bool parsed = Parse(module.Tokens, module.Tree, module.Diagnostics);
+
+    const Node& root = module.Tree.Get(module.Tree.GetRoot());
+    for (NodeId statement = root.First; statement != NoNode; statement = module.Tree.Get(statement).Next) {
+        const Node& node = module.Tree.Get(statement);
+        if (node.Kind != NodeKind::IMPORT) {
+            continue;
+        }
+        std::string path = resolveImport(module.Path, module.Tokens.Text(module.Tokens.Tokens[node.Token]));
+        std::pair<size_t, bool> found;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            found = Find(path);
+            Stats.Imports++;
+            Stats.Shared += !found.second;
+        }
+        if (found.second) {
+            Submit(found.first, pool, options);
+        }
+        module.Imports.push_back(found.first);
+        module.ImportTokens.push_back(node.Token);
+    }
+
+    if (parsed && module.Diagnostics.empty()) {
+        Optimize(module.Tokens, module.Tree, options.Optimize, &module.Optimizer);
+    }
+    module.LoadSeconds = ThreadSeconds() - start;
+}
+
+// walks the graph from the entries (see modules.h) and gives the modules without errors their slots and exports,
+// returns every module in the order the walk finished them
+std::vector<size_t> ModuleGraph::Link(const std::vector<size_t>& entries) {
+    enum class Mark : uint8_t {
+        NEW,
+        WALKING,
+        DONE
+    };
+    std::vector<Mark> marks(Modules.size(), Mark::NEW);
+    std::vector<uint64_t> depths(Modules.size(), 0);
+    std::vector<double> chains(Modules.size(), 0);
+    std::vector<size_t> order;
+    // a module and its next import to follow
+    std::vector<std::pair<size_t, size_t>> stack;
+    for (size_t entry : entries) {
+        if (marks[entry] != Mark::NEW) {
+            continue;
+        }
+        marks[entry] = Mark::WALKING;
+        stack.emplace_back(entry, 0);
+        while (!stack.empty()) {
+            auto& [index, next] = stack.back();
+            Module& module = *Modules[index];
+            if (next < module.Imports.size()) {
+                size_t import = module.Imports[next++];
+                if (marks[import] == Mark::WALKING) {
+                    const Token& path = module.Tokens.Tokens[module.ImportTokens[next - 1]];
+                    module.Diagnostics.push_back(Diagnostic{DiagnosticCode::IMPORT_CYCLE, path.offset, path.length});
+                }
+                else if (marks[import] == Mark::NEW) {
+                    marks[import] = Mark::WALKING;
+                    stack.emplace_back(import, 0);
+                }
+                continue;
+            }
+            // everything it imports is done (but the imports that closed a cycle)
+            for (size_t i = 0; i < module.Imports.size(); i++) {
+                const Module& imported = *Modules[module.Imports[i]];
+                if (marks[module.Imports[i]] != Mark::DONE) {
+                    continue;
+                }
+                if (!imported.Error.empty() || !imported.Diagnostics.empty()) {
+                    const Token& path = module.Tokens.Tokens[module.ImportTokens[i]];
+                    module.Diagnostics.push_back(Diagnostic{imported.Error.empty() ? DiagnosticCode::MODULE_HAS_ERRORS : DiagnosticCode::MODULE_NOT_FOUND, path.offset, path.length});
+                }
+                depths[index] = std::max(depths[index], depths[module.Imports[i]]);
+                chains[index] = std::max(chains[index], chains[module.Imports[i]]);
+            }
+            depths[index]++;
+            chains[index] += module.LoadSeconds;
+            marks[index] = Mark::DONE;
+            order.push_back(index);
+            stack.pop_back();
+        }
+    }
+
+    // the natives have the first slots, then the globals of every module in the order of the walk
+    uint32_t base = static_cast<uint32_t>(GetNatives().size());
+    for (size_t index : order) {
+        Module& module = *Modules[index];
+        Stats.Depth = std::max(Stats.Depth, depths[index]);
+        Stats.CriticalSeconds = std::max(Stats.CriticalSeconds, chains[index]);
+        Stats.LoadSeconds += module.LoadSeconds;
+        if (!module.Error.empty() || !module.Diagnostics.empty()) {
+            continue;
+        }
+        module.GlobalBase = base;
+        std::unordered_map<uint32_t, uint32_t> slots;
+        for (uint32_t token : CollectGlobals(module.Tokens, module.Tree)) {
+            slots.emplace(module.Tokens.Tokens[token].symbol, base++);
+        }
+        const Node& root = module.Tree.Get(module.Tree.GetRoot());
+        for (NodeId statement = root.First; statement != NoNode; statement = module.Tree.Get(statement).Next) {
+            const Node& node = module.Tree.Get(statement);
+            if (node.Kind == NodeKind::EXPORT) {
+                uint32_t symbol = module.Tokens.Tokens[module.Tree.Get(node.First).Token].symbol;
+                module.Exports[symbol] = slots[symbol];
+            }
+        }
+    }
+    return order;
+}
+
+// compiles every module without errors at once, then fails (in the order of the walk, so it reaches the importers
+// of the importers) every module that imports one that failed to compile
+void ModuleGraph::CompileAll(const std::vector<size_t>& order, ThreadPool& pool, const ModuleOptions& options) {
+    std::vector<std::future<void>> compiles;
+    for (size_t index : order) {
+        Module& module = *Modules[index];
+        if (!module.Error.empty() || !module.Diagnostics.empty()) {
+            continue;
+        }
+        ModuleLink link;
+        link.GlobalBase = module.GlobalBase;
+        for (size_t import : module.Imports) {
+            link.Imports.push_back(&Modules[import]->Exports);
+        }
+        compiles.push_back(pool.Submit([&module, &options, link = std::move(link)]() {
+            double start = ThreadSeconds();
+            CompileOptions compileOptions = options.Compile;
+            compileOptions.Link = &link;
+            module.Compiled = Compile(module.Tokens, module.Tree, module.Code, module.Diagnostics, compileOptions);
+            module.CompileSeconds = ThreadSeconds() - start;
+        }));
+    }
+    for (std::future<void>& compile : compiles) {
+        compile.get();
+    }
+
+    double slowest = 0;
+    for (size_t index : order) {
+        Module& module = *Modules[index];
+        for (size_t i = 0; i < module.Imports.size() && module.Compiled; i++) {
+            if (!Modules[module.Imports[i]]->Compiled) {
+                const Token& path = module.Tokens.Tokens[module.ImportTokens[i]];
+                module.Diagnostics.push_back(Diagnostic{DiagnosticCode::MODULE_HAS_ERRORS, path.offset, path.length});
+                module.Compiled = false;
+            }
+        }
+        Stats.CompileSeconds += module.CompileSeconds;
+        slowest = std::max(slowest, module.CompileSeconds);
+    }
+    Stats.CriticalSeconds += slowest;
+}
+
+std::vector<size_t> ModuleGraph::GetRunOrder(size_t index) const {
+    std::vector<size_t> order;
+    std::vector<bool> seen(Modules.size(), false);
+    std::vector<std::pair<size_t, size_t>> stack = {{index, 0}};
+    seen[index] = true;
+    while (!stack.empty()) {
+        auto& [current, next] = stack.back();
+        const Module& module = *Modules[current];
+        if (next < module.Imports.size()) {
+            size_t import = module.Imports[next++];
+            if (!seen[import]) {
+                seen[import] = true;
+                stack.emplace_back(import, 0);
+            }
+            continue;
+        }
+        order.push_back(current);
+        stack.pop_back();
+    }
+    return order;
+}
@@ -0,0 +1,112 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include "../Lexer/lexer.h"
+#include "../Support/thread_pool.h"
+#include "../VM/compiler.h"
+#include "../VM/optimizer.h"
+
+#include <iosfwd>
+
+// one file of a build, loaded and compiled once however many modules import it
+struct Module {
+    // as it was given for an entry, else the file an import names (relative to the working directory)
+    std::string Path;
+    // why it couldn't be read (an import of it is MODULE_NOT_FOUND), empty if it was
+    std::string Error;
+    TokenStream Tokens;
+    Ast Tree;
+    // of the file (its lexing, parsing, imports and compiling), sorted by offset
+    std::vector<Diagnostic> Diagnostics;
+    // per import statement, in order: the module it names and the token of its path
+    std::vector<size_t> Imports;
+    std::vector<uint32_t> ImportTokens;
+    // the slot of its first global and what it exports (see ModuleLink), once it is linked
+    uint32_t GlobalBase = 0;
+    ModuleExports Exports;
+    Program Code;
+    // compiled without errors, and so was everything it imports (only then can it run)
+    bool Compiled = false;
+    OptimizeStats Optimizer;
+    // cpu time reading, lexing, parsing and optimizing it, and compiling it
+    double LoadSeconds = 0;
+    double CompileSeconds = 0;
+};
+
+struct ModuleOptions {
+    OptimizeOptions Optimize;
+    // for every module, with its Link set
+    CompileOptions Compile;
+    // lexes the source of the module at a path into tokens interned in the graph's symbols (the driver goes through
+    // its lexers and the token cache), Tokenize if empty
+    std::function<void(const std::string&, std::shared_ptr<const SourceBuffer>, TokenStream&)> Lex;
+};
+
+// what a build did
+struct ModuleStats {
+    uint64_t Modules = 0;
+    // import statements, and how many of them named a module another one had loaded already
+    uint64_t Imports = 0;
+    uint64_t Shared = 0;
+    // modules in the longest chain of imports
+    uint64_t Depth = 0;
+    // cpu time loading and compiling every module, and the longest chain of imports (its loads one after the
+    // other, then the slowest compile), the least the build takes however many threads it has
+    double LoadSeconds = 0;
+    double CompileSeconds = 0;
+    double CriticalSeconds = 0;
+    double WallSeconds = 0;
+
+    void PrintText(std::ostream& out) const;
+};
+
+// the modules of a build: the files given (the entries) and every module they import, found by following the
+// imports (import name, ... from "path": the path is relative to the directory of the importing file, .ilys is
+// added if it has none). a module is known by its canonical path, which is the key of the cache of modules, so a
+// file is read, lexed, parsed, optimized and compiled once per build.
+// every module is a task on the work stealing pool that loads it and queues a task for every module it imports
+// that isn't known yet, before optimizing it: modules that don't depend on each other load at the same time, and
+// loading them takes about as long as the longest chain of imports instead of as long as all of the files.
+// once every module is loaded the graph is walked from the entries, depth first in the order of the imports: an
+// import of a module that is still being walked is an IMPORT_CYCLE, one of a module that can't be read or has
+// errors is MODULE_NOT_FOUND or MODULE_HAS_ERRORS, and the order the walk finishes the modules in is the order
+// their globals get slots in. then every module without errors is compiled, all of them at once on the pool
+class ModuleGraph {
+    public:
+        // the modules are lexed into symbols (the symbols of their exports are looked up in the importers)
+        explicit ModuleGraph(std::shared_ptr<SymbolTable> symbols);
+        ModuleGraph(const ModuleGraph&) = delete;
+        ModuleGraph& operator=(const ModuleGraph&) = delete;
+
+        // builds the graph of paths on pool (this thread waits for its tasks, so it can't be one of its workers),
+        // returns the module of every path, in the order given. a graph is built once
+        std::vector<size_t> Build(const std::vector<std::string>& paths, ThreadPool& pool, const ModuleOptions& options);
+
+        size_t GetModuleCount() const;
+        const Module& GetModule(size_t index) const;
+
+        // what runs for a module (see VirtualMachine::RunModules): everything it imports, directly or not, each
+        // module before the ones that import it, then itself
+        std::vector<size_t> GetRunOrder(size_t index) const;
+
+        const ModuleStats& GetStats() const;
+
+    private:
+        std::shared_ptr<SymbolTable> Symbols;
+        std::vector<std::unique_ptr<Module>> Modules;
+        // the cache of modules, by canonical path
+        std::unordered_map<std::string, size_t> Index;
+        ModuleStats Stats;
+        // guards Modules, Index and the loads not finished yet while loading
+        std::mutex Mutex;
+        std::condition_variable Loaded;
+        size_t Pending;
+
+        std::pair<size_t, bool> Find(const std::string& path);
+        void Submit(size_t index, ThreadPool& pool, const ModuleOptions& options);
+        void Load(Module& module, ThreadPool& pool, const ModuleOptions& options);
+        std::vector<size_t> Link(const std::vector<size_t>& entries);
+        void CompileAll(const std::vector<size_t>& order, ThreadPool& pool, const ModuleOptions& options);
+};
+
+#endif
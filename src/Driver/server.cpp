@@ -0,0 +1,312 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// the longest message either side accepts, a length past it is a client speaking something else
+static constexpr uint32_t MaxMessage = 1u << 30;
+
+template <typename Integer>
+static void appendInteger(std::string& message, Integer value) {
+    message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void appendString(std::string& message, std::string_view text) {
+    appendInteger(message, static_cast<uint32_t>(text.size()));
+    message.append(text);
+}
+
+// takes an integer off the front of message, false if it is too short
+template <typename Integer>
+static bool readInteger(std::string_view& message, Integer& value) {
+    if (message.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, message.data(), sizeof(value));
+    message.remove_prefix(sizeof(value));
+    return true;
+}
+
+static bool readString(std::string_view& message, std::string& text) {
+    uint32_t size;
+    if (!readInteger(message, size) || message.size() < size) {
+        return false;
+    }
+    text.assign(message.data(), size);
+    message.remove_prefix(size);
+    return true;
+}
+
+// sends a whole message behind its length (a client that hung up is an error, not a SIGPIPE)
+static bool sendMessage(int descriptor, const std::string& body) {
+    std::string message;
+    message.reserve(sizeof(uint32_t) + body.size());
+    appendString(message, body);
+    for (size_t sent = 0; sent < message.size();) {
+        ssize_t written = send(descriptor, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool receiveAll(int descriptor, char* data, size_t size) {
+    for (size_t received = 0; received < size;) {
+        ssize_t read = recv(descriptor, data + received, size - received, 0);
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(read);
+    }
+    return true;
+}
+
+static bool receiveMessage(int descriptor, std::string& body) {
+    uint32_t size;
+    if (!receiveAll(descriptor, reinterpret_cast<char*>(&size), sizeof(size)) || size > MaxMessage) {
+        return false;
+    }
+    body.resize(size);
+    return receiveAll(descriptor, body.data(), size);
+}
+
+static bool socketAddress(const std::string& path, sockaddr_un& address, std::string* error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        *error = path + ": a socket path has to be 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+// a socket connected to the server at path, -1 (with error filled) if nothing listens there
+static int connectTo(const std::string& path, std::string* error) {
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) {
+        return -1;
+    }
+    int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0 || connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        *error = path + ": " + std::strerror(errno);
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+        return -1;
+    }
+    return descriptor;
+}
+
+// runs one command line of a client in its working directory, fills reply with what it printed
+static void runRequest(DriverSession& session, const std::string& directory, const std::vector<std::string>& arguments, const std::string& home, ServerReply& reply,
+                       std::ostream& log) {
+    std::ostringstream out;
+    std::ostringstream err;
+    DriverOptions options;
+    std::string error;
+    reply.Status = 1;
+    if (!ParseDriverOptions(arguments, options, &error)) {
+        err << "Error: " << error << std::endl;
+    }
+    else if (options.Stats != StatsFormat::NONE) {
+        err << "Error: the server doesn't keep lexer stats, run without it for --stats" << std::endl;
+    }
+    else if (options.Paths.empty()) {
+        err << "Error: no files given" << std::endl;
+    }
+    else if (std::find(options.Paths.begin(), options.Paths.end(), "-") != options.Paths.end()) {
+        err << "Error: the server can't read the stdin of its client" << std::endl;
+    }
+    else if (chdir(directory.c_str()) != 0) {
+        err << "Error: " << directory << ": " << std::strerror(errno) << std::endl;
+    }
+    else {
+        reply.Status = session.Run(options, out, err);
+        if (chdir(home.c_str()) != 0) {
+            log << "Warning: could not change back into " << home << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+    reply.Output = out.str();
+    reply.Errors = err.str();
+}
+
+// the percentiles of the latencies of the runs served, in microseconds
+static std::string summarize(std::vector<uint64_t> latencies, size_t kept) {
+    std::ostringstream summary;
+    summary << "Served " << latencies.size() << " runs";
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](size_t percent) {
+            return latencies[(latencies.size() - 1) * percent / 100];
+        };
+        summary << ": p50 " << percentile(50) << " us, p90 " << percentile(90) << " us, p99 " << percentile(99) << " us, max " << latencies.back() << " us";
+    }
+    summary << ", tokens kept from an earlier run for " << kept << " sources" << std::endl;
+    return summary.str();
+}
+
+int RunServer(const std::string& path, const DriverOptions& options, std::ostream& log) {
+    sockaddr_un address;
+    std::string error;
+    if (!socketAddress(path, address, &error)) {
+        log << "Error: " << error << std::endl;
+        return 1;
+    }
+    // a socket left by a server that is gone is removed, one a server still answers on is not
+    int probe = connectTo(path, &error);
+    if (probe >= 0) {
+        close(probe);
+        log << "Error: a server is already listening on " << path << std::endl;
+        return 1;
+    }
+    std::error_code code;
+    if (std::filesystem::is_socket(path, code)) {
+        std::filesystem::remove(path, code);
+    }
+
+    // the runs change the working directory, so the cache has to be found from anywhere
+    DriverOptions sessionOptions = options;
+    if (!sessionOptions.CacheDirectory.empty()) {
+        sessionOptions.CacheDirectory = std::filesystem::absolute(sessionOptions.CacheDirectory, code).string();
+    }
+    std::unique_ptr<DriverSession> session = DriverSession::Open(sessionOptions, true, &error);
+    if (!session) {
+        log << "Error: " << error << std::endl;
+        return 1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        log << "Error: " << path << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) {
+            close(listener);
+        }
+        return 1;
+    }
+    std::string home = std::filesystem::current_path(code).string();
+    log << "Serving on " << path << std::endl;
+
+    std::vector<uint64_t> latencies;
+    bool stopping = false;
+    while (!stopping) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            log << "Error: " << path << ": " << std::strerror(errno) << std::endl;
+            break;
+        }
+        // a client that stops sending can't hold the server up for long
+        timeval timeout = {10, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string message;
+        std::string_view request;
+        uint32_t kind;
+        std::string directory;
+        uint32_t count;
+        std::vector<std::string> arguments;
+        bool valid = receiveMessage(client, message);
+        request = message;
+        valid = valid && readInteger(request, kind) && readString(request, directory) && readInteger(request, count);
+        for (uint32_t i = 0; valid && i < count; i++) {
+            valid = readString(request, arguments.emplace_back());
+        }
+        if (!valid) {
+            // (a client that hangs up before sending anything is only seeing if a server listens, see RunServer)
+            if (!message.empty()) {
+                log << "Warning: dropped a request that wasn't one" << std::endl;
+            }
+            close(client);
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        ServerReply reply;
+        if (static_cast<RequestKind>(kind) == RequestKind::STOP) {
+            reply.Errors = summarize(latencies, session->GetKeptHits());
+            log << reply.Errors;
+            stopping = true;
+        }
+        else {
+            runRequest(*session, directory, arguments, home, reply, log);
+            reply.Microseconds = static_cast<uint64_t>(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            latencies.push_back(reply.Microseconds);
+            log << "Run " << latencies.size() << " in " << directory << ":";
+            for (const std::string& argument : arguments) {
+                log << " " << argument;
+            }
+            log << ", status " << reply.Status << ", " << reply.Microseconds << " us" << std::endl;
+        }
+        std::string body;
+        appendInteger(body, static_cast<int32_t>(reply.Status));
+        appendInteger(body, reply.Microseconds);
+        appendString(body, reply.Output);
+        appendString(body, reply.Errors);
+        if (!sendMessage(client, body)) {
+            log << "Warning: a client hung up before its reply" << std::endl;
+        }
+        close(client);
+    }
+    close(listener);
+    std::filesystem::remove(path, code);
+    return 0;
+}
+
+bool SendRequest(const std::string& path, RequestKind kind, const std::vector<std::string>& arguments, ServerReply& reply, std::string* error) {
+    int descriptor = connectTo(path, error);
+    if (descriptor < 0) {
+        return false;
+    }
+    std::error_code code;
+    std::string body;
+    appendInteger(body, static_cast<uint32_t>(kind));
+    appendString(body, std::filesystem::current_path(code).string());
+    appendInteger(body, static_cast<uint32_t>(arguments.size()));
+    for (const std::string& argument : arguments) {
+        appendString(body, argument);
+    }
+    std::string message;
+    bool received = sendMessage(descriptor, body) && receiveMessage(descriptor, message);
+    close(descriptor);
+
+    std::string_view rest = message;
+    int32_t status;
+    if (!received || !readInteger(rest, status) || !readInteger(rest, reply.Microseconds) || !readString(rest, reply.Output) || !readString(rest, reply.Errors)) {
+        *error = path + ": the server hung up without replying";
+        return false;
+    }
+    reply.Status = status;
+    return true;
+}
+
+int RunClient(const std::string& path, const std::vector<std::string>& arguments) {
+    ServerReply reply;
+    std::string error;
+    if (!SendRequest(path, RequestKind::RUN, arguments, reply, &error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::cout.write(reply.Output.data(), reply.Output.size());
+    std::cout.flush();
+    std::cerr.write(reply.Errors.data(), reply.Errors.size());
+    return reply.Status;
+}
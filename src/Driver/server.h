@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "driver.h"
+
+#include <iostream>
+
+// a compile server: one process that keeps a DriverSession (the symbols, the lexers, the pool, the token cache and
+// the tokens of every source it lexed) warm and runs the command lines thin clients send it over a Unix domain
+// socket, so a small script costs a run of the driver instead of a process, its rule set and its pool.
+// requests are run one at a time, in the working directory of their client (the server changes into it for the
+// run), and every one is logged with how long it took
+// on the socket every message is a uint32_t length and that many bytes, made of strings (a uint32_t length and
+// its bytes) and integers in the byte order of the machine (client and server are the same binary):
+//   request: uint32_t RequestKind | working directory | uint32_t count | the arguments (like ParseDriverOptions')
+//   reply:   int32_t exit status | uint64_t microseconds the run took on the server | stdout | stderr
+enum class RequestKind : uint32_t {
+    RUN,
+    // replies and stops the server (with a summary of the latencies of its runs)
+    STOP
+};
+
+struct ServerReply {
+    int Status = 0;
+    uint64_t Microseconds = 0;
+    std::string Output;
+    std::string Errors;
+};
+
+// serves on the socket at path until a STOP request, with the threads and the token cache of options (the ones
+// of a request are ignored, --stats is refused), logging every run into log, returns 1 if it can't listen
+// (another server already does, say)
+int RunServer(const std::string& path, const DriverOptions& options, std::ostream& log = std::cerr);
+
+// sends one request to the server at path and waits for its reply, returns false and fills error if the server
+// can't be reached or hangs up before replying
+bool SendRequest(const std::string& path, RequestKind kind, const std::vector<std::string>& arguments, ServerReply& reply, std::string* error);
+
+// the thin client: sends the arguments, writes what the run printed to stdout and stderr, returns its status
+int RunClient(const std::string& path, const std::vector<std::string>& arguments);
+
+#endif
@@ -0,0 +1,462 @@
+#include "dfa.h"
+
+#include <bitset>
+#include <map>
+#include <algorithm>
+
+namespace {
+
+// one state of the Thompson NFA, either it consumes a byte from Chars and goes to Next, or it only has epsilon moves
+struct NfaState {
+    std::bitset<256> Chars;
+    int Next = -1;
+    std::vector<int> Epsilon;
+    int Accept = -1;
+};
+
+// a piece of NFA with one entry and one (still open) exit state
+struct Fragment {
+    int Start;
+    int End;
+};
+
+// recursive descent over the small regex subset used by the lexer rules:
+// literals, escapes, '.', [classes], (groups), (?:groups), '|', '?', '*' and '+'
+class NfaBuilder {
+    public:
+        NfaBuilder(std::vector<NfaState>& states, const std::string& pattern) : States(states), Pattern(pattern), Index(0), Ok(true) {}
+
+        // parses the whole pattern, returns false on anything unsupported
+        bool Build(Fragment* fragment) {
+            *fragment = ParseAlternation();
+            return Ok && Index == Pattern.size();
+        }
+
+    private:
+        std::vector<NfaState>& States;
+        const std::string& Pattern;
+        size_t Index;
+        bool Ok;
+
+        int NewState() {
+            States.emplace_back();
+            return static_cast<int>(States.size()) - 1;
+        }
+
+        Fragment CharSet(const std::bitset<256>& chars) {
+            int start = NewState();
+            int end = NewState();
+            States[start].Chars = chars;
+            States[start].Next = end;
+            return {start, end};
+        }
+
+        bool AtEnd() const {
+            return Index >= Pattern.size();
+        }
+
+        Fragment ParseAlternation() {
+            Fragment left = ParseSequence();
+            while (Ok && !AtEnd() && Pattern[Index] == '|') {
+                Index++;
+                Fragment right = ParseSequence();
+                int start = NewState();
+                int end = NewState();
+                States[start].Epsilon = {left.Start, right.Start};
+                States[left.End].Epsilon.push_back(end);
+                States[right.End].Epsilon.push_back(end);
+                left = {start, end};
+            }
+            return left;
+        }
+
+        Fragment ParseSequence() {
+            int empty = NewState();
+            Fragment sequence = {empty, empty};
+            while (Ok && !AtEnd() && Pattern[Index] != '|' && Pattern[Index] != ')') {
+                Fragment next = ParseRepeat();
+                States[sequence.End].Epsilon.push_back(next.Start);
+                sequence.End = next.End;
+            }
+            return sequence;
+        }
+
+        Fragment ParseRepeat() {
+            Fragment atom = ParseAtom();
+            while (Ok && !AtEnd()) {
+                char op = Pattern[Index];
+                if (op != '?' && op != '*' && op != '+') {
+                    if (op == '{') {
+                        // counted repetition isn't needed by any rule yet
+                        Ok = false;
+                    }
+                    break;
+                }
+                Index++;
+                int start = NewState();
+                int end = NewState();
+                if (op == '?') {
+                    States[start].Epsilon = {atom.Start, end};
+                    States[atom.End].Epsilon.push_back(end);
+                }
+                else if (op == '*') {
+                    States[start].Epsilon = {atom.Start, end};
+                    States[atom.End].Epsilon = {atom.Start, end};
+                }
+                else {
+                    States[start].Epsilon = {atom.Start};
+                    States[atom.End].Epsilon = {atom.Start, end};
+                }
+                atom = {start, end};
+            }
+            return atom;
+        }
+
+        // fills chars for the escape sequence right after a backslash
+        void ParseEscape(std::bitset<256>& chars) {
+            if (AtEnd()) {
+                Ok = false;
+                return;
+            }
+            char c = Pattern[Index++];
+            switch (c) {
+                case 'd': case 'D':
+                case 's': case 'S':
+                case 'w': case 'W': {
+                    std::bitset<256> set;
+                    for (int b = 0; b < 256; b++) {
+                        bool digit = b >= '0' && b <= '9';
+                        bool word = digit || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_';
+                        bool space = b == ' ' || (b >= '\t' && b <= '\r');
+                        char lower = static_cast<char>(c | 0x20);
+                        set[b] = lower == 'd' ? digit : lower == 's' ? space : word;
+                    }
+                    if (c >= 'A' && c <= 'Z') {
+                        set.flip();
+                    }
+                    chars |= set;
+                    return;
+                }
+                case 't': chars.set('\t'); return;
+                case 'n': chars.set('\n'); return;
+                case 'r': chars.set('\r'); return;
+                case 'f': chars.set('\f'); return;
+                case 'v': chars.set('\v'); return;
+                case '0': chars.set(0); return;
+                case 'x': {
+                    // exactly two hex digits, like ECMAScript (which std::regex follows)
+                    int value = 0;
+                    for (int digit = 0; digit < 2; digit++) {
+                        char h = AtEnd() ? '\0' : Pattern[Index++];
+                        int nibble = h >= '0' && h <= '9' ? h - '0' : (h | 0x20) >= 'a' && (h | 0x20) <= 'f' ? (h | 0x20) - 'a' + 10 : -1;
+                        if (nibble < 0) {
+                            Ok = false;
+                            return;
+                        }
+                        value = value * 16 + nibble;
+                    }
+                    chars.set(value);
+                    return;
+                }
+                case 'b': case 'B':
+                    // word boundaries are assertions, not characters
+                    Ok = false;
+                    return;
+                default:
+                    chars.set(static_cast<unsigned char>(c));
+                    return;
+            }
+        }
+
+        Fragment ParseClass() {
+            std::bitset<256> chars;
+            bool negate = !AtEnd() && Pattern[Index] == '^';
+            if (negate) {
+                Index++;
+            }
+            while (!AtEnd() && Pattern[Index] != ']') {
+                std::bitset<256> item;
+                int low = -1;
+                if (Pattern[Index] == '\\') {
+                    Index++;
+                    ParseEscape(item);
+                    if (item.count() == 1) {
+                        for (int b = 0; b < 256; b++) {
+                            if (item[b]) {
+                                low = b;
+                            }
+                        }
+                    }
+                }
+                else {
+                    low = static_cast<unsigned char>(Pattern[Index++]);
+                    item.set(low);
+                }
+
+                // a range like 0-9 (a '-' right before ']' is a literal)
+                if (low >= 0 && Index + 1 < Pattern.size() && Pattern[Index] == '-' && Pattern[Index + 1] != ']') {
+                    Index++;
+                    int high;
+                    if (Pattern[Index] == '\\') {
+                        Index++;
+                        std::bitset<256> end;
+                        ParseEscape(end);
+                        if (end.count() != 1) {
+                            Ok = false;
+                            break;
+                        }
+                        high = 0;
+                        while (!end[high]) {
+                            high++;
+                        }
+                    }
+                    else {
+                        high = static_cast<unsigned char>(Pattern[Index++]);
+                    }
+                    for (int b = low; b <= high; b++) {
+                        item.set(b);
+                    }
+                }
+                chars |= item;
+            }
+            if (AtEnd()) {
+                Ok = false;
+                return CharSet(chars);
+            }
+            Index++; // skipping ']'
+            if (negate) {
+                chars.flip();
+            }
+            return CharSet(chars);
+        }
+
+        Fragment ParseAtom() {
+            char c = Pattern[Index++];
+            switch (c) {
+                case '(': {
+                    if (Pattern.compare(Index, 2, "?:") == 0) {
+                        Index += 2;
+                    }
+                    else if (!AtEnd() && Pattern[Index] == '?') {
+                        // lookaheads aren't regular
+                        Ok = false;
+                    }
+                    Fragment group = ParseAlternation();
+                    if (AtEnd() || Pattern[Index] != ')') {
+                        Ok = false;
+                        return group;
+                    }
+                    Index++;
+                    return group;
+                }
+                case '[':
+                    return ParseClass();
+                case '.': {
+                    std::bitset<256> chars;
+                    chars.set();
+                    chars.reset('\n');
+                    chars.reset('\r');
+                    return CharSet(chars);
+                }
+                case '\\': {
+                    std::bitset<256> chars;
+                    ParseEscape(chars);
+                    return CharSet(chars);
+                }
+                case '^': case '$': case '*': case '+': case '?': case '{': case ')':
+                    Ok = false;
+                    return CharSet(std::bitset<256>());
+                default: {
+                    std::bitset<256> chars;
+                    chars.set(static_cast<unsigned char>(c));
+                    return CharSet(chars);
+                }
+            }
+        }
+};
+
+// adds every state reachable through epsilon moves, keeps the set sorted so it can be used as a map key
+void EpsilonClosure(const std::vector<NfaState>& states, std::vector<int>& set) {
+    std::vector<bool> seen(states.size(), false);
+    std::vector<int> stack(set.begin(), set.end());
+    set.clear();
+    while (!stack.empty()) {
+        int state = stack.back();
+        stack.pop_back();
+        if (seen[state]) {
+            continue;
+        }
+        seen[state] = true;
+        set.push_back(state);
+        for (int next : states[state].Epsilon) {
+            stack.push_back(next);
+        }
+    }
+    std::sort(set.begin(), set.end());
+}
+
+}
+
+Dfa::Dfa() {
+    StateCount = 0;
+    ClassCount = 0;
+    std::fill(std::begin(ByteClass), std::end(ByteClass), 0);
+}
+
+bool Dfa::Compile(const std::vector<std::string>& patterns) {
+    StateCount = 0;
+    Transitions.clear();
+    Accepting.clear();
+    Kernels.clear();
+
+    // building one NFA with a shared start state that branches into every rule
+    std::vector<NfaState> states(1);
+    for (size_t rule = 0; rule < patterns.size(); rule++) {
+        Fragment fragment;
+        NfaBuilder builder(states, patterns[rule]);
+        if (!builder.Build(&fragment)) {
+            return false;
+        }
+        states[fragment.End].Accept = static_cast<int>(rule);
+        states[0].Epsilon.push_back(fragment.Start);
+    }
+
+    // splitting the 256 byte values into classes that no rule can tell apart, keeps the table small
+    int classOf[256] = {0};
+    int classes = 1;
+    for (const NfaState& state : states) {
+        if (state.Next < 0) {
+            continue;
+        }
+        std::map<std::pair<int, bool>, int> split;
+        int next = 0;
+        for (int b = 0; b < 256; b++) {
+            auto key = std::make_pair(classOf[b], static_cast<bool>(state.Chars[b]));
+            auto found = split.find(key);
+            if (found == split.end()) {
+                found = split.emplace(key, next++).first;
+            }
+            classOf[b] = found->second;
+        }
+        classes = next;
+    }
+    if (classes > 256) {
+        return false;
+    }
+    int representative[256];
+    for (int b = 255; b >= 0; b--) {
+        ByteClass[b] = static_cast<uint8_t>(classOf[b]);
+        representative[classOf[b]] = b;
+    }
+    ClassCount = classes;
+
+    // subset construction, DFA state 0 is the dead state and 1 the start state
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> sets;
+    sets.emplace_back();
+    ids[sets[0]] = 0;
+    std::vector<int> start = {0};
+    EpsilonClosure(states, start);
+    ids[start] = 1;
+    sets.push_back(start);
+
+    for (size_t current = 0; current < sets.size(); current++) {
+        if (sets.size() > 0xFFFF) {
+            return false;
+        }
+        int accept = -1;
+        for (int state : sets[current]) {
+            if (states[state].Accept >= 0 && (accept < 0 || states[state].Accept < accept)) {
+                accept = states[state].Accept;
+            }
+        }
+        Accepting.push_back(accept);
+
+        for (int cls = 0; cls < ClassCount; cls++) {
+            std::vector<int> target;
+            for (int state : sets[current]) {
+                if (states[state].Next >= 0 && states[state].Chars[representative[cls]]) {
+                    target.push_back(states[state].Next);
+                }
+            }
+            int id = 0;
+            if (!target.empty()) {
+                EpsilonClosure(states, target);
+                auto found = ids.find(target);
+                if (found == ids.end()) {
+                    id = static_cast<int>(sets.size());
+                    ids.emplace(target, id);
+                    sets.push_back(target);
+                }
+                else {
+                    id = found->second;
+                }
+            }
+            Transitions.push_back(static_cast<uint16_t>(id));
+        }
+    }
+    StateCount = static_cast<int>(sets.size());
+
+    // finding the states where a kernel can take over: the bytes that keep the automaton in the same state
+    // must be exactly one of the kernel classes
+    const ScanKernel candidates[] = {ScanKernel::WHITESPACE, ScanKernel::IDENTIFIER, ScanKernel::DIGITS, ScanKernel::STRING_BODY};
+    std::vector<std::bitset<256>> kernelBytes;
+    for (ScanKernel kernel : candidates) {
+        std::bitset<256> bytes;
+        char probe[1];
+        for (int b = 0; b < 256; b++) {
+            probe[0] = static_cast<char>(b);
+            bytes[b] = ScanRun(kernel, probe, 0, 1) == 1;
+        }
+        kernelBytes.push_back(bytes);
+    }
+    Kernels.assign(StateCount, ScanKernel::NONE);
+    for (int state = 1; state < StateCount; state++) {
+        std::bitset<256> loop;
+        for (int b = 0; b < 256; b++) {
+            loop[b] = Transitions[state * ClassCount + ByteClass[b]] == state;
+        }
+        for (size_t k = 0; k < kernelBytes.size(); k++) {
+            if (loop == kernelBytes[k]) {
+                Kernels[state] = candidates[k];
+            }
+        }
+    }
+    return true;
+}
+
+bool Dfa::IsCompiled() const {
+    return StateCount > 0;
+}
+
+int Dfa::Match(std::string_view text, size_t position, int* length, size_t* scanned) const {
+    int rule = -1;
+    size_t best = position;
+    uint32_t state = 1;
+    size_t i = position;
+    while (i < text.size()) {
+        state = Transitions[state * ClassCount + ByteClass[static_cast<unsigned char>(text[i])]];
+        if (state == 0) {
+            i++;
+            break;
+        }
+        i++;
+        if (Kernels[state] != ScanKernel::NONE) {
+            // every byte the kernel skips keeps us in this state
+            i = ScanRun(Kernels[state], text.data(), i, text.size());
+        }
+        if (Accepting[state] >= 0) {
+            rule = Accepting[state];
+            best = i;
+        }
+    }
+    *length = static_cast<int>(best - position);
+    if (scanned != nullptr) {
+        *scanned = state == 0 ? i : text.size() + 1;
+    }
+    return rule;
+}
+
+int Dfa::GetStateCount() const {
+    return StateCount;
+}
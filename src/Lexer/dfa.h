@@ -0,0 +1,42 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "scan.h"
+
+// a deterministic automaton built from the source text of every lexer rule at once
+// (rule 0 wins over rule 1 when both match the same length, just like the order in ConstructLexer)
+class Dfa {
+    public:
+        Dfa();
+
+        // compiles the given patterns into one automaton, returns false if one of them uses regex syntax we can't compile
+        bool Compile(const std::vector<std::string>& patterns);
+
+        // true when Compile succeeded and Match can be used
+        bool IsCompiled() const;
+
+        // runs the automaton from position and returns the index of the rule with the longest match (or -1),
+        // the length of that match is written to length, and if scanned is given it gets the offset just past the
+        // last byte the automaton had to look at (text.size() + 1 if it ran into the end of the text)
+        int Match(std::string_view text, size_t position, int* length, size_t* scanned = nullptr) const;
+
+        // number of states (including the dead state 0), handy for debugging
+        int GetStateCount() const;
+
+    private:
+        int StateCount;
+        int ClassCount;
+        uint8_t ByteClass[256];
+        std::vector<uint16_t> Transitions;
+        std::vector<int> Accepting;
+        // states that loop on themselves over a whole character class we have a vectorized kernel for
+        // (identifier bodies, whitespace runs, digits, string bodies) skip that run in one call
+        std::vector<ScanKernel> Kernels;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "diagnostics.h"
+#include "scan.h"
+#include "utf8.h"
+
+const char* GetDiagnosticMessage(DiagnosticCode code) {
+    switch (code) {
+        case DiagnosticCode::UNEXPECTED_CHARACTERS: return "unexpected characters";
+        case DiagnosticCode::UNTERMINATED_STRING: return "unterminated string literal";
+        case DiagnosticCode::NUMBER_OUT_OF_RANGE: return "number literal out of range";
+        case DiagnosticCode::UNEXPECTED_TOKEN: return "unexpected token";
+        case DiagnosticCode::MISSING_TOKEN: return "expected";
+        case DiagnosticCode::INVALID_ASSIGNMENT: return "cannot assign to this expression";
+        case DiagnosticCode::NESTING_TOO_DEEP: return "nesting too deep";
+        case DiagnosticCode::UNDEFINED_NAME: return "undefined name";
+        case DiagnosticCode::CONSTANT_ASSIGNMENT: return "cannot assign to a constant";
+        case DiagnosticCode::NOT_SUPPORTED: return "not supported yet";
+        case DiagnosticCode::FUNCTION_TOO_LARGE: return "function too large";
+        case DiagnosticCode::TYPE_MISMATCH: return "wrong type of operand for";
+        case DiagnosticCode::NOT_CALLABLE: return "not a function";
+        case DiagnosticCode::WRONG_ARGUMENT_COUNT: return "wrong number of arguments to";
+        case DiagnosticCode::INDEX_OUT_OF_RANGE: return "index out of range";
+        case DiagnosticCode::STACK_OVERFLOW: return "call stack too deep calling";
+        case DiagnosticCode::MODULE_NOT_FOUND: return "cannot read module";
+        case DiagnosticCode::IMPORT_CYCLE: return "import cycle through";
+        case DiagnosticCode::MODULE_HAS_ERRORS: return "imported module has errors";
+        case DiagnosticCode::NOT_EXPORTED: return "not exported by the module";
+        case DiagnosticCode::IMPORT_CONFLICT: return "already imported or declared";
+        case DiagnosticCode::TOO_MANY_GLOBALS: return "too many globals at";
+        case DiagnosticCode::INVALID_UTF8: return "invalid UTF-8";
+        default: return "unknown error";
+    }
+}
+
+std::vector<Diagnostic> CollectDiagnostics(std::string_view source, const std::vector<uint32_t>& unmatched) {
+    std::vector<Diagnostic> diagnostics;
+    for (uint32_t offset : unmatched) {
+        bool quote = offset < source.size() && source[offset] == '"';
+        if (!quote && !diagnostics.empty()) {
+            Diagnostic& last = diagnostics.back();
+            if (last.Code == DiagnosticCode::UNEXPECTED_CHARACTERS && last.Offset + last.Length == offset) {
+                last.Length++;
+                continue;
+            }
+        }
+        diagnostics.push_back(Diagnostic{quote ? DiagnosticCode::UNTERMINATED_STRING : DiagnosticCode::UNEXPECTED_CHARACTERS, offset, 1});
+    }
+    return diagnostics;
+}
+
+std::vector<Diagnostic> CollectDiagnostics(const TokenStream& stream) {
+    std::vector<Diagnostic> diagnostics = CollectDiagnostics(stream.GetSource(), stream.Unmatched);
+    size_t unmatched = diagnostics.size();
+    for (const Token& token : stream.Tokens) {
+        if (token.type == TokenType::NUMBER && token.symbol == 0) {
+            diagnostics.push_back(Diagnostic{DiagnosticCode::NUMBER_OUT_OF_RANGE, token.offset, token.length});
+        }
+    }
+    size_t numbers = diagnostics.size();
+    // an ASCII source is confirmed by the ASCII kernel alone, without decoding a byte
+    std::string_view source = stream.GetSource();
+    size_t length;
+    for (size_t position = ValidateUtf8(source, 0, &length); position < source.size(); position = ValidateUtf8(source, position + length, &length)) {
+        if (diagnostics.size() > numbers && diagnostics.back().Offset + diagnostics.back().Length == position) {
+            diagnostics.back().Length += static_cast<uint32_t>(length);
+            continue;
+        }
+        diagnostics.push_back(Diagnostic{DiagnosticCode::INVALID_UTF8, static_cast<uint32_t>(position), static_cast<uint32_t>(length)});
+    }
+
+    auto byOffset = [](const Diagnostic& left, const Diagnostic& right) {
+        return left.Offset < right.Offset;
+    };
+    if (numbers > unmatched && unmatched > 0) {
+        std::inplace_merge(diagnostics.begin(), diagnostics.begin() + unmatched, diagnostics.begin() + numbers, byOffset);
+    }
+    if (diagnostics.size() > numbers && numbers > 0) {
+        std::inplace_merge(diagnostics.begin(), diagnostics.begin() + numbers, diagnostics.end(), byOffset);
+    }
+    return diagnostics;
+}
+
+// creating a table over a source, nothing is scanned yet
+LineTable::LineTable(std::string_view source) {
+    Source = source;
+}
+
+void LineTable::Build() const {
+    LineStarts.push_back(0);
+    size_t position = 0;
+    while (true) {
+        position = ScanRun(ScanKernel::LINE_BODY, Source.data(), position, Source.size());
+        if (position >= Source.size()) {
+            break;
+        }
+        position++;
+        LineStarts.push_back(static_cast<uint32_t>(position));
+    }
+}
+
+SourceLocation LineTable::Locate(uint32_t offset) const {
+    std::call_once(Built, [this]() {
+        Build();
+    });
+    // the last line starting at or before the offset
+    size_t line = std::upper_bound(LineStarts.begin(), LineStarts.end(), offset) - LineStarts.begin() - 1;
+    size_t column = CountCodePoints(Source.substr(LineStarts[line], std::min<size_t>(offset, Source.size()) - LineStarts[line]));
+    return SourceLocation{static_cast<uint32_t>(line + 1), static_cast<uint32_t>(column + 1)};
+}
+
+std::string_view LineTable::GetLine(uint32_t line) const {
+    std::call_once(Built, [this]() {
+        Build();
+    });
+    if (line == 0 || line > LineStarts.size()) {
+        return std::string_view();
+    }
+    size_t begin = LineStarts[line - 1];
+    size_t end = line < LineStarts.size() ? LineStarts[line] - 1 : Source.size();
+    return Source.substr(begin, end - begin);
+}
+
+// getter for the source field
+std::string_view LineTable::GetSource() const {
+    return Source;
+}
+
+size_t LineTable::GetLineCount() const {
+    std::call_once(Built, [this]() {
+        Build();
+    });
+    return LineStarts.size();
+}
+
+// appends the bytes of a diagnostic the way a C string literal would spell them (at most 16 of them), a
+// well-formed multibyte sequence is copied as it is so a name in another script reads as itself
+static void appendQuoted(std::string& out, std::string_view bytes) {
+    static const char digits[] = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < bytes.size() && i < 16; i++) {
+        unsigned char c = static_cast<unsigned char>(bytes[i]);
+        size_t length;
+        if (c >= 0x80 && DecodeUtf8(bytes, i, &length) != InvalidCodePoint) {
+            out.append(bytes.substr(i, length));
+            i += length - 1;
+        }
+        else if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        }
+        else if (c >= 0x20 && c < 0x7F) {
+            out += static_cast<char>(c);
+        }
+        else {
+            out += "\\x";
+            out += digits[c >> 4];
+            out += digits[c & 15];
+        }
+    }
+    out += bytes.size() > 16 ? "\"..." : "\"";
+}
+
+void AppendDiagnostics(std::string& out, const std::string& path, const LineTable& lines, const std::vector<Diagnostic>& diagnostics, size_t limit) {
+    static const char digits[] = "0123456789";
+    for (size_t i = 0; i < diagnostics.size() && i < limit; i++) {
+        const Diagnostic& diagnostic = diagnostics[i];
+        SourceLocation location = lines.Locate(diagnostic.Offset);
+        uint16_t code = static_cast<uint16_t>(diagnostic.Code);
+
+        out += path;
+        out += ':';
+        out += std::to_string(location.Line);
+        out += ':';
+        out += std::to_string(location.Column);
+        out += ": error E";
+        out += digits[code / 1000 % 10];
+        out += digits[code / 100 % 10];
+        out += digits[code / 10 % 10];
+        out += digits[code % 10];
+        out += ": ";
+        out += GetDiagnosticMessage(diagnostic.Code);
+        if (diagnostic.Code == DiagnosticCode::MISSING_TOKEN) {
+            // "expected CLOSE PARENTHESIS before "{"" (or at the end of the file, where the EOF token is empty)
+            out += ' ';
+            out += Token::GetType(diagnostic.Expected);
+            out += diagnostic.Length > 0 ? " before" : "";
+        }
+        if (diagnostic.Code != DiagnosticCode::UNTERMINATED_STRING && diagnostic.Length == 0) {
+            out += " at end of file";
+        }
+        else if (diagnostic.Code != DiagnosticCode::UNTERMINATED_STRING) {
+            out += ' ';
+            appendQuoted(out, lines.GetSource().substr(diagnostic.Offset, diagnostic.Length));
+        }
+        out += '\n';
+    }
+    if (diagnostics.size() > limit) {
+        out += path;
+        out += ": ";
+        out += std::to_string(diagnostics.size() - limit);
+        out += " more errors not shown\n";
+    }
+}
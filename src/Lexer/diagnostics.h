@@ -0,0 +1,86 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "tokens.h"
+
+#include <mutex>
+
+// what went wrong, the number is the one printed (E0001, ...) and never changes meaning
+enum class DiagnosticCode : uint16_t {
+    UNEXPECTED_CHARACTERS = 1, // bytes no rule matched
+    UNTERMINATED_STRING = 2,   // a quote whose string literal never ends
+    NUMBER_OUT_OF_RANGE = 3,   // a number literal too large for its type (see DecodeNumber)
+    UNEXPECTED_TOKEN = 4,      // a token the parser can't use where it is
+    MISSING_TOKEN = 5,         // the parser needed a given token (Diagnostic::Expected) before this one
+    INVALID_ASSIGNMENT = 6,    // the left side of an assignment, ++ or -- isn't a name, a member or an index
+    NESTING_TOO_DEEP = 7,      // more nested expressions or blocks than the parser follows (see MaxParseDepth)
+    UNDEFINED_NAME = 8,        // a name the compiler finds no declaration of
+    CONSTANT_ASSIGNMENT = 9,   // an assignment, ++ or -- to a const
+    NOT_SUPPORTED = 10,        // parses, but the compiler can't run it yet (classes, members, closures)
+    FUNCTION_TOO_LARGE = 11,   // a function needs more registers or longer jumps than the bytecode has
+    TYPE_MISMATCH = 12,        // at run time: an operator or a native function given a value of the wrong type
+    NOT_CALLABLE = 13,         // at run time: a call of something that isn't a function
+    WRONG_ARGUMENT_COUNT = 14, // at run time: a call with more or fewer arguments than the function has parameters
+    INDEX_OUT_OF_RANGE = 15,   // at run time: an index that isn't a whole number inside the array or string
+    STACK_OVERFLOW = 16,       // at run time: calls nested deeper than the VM's stack (see MaxCallDepth)
+    MODULE_NOT_FOUND = 17,     // an import of a file that can't be read
+    IMPORT_CYCLE = 18,         // an import of a module that imports this one, directly or through others
+    MODULE_HAS_ERRORS = 19,    // an import of a module that has errors of its own (reported with its file)
+    NOT_EXPORTED = 20,         // an import of a name the module doesn't export
+    IMPORT_CONFLICT = 21,      // a name imported twice, or imported and declared at the top level too
+    TOO_MANY_GLOBALS = 22,     // more globals than the bytecode has slots for (every module of a build shares them)
+    INVALID_UTF8 = 23          // bytes that aren't well-formed UTF-8 (see DecodeUtf8), in a name, a string or anywhere
+};
+
+// one problem found in a source, as a range of bytes (line and column are only worked out when it is printed)
+struct Diagnostic {
+    DiagnosticCode Code;
+    uint32_t Offset;
+    uint32_t Length;
+    // only for MISSING_TOKEN
+    TokenType Expected = TokenType::E0F_TOKEN;
+};
+
+const char* GetDiagnosticMessage(DiagnosticCode code);
+
+// turns the unmatched offsets of a lexer into diagnostics: a run of neighbouring bytes is one diagnostic, a quote
+// always gets one of its own (costs nothing when there are no unmatched bytes)
+std::vector<Diagnostic> CollectDiagnostics(std::string_view source, const std::vector<uint32_t>& unmatched);
+
+// same for a stream, with the number literals that didn't decode (a NUMBER token whose symbol is 0) and the
+// ill-formed UTF-8 sequences (one per run of neighbouring ones, found by ValidateUtf8) as well, sorted by offset
+std::vector<Diagnostic> CollectDiagnostics(const TokenStream& stream);
+
+// 1-based line and column (the column counts code points, an ill-formed sequence counts as one)
+struct SourceLocation {
+    uint32_t Line;
+    uint32_t Column;
+};
+
+// the offset every line starts at, found the first time a location is asked for (one pass of the LINE_BODY
+// scan kernel) and searched with a binary search after that, so a source with no errors never builds it
+class LineTable {
+    public:
+        // the source has to outlive the table
+        explicit LineTable(std::string_view source);
+
+        SourceLocation Locate(uint32_t offset) const;
+
+        // the text of a line, without its '\n'
+        std::string_view GetLine(uint32_t line) const;
+        size_t GetLineCount() const;
+        std::string_view GetSource() const;
+
+    private:
+        std::string_view Source;
+        mutable std::once_flag Built;
+        mutable std::vector<uint32_t> LineStarts;
+
+        void Build() const;
+};
+
+// appends one line per diagnostic, "path:line:column: error E0001: message", stopping after limit of them
+// (a binary file can have one for every few bytes) with a line saying how many were left out
+void AppendDiagnostics(std::string& out, const std::string& path, const LineTable& lines, const std::vector<Diagnostic>& diagnostics, size_t limit = 20);
+
+#endif
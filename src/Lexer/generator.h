@@ -0,0 +1,91 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "lexer.h"
+
+// coroutine adaptor over Lexer::NextToken, only available when compiled as C++20 (ex: -std=c++20)
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+
+// a lazy sequence of tokens, ends right after the EOF token:
+//     for (const Token& token : GenerateTokens(lexer)) { ... }
+class TokenGenerator {
+    public:
+        struct promise_type {
+            Token Current;
+
+            TokenGenerator get_return_object() {
+                return TokenGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+            std::suspend_always yield_value(const Token& token) noexcept {
+                Current = token;
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() {
+                throw;
+            }
+        };
+
+        class Iterator {
+            public:
+                explicit Iterator(std::coroutine_handle<promise_type> handle) : Handle(handle) {}
+
+                const Token& operator*() const {
+                    return Handle.promise().Current;
+                }
+                Iterator& operator++() {
+                    Handle.resume();
+                    return *this;
+                }
+                bool operator!=(std::default_sentinel_t) const {
+                    return !Handle.done();
+                }
+
+            private:
+                std::coroutine_handle<promise_type> Handle;
+        };
+
+        explicit TokenGenerator(std::coroutine_handle<promise_type> handle) : Handle(handle) {}
+        TokenGenerator(TokenGenerator&& other) noexcept : Handle(other.Handle) {
+            other.Handle = nullptr;
+        }
+        TokenGenerator(const TokenGenerator&) = delete;
+        ~TokenGenerator() {
+            if (Handle) {
+                Handle.destroy();
+            }
+        }
+
+        Iterator begin() {
+            Handle.resume();
+            return Iterator(Handle);
+        }
+        std::default_sentinel_t end() {
+            return {};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> Handle;
+};
+
+// yields every token of the lexer (EOF last), the lexer must outlive the generator
+inline TokenGenerator GenerateTokens(Lexer* lexer) {
+    while (true) {
+        Token token = lexer->NextToken();
+        co_yield token;
+        if (token.type == TokenType::E0F_TOKEN) {
+            co_return;
+        }
+    }
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,461 @@
+#include "incremental.h"
+#include "utf8.h"
+
+// end offset of a token (where the lexer was right after matching it)
+static size_t tokenEnd(const Token& token) {
+    return static_cast<size_t>(token.offset) + token.length;
+}
+
+// replays the lexer's matches from begin (a position the lexer really stood at) up to end and returns true if
+// one of them had to look at the byte at edit or after it
+static bool reachesEdit(const Dfa& dfa, std::string_view source, size_t begin, size_t end, size_t edit) {
+    size_t position = begin;
+    while (position < end) {
+        int length = 0;
+        size_t scanned = 0;
+        dfa.Match(source, position, &length, &scanned);
+        if (scanned > edit) {
+            return true;
+        }
+        position += length > 0 ? length : 1;
+    }
+    return false;
+}
+
+// drops the values no number token refers to anymore, renumbering the symbols of the number tokens
+static void packNumbers(TokenStream& stream) {
+    std::vector<NumberValue> numbers;
+    for (Token& token : stream.Tokens) {
+        if (token.type == TokenType::NUMBER && token.symbol != 0) {
+            numbers.push_back(stream.Numbers[token.symbol - 1]);
+            token.symbol = static_cast<uint32_t>(numbers.size());
+        }
+    }
+    stream.Numbers = std::move(numbers);
+}
+
+void Relex(Lexer* lexer, TokenStream& stream, const TextEdit& edit, RelexStats* stats) {
+    // keeping the old buffer alive until the old tokens aren't needed anymore
+    std::shared_ptr<const SourceBuffer> previous = stream.Source;
+    std::string_view old = stream.GetSource();
+    std::vector<Token>& tokens = stream.Tokens;
+
+    // an edit reaching past the end of the buffer is cut at the end
+    size_t editStart = std::min<size_t>(edit.Offset, old.size());
+    size_t editEndOld = std::min<size_t>(editStart + edit.RemovedLength, old.size());
+    size_t editEndNew = editStart + edit.InsertedText.size();
+    int64_t delta = static_cast<int64_t>(edit.InsertedText.size()) - static_cast<int64_t>(editEndOld - editStart);
+
+    // building the edited buffer
+    std::string text;
+    text.reserve(old.size() - (editEndOld - editStart) + edit.InsertedText.size());
+    text.append(old.substr(0, editStart));
+    text.append(edit.InsertedText);
+    text.append(old.substr(editEndOld));
+    std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(std::move(text));
+
+    // every token but the EOF token at the end
+    size_t count = tokens.empty() ? 0 : tokens.size() - 1;
+
+    // the first token that touches the edit (a token ending right at the edit may grow, so touching counts)
+    size_t restart = std::lower_bound(tokens.begin(), tokens.begin() + count, editStart, [](const Token& token, size_t offset) {
+        return tokenEnd(token) < offset;
+    }) - tokens.begin();
+
+    // walking back over tokens whose match had to look at a byte the edit changes (ex: "-" followed by
+    // whitespace, where the DFA kept reading in case digits follow), without the DFA we can't tell so start over
+    const Dfa& dfa = lexer->GetDfa();
+    if (!dfa.IsCompiled() || lexer->GetUseRegex()) {
+        restart = 0;
+    }
+    while (restart > 0) {
+        size_t begin = restart > 1 ? tokenEnd(tokens[restart - 2]) : 0;
+        if (!reachesEdit(dfa, old, begin, tokenEnd(tokens[restart - 1]), editStart)) {
+            break;
+        }
+        restart--;
+    }
+
+    // a byte nothing matched (ex: a quote that never closes) may have been read up to the end of the file, the
+    // stream remembers where those are so the first one that looked at the edit moves the restart point back
+    size_t limit = restart > 0 ? tokenEnd(tokens[restart - 1]) : 0;
+    for (auto unmatched = stream.Unmatched.begin(); unmatched != stream.Unmatched.end() && *unmatched < limit; ++unmatched) {
+        if (reachesEdit(dfa, old, *unmatched, *unmatched + 1, editStart)) {
+            restart = std::upper_bound(tokens.begin(), tokens.begin() + restart, *unmatched, [](size_t offset, const Token& token) {
+                return offset < tokenEnd(token);
+            }) - tokens.begin();
+            break;
+        }
+    }
+    size_t position = restart > 0 ? tokenEnd(tokens[restart - 1]) : 0;
+
+    lexer->SetSource(source);
+    lexer->SetEnd(std::string_view::npos);
+    // new names go into the stream's table so old and new tokens share ids
+    if (lexer->GetSymbols() != stream.Symbols) {
+        lexer->SetSymbols(stream.Symbols);
+    }
+    lexer->Restart(static_cast<int>(position));
+
+    // lexing until a new token ends where an old token ended past the edit, from there on the lexer would do
+    // exactly what it did before (same bytes, same position), so the old tokens after it only need shifting
+    std::vector<Token> fresh;
+    size_t reuse = count;
+    bool converged = false;
+    while (true) {
+        Token token = lexer->NextToken();
+        if (token.type == TokenType::E0F_TOKEN) {
+            break;
+        }
+        fresh.push_back(token);
+
+        size_t end = tokenEnd(token);
+        if (end < editEndNew || static_cast<size_t>(lexer->GetPosition()) != end) {
+            continue;
+        }
+        size_t oldEnd = static_cast<size_t>(static_cast<int64_t>(end) - delta);
+        auto match = std::lower_bound(tokens.begin() + restart, tokens.begin() + count, oldEnd, [](const Token& old, size_t offset) {
+            return tokenEnd(old) < offset;
+        });
+        if (match != tokens.begin() + count && tokenEnd(*match) == oldEnd) {
+            reuse = (match - tokens.begin()) + 1;
+            converged = true;
+            break;
+        }
+    }
+
+    // same for the unmatched bytes: the ones in the re-lexed range are replaced by what the lexer found this time
+    // (converging on the last token still leaves the ones after it, those the lexer didn't get to again)
+    size_t oldBegin = position;
+    size_t oldEnd = converged ? tokenEnd(tokens[reuse - 1]) : old.size() + 1;
+    std::vector<uint32_t>& unmatched = stream.Unmatched;
+    auto first = std::lower_bound(unmatched.begin(), unmatched.end(), oldBegin);
+    auto last = std::lower_bound(first, unmatched.end(), oldEnd);
+    first = unmatched.insert(unmatched.erase(first, last), lexer->GetUnmatched().begin(), lexer->GetUnmatched().end());
+    for (auto shifted = first + lexer->GetUnmatched().size(); shifted != unmatched.end(); ++shifted) {
+        *shifted = static_cast<uint32_t>(static_cast<int64_t>(*shifted) + delta);
+    }
+
+    // the values of the new numbers are appended, the ones they replace stay behind until they outnumber the
+    // tokens, then the live ones are packed again (so an edit stays amortised O(edit))
+    uint32_t base = static_cast<uint32_t>(stream.Numbers.size());
+    for (Token& token : fresh) {
+        if (token.type == TokenType::NUMBER && token.symbol != 0) {
+            token.symbol += base;
+        }
+    }
+    stream.Numbers.insert(stream.Numbers.end(), lexer->GetNumbers().begin(), lexer->GetNumbers().end());
+    // what the old tokens saw isn't known per token, so the flag only ever gets set here (CollectDiagnostics
+    // finds nothing if the edit took the bad bytes out)
+    stream.MayHaveErrors = stream.MayHaveErrors || lexer->GetMayHaveErrors();
+
+    // splicing the new tokens over [restart, reuse) and shifting everything after them
+    tokens.erase(tokens.begin() + restart, tokens.begin() + reuse);
+    tokens.insert(tokens.begin() + restart, fresh.begin(), fresh.end());
+    for (size_t i = restart + fresh.size(); i < tokens.size(); i++) {
+        tokens[i].offset = static_cast<uint32_t>(static_cast<int64_t>(tokens[i].offset) + delta);
+    }
+    if (tokens.empty() || tokens.back().type != TokenType::E0F_TOKEN) {
+        tokens.push_back(Token::ConstructToken(TokenType::E0F_TOKEN, source->View().size(), 0));
+    }
+    stream.Source = source;
+    if (stream.Numbers.size() > 2 * tokens.size()) {
+        packNumbers(stream);
+    }
+
+    if (stats != nullptr) {
+        stats->RestartToken = restart;
+        stats->RelexedTokens = fresh.size();
+        stats->Converged = converged;
+    }
+}
+
+// offsets where stream can be cut into chunks of about chunkSize bytes that lex on their own to the same tokens:
+// right after a newline that no string literal holds and no scan of a skipped quote read past (the scan of a
+// quote that never closes stops at a backslash before a newline, or runs to the end and then nothing after it
+// can be cut). whitespace runs read across lines too, but lexing from inside one only skips the rest of it
+static std::vector<size_t> findCuts(const TokenStream& stream, const Dfa& dfa, size_t chunkSize) {
+    std::vector<size_t> cuts;
+    std::string_view text = stream.GetSource();
+    if (!dfa.IsCompiled()) {
+        return cuts;
+    }
+    size_t reach = 0;
+    size_t token = 0;
+    size_t unmatched = 0;
+    size_t from = chunkSize;
+    while (from < text.size()) {
+        size_t newline = text.find('\n', std::max(from, reach));
+        if (newline == std::string_view::npos || newline + 1 >= text.size()) {
+            break;
+        }
+        size_t cut = newline + 1;
+        for (; token < stream.Tokens.size() && stream.Tokens[token].offset < cut; token++) {
+            if (stream.Tokens[token].type == TokenType::STRING) {
+                reach = std::max(reach, tokenEnd(stream.Tokens[token]));
+            }
+        }
+        for (; unmatched < stream.Unmatched.size() && stream.Unmatched[unmatched] < cut; unmatched++) {
+            if (text[stream.Unmatched[unmatched]] != '"') {
+                continue;
+            }
+            int length = 0;
+            size_t scanned = 0;
+            dfa.Match(text, stream.Unmatched[unmatched], &length, &scanned);
+            if (scanned > text.size()) {
+                return cuts;
+            }
+            reach = std::max(reach, scanned);
+        }
+        if (reach > cut) {
+            from = reach;
+            continue;
+        }
+        cuts.push_back(cut);
+        from = cut + chunkSize;
+    }
+    return cuts;
+}
+
+// true if nothing the lexer matched from offset from on read past the end of the chunk, so the chunk after it
+// still lexes on its own (the same conditions as findCuts)
+static bool endsCleanly(const TokenStream& chunk, const Dfa& dfa, size_t from) {
+    std::string_view text = chunk.GetSource();
+    if (text.empty()) {
+        return true;
+    }
+    if (text.back() != '\n' || !dfa.IsCompiled()) {
+        return false;
+    }
+    for (auto unmatched = std::lower_bound(chunk.Unmatched.begin(), chunk.Unmatched.end(), from); unmatched != chunk.Unmatched.end(); ++unmatched) {
+        if (text[*unmatched] != '"') {
+            continue;
+        }
+        int length = 0;
+        size_t scanned = 0;
+        dfa.Match(text, *unmatched, &length, &scanned);
+        if (scanned > text.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the bytes [begin, end) of stream as a stream of their own, token is the index of the first token at begin or
+// after it and is moved past the last one taken (same for unmatched)
+static TokenStream slice(const TokenStream& stream, size_t begin, size_t end, size_t& token, size_t& unmatched) {
+    std::string_view text = stream.GetSource().substr(begin, end - begin);
+    TokenStream chunk;
+    chunk.Source = SourceBuffer::FromString(std::string(text));
+    chunk.Symbols = stream.Symbols;
+    bool undecoded = false;
+    for (; token < stream.Tokens.size() && stream.Tokens[token].type != TokenType::E0F_TOKEN && stream.Tokens[token].offset < end; token++) {
+        Token moved = stream.Tokens[token];
+        moved.offset -= static_cast<uint32_t>(begin);
+        if (moved.type == TokenType::NUMBER) {
+            if (moved.symbol != 0) {
+                chunk.Numbers.push_back(stream.Numbers[moved.symbol - 1]);
+                moved.symbol = static_cast<uint32_t>(chunk.Numbers.size());
+            }
+            else {
+                undecoded = true;
+            }
+        }
+        chunk.Tokens.push_back(moved);
+    }
+    chunk.Tokens.push_back(Token::ConstructToken(TokenType::E0F_TOKEN, static_cast<uint32_t>(text.size()), 0));
+    for (; unmatched < stream.Unmatched.size() && stream.Unmatched[unmatched] < end; unmatched++) {
+        chunk.Unmatched.push_back(static_cast<uint32_t>(stream.Unmatched[unmatched] - begin));
+    }
+    // the hint is worked out again for the piece, so one bad byte doesn't mark every chunk of the file
+    chunk.MayHaveErrors = stream.MayHaveErrors && (undecoded || !IsAscii(text));
+    return chunk;
+}
+
+// stream cut into chunks at findCuts (a single chunk if it can't be cut)
+static std::vector<TokenStream> split(const TokenStream& stream, const Dfa& dfa, size_t chunkSize) {
+    std::vector<size_t> cuts = findCuts(stream, dfa, chunkSize);
+    cuts.push_back(stream.GetSource().size());
+    std::vector<TokenStream> chunks;
+    size_t begin = 0;
+    size_t token = 0;
+    size_t unmatched = 0;
+    for (size_t cut : cuts) {
+        chunks.push_back(slice(stream, begin, cut, token, unmatched));
+        begin = cut;
+    }
+    return chunks;
+}
+
+// the chunks [first, last) put back together into one stream, with offsets from the start of the first
+static TokenStream join(const TokenStream* first, const TokenStream* last, const std::shared_ptr<SymbolTable>& symbols) {
+    TokenStream stream;
+    stream.Symbols = symbols;
+    std::string text;
+    size_t size = 0;
+    size_t tokens = 0;
+    for (const TokenStream* chunk = first; chunk != last; ++chunk) {
+        size += chunk->GetSource().size();
+        tokens += chunk->Tokens.size() - 1;
+    }
+    text.reserve(size);
+    stream.Tokens.reserve(tokens + 1);
+    for (const TokenStream* chunk = first; chunk != last; ++chunk) {
+        uint32_t base = static_cast<uint32_t>(text.size());
+        uint32_t numbers = static_cast<uint32_t>(stream.Numbers.size());
+        text.append(chunk->GetSource());
+        for (size_t i = 0; i + 1 < chunk->Tokens.size(); i++) {
+            Token token = chunk->Tokens[i];
+            token.offset += base;
+            if (token.type == TokenType::NUMBER && token.symbol != 0) {
+                token.symbol += numbers;
+            }
+            stream.Tokens.push_back(token);
+        }
+        stream.Numbers.insert(stream.Numbers.end(), chunk->Numbers.begin(), chunk->Numbers.end());
+        for (uint32_t unmatched : chunk->Unmatched) {
+            stream.Unmatched.push_back(unmatched + base);
+        }
+        stream.MayHaveErrors = stream.MayHaveErrors || chunk->MayHaveErrors;
+    }
+    stream.Tokens.push_back(Token::ConstructToken(TokenType::E0F_TOKEN, static_cast<uint32_t>(text.size()), 0));
+    stream.Source = SourceBuffer::FromString(std::move(text));
+    return stream;
+}
+
+// building the chunks, cut where the default rules allow it
+IncrementalStream::IncrementalStream(const TokenStream& stream, size_t chunkSize) : Symbols(stream.Symbols) {
+    ChunkSize = std::max<size_t>(chunkSize, 1);
+    Chunks = split(stream, RuleSet::GetDefault()->GetDfa(), ChunkSize);
+    Rebuild();
+}
+
+void IncrementalStream::Relex(Lexer* lexer, const TextEdit& edit, RelexStats* stats) {
+    size_t editStart = std::min<size_t>(edit.Offset, Size);
+    size_t editEnd = std::min<size_t>(editStart + edit.RemovedLength, Size);
+    size_t start = 0;
+    size_t first = Locate(editStart, &start);
+    size_t last = editEnd > editStart ? Locate(editEnd - 1, nullptr) : first;
+    size_t before = TokensBefore(first);
+    TextEdit local{static_cast<uint32_t>(editStart - start), static_cast<uint32_t>(editEnd - editStart), edit.InsertedText};
+
+    // the edit is applied to a copy of its chunks, and applied again with twice as many chunks after them while
+    // what it left at the end of the copy reads on into the next chunk (ex: a quote that no longer closes)
+    const Dfa& dfa = lexer->GetDfa();
+    TokenStream merged;
+    RelexStats relexed;
+    while (true) {
+        merged = first == last ? Chunks[first] : join(&Chunks[first], &Chunks[last] + 1, Symbols);
+        ::Relex(lexer, merged, local, &relexed);
+        size_t from = relexed.RestartToken > 0 ? tokenEnd(merged.Tokens[relexed.RestartToken - 1]) : 0;
+        if (last + 1 == Chunks.size() || endsCleanly(merged, dfa, from)) {
+            break;
+        }
+        last = std::min(Chunks.size() - 1, last + (last - first + 1));
+    }
+    if (stats != nullptr) {
+        stats->RestartToken = before + relexed.RestartToken;
+        stats->RelexedTokens = relexed.RelexedTokens;
+        // the chunks after the copy are the same tokens as before, so it lined up at the end of the copy at worst
+        stats->Converged = relexed.Converged || last + 1 < Chunks.size();
+    }
+
+    // one chunk in place of one only moves the chunks after it in the trees, anything else builds them again
+    size_t size = merged.GetSource().size();
+    if (first == last && size <= 2 * ChunkSize && (size > 0 || Chunks.size() == 1)) {
+        size_t bytes = size - Chunks[first].GetSource().size();
+        size_t tokens = merged.Tokens.size() - Chunks[first].Tokens.size();
+        Chunks[first] = std::move(merged);
+        Add(first, bytes, tokens);
+        return;
+    }
+    std::vector<TokenStream> pieces;
+    if (size > 2 * ChunkSize) {
+        pieces = split(merged, dfa, ChunkSize);
+    }
+    else if (size > 0 || Chunks.size() == last - first + 1) {
+        pieces.push_back(std::move(merged));
+    }
+    Chunks.erase(Chunks.begin() + first, Chunks.begin() + last + 1);
+    Chunks.insert(Chunks.begin() + first, std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+    Rebuild();
+}
+
+TokenStream IncrementalStream::ToStream() const {
+    return join(Chunks.data(), Chunks.data() + Chunks.size(), Symbols);
+}
+
+// getter for the size of the source
+size_t IncrementalStream::GetSize() const {
+    return Size;
+}
+
+size_t IncrementalStream::GetTokenCount() const {
+    return TokensBefore(Chunks.size());
+}
+
+// getter for the number of chunks
+size_t IncrementalStream::GetChunkCount() const {
+    return Chunks.size();
+}
+
+// fills both trees from the chunks, in O(chunks)
+void IncrementalStream::Rebuild() {
+    size_t count = Chunks.size();
+    SizeTree.assign(count + 1, 0);
+    TokenTree.assign(count + 1, 0);
+    Size = 0;
+    for (size_t i = 1; i <= count; i++) {
+        SizeTree[i] += Chunks[i - 1].GetSource().size();
+        TokenTree[i] += Chunks[i - 1].Tokens.size() - 1;
+        Size += Chunks[i - 1].GetSource().size();
+        size_t parent = i + (i & -i);
+        if (parent <= count) {
+            SizeTree[parent] += SizeTree[i];
+            TokenTree[parent] += TokenTree[i];
+        }
+    }
+}
+
+// adds to the counts of one chunk (a decrease wraps around, which the sums undo)
+void IncrementalStream::Add(size_t chunk, size_t bytes, size_t tokens) {
+    Size += bytes;
+    for (size_t i = chunk + 1; i < SizeTree.size(); i += i & -i) {
+        SizeTree[i] += bytes;
+        TokenTree[i] += tokens;
+    }
+}
+
+// the chunk holding the byte at offset (the last one for the end of the source) and where it starts
+size_t IncrementalStream::Locate(size_t offset, size_t* start) const {
+    size_t count = Chunks.size();
+    size_t chunk = 0;
+    size_t remaining = offset;
+    size_t step = 1;
+    while (step * 2 <= count) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (chunk + step <= count && SizeTree[chunk + step] <= remaining) {
+            chunk += step;
+            remaining -= SizeTree[chunk];
+        }
+    }
+    if (chunk == count) {
+        chunk = count - 1;
+        remaining = Chunks[chunk].GetSource().size();
+    }
+    if (start != nullptr) {
+        *start = offset - remaining;
+    }
+    return chunk;
+}
+
+// number of tokens in the chunks before chunk
+size_t IncrementalStream::TokensBefore(size_t chunk) const {
+    size_t tokens = 0;
+    for (size_t i = chunk; i > 0; i -= i & -i) {
+        tokens += TokenTree[i];
+    }
+    return tokens;
+}
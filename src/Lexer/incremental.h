@@ -0,0 +1,69 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "lexer.h"
+
+// one change to a buffer: removedLength bytes at offset are replaced by insertedText
+struct TextEdit {
+    uint32_t Offset;
+    uint32_t RemovedLength;
+    std::string InsertedText;
+};
+
+// how much work the last Relex did, handy to check that an edit stayed local
+struct RelexStats {
+    size_t RestartToken;   // index of the first token that was lexed again
+    size_t RelexedTokens;  // how many tokens were produced before the stream lined up with the old one
+    bool Converged;        // false if the edit changed everything up to the end of the file
+};
+
+// applies the edit to stream in place: lexing restarts at the end of the last token the edit can't have
+// influenced (the DFA's lookahead is checked, not guessed) and stops as soon as a new token ends where an old
+// token ended past the edit, the new tokens are spliced in and the offsets after them shifted
+// (the lexer is reused, its source and position are replaced). the buffer is copied and every later offset
+// moved, so an edit costs in proportion to the stream, an editor keeps an IncrementalStream instead
+void Relex(Lexer* lexer, TokenStream& stream, const TextEdit& edit, RelexStats* stats = nullptr);
+
+// a source being edited, kept in chunks so an edit costs about the same in a 16 MB file as in a 16 KB one. every
+// chunk is a TokenStream of its own (its text, tokens, unmatched bytes and numbers, offsets from the chunk's
+// start), an edit copies and re-lexes the chunk it falls in and the chunks after it don't move: where a chunk
+// starts comes from a Fenwick tree of the chunk sizes. a chunk ends right after a newline that no string literal
+// and no scan of a quote the lexer skipped reaches past (those are the only matches that read across a line, see
+// FindSplitPoints), so lexing it on its own gives the tokens the whole file gives and an edit in it can't change
+// the tokens of another chunk. the cuts are made for the default rules, like TokenizeParallel's
+class IncrementalStream {
+    public:
+        // a chunk is cut at the first place it can be past this many bytes, and cut again once edits leave it
+        // more than twice as large
+        static constexpr size_t DefaultChunkSize = 8 << 10;
+
+        explicit IncrementalStream(const TokenStream& stream, size_t chunkSize = DefaultChunkSize);
+
+        // applies the edit like Relex does on a TokenStream (stats count tokens of the whole stream). only an edit
+        // whose effect really runs on (ex: an opening quote) takes the chunks after it along
+        void Relex(Lexer* lexer, const TextEdit& edit, RelexStats* stats = nullptr);
+
+        // the whole stream as one TokenStream (copies every chunk, for the stages that want the whole file)
+        TokenStream ToStream() const;
+
+        size_t GetSize() const;
+        // the tokens of every chunk, without the EOF token
+        size_t GetTokenCount() const;
+        size_t GetChunkCount() const;
+
+    private:
+        std::vector<TokenStream> Chunks;
+        std::shared_ptr<SymbolTable> Symbols;
+        size_t ChunkSize;
+        size_t Size;
+        // Fenwick trees over the bytes and the tokens of the chunks (index 1 is the first chunk)
+        std::vector<size_t> SizeTree;
+        std::vector<size_t> TokenTree;
+
+        void Rebuild();
+        void Add(size_t chunk, size_t bytes, size_t tokens);
+        size_t Locate(size_t offset, size_t* start) const;
+        size_t TokensBefore(size_t chunk) const;
+};
+
+#endif
\ No newline at end of file
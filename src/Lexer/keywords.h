@@ -0,0 +1,100 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include "tokens.h"
+
+#include <array>
+
+// every reserved word of the language and the token it becomes (generated from token_spec.h)
+struct Keyword {
+    std::string_view Text;
+    TokenType Type;
+};
+
+constexpr Keyword Keywords[] = {
+#define ILYS_KEYWORD_ENTRY(type, name, text) {text, TokenType::type},
+    ILYS_TOKEN_SPEC(ILYS_TOKEN_IGNORE, ILYS_TOKEN_IGNORE, ILYS_KEYWORD_ENTRY)
+#undef ILYS_KEYWORD_ENTRY
+};
+
+constexpr size_t KeywordCount = sizeof(Keywords) / sizeof(Keywords[0]);
+
+// the table has 2^KeywordTableBits slots, comfortably more than the number of keywords
+constexpr int KeywordTableBits = 6;
+constexpr size_t KeywordTableSize = size_t(1) << KeywordTableBits;
+
+// hashes only the first byte, the last byte and the length (all keywords differ in at least one of them),
+// the multiply by seed spreads those bits and the top bits pick the slot
+constexpr uint32_t KeywordHash(std::string_view text, uint32_t seed) {
+    uint32_t key = static_cast<uint8_t>(text[0]) | (static_cast<uint32_t>(static_cast<uint8_t>(text[text.size() - 1])) << 8) | (static_cast<uint32_t>(text.size()) << 16);
+    return (key * seed) >> (32 - KeywordTableBits);
+}
+
+// tries seeds until every keyword lands in its own slot, runs entirely at compile time
+constexpr uint32_t FindKeywordSeed() {
+    for (uint32_t seed = 0x9E3779B1u; ; seed += 2) {
+        bool used[KeywordTableSize] = {};
+        bool collision = false;
+        for (const Keyword& keyword : Keywords) {
+            uint32_t slot = KeywordHash(keyword.Text, seed);
+            if (used[slot]) {
+                collision = true;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (!collision) {
+            return seed;
+        }
+    }
+}
+
+constexpr uint32_t KeywordSeed = FindKeywordSeed();
+
+// slot -> index in Keywords (or -1 for an empty slot)
+constexpr std::array<int8_t, KeywordTableSize> BuildKeywordTable() {
+    std::array<int8_t, KeywordTableSize> table = {};
+    for (size_t slot = 0; slot < KeywordTableSize; slot++) {
+        table[slot] = -1;
+    }
+    for (size_t i = 0; i < KeywordCount; i++) {
+        table[KeywordHash(Keywords[i].Text, KeywordSeed)] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, KeywordTableSize> KeywordTable = BuildKeywordTable();
+
+constexpr size_t ShortestKeyword() {
+    size_t shortest = Keywords[0].Text.size();
+    for (const Keyword& keyword : Keywords) {
+        shortest = keyword.Text.size() < shortest ? keyword.Text.size() : shortest;
+    }
+    return shortest;
+}
+
+constexpr size_t LongestKeyword() {
+    size_t longest = 0;
+    for (const Keyword& keyword : Keywords) {
+        longest = keyword.Text.size() > longest ? keyword.Text.size() : longest;
+    }
+    return longest;
+}
+
+// returns the keyword type for text, or IDENTIFIER if it isn't one (one hash and one compare)
+constexpr TokenType ClassifyIdentifier(std::string_view text) {
+    if (text.size() < ShortestKeyword() || text.size() > LongestKeyword()) {
+        return TokenType::IDENTIFIER;
+    }
+    int index = KeywordTable[KeywordHash(text, KeywordSeed)];
+    if (index >= 0 && Keywords[index].Text == text) {
+        return Keywords[index].Type;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+static_assert(ClassifyIdentifier("forevery") == TokenType::FOREVERY, "keyword table is broken");
+static_assert(ClassifyIdentifier("for") == TokenType::FOR, "keyword table is broken");
+static_assert(ClassifyIdentifier("fore") == TokenType::IDENTIFIER, "keyword table is broken");
+
+#endif
\ No newline at end of file
@@ -1,127 +1,331 @@
-#include "tokens.h"
+#include "lexer.h"
+#include "keywords.h"
+#include "operators.h"
+#include "utf8.h"
+
+// creating a default constructor to set all fields to default values
+RegexPattern::RegexPattern() {
+    regex = nullptr;
+    handler = nullptr;
+}
 
-class Lexer;
+// creating a constructor with parameters
+RegexPattern::RegexPattern(std::unique_ptr<std::regex> regex, RegexHandler handler) {
+    this->regex = std::move(regex);
+    this->handler = handler;
+}
 
-using RegexHandler = std::function<void(Lexer* lexer, std::regex* regex)>;
+// creating a constructor from the pattern text, the text is kept so the pattern can also be compiled into the DFA
+RegexPattern::RegexPattern(const std::string& source, RegexHandler handler) {
+    this->regex = std::make_unique<std::regex>(source);
+    this->source = source;
+    this->handler = handler;
+}
 
-class RegexPattern {
-    private:
-        std::unique_ptr<std::regex> regex;
-        RegexHandler handler;
+// Custom copy constructor (deep copy --> cannot copy unique pointers)
+RegexPattern::RegexPattern(const RegexPattern& other) {
+    if (other.regex) {
+        regex = std::make_unique<std::regex>(*other.regex);
+    }
+    else {
+        regex = nullptr;
+    }
+    source = other.source;
+    handler = other.handler;
+}
 
-    public:
-        // creating a default constructor to set all fields to default values
-        RegexPattern() {
+// Custom copy assignment operator (deep copy --> cannot copy unique pointers)
+RegexPattern& RegexPattern::operator=(const RegexPattern& other) {
+    if (this != &other) {
+        if (other.regex) {
+            regex = std::make_unique<std::regex>(*other.regex);
+        }
+        else {
             regex = nullptr;
-            handler = nullptr;
-        };
-
-        // creating a constructor with parameters
-        RegexPattern(std::unique_ptr<std::regex> regex, RegexHandler handler) {
-            this->regex = std::move(regex);
-            this->handler = handler;
         }
+        source = other.source;
+        handler = other.handler;
+    }
+    return *this;
+}
 
-        // Custom copy constructor (deep copy --> cannot copy unique pointers)
-        RegexPattern(const RegexPattern& other) {
-            if (other.regex) {
-                regex = std::make_unique<std::regex>(*other.regex);
-            }
-            else {
-                regex = nullptr;
-            }
-            handler = other.handler;
-        }
+// getter for the regex field
+const std::unique_ptr<std::regex>& RegexPattern::GetRegex() const {
+    return regex;
+}
 
-        // Custom copy assignment operator (deep copy --> cannot copy unique pointers)
-        RegexPattern& operator=(const RegexPattern& other) {
-            if (this != &other) {
-                if (other.regex) {
-                    regex = std::make_unique<std::regex>(*other.regex);
-                }
-                else {
-                    regex = nullptr;
-                }
-                handler = other.handler;
-            }
-            return *this;
-        }
+// getter for the source field (empty if the pattern was built from a std::regex directly)
+const std::string& RegexPattern::GetSource() const {
+    return source;
+}
+
+// getter for the handler field
+const RegexHandler& RegexPattern::GetHandler() const {
+    return handler;
+}
+
+// creating default constructor to set all fields to default values
+Lexer::Lexer() {
+    Source = SourceBuffer::FromString("");
+    End = std::string_view::npos;
+    Position = 0;
+    MatchLength = 0;
+    UseRegex = false;
+    Lookahead = std::vector<Token>(16);
+    LookaheadHead = 0;
+    LookaheadCount = 0;
+    EofQueued = false;
+    MayHaveErrors = false;
+    Tokens = std::vector<Token>();
+    // no rules until SetPatterns or SetRules (one empty set shared by every such lexer)
+    static const std::shared_ptr<const RuleSet> noRules = std::make_shared<const RuleSet>(std::vector<RegexPattern>());
+    Rules = noRules;
+}
+
+// getter for the position field
+int Lexer::GetPosition() const {
+    return Position;
+}
+
+// getter for a view over the source buffer (cut at the end field, so the lexer can work on one region of a file)
+std::string_view Lexer::GetSource() const {
+    std::string_view view = Source->View();
+    return End < view.size() ? view.substr(0, End) : view;
+}
+
+// getter for the source field (the buffer the token offsets point into)
+const std::shared_ptr<const SourceBuffer>& Lexer::GetSourceBuffer() const {
+    return Source;
+}
+
+// setter for the position field
+void Lexer::SetPosition(int position) {
+    Position = position;
+}
+
+// setter for the source field
+void Lexer::SetSource(std::shared_ptr<const SourceBuffer> source) {
+    Source = std::move(source);
+}
+
+// getter for the end field (npos when the lexer runs to the end of the buffer)
+size_t Lexer::GetEnd() const {
+    return End;
+}
+
+// setter for the end field, token offsets stay relative to the start of the whole buffer
+void Lexer::SetEnd(size_t end) {
+    End = end;
+}
+
+// getter for the match length field (length of the match the current handler was called for)
+int Lexer::GetMatchLength() const {
+    return MatchLength;
+}
+
+// setter for the match length field
+void Lexer::SetMatchLength(int length) {
+    MatchLength = length;
+}
+
+// getter for the use regex field
+bool Lexer::GetUseRegex() const {
+    return UseRegex;
+}
 
-        // Move constructor and move assignment operator (default implementation)
-        RegexPattern(RegexPattern&&) = default;
-        RegexPattern& operator=(RegexPattern&&) = default;
+// setter for the use regex field (true forces the regex loop even when the DFA compiled)
+void Lexer::SetUseRegex(bool useRegex) {
+    UseRegex = useRegex;
+}
+
+// returns the next token and moves past it, keeps returning the EOF token once the source is done
+Token Lexer::NextToken() {
+    if (!FillLookahead(1)) {
+        return Token::ConstructToken(TokenType::E0F_TOKEN, GetSource().size(), 0);
+    }
+    Token token = Lookahead[LookaheadHead];
+    LookaheadHead = (LookaheadHead + 1) & (Lookahead.size() - 1);
+    LookaheadCount--;
+    return token;
+}
 
-        // getter for the regex field
-        const std::unique_ptr<std::regex>& GetRegex() const {
-            return regex;
+// returns the token k positions ahead without consuming anything (Peek(0) is what NextToken would return)
+Token Lexer::Peek(size_t k) {
+    if (!FillLookahead(k + 1)) {
+        return Token::ConstructToken(TokenType::E0F_TOKEN, GetSource().size(), 0);
+    }
+    return Lookahead[(LookaheadHead + k) & (Lookahead.size() - 1)];
+}
+
+// appends a token to the lookahead ring, only grows it if a handler pushes more tokens than it can hold
+void Lexer::Emit(const Token& token) {
+    if (LookaheadCount == Lookahead.size()) {
+        std::vector<Token> grown(Lookahead.size() * 2);
+        for (size_t i = 0; i < LookaheadCount; i++) {
+            grown[i] = Lookahead[(LookaheadHead + i) & (Lookahead.size() - 1)];
         }
+        Lookahead = std::move(grown);
+        LookaheadHead = 0;
+    }
+    Lookahead[(LookaheadHead + LookaheadCount) & (Lookahead.size() - 1)] = token;
+    LookaheadCount++;
+}
+
+// drops the tokens still waiting in the lookahead and continues lexing from position
+void Lexer::Restart(int position) {
+    Position = position;
+    LookaheadHead = 0;
+    LookaheadCount = 0;
+    EofQueued = false;
+    Unmatched.clear();
+    Numbers.clear();
+    MayHaveErrors = false;
+}
+
+// points the lexer at another source and starts over from its beginning, the rules, the symbol table and the
+// capacity of the buffers are kept (much cheaper than constructing a lexer per file)
+void Lexer::Reset(std::shared_ptr<const SourceBuffer> source) {
+    Source = std::move(source);
+    End = std::string_view::npos;
+    MatchLength = 0;
+    Tokens.clear();
+    Restart(0);
+}
+
+// getter for the unmatched field
+const std::vector<uint32_t>& Lexer::GetUnmatched() const {
+    return Unmatched;
+}
+
+// records a byte no rule matched
+void Lexer::AddUnmatched(uint32_t offset) {
+    Unmatched.push_back(offset);
+}
+
+// getter for the numbers field
+const std::vector<NumberValue>& Lexer::GetNumbers() const {
+    return Numbers;
+}
+
+// keeps the value of a number token, returns the symbol the token refers to it with
+uint32_t Lexer::AddNumber(NumberValue value) {
+    Numbers.push_back(value);
+    return static_cast<uint32_t>(Numbers.size());
+}
 
-        // getter for the handler field
-        const RegexHandler& GetHandler() const {
-            return handler;
+// getter for the may have errors field (false means CollectDiagnostics has nothing to find but the unmatched bytes)
+bool Lexer::GetMayHaveErrors() const {
+    return MayHaveErrors;
+}
+
+// setter for the may have errors field, it only goes back to false on Restart
+void Lexer::SetMayHaveErrors() {
+    MayHaveErrors = true;
+}
+
+void Lexer::EnableStats() {
+    std::vector<std::string> labels;
+    for (const RegexPattern& pattern : GetPatterns()) {
+        labels.push_back(pattern.GetSource());
+    }
+    Stats = std::make_unique<LexerStats>(std::move(labels));
+}
+
+// getter for the stats field
+LexerStats* Lexer::GetStats() const {
+    return Stats.get();
+}
+
+// moves the values into numbers without copying them (the lexer keeps the buffer numbers had, emptied)
+void Lexer::TakeNumbers(std::vector<NumberValue>& numbers) {
+    numbers.swap(Numbers);
+    Numbers.clear();
+}
+
+// lexes until the ring holds count tokens, returns false if the source ran out first (EOF included)
+bool Lexer::FillLookahead(size_t count) {
+    while (LookaheadCount < count) {
+        if (!IsEOF(this)) {
+            LexStep(this);
         }
-};
-
-class Lexer {
-    public:
-        std::vector<Token> Tokens;
-
-        // creating default constructor to set all fields to default values
-        Lexer() {
-            Source = "";
-            Position = 0;
-            Tokens = std::vector<Token>();
-            Patterns = std::vector<RegexPattern>();
+        else if (!EofQueued) {
+            EofQueued = true;
+            Emit(Token::ConstructToken(TokenType::E0F_TOKEN, GetSource().size(), 0));
         }
-
-        // getter for the position field
-        int GetPosition() const {
-            return Position;
+        else {
+            return false;
         }
+    }
+    return true;
+}
 
-        // getter for the source field
-        const std::string& GetSource() const {
-            return Source;
-        }
+// getter for the patterns field
+const std::vector<RegexPattern>& Lexer::GetPatterns() const {
+    return Rules->GetPatterns();
+}
 
-        // setter for the position field
-        void SetPosition(int position) {
-            Position = position;
-        }
+// setter for the patterns field, compiles a rule set of its own for this lexer (the operator dispatch is off,
+// it only knows the rules of the language)
+void Lexer::SetPatterns(const std::vector<RegexPattern>& patterns) {
+    Rules = std::make_shared<const RuleSet>(patterns);
+    if (Stats) {
+        EnableStats();
+    }
+}
 
-        // setter for the source field
-        void SetSource(const std::string& source) {
-            Source = source;
-        }
+// getter for the rules field
+const std::shared_ptr<const RuleSet>& Lexer::GetRules() const {
+    return Rules;
+}
 
-        // getter for the patterns field
-        const std::vector<RegexPattern>& GetPatterns() const {
-            return Patterns;
-        }
+// setter for the rules field (shared, nothing is copied or compiled)
+void Lexer::SetRules(std::shared_ptr<const RuleSet> rules) {
+    Rules = std::move(rules);
+    if (Stats) {
+        EnableStats();
+    }
+}
 
-        // setter for the patterns field
-        void SetPatterns(const std::vector<RegexPattern>& patterns) {
-            Patterns = patterns;
-        }
+// getter for the symbols field
+const std::shared_ptr<SymbolTable>& Lexer::GetSymbols() const {
+    return Symbols;
+}
 
-    private:
-        std::string Source;
-        int Position;
-        std::vector<RegexPattern> Patterns;
-};
-
-// returns the byte at the current position of the lexer's source string
-std::byte SourceAt(Lexer* lexer) {
-    // error checking (returning null byte if the position is out of index bounds)
-    if (lexer->GetPosition() < 0 || lexer->GetPosition() >= lexer->GetSource().length()) {
-        return static_cast<std::byte>(0);
+// setter for the symbols field (the cache in front of the old table is dropped)
+void Lexer::SetSymbols(std::shared_ptr<SymbolTable> symbols) {
+    Symbols = std::move(symbols);
+    Cache.Clear();
+}
+
+// returns the symbol of an identifier or string, NoSymbol if the lexer has no table
+uint32_t Lexer::Intern(std::string_view text) {
+    return Symbols ? Cache.Intern(*Symbols, text) : SymbolTable::NoSymbol;
+}
+
+// getter for the useDispatch field of the rules
+bool Lexer::GetUseDispatch() const {
+    return Rules->GetUseDispatch();
+}
+
+// getter for the automaton field
+const Dfa& Lexer::GetDfa() const {
+    return Rules->GetDfa();
+}
+
+// returns the code point at the current position of the lexer's source string and sets length to its bytes
+// (InvalidCodePoint for an ill-formed sequence, see DecodeUtf8)
+char32_t SourceAt(Lexer* lexer, size_t* length) {
+    // error checking (returning a null code point if the position is out of index bounds)
+    if (lexer->GetPosition() < 0 || static_cast<size_t>(lexer->GetPosition()) >= lexer->GetSource().length()) {
+        *length = 0;
+        return 0;
     }
-    return static_cast<std::byte>(lexer->GetSource()[lexer->GetPosition()]);
+    return DecodeUtf8(lexer->GetSource(), lexer->GetPosition(), length);
 }
 
-// returns the string from the source at position index to the end of the source string
-std::string WhatRemains(Lexer* lexer) {
-    if (lexer->GetPosition() < 0 || lexer->GetPosition() >= lexer->GetSource().length()) {
+// returns a view of the source from position index to the end of the source (no copy)
+std::string_view WhatRemains(Lexer* lexer) {
+    if (lexer->GetPosition() < 0 || static_cast<size_t>(lexer->GetPosition()) >= lexer->GetSource().length()) {
         return "";
     }
     return lexer->GetSource().substr(lexer->GetPosition());
@@ -129,7 +333,7 @@ std::string WhatRemains(Lexer* lexer) {
 
 // boolean to check if the lexer's position is at an EOF token (greater than or equal to the length of the source string)
 bool IsEOF(Lexer* lexer) {
-    return lexer->GetPosition() >= lexer->GetSource().length();
+    return static_cast<size_t>(lexer->GetPosition()) >= lexer->GetSource().length();
 }
 
 // defining a function called "LexAdvance" to advance the lexer's position by a given amount (int)
@@ -137,172 +341,312 @@ void LexAdvance(Lexer* lexer, int amount) {
     lexer->SetPosition(lexer->GetPosition() + amount);
 }
 
-// defining a function called "TokenPush" to append a token to the lexer's tokens vector
+// defining a function called "TokenPush" to append a token to the lexer's lookahead (NextToken hands it out from there)
 void TokenPush(Lexer* lexer, Token token) {
-    lexer->Tokens.push_back(token);
+    lexer->Emit(token);
 }
 
-// defining a function called "defaultHandler" which takes a type TokenType and a string value and returns a RegexHandler
-RegexHandler defaultHandler(TokenType type, std::string value) {
-    return [type, value](Lexer* lexer, std::regex* regex) {
-        std::smatch match;
-        std::string remains = WhatRemains(lexer);
+// returns the text of the match the current handler was called for
+std::string_view CurrentMatch(Lexer* lexer) {
+    return lexer->GetSource().substr(lexer->GetPosition(), lexer->GetMatchLength());
+}
 
-        if (std::regex_search(remains, match, *regex, std::regex_constants::match_continuous)) {
-            TokenPush(lexer, Token::ConstructToken(type, value));
-        }
+// defining a function called "defaultHandler" which takes a type TokenType and returns a RegexHandler
+RegexHandler defaultHandler(TokenType type) {
+    return [type](Lexer* lexer, const std::regex*) {
+        // the match was already found by Tokenize, no need to run the regex a second time
+        TokenPush(lexer, Token::ConstructToken(type, lexer->GetPosition(), lexer->GetMatchLength()));
     };
 }
 
 // defining a function called "skipHandler" which takes a mutable instance of a lexer and a regex pointer and returns nothing
-void skipHandler(Lexer* lexer, std::regex* regex) {
-    // getting the matched string from the regex
-    std::smatch match;
-    std::string remains = WhatRemains(lexer);
-
-    // checking if the regex matches the source string at the current position
-    if (std::regex_search(remains, match, *regex)) {
-        // not advancing since it is handled in Tokenize
-        
-    }
+void skipHandler(Lexer*, const std::regex*) {
+    // not advancing since it is handled in Tokenize
 
     // NOTE: we are not pushing a token here because we are skipping the whitespace
 }
 
 // defining a function called "numberHandler" which takes a mutable instance of a lexer and a regex pointer and returns nothing
-void numberHandler(Lexer* lexer, std::regex* regex) {
-    std::smatch match;
-    std::string remains = WhatRemains(lexer);
-
-    if (std::regex_search(remains, match, *regex, std::regex_constants::match_continuous)) {
-        std::string matchedStr = match.str();
-
-        // Trim leading and trailing whitespaces
-        matchedStr.erase(matchedStr.begin(), std::find_if(matchedStr.begin(), matchedStr.end(), [](unsigned char ch) {
-            return !std::isspace(ch);
-        }));
-        matchedStr.erase(std::find_if(matchedStr.rbegin(), matchedStr.rend(), [](unsigned char ch) {
-            return !std::isspace(ch);
-        }).base(), matchedStr.end());
-
-        TokenPush(lexer, Token::ConstructToken(TokenType::NUMBER, matchedStr));
+// (the literal is decoded here, once, so no later stage parses its text again)
+void numberHandler(Lexer* lexer, const std::regex*) {
+    std::string_view text = CurrentMatch(lexer);
+
+    // a literal too large for its type gets symbol 0, CollectDiagnostics reports it
+    NumberValue value;
+    uint32_t symbol = 0;
+    if (DecodeNumber(text, &value)) {
+        symbol = lexer->AddNumber(value);
+    }
+    else {
+        lexer->SetMayHaveErrors();
     }
+    TokenPush(lexer, Token::ConstructToken(TokenType::NUMBER, lexer->GetPosition(), lexer->GetMatchLength(), symbol));
 }
 
-// defining a function called "dotHandler"
-void dotHandler(Lexer* lexer, std::regex* regex) {
-    std::smatch match;
-    std::string remains = WhatRemains(lexer);
+// defining a function called "identifierHandler" which pushes either a keyword or an IDENTIFIER
+void identifierHandler(Lexer* lexer, const std::regex*) {
+    std::string_view text = CurrentMatch(lexer);
+    // every byte that isn't ASCII lands in a name or a string, so these two handlers are the only ones that
+    // have to look for the ill-formed UTF-8 CollectDiagnostics would report
+    if (!IsAscii(text)) {
+        lexer->SetMayHaveErrors();
+    }
+    TokenType type = ClassifyIdentifier(text);
+    uint32_t symbol = type == TokenType::IDENTIFIER ? lexer->Intern(text) : SymbolTable::NoSymbol;
+    TokenPush(lexer, Token::ConstructToken(type, lexer->GetPosition(), lexer->GetMatchLength(), symbol));
+}
 
-    // Check for DOTDOT first
-    std::regex dotdotRegex("\\.\\.");
-    if (std::regex_search(remains, match, dotdotRegex, std::regex_constants::match_continuous)) {
-        TokenPush(lexer, Token::ConstructToken(TokenType::DOTDOT, ".."));
-        // no need to advance since it is handled in Tokenize
-        return;
+// defining a function called "stringHandler" which pushes a STRING interned with its quotes (escapes are left as
+// they are, so two literals only share a symbol if they are spelled the same)
+void stringHandler(Lexer* lexer, const std::regex*) {
+    std::string_view text = CurrentMatch(lexer);
+    if (!IsAscii(text)) {
+        lexer->SetMayHaveErrors();
     }
+    uint32_t symbol = lexer->Intern(text);
+    TokenPush(lexer, Token::ConstructToken(TokenType::STRING, lexer->GetPosition(), lexer->GetMatchLength(), symbol));
+}
 
-    // Check for DOT second
-    std::regex dotRegex("\\.");
-    if (std::regex_search(remains, match, dotRegex, std::regex_constants::match_continuous)) {
-        TokenPush(lexer, Token::ConstructToken(TokenType::DOT, "."));
+// returns a regex matching exactly text (every regex metacharacter escaped)
+static std::string escapeLiteral(std::string_view text) {
+    std::string escaped;
+    for (char c : text) {
+        if (std::string_view("\\^$.|?*+()[]{}").find(c) != std::string_view::npos) {
+            escaped += '\\';
+        }
+        escaped += c;
     }
+    return escaped;
 }
 
-// defining a function that creates a lexer by taking a source string and returning a lexer pointer
-Lexer* ConstructLexer(std::string source) {
-    Lexer* lexer = new Lexer();
-    lexer->SetSource(source);
-    lexer->SetPosition(0);
-    lexer->Tokens = std::vector<Token>();
-    lexer->SetPatterns({
-        // OPENPARENTHESIS AND CLOSEPARENTHESIS
-        RegexPattern{std::make_unique<std::regex>("\\("), defaultHandler(TokenType::OPENPARENTHESIS, "(")},
-        RegexPattern{std::make_unique<std::regex>("\\)"), defaultHandler(TokenType::CLOSEPARENTHESIS, ")")},
-        // NUMBER (special handler)
-        RegexPattern{std::make_unique<std::regex>("-?\\s*[0-9]+(\\.[0-9]+)?"), numberHandler},
+// defining a function that builds the rules of the language (runs once, see RuleSet::GetDefault)
+static std::shared_ptr<const RuleSet> buildDefaultRules() {
+    std::vector<RegexPattern> patterns = {
+        // NUMBER (special handler --> decoded by DecodeNumber), hexadecimal, binary or decimal with '_' between
+        // digits, a minus sign is always its own token
+        RegexPattern{"0[xX][0-9A-Fa-f]([0-9A-Fa-f_]*[0-9A-Fa-f])?|0[bB][01]([01_]*[01])?|[0-9]([0-9_]*[0-9])?(\\.[0-9]([0-9_]*[0-9])?)?", numberHandler},
         // Handling whitespaces (special handler --> skipHandler)
-        RegexPattern{std::make_unique<std::regex>("[ \t\n\r]+"), skipHandler},
-        // OPENBRACKET and CLOSEBRACKET
-        RegexPattern{std::make_unique<std::regex>("\\["), defaultHandler(TokenType::OPENBRACKET, "[")},
-        RegexPattern{std::make_unique<std::regex>("\\]"), defaultHandler(TokenType::CLOSEBRACKET, "]")},
-        // OPENCURLYBRACKET and CLOSECURLYBRACKET
-        RegexPattern{std::make_unique<std::regex>("\\{"), defaultHandler(TokenType::OPENCURLYBRACKET, "{")},
-        RegexPattern{std::make_unique<std::regex>("\\}"), defaultHandler(TokenType::CLOSECURLYBRACKET, "}")},
-        // EQUALS AND NOTEQUALS
-        RegexPattern{std::make_unique<std::regex>("=="), defaultHandler(TokenType::EQUALS, "==")},
-        RegexPattern{std::make_unique<std::regex>("!="), defaultHandler(TokenType::NOTEQUALS, "!=")},
-        // ASSIGNMENT AND NOT
-        RegexPattern{std::make_unique<std::regex>("="), defaultHandler(TokenType::ASSIGNMENT, "=")},
-        RegexPattern{std::make_unique<std::regex>("!"), defaultHandler(TokenType::NOT, "!")},
-        // LESSTHAN AND LESSTHANEQUALS
-        RegexPattern{std::make_unique<std::regex>("<="), defaultHandler(TokenType::LESSTHANEQUALS, "<=")},
-        RegexPattern{std::make_unique<std::regex>("<"), defaultHandler(TokenType::LESSTHAN, "<")},
-        // GREATERTHAN AND GREATERTHANEQUALS
-        RegexPattern{std::make_unique<std::regex>(">="), defaultHandler(TokenType::GREATERTHANEQUALS, ">=")},
-        RegexPattern{std::make_unique<std::regex>(">"), defaultHandler(TokenType::GREATERTHAN, ">")},
-        // AND AND OR
-        RegexPattern{std::make_unique<std::regex>("&&"), defaultHandler(TokenType::AND, "&&")},
-        RegexPattern{std::make_unique<std::regex>("\\|\\|"), defaultHandler(TokenType::OR, "||")},
-        // DOT AND DOTDOT (special handler)
-        RegexPattern{std::make_unique<std::regex>("\\."), dotHandler},
-        RegexPattern{std::make_unique<std::regex>("\\.\\."), dotHandler},
-        // COLON AND SEMICOLON
-        RegexPattern{std::make_unique<std::regex>(":"), defaultHandler(TokenType::COLON, ":")},
-        RegexPattern{std::make_unique<std::regex>(";"), defaultHandler(TokenType::SEMICOLON, ";")},
-        // QUESTIONMARK AND COMMA
-        RegexPattern{std::make_unique<std::regex>("\\?"), defaultHandler(TokenType::QUESTIONMARK, "?")},
-        RegexPattern{std::make_unique<std::regex>(","), defaultHandler(TokenType::COMMA, ",")},
-        // PLUSPLUS AND MINUSMINUS (CREATING FIRST TO AVOID CONFLICT WITH PLUS AND MINUS DEFINED FIRST)
-        RegexPattern{std::make_unique<std::regex>("\\+\\+"), defaultHandler(TokenType::PLUSPLUS, "++")},
-        RegexPattern{std::make_unique<std::regex>("--"), defaultHandler(TokenType::MINUSMINUS, "--")},
-        // PLUSEQUALS AND MINUSEQUALS
-        RegexPattern{std::make_unique<std::regex>("\\+="), defaultHandler(TokenType::PLUSEQUALS, "+=")},
-        RegexPattern{std::make_unique<std::regex>("-="), defaultHandler(TokenType::MINUSEQUALS, "-=")},
-        // PLUS AND MINUS
-        RegexPattern{std::make_unique<std::regex>("\\+"), defaultHandler(TokenType::PLUS, "+")},
-        RegexPattern{std::make_unique<std::regex>("-"), defaultHandler(TokenType::MINUS, "-")},
-        // DIVIDE AND MULTIPLY
-        RegexPattern{std::make_unique<std::regex>("/"), defaultHandler(TokenType::DIVIDE, "/")},
-        RegexPattern{std::make_unique<std::regex>("\\*"), defaultHandler(TokenType::MULTIPLY, "*")},
-        // MODULO
-        RegexPattern{std::make_unique<std::regex>("%"), defaultHandler(TokenType::MODULO, "%")},
+        RegexPattern{"[ \t\n\r]+", skipHandler},
+        // IDENTIFIER and every keyword (special handler --> the keyword is found by a perfect hash, see keywords.h),
+        // every byte of a multibyte UTF-8 sequence is a letter so names can be in any script (ill-formed sequences
+        // are reported by CollectDiagnostics, not here)
+        RegexPattern{"[A-Za-z_\\x80-\\xff][A-Za-z0-9_\\x80-\\xff]*", identifierHandler},
+        // STRING (the token keeps its quotes, escapes are left as they are)
+        RegexPattern{"\"([^\"\\\\]|\\\\.)*\"", stringHandler},
+    };
+
+    // every operator and punctuation mark of token_spec.h, the longer ones first so the regex loop (where the
+    // first rule that matches wins) doesn't cut "==" into two "=" (the DFA takes the longest match anyway)
+    std::vector<Operator> operators(std::begin(Operators), std::end(Operators));
+    std::stable_sort(operators.begin(), operators.end(), [](const Operator& left, const Operator& right) {
+        return left.Text.size() > right.Text.size();
     });
+    for (const Operator& op : operators) {
+        patterns.push_back(RegexPattern{escapeLiteral(op.Text), defaultHandler(op.Type)});
+    }
+
+    return std::make_shared<const RuleSet>(std::move(patterns), true);
+}
+
+// creating the rule set, the DFA is compiled once here
+RuleSet::RuleSet(std::vector<RegexPattern> patterns, bool useDispatch) {
+    Patterns = std::move(patterns);
+    UseDispatch = useDispatch;
+
+    // the dispatch table and the handlers aren't text, the token names and HandlerVersion stand in for them
+    Version = HashBytes(&useDispatch, sizeof(useDispatch), HandlerVersion);
+    for (std::string_view name : TokenNames) {
+        Version = HashBytes(name, Version);
+    }
+    for (const RegexPattern& pattern : Patterns) {
+        Version = HashBytes(pattern.GetSource(), Version);
+    }
+
+    std::vector<std::string> sources;
+    for (const RegexPattern& pattern : Patterns) {
+        if (pattern.GetSource().empty()) {
+            return;
+        }
+        sources.push_back(pattern.GetSource());
+    }
+    if (!Automaton.Compile(sources)) {
+        Automaton = Dfa();
+    }
+}
+
+// getter for the patterns field
+const std::vector<RegexPattern>& RuleSet::GetPatterns() const {
+    return Patterns;
+}
+
+// getter for the automaton field
+const Dfa& RuleSet::GetDfa() const {
+    return Automaton;
+}
+
+// getter for the useDispatch field
+bool RuleSet::GetUseDispatch() const {
+    return UseDispatch;
+}
+
+// getter for the version field
+uint64_t RuleSet::GetVersion() const {
+    return Version;
+}
+
+const std::shared_ptr<const RuleSet>& RuleSet::GetDefault() {
+    // a function local static is built exactly once even if several threads get here first
+    static const std::shared_ptr<const RuleSet> rules = buildDefaultRules();
+    return rules;
+}
+
+// defining a function that creates a lexer by taking a source buffer and returning a lexer (owned by the caller)
+std::unique_ptr<Lexer> ConstructLexer(std::shared_ptr<const SourceBuffer> source) {
+    std::unique_ptr<Lexer> lexer = std::make_unique<Lexer>();
+    lexer->SetSource(std::move(source));
+    lexer->SetPosition(0);
+    lexer->SetSymbols(std::make_shared<SymbolTable>());
+    lexer->SetRules(RuleSet::GetDefault());
     return lexer;
 }
 
-// defining a function called Tokenize which takes a source string and returns an array of tokens
-std::vector<Token> Tokenize(std::string source) {
-    Lexer* lexer = ConstructLexer(source);
+// records a byte no pattern matched and skips over it (nothing is printed here, see CollectDiagnostics)
+static void skipUnexpected(Lexer* lexer) {
+    lexer->AddUnmatched(lexer->GetPosition());
+    lexer->SetPosition(lexer->GetPosition() + 1); // Skip the unexpected character
+}
 
-    while (!IsEOF(lexer)) {
-        bool matched = false;
+// the counters of the lexer, without a call at all when stats aren't compiled in
+static LexerStats* statsOf(Lexer* lexer) {
+    return LexerStats::Enabled ? lexer->GetStats() : nullptr;
+}
 
-        for (const RegexPattern& pattern : lexer->GetPatterns()) {
-            if (IsEOF(lexer)) {
-                break;
+// matches one rule by trying each regex in order and taking the first one that matches
+static void regexStep(Lexer* lexer) {
+    StatsProbe probe(statsOf(lexer));
+    const std::vector<RegexPattern>& patterns = lexer->GetPatterns();
+    for (size_t rule = 0; rule < patterns.size(); rule++) {
+        const RegexPattern& pattern = patterns[rule];
+        const std::regex* regex = pattern.GetRegex().get();
+        std::cmatch match;
+        std::string_view remains = WhatRemains(lexer);
+
+        if (std::regex_search(remains.data(), remains.data() + remains.size(), match, *regex, std::regex_constants::match_continuous)) {
+            if (match.position() == 0) {
+                lexer->SetMatchLength(match.length());
+                pattern.GetHandler()(lexer, regex);
+                LexAdvance(lexer, match.length());
+                probe.Matched(rule, match.length());
+                return;
             }
+        }
+        probe.Missed(rule);
+    }
 
-            std::regex* regex = pattern.GetRegex().get();
-            std::smatch match;
-            std::string remains = WhatRemains(lexer);
-
-            if (std::regex_search(remains, match, *regex, std::regex_constants::match_continuous)) {
-                if (match.position() == 0) {
-                    pattern.GetHandler()(lexer, regex);
-                    LexAdvance(lexer, match.length());
-                    matched = true;
-                    break;
-                }
-            }
+    // Handle the case where no pattern was matched
+    skipUnexpected(lexer);
+    probe.Skipped();
+}
+
+// matches one rule with the DFA, one pass over the bytes and the longest match wins
+static void dfaStep(Lexer* lexer) {
+    // operators and punctuation don't need the DFA, one lookup in the dispatch table of operators.h finds them
+    StatsProbe probe(statsOf(lexer));
+    std::string_view source = lexer->GetSource();
+    size_t position = lexer->GetPosition();
+    if (lexer->GetUseDispatch() && OperatorOnly[static_cast<uint8_t>(source[position])]) {
+        TokenType type = TokenType::E0F_TOKEN;
+        size_t operatorLength = MatchOperator(source, position, &type);
+        if (operatorLength > 0) {
+            TokenPush(lexer, Token::ConstructToken(type, position, operatorLength));
+            LexAdvance(lexer, operatorLength);
+            probe.Dispatched(operatorLength);
+            return;
         }
+    }
+
+    int length = 0;
+    int rule = lexer->GetDfa().Match(source, position, &length);
+
+    if (rule < 0 || length == 0) {
+        skipUnexpected(lexer);
+        probe.Skipped();
+        return;
+    }
 
-        if (!matched) {
-            // Handle the case where no pattern was matched
-            std::cerr << "Unexpected character at position " << lexer->GetPosition() << ": " << source[lexer->GetPosition()] << std::endl;
-            lexer->SetPosition(lexer->GetPosition() + 1); // Skip the unexpected character
+    const RegexPattern& pattern = lexer->GetPatterns()[rule];
+    lexer->SetMatchLength(length);
+    pattern.GetHandler()(lexer, pattern.GetRegex().get());
+    LexAdvance(lexer, length);
+    probe.Matched(rule, length);
+}
+
+// runs one step of the lexer: one rule is matched and its handler called (or one unexpected byte skipped)
+void LexStep(Lexer* lexer) {
+    if (lexer->GetDfa().IsCompiled() && !lexer->GetUseRegex()) {
+        dfaStep(lexer);
+    }
+    else {
+        regexStep(lexer);
+    }
+}
+
+// pulls every token out of the lexer into stream (whose vectors are refilled, not reallocated)
+static void drainStream(Lexer* lexer, TokenStream& stream) {
+    StatsProbe probe(statsOf(lexer));
+    stream.Tokens.clear();
+    while (true) {
+        Token token = lexer->NextToken();
+        stream.Tokens.push_back(token);
+        if (token.type == TokenType::E0F_TOKEN) {
+            break;
         }
     }
-    TokenPush(lexer, Token::ConstructToken(TokenType::E0F_TOKEN, "EOF"));
-    return lexer->Tokens;
-}
\ No newline at end of file
+
+    stream.Source = lexer->GetSourceBuffer();
+    stream.Unmatched.assign(lexer->GetUnmatched().begin(), lexer->GetUnmatched().end());
+    lexer->TakeNumbers(stream.Numbers);
+    stream.MayHaveErrors = lexer->GetMayHaveErrors();
+    stream.Symbols = lexer->GetSymbols();
+    probe.Ran(stream.GetSource().size(), stream.Tokens.size());
+}
+
+// defining a function called Tokenize which takes a source buffer and returns its tokens
+// (a thin wrapper over NextToken for callers that want the whole stream at once)
+TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source) {
+    std::unique_ptr<Lexer> lexer = ConstructLexer(std::move(source));
+    TokenStream stream;
+    drainStream(lexer.get(), stream);
+    return stream;
+}
+
+// same as above but taking ownership of a plain string
+TokenStream Tokenize(std::string source) {
+    return Tokenize(SourceBuffer::FromString(std::move(source)));
+}
+
+TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols) {
+    std::unique_ptr<Lexer> lexer = ConstructLexer(std::move(source));
+    lexer->SetSymbols(std::move(symbols));
+    TokenStream stream;
+    drainStream(lexer.get(), stream);
+    return stream;
+}
+
+void Tokenize(Lexer* lexer, std::shared_ptr<const SourceBuffer> source, TokenStream& stream) {
+    lexer->Reset(std::move(source));
+    drainStream(lexer, stream);
+}
+
+// defining a function called TokenizeRegex which always uses the regex loop (the reference for the DFA)
+TokenStream TokenizeRegex(std::shared_ptr<const SourceBuffer> source) {
+    std::unique_ptr<Lexer> lexer = ConstructLexer(std::move(source));
+    lexer->SetUseRegex(true);
+    TokenStream stream;
+    drainStream(lexer.get(), stream);
+    return stream;
+}
+
+TokenStream TokenizeRegex(std::string source) {
+    return TokenizeRegex(SourceBuffer::FromString(std::move(source)));
+}
@@ -2,44 +2,135 @@
 #define LEXER_H
 
 #include "tokens.h"
+#include "dfa.h"
+#include "lexer_stats.h"
 
 class Lexer;
 
-using RegexHandler = std::function<void(Lexer* lexer, std::regex* regex)>;
+using RegexHandler = std::function<void(Lexer* lexer, const std::regex* regex)>;
 
 class RegexPattern {
     private:
         std::unique_ptr<std::regex> regex;
+        std::string source;
         RegexHandler handler;
 
     public:
         RegexPattern();
         RegexPattern(std::unique_ptr<std::regex> regex, RegexHandler handler);
+        RegexPattern(const std::string& source, RegexHandler handler);
+        RegexPattern(const RegexPattern& other);
+        RegexPattern& operator=(const RegexPattern& other);
+        RegexPattern(RegexPattern&&) = default;
+        RegexPattern& operator=(RegexPattern&&) = default;
         const std::unique_ptr<std::regex>& GetRegex() const;
+        const std::string& GetSource() const;
         const RegexHandler& GetHandler() const;
 };
 
+// a compiled set of rules: the patterns, the DFA built from them and whether the operator dispatch of
+// operators.h applies, never changed once built so any number of lexers (and threads) can share one
+class RuleSet {
+    public:
+        // compiles the DFA (left uncompiled if any pattern has no source text or can't be compiled)
+        explicit RuleSet(std::vector<RegexPattern> patterns, bool useDispatch = false);
+        RuleSet(const RuleSet&) = delete;
+        RuleSet& operator=(const RuleSet&) = delete;
+
+        const std::vector<RegexPattern>& GetPatterns() const;
+        const Dfa& GetDfa() const;
+        bool GetUseDispatch() const;
+        // changes whenever the tokens the rules give could change (the pattern texts, the token types or
+        // HandlerVersion), used to key caches of lexed files
+        uint64_t GetVersion() const;
+
+        // bump this whenever a handler starts producing different tokens for the same match
+        static constexpr uint64_t HandlerVersion = 2;
+
+        // the rules of the language, built the first time they are asked for and then shared by every lexer
+        static const std::shared_ptr<const RuleSet>& GetDefault();
+
+    private:
+        std::vector<RegexPattern> Patterns;
+        Dfa Automaton;
+        bool UseDispatch;
+        uint64_t Version;
+};
+
 class Lexer {
     public:
         std::vector<Token> Tokens;
         Lexer();
         int GetPosition() const;
-        const std::string& GetSource() const;
+        std::string_view GetSource() const;
+        const std::shared_ptr<const SourceBuffer>& GetSourceBuffer() const;
         void SetPosition(int position);
-        void SetSource(const std::string& source);
+        void SetSource(std::shared_ptr<const SourceBuffer> source);
+        size_t GetEnd() const;
+        void SetEnd(size_t end);
+        int GetMatchLength() const;
+        void SetMatchLength(int length);
         const std::vector<RegexPattern>& GetPatterns() const;
         void SetPatterns(const std::vector<RegexPattern>& patterns);
+        const std::shared_ptr<const RuleSet>& GetRules() const;
+        void SetRules(std::shared_ptr<const RuleSet> rules);
+        const Dfa& GetDfa() const;
+        bool GetUseRegex() const;
+        void SetUseRegex(bool useRegex);
+        const std::shared_ptr<SymbolTable>& GetSymbols() const;
+        void SetSymbols(std::shared_ptr<SymbolTable> symbols);
+        uint32_t Intern(std::string_view text);
+        bool GetUseDispatch() const;
+        Token NextToken();
+        Token Peek(size_t k);
+        void Emit(const Token& token);
+        void Restart(int position);
+        void Reset(std::shared_ptr<const SourceBuffer> source);
+        const std::vector<uint32_t>& GetUnmatched() const;
+        void AddUnmatched(uint32_t offset);
+        const std::vector<NumberValue>& GetNumbers() const;
+        uint32_t AddNumber(NumberValue value);
+        void TakeNumbers(std::vector<NumberValue>& numbers);
+        bool GetMayHaveErrors() const;
+        void SetMayHaveErrors();
+        // starts counting what every rule costs (only in a build with ILYS_LEXER_STATS, see lexer_stats.h), the
+        // counters start over if it already was or when the rules change
+        void EnableStats();
+        LexerStats* GetStats() const;
 
     private:
-        std::string Source;
+        std::shared_ptr<const SourceBuffer> Source;
+        size_t End;
         int Position;
-        std::vector<RegexPattern> Patterns;
+        int MatchLength;
+        std::shared_ptr<const RuleSet> Rules;
+        bool UseRegex;
+        // ring buffer of tokens lexed but not handed out yet (size is always a power of two)
+        std::vector<Token> Lookahead;
+        size_t LookaheadHead;
+        size_t LookaheadCount;
+        bool EofQueued;
+        // where identifiers and strings are interned (null means tokens get no symbol)
+        std::shared_ptr<SymbolTable> Symbols;
+        SymbolCache Cache;
+        // bytes skipped because no rule matched there, since the last Restart
+        std::vector<uint32_t> Unmatched;
+        // the values of the number tokens lexed since the last Restart (their symbol is 1 + the index in here)
+        std::vector<NumberValue> Numbers;
+        // set by a handler that saw a number that didn't decode or a byte that isn't ASCII, since the last Restart
+        bool MayHaveErrors;
+        // null unless EnableStats was called
+        std::unique_ptr<LexerStats> Stats;
+
+        bool FillLookahead(size_t count);
 };
 
 // defining the functions that will be used in the lexer.cpp file
-std::byte SourceAt(Lexer* lexer);
+char32_t SourceAt(Lexer* lexer, size_t* length);
+
+std::string_view WhatRemains(Lexer* lexer);
 
-std::string WhatRemains(Lexer* lexer);
+std::string_view CurrentMatch(Lexer* lexer);
 
 bool IsEOF(Lexer* lexer);
 
@@ -47,12 +138,37 @@ void LexAdvance(Lexer* lexer, int amount);
 
 void TokenPush(Lexer* lexer, Token token);
 
-RegexHandler defaultHandler(TokenType type, std::string value);
+void LexStep(Lexer* lexer);
+
+RegexHandler defaultHandler(TokenType type);
+
+void skipHandler(Lexer* lexer, const std::regex* regex);
+
+void numberHandler(Lexer* lexer, const std::regex* regex);
+
+void identifierHandler(Lexer* lexer, const std::regex* regex);
+
+void stringHandler(Lexer* lexer, const std::regex* regex);
+
+// creates a lexer over source with the rules of the language (shared, nothing is compiled here) and its own
+// symbol table
+std::unique_ptr<Lexer> ConstructLexer(std::shared_ptr<const SourceBuffer> source);
+
+// tokenizes with the DFA built from the patterns (falls back to the regex loop if a pattern can't be compiled)
+TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source);
+
+TokenStream Tokenize(std::string source);
+
+// same, interning names into an existing table (ex: every file of one compilation sharing a table)
+TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols);
 
-void numberHandler(Lexer* lexer, std::regex* regex);
+// tokenizes source with an existing lexer into an existing stream, for batches of files: the lexer is Reset
+// (its rules and symbol table stay) and the stream's vectors are refilled, so their capacity carries over
+void Tokenize(Lexer* lexer, std::shared_ptr<const SourceBuffer> source, TokenStream& stream);
 
-Lexer* ConstructLexer(std::string source);
+// tokenizes by trying every std::regex in order, kept as the reference the DFA is checked against
+TokenStream TokenizeRegex(std::shared_ptr<const SourceBuffer> source);
 
-std::vector<Token> Tokenize(std::string source);
+TokenStream TokenizeRegex(std::string source);
 
 #endif
\ No newline at end of file
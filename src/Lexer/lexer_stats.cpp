@@ -0,0 +1,159 @@
+#include "lexer_stats.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#if ILYS_LEXER_STATS
+// every allocation of the process goes through these, each thread counts its own so no counter is shared
+static thread_local uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+uint64_t ThreadAllocations() {
+    return allocations;
+}
+#else
+uint64_t ThreadAllocations() {
+    return 0;
+}
+#endif
+
+// creating the counters, all at 0
+LexerStats::LexerStats(std::vector<std::string> labels) {
+    Labels = std::move(labels);
+    Labels.push_back("(operator dispatch)");
+    Labels.push_back("(unmatched bytes)");
+    Rows.resize(Labels.size());
+}
+
+RuleStats& LexerStats::GetRow(size_t row) {
+    return Rows[row];
+}
+
+size_t LexerStats::GetDispatchRow() const {
+    return Rows.size() - 2;
+}
+
+size_t LexerStats::GetUnmatchedRow() const {
+    return Rows.size() - 1;
+}
+
+void LexerStats::AddRun(uint64_t nanoseconds, uint64_t allocations, uint64_t bytes, uint64_t tokens) {
+    Runs++;
+    RunNanoseconds += nanoseconds;
+    RunAllocations += allocations;
+    RunBytes += bytes;
+    RunTokens += tokens;
+}
+
+bool LexerStats::Merge(const LexerStats& other) {
+    if (other.Labels != Labels) {
+        return false;
+    }
+    for (size_t i = 0; i < Rows.size(); i++) {
+        Rows[i].Attempts += other.Rows[i].Attempts;
+        Rows[i].Matches += other.Rows[i].Matches;
+        Rows[i].Bytes += other.Rows[i].Bytes;
+        Rows[i].Nanoseconds += other.Rows[i].Nanoseconds;
+        Rows[i].Allocations += other.Rows[i].Allocations;
+    }
+    Runs += other.Runs;
+    RunNanoseconds += other.RunNanoseconds;
+    RunAllocations += other.RunAllocations;
+    RunBytes += other.RunBytes;
+    RunTokens += other.RunTokens;
+    return true;
+}
+
+// writes a pattern on one line, the whitespace in it spelled the way it is in the source ("[ \t\n\r]+")
+static void printPattern(std::ostream& out, const std::string& pattern) {
+    for (char c : pattern) {
+        switch (c) {
+            case '\t': out << "\\t"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            default: out << c; break;
+        }
+    }
+}
+
+void LexerStats::PrintText(std::ostream& out) const {
+    out << "Lexer stats: " << Runs << " runs, " << RunBytes << " bytes, " << RunTokens << " tokens in " << std::fixed
+        << std::setprecision(3) << RunNanoseconds * 1e-6 << " ms, " << RunAllocations << " allocations\n";
+    out << std::setw(5) << "rule" << std::setw(12) << "attempts" << std::setw(12) << "matches" << std::setw(12) << "bytes"
+        << std::setw(11) << "ms" << std::setw(7) << "time" << std::setw(10) << "allocs" << "  pattern\n";
+    uint64_t total = 0;
+    for (const RuleStats& row : Rows) {
+        total += row.Nanoseconds;
+    }
+    for (size_t i = 0; i < Rows.size(); i++) {
+        const RuleStats& row = Rows[i];
+        if (row.Attempts == 0) {
+            continue;
+        }
+        out << std::setw(5) << i << std::setw(12) << row.Attempts << std::setw(12) << row.Matches << std::setw(12) << row.Bytes
+            << std::setw(11) << std::setprecision(3) << row.Nanoseconds * 1e-6 << std::setw(6) << std::setprecision(1)
+            << (total > 0 ? row.Nanoseconds * 100.0 / total : 0) << '%' << std::setw(10) << row.Allocations << "  ";
+        printPattern(out, Labels[i]);
+        out << '\n';
+    }
+}
+
+// writes text as a JSON string (the patterns are full of backslashes and quotes)
+static void printJsonString(std::ostream& out, const std::string& text) {
+    static const char digits[] = "0123456789abcdef";
+    out << '"';
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (byte < 0x20) {
+            out << "\\u00" << digits[byte >> 4] << digits[byte & 15];
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void LexerStats::PrintJson(std::ostream& out) const {
+    out << "{\"runs\": " << Runs << ", \"bytes\": " << RunBytes << ", \"tokens\": " << RunTokens << ", \"nanoseconds\": " << RunNanoseconds
+        << ", \"allocations\": " << RunAllocations << ", \"rules\": [";
+    for (size_t i = 0; i < Rows.size(); i++) {
+        const RuleStats& row = Rows[i];
+        out << (i > 0 ? ", " : "") << "{\"rule\": " << i << ", \"pattern\": ";
+        printJsonString(out, Labels[i]);
+        out << ", \"attempts\": " << row.Attempts << ", \"matches\": " << row.Matches << ", \"bytes\": " << row.Bytes
+            << ", \"nanoseconds\": " << row.Nanoseconds << ", \"allocations\": " << row.Allocations << "}";
+    }
+    out << "]}\n";
+}
@@ -0,0 +1,155 @@
+#ifndef LEXER_STATS_H
+#define LEXER_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// per rule counters of the lexer, only compiled in when every file is built with -DILYS_LEXER_STATS=1 (without it
+// the probes below are empty and the lexer loop is the same as before). a stats build replaces the global
+// operator new to count allocations, so it can't be linked with Benchmarks/lexer_bench.cpp (which does the same)
+#ifndef ILYS_LEXER_STATS
+#define ILYS_LEXER_STATS 0
+#endif
+
+// what one rule cost: the DFA tries every rule at once so there a rule's attempts are its matches, the regex loop
+// tries them one after the other so a rule late in the list pays for every rule before it
+struct RuleStats {
+    uint64_t Attempts = 0;
+    uint64_t Matches = 0;
+    uint64_t Bytes = 0;
+    uint64_t Nanoseconds = 0;  // matching and the handler
+    uint64_t Allocations = 0;
+};
+
+// the counters of one lexer (not thread safe, each lexer has its own and they are merged for the report)
+class LexerStats {
+    public:
+        // one row per rule, labelled with its pattern, and two more for the operator dispatch and the bytes no
+        // rule matched
+        explicit LexerStats(std::vector<std::string> labels);
+
+        static constexpr bool Enabled = ILYS_LEXER_STATS != 0;
+
+        RuleStats& GetRow(size_t row);
+        size_t GetDispatchRow() const;
+        size_t GetUnmatchedRow() const;
+
+        // one whole run over a source (a Tokenize)
+        void AddRun(uint64_t nanoseconds, uint64_t allocations, uint64_t bytes, uint64_t tokens);
+
+        // adds the counters of another lexer with the same rules, returns false if the rules differ
+        bool Merge(const LexerStats& other);
+
+        // a table with the rules in their order (the order matters to the regex loop), rules never tried left out
+        void PrintText(std::ostream& out) const;
+        // the same as one JSON object
+        void PrintJson(std::ostream& out) const;
+
+    private:
+        std::vector<std::string> Labels;
+        std::vector<RuleStats> Rows;
+        uint64_t Runs = 0;
+        uint64_t RunNanoseconds = 0;
+        uint64_t RunAllocations = 0;
+        uint64_t RunBytes = 0;
+        uint64_t RunTokens = 0;
+};
+
+// allocations made by the calling thread so far (always 0 without ILYS_LEXER_STATS)
+uint64_t ThreadAllocations();
+
+// times a piece of the lexer and charges it to a row, checkpoint after checkpoint: every call is charged the time
+// and allocations since the previous one. does nothing without ILYS_LEXER_STATS or without stats
+class StatsProbe {
+    public:
+#if ILYS_LEXER_STATS
+        explicit StatsProbe(LexerStats* stats) : Stats(stats) {
+            if (Stats) {
+                Started = Last = now();
+                StartAllocations = Allocations = ThreadAllocations();
+            }
+        }
+
+        // a rule that was tried and didn't match
+        void Missed(size_t row) {
+            if (Stats) {
+                charge(Stats->GetRow(row));
+            }
+        }
+
+        // the rule that matched and how many bytes it took
+        void Matched(size_t row, size_t bytes) {
+            if (Stats) {
+                RuleStats& stats = Stats->GetRow(row);
+                stats.Matches++;
+                stats.Bytes += bytes;
+                charge(stats);
+            }
+        }
+
+        // an operator found by the dispatch table instead of a rule
+        void Dispatched(size_t bytes) {
+            if (Stats) {
+                Matched(Stats->GetDispatchRow(), bytes);
+            }
+        }
+
+        // a byte no rule matched
+        void Skipped() {
+            if (Stats) {
+                Matched(Stats->GetUnmatchedRow(), 1);
+            }
+        }
+
+        // a whole run, charged from the creation of the probe
+        void Ran(uint64_t bytes, uint64_t tokens) {
+            if (Stats) {
+                Stats->AddRun(now() - Started, ThreadAllocations() - StartAllocations, bytes, tokens);
+            }
+        }
+
+    private:
+        LexerStats* Stats;
+        uint64_t Started = 0;
+        uint64_t StartAllocations = 0;
+        uint64_t Last = 0;
+        uint64_t Allocations = 0;
+
+        static uint64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void charge(RuleStats& stats) {
+            uint64_t time = now();
+            uint64_t allocations = ThreadAllocations();
+            stats.Attempts++;
+            stats.Nanoseconds += time - Last;
+            stats.Allocations += allocations - Allocations;
+            Last = time;
+            Allocations = allocations;
+        }
+#else
+        explicit StatsProbe(LexerStats*) {
+        }
+
+        void Missed(size_t) {
+        }
+
+        void Matched(size_t, size_t) {
+        }
+
+        void Dispatched(size_t) {
+        }
+
+        void Skipped() {
+        }
+
+        void Ran(uint64_t, uint64_t) {
+        }
+#endif
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "numbers.h"
+
+#include <charconv>
+#include <cstring>
+#include <string>
+
+// creating the integer 0
+NumberValue::NumberValue() {
+    Bits = 0;
+    Float = false;
+}
+
+NumberValue NumberValue::FromInteger(int64_t value) {
+    NumberValue number;
+    number.Bits = static_cast<uint64_t>(value);
+    number.Float = false;
+    return number;
+}
+
+NumberValue NumberValue::FromFloat(double value) {
+    NumberValue number;
+    std::memcpy(&number.Bits, &value, sizeof(value));
+    number.Float = true;
+    return number;
+}
+
+bool NumberValue::IsFloat() const {
+    return Float;
+}
+
+int64_t NumberValue::GetInteger() const {
+    return static_cast<int64_t>(Bits);
+}
+
+double NumberValue::GetFloat() const {
+    double value;
+    std::memcpy(&value, &Bits, sizeof(value));
+    return value;
+}
+
+double NumberValue::ToDouble() const {
+    return Float ? GetFloat() : static_cast<double>(GetInteger());
+}
+
+bool NumberValue::IsSame(const NumberValue& other) const {
+    return Float == other.Float && Bits == other.Bits;
+}
+
+// the value of a digit in the given base, or -1 (so '_' and anything else stop a run of digits)
+static int digitValue(char c, int base) {
+    int value = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : 99;
+    return value < base ? value : -1;
+}
+
+// reads the digits and separators of an integer in base 2 or 16, as 64 raw bits
+static bool decodeBits(std::string_view digits, int base, int bitsPerDigit, uint64_t* bits) {
+    uint64_t value = 0;
+    bool any = false;
+    for (char c : digits) {
+        if (c == '_') {
+            continue;
+        }
+        int digit = digitValue(c, base);
+        if (digit < 0 || (value >> (64 - bitsPerDigit)) != 0) {
+            return false;
+        }
+        value = (value << bitsPerDigit) | static_cast<uint64_t>(digit);
+        any = true;
+    }
+    *bits = value;
+    return any && digits.front() != '_' && digits.back() != '_';
+}
+
+bool DecodeNumber(std::string_view text, NumberValue* value) {
+    // a separator only ever sits between two digits
+    if (text.empty() || text.front() < '0' || text.front() > '9' || text.back() == '_' || text.find("_.") != std::string_view::npos
+        || text.find("._") != std::string_view::npos) {
+        return false;
+    }
+
+    if (text.size() > 2 && text[0] == '0' && ((text[1] | 0x20) == 'x' || (text[1] | 0x20) == 'b')) {
+        bool hex = (text[1] | 0x20) == 'x';
+        uint64_t bits;
+        if (!decodeBits(text.substr(2), hex ? 16 : 2, hex ? 4 : 1, &bits)) {
+            return false;
+        }
+        *value = NumberValue::FromInteger(static_cast<int64_t>(bits));
+        return true;
+    }
+
+    // decimal integers are read directly, with an overflow check per digit
+    int64_t integer = 0;
+    size_t i = 0;
+    for (; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '_') {
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            break;
+        }
+        if (__builtin_mul_overflow(integer, 10, &integer) || __builtin_add_overflow(integer, c - '0', &integer)) {
+            // can still be a valid decimal ("99999999999999999999.5"), from_chars below decides
+            integer = -1;
+            break;
+        }
+    }
+    if (i == text.size() && integer >= 0) {
+        *value = NumberValue::FromInteger(integer);
+        return true;
+    }
+
+    // decimals go through from_chars (correctly rounded), the separators are dropped first
+    char buffer[64];
+    std::string longer;
+    const char* begin = text.data();
+    const char* end = text.data() + text.size();
+    if (text.find('_') != std::string_view::npos) {
+        char* out = buffer;
+        if (text.size() > sizeof(buffer)) {
+            longer.resize(text.size());
+            out = &longer[0];
+        }
+        begin = out;
+        for (char c : text) {
+            if (c != '_') {
+                *out++ = c;
+            }
+        }
+        end = out;
+    }
+    std::string_view digits(begin, end - begin);
+    size_t dot = digits.find('.');
+    // a literal has digits on both sides of its one dot, and no exponent or sign (from_chars would take both)
+    if (dot == std::string_view::npos || dot == 0 || dot + 1 == digits.size() || digits.find_first_not_of("0123456789.") != std::string_view::npos
+        || digits.find('.', dot + 1) != std::string_view::npos) {
+        return false;
+    }
+    double result;
+    std::from_chars_result parsed = std::from_chars(begin, end, result, std::chars_format::fixed);
+    if (parsed.ec != std::errc() || parsed.ptr != end) {
+        return false;
+    }
+    *value = NumberValue::FromFloat(result);
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef NUMBERS_H
+#define NUMBERS_H
+
+#include <cstdint>
+#include <string_view>
+
+// the decoded value of a NUMBER token: a 64-bit integer for literals without a fraction, a double otherwise
+class NumberValue {
+    public:
+        // the integer 0
+        NumberValue();
+
+        static NumberValue FromInteger(int64_t value);
+        static NumberValue FromFloat(double value);
+
+        bool IsFloat() const;
+        // only meaningful for the kind the value has
+        int64_t GetInteger() const;
+        double GetFloat() const;
+        // either kind, as a double
+        double ToDouble() const;
+
+        // same kind and the same bits (so NaN equals NaN, unlike ==)
+        bool IsSame(const NumberValue& other) const;
+
+    private:
+        uint64_t Bits;
+        bool Float;
+};
+
+// decodes the text of a NUMBER token without going through a string: decimal integers ("42"), decimals ("3.25"),
+// hexadecimal ("0xFF") and binary ("0b1010") literals, with '_' allowed between digits ("1_000_000").
+// a sign is never part of the literal (unary minus is left to the parser), so decimal integers go up to
+// INT64_MAX while hexadecimal and binary ones may use all 64 bits (0xFFFFFFFFFFFFFFFF is -1).
+// returns false if the text isn't such a literal or its value doesn't fit
+bool DecodeNumber(std::string_view text, NumberValue* value);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include "tokens.h"
+
+#include <array>
+
+// every operator and punctuation mark of the language and the token it becomes (generated from token_spec.h)
+struct Operator {
+    std::string_view Text;
+    TokenType Type;
+};
+
+constexpr Operator Operators[] = {
+#define ILYS_OPERATOR_ENTRY(type, name, text) {text, TokenType::type},
+    ILYS_TOKEN_SPEC(ILYS_TOKEN_IGNORE, ILYS_OPERATOR_ENTRY, ILYS_TOKEN_IGNORE)
+#undef ILYS_OPERATOR_ENTRY
+};
+
+constexpr size_t OperatorCount = sizeof(Operators) / sizeof(Operators[0]);
+
+// indexes of Operators sorted by first byte, and longest first among the ones sharing a first byte
+// (so the first operator that matches is the longest, the same answer the DFA gives)
+constexpr std::array<uint8_t, OperatorCount> BuildOperatorOrder() {
+    std::array<uint8_t, OperatorCount> order = {};
+    for (size_t i = 0; i < OperatorCount; i++) {
+        order[i] = static_cast<uint8_t>(i);
+    }
+    // insertion sort, stable so the spec order breaks ties
+    for (size_t i = 1; i < OperatorCount; i++) {
+        uint8_t current = order[i];
+        size_t j = i;
+        while (j > 0) {
+            const Operator& previous = Operators[order[j - 1]];
+            const Operator& candidate = Operators[current];
+            uint8_t previousByte = static_cast<uint8_t>(previous.Text[0]);
+            uint8_t candidateByte = static_cast<uint8_t>(candidate.Text[0]);
+            if (previousByte < candidateByte || (previousByte == candidateByte && previous.Text.size() >= candidate.Text.size())) {
+                break;
+            }
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = current;
+    }
+    return order;
+}
+
+constexpr std::array<uint8_t, OperatorCount> OperatorOrder = BuildOperatorOrder();
+
+// for every first byte, where its operators start in OperatorOrder and how many there are
+struct OperatorRange {
+    uint8_t Begin;
+    uint8_t Count;
+};
+
+constexpr std::array<OperatorRange, 256> BuildOperatorDispatch() {
+    std::array<OperatorRange, 256> dispatch = {};
+    for (size_t i = 0; i < OperatorCount; i++) {
+        uint8_t byte = static_cast<uint8_t>(Operators[OperatorOrder[i]].Text[0]);
+        if (dispatch[byte].Count == 0) {
+            dispatch[byte].Begin = static_cast<uint8_t>(i);
+        }
+        dispatch[byte].Count++;
+    }
+    return dispatch;
+}
+
+constexpr std::array<OperatorRange, 256> OperatorDispatch = BuildOperatorDispatch();
+
+// returns the length of the longest operator at position (0 if none) and stores its type
+constexpr size_t MatchOperator(std::string_view text, size_t position, TokenType* type) {
+    OperatorRange range = OperatorDispatch[static_cast<uint8_t>(text[position])];
+    for (size_t i = range.Begin; i < size_t(range.Begin) + range.Count; i++) {
+        const Operator& candidate = Operators[OperatorOrder[i]];
+        if (text.compare(position, candidate.Text.size(), candidate.Text) == 0) {
+            *type = candidate.Type;
+            return candidate.Text.size();
+        }
+    }
+    return 0;
+}
+
+// true for the bytes only operators can start, the lexer hands those straight to MatchOperator instead of the
+// DFA. every other rule of ConstructLexer starts with a letter, a digit, a quote or whitespace, which no operator
+// does (a NUMBER never takes its sign, "-3" is MINUS then NUMBER)
+constexpr std::array<bool, 256> BuildOperatorOnly() {
+    std::array<bool, 256> only = {};
+    for (size_t byte = 0; byte < 256; byte++) {
+        only[byte] = OperatorDispatch[byte].Count > 0;
+    }
+    return only;
+}
+
+constexpr std::array<bool, 256> OperatorOnly = BuildOperatorOnly();
+
+// the operator at the start of text (E0F_TOKEN if none), for the checks below
+constexpr TokenType OperatorAt(std::string_view text) {
+    TokenType type = TokenType::E0F_TOKEN;
+    MatchOperator(text, 0, &type);
+    return type;
+}
+
+static_assert(OperatorAt("..") == TokenType::DOTDOT, "operator dispatch is broken");
+static_assert(OperatorAt(".5") == TokenType::DOT, "operator dispatch is broken");
+static_assert(OperatorAt("<=") == TokenType::LESSTHANEQUALS, "operator dispatch is broken");
+static_assert(OperatorAt("&") == TokenType::E0F_TOKEN, "operator dispatch is broken");
+static_assert(OperatorOnly['-'] && OperatorOnly['('] && !OperatorOnly['a'] && !OperatorOnly['"'], "operator dispatch is broken");
+
+#endif
@@ -0,0 +1,131 @@
+#include "parallel.h"
+
+// returns the offset right after the string literal starting at quote, scanned exactly like the STRING rule:
+// if the literal never closes (or has a backslash before a line break) the lexer only skips the quote itself
+static size_t skipStringLiteral(std::string_view source, size_t quote) {
+    size_t position = quote + 1;
+    while (true) {
+        position = ScanRun(ScanKernel::STRING_BODY, source.data(), position, source.size());
+        if (position >= source.size()) {
+            return quote + 1;
+        }
+        if (source[position] == '"') {
+            return position + 1;
+        }
+        // a backslash escapes anything but a line break
+        if (position + 1 < source.size() && source[position + 1] != '\n' && source[position + 1] != '\r') {
+            position += 2;
+        }
+        else {
+            return quote + 1;
+        }
+    }
+}
+
+std::vector<size_t> FindSplitPoints(std::string_view source, size_t parts) {
+    std::vector<size_t> points;
+    if (parts < 2) {
+        return points;
+    }
+
+    size_t target = source.size() / parts;
+    size_t position = 0;
+    while (points.size() + 1 < parts && position < source.size()) {
+        // everything up to the next quote is outside of any string
+        size_t quote = source.find('"', position);
+        size_t stop = quote == std::string_view::npos ? source.size() : quote;
+
+        size_t search = std::max(position, target);
+        while (points.size() + 1 < parts && search < stop) {
+            size_t newline = source.find('\n', search);
+            if (newline == std::string_view::npos || newline >= stop || newline + 1 >= source.size()) {
+                break;
+            }
+            points.push_back(newline + 1);
+            target = std::max(source.size() / parts * (points.size() + 1), newline + 1);
+            search = target;
+        }
+
+        if (quote == std::string_view::npos) {
+            break;
+        }
+        position = skipStringLiteral(source, quote);
+    }
+    return points;
+}
+
+// lexes [begin, end) of the source and returns the tokens without the EOF token
+static TokenStream lexChunk(const std::shared_ptr<const SourceBuffer>& source, const std::shared_ptr<SymbolTable>& symbols, size_t begin, size_t end) {
+    std::unique_ptr<Lexer> lexer(ConstructLexer(source));
+    lexer->SetSymbols(symbols);
+    lexer->SetPosition(begin);
+    lexer->SetEnd(end);
+
+    TokenStream chunk;
+    while (true) {
+        Token token = lexer->NextToken();
+        if (token.type == TokenType::E0F_TOKEN) {
+            break;
+        }
+        chunk.Tokens.push_back(token);
+    }
+    chunk.Unmatched = lexer->GetUnmatched();
+    chunk.MayHaveErrors = lexer->GetMayHaveErrors();
+    lexer->TakeNumbers(chunk.Numbers);
+    return chunk;
+}
+
+TokenStream TokenizeParallel(std::shared_ptr<const SourceBuffer> source, ThreadPool& pool, size_t minChunkSize) {
+    return TokenizeParallel(std::move(source), std::make_shared<SymbolTable>(), pool, minChunkSize);
+}
+
+TokenStream TokenizeParallel(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols, ThreadPool& pool, size_t minChunkSize) {
+    std::string_view text = source->View();
+    size_t parts = std::min(pool.GetThreadCount(), text.size() / std::max<size_t>(minChunkSize, 1));
+    std::vector<size_t> bounds = FindSplitPoints(text, parts);
+    if (bounds.empty()) {
+        return Tokenize(source, symbols);
+    }
+    bounds.insert(bounds.begin(), 0);
+    bounds.push_back(text.size());
+
+    // every chunk interns into the same table, so equal names get equal ids across chunks
+    std::vector<std::future<TokenStream>> chunks;
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+        size_t begin = bounds[i];
+        size_t end = bounds[i + 1];
+        chunks.push_back(pool.Submit([source, symbols, begin, end]() {
+            return lexChunk(source, symbols, begin, end);
+        }));
+    }
+
+    std::vector<TokenStream> results;
+    size_t total = 1;
+    for (std::future<TokenStream>& chunk : chunks) {
+        results.push_back(pool.Wait(chunk));
+        total += results.back().Tokens.size();
+    }
+
+    // the offsets are already absolute, stitching is only appending (and moving the symbols of the numbers past
+    // the values of the chunks before)
+    TokenStream stream;
+    stream.Source = source;
+    stream.Symbols = symbols;
+    stream.Tokens.reserve(total);
+    for (TokenStream& chunk : results) {
+        size_t first = stream.Tokens.size();
+        uint32_t base = static_cast<uint32_t>(stream.Numbers.size());
+        stream.Tokens.insert(stream.Tokens.end(), chunk.Tokens.begin(), chunk.Tokens.end());
+        for (size_t i = first; base > 0 && i < stream.Tokens.size(); i++) {
+            if (stream.Tokens[i].type == TokenType::NUMBER && stream.Tokens[i].symbol != 0) {
+                stream.Tokens[i].symbol += base;
+            }
+        }
+        stream.Numbers.insert(stream.Numbers.end(), chunk.Numbers.begin(), chunk.Numbers.end());
+        stream.Unmatched.insert(stream.Unmatched.end(), chunk.Unmatched.begin(), chunk.Unmatched.end());
+        stream.MayHaveErrors = stream.MayHaveErrors || chunk.MayHaveErrors;
+        std::vector<Token>().swap(chunk.Tokens);
+    }
+    stream.Tokens.push_back(Token::ConstructToken(TokenType::E0F_TOKEN, text.size(), 0));
+    return stream;
+}
\ No newline at end of file
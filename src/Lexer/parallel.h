@@ -0,0 +1,23 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "lexer.h"
+#include "../Support/thread_pool.h"
+
+// chunks smaller than this aren't worth a thread (building a lexer costs more than lexing them)
+constexpr size_t DefaultParallelChunkSize = 1 << 20;
+
+// finds up to parts - 1 offsets where the source can be cut so that lexing each piece on its own gives exactly
+// the tokens the whole file gives: right after a newline that is outside any string literal (string literals
+// are the only tokens that can hold a newline)
+std::vector<size_t> FindSplitPoints(std::string_view source, size_t parts);
+
+// lexes the chunks on the pool and stitches the tokens back together, the result is the same as Tokenize. it can
+// be called from one of the pool's workers too, which then lexes chunks itself while it waits (see Wait)
+TokenStream TokenizeParallel(std::shared_ptr<const SourceBuffer> source, ThreadPool& pool, size_t minChunkSize = DefaultParallelChunkSize);
+
+// same as above but interning into symbols (ex: the table of a whole compilation)
+TokenStream TokenizeParallel(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols, ThreadPool& pool,
+                             size_t minChunkSize = DefaultParallelChunkSize);
+
+#endif
\ No newline at end of file
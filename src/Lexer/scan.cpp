@@ -0,0 +1,228 @@
+#include "scan.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ILYS_X86 1
+#define ILYS_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+// each class knows how to test one byte, and on x86 a whole 16 or 32 byte register at a time
+// (the vector versions return a lane with its top bit set for every byte in the class, 0xFF but for AsciiClass)
+
+#ifdef ILYS_X86
+// unsigned lo <= byte <= hi with the signed compare SSE2 has: shift the range down to start at -128
+inline __m128i InRange(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_add_epi8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(static_cast<char>(-128)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1)));
+}
+
+ILYS_AVX2 inline __m256i InRange(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_add_epi8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), _mm256_set1_epi8(static_cast<char>(-128)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1)), shifted);
+}
+#endif
+
+struct WhitespaceClass {
+    static bool Scalar(unsigned char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+#ifdef ILYS_X86
+    static __m128i Sse2(__m128i v) {
+        __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        __m128i lines = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        return _mm_or_si128(spaces, lines);
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        __m256i lines = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+        return _mm256_or_si256(spaces, lines);
+    }
+#endif
+};
+
+struct IdentifierClass {
+    static bool Scalar(unsigned char c) {
+        return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+    }
+#ifdef ILYS_X86
+    static __m128i Sse2(__m128i v) {
+        // or-ing 0x20 folds upper case onto lower case (and doesn't move any other byte into a-z), the bytes of
+        // multibyte sequences are the negative ones
+        __m128i letters = InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digits = InRange(v, '0', '9');
+        __m128i high = _mm_cmplt_epi8(v, _mm_setzero_si128());
+        return _mm_or_si128(_mm_or_si128(letters, digits), _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), high));
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        __m256i letters = InRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i digits = InRange(v, '0', '9');
+        __m256i high = _mm256_cmpgt_epi8(_mm256_setzero_si256(), v);
+        return _mm256_or_si256(_mm256_or_si256(letters, digits), _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')), high));
+    }
+#endif
+};
+
+struct DigitClass {
+    static bool Scalar(unsigned char c) {
+        return c >= '0' && c <= '9';
+    }
+#ifdef ILYS_X86
+    static __m128i Sse2(__m128i v) {
+        return InRange(v, '0', '9');
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        return InRange(v, '0', '9');
+    }
+#endif
+};
+
+struct StringBodyClass {
+    static bool Scalar(unsigned char c) {
+        return c != '"' && c != '\\';
+    }
+#ifdef ILYS_X86
+    static __m128i Sse2(__m128i v) {
+        __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        return _mm_xor_si128(stop, _mm_set1_epi8(static_cast<char>(0xFF)));
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+        return _mm256_xor_si256(stop, _mm256_set1_epi8(static_cast<char>(0xFF)));
+    }
+#endif
+};
+
+struct LineBodyClass {
+    static bool Scalar(unsigned char c) {
+        return c != '\n';
+    }
+#ifdef ILYS_X86
+    static __m128i Sse2(__m128i v) {
+        return _mm_xor_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_set1_epi8(static_cast<char>(0xFF)));
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        return _mm256_xor_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_set1_epi8(static_cast<char>(0xFF)));
+    }
+#endif
+};
+
+struct AsciiClass {
+    static bool Scalar(unsigned char c) {
+        return c < 0x80;
+    }
+#ifdef ILYS_X86
+    // the sign bit is all movemask looks at, so the byte itself is the mask of the ones that are NOT in the class
+    static __m128i Sse2(__m128i v) {
+        return _mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(0xFF)));
+    }
+    ILYS_AVX2 static __m256i Avx2(__m256i v) {
+        return _mm256_xor_si256(v, _mm256_set1_epi8(static_cast<char>(0xFF)));
+    }
+#endif
+};
+
+template <typename Class>
+size_t RunScalar(const char* data, size_t position, size_t size) {
+    while (position < size && Class::Scalar(static_cast<unsigned char>(data[position]))) {
+        position++;
+    }
+    return position;
+}
+
+#ifdef ILYS_X86
+template <typename Class>
+size_t RunSse2(const char* data, size_t position, size_t size) {
+    while (position + 16 <= size) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        uint32_t outside = ~static_cast<uint32_t>(_mm_movemask_epi8(Class::Sse2(v))) & 0xFFFF;
+        if (outside != 0) {
+            return position + __builtin_ctz(outside);
+        }
+        position += 16;
+    }
+    return RunScalar<Class>(data, position, size);
+}
+
+template <typename Class>
+ILYS_AVX2 size_t RunAvx2(const char* data, size_t position, size_t size) {
+    // most runs are short, so the first 16 bytes are checked with a half-width register before going 32 wide
+    if (position + 16 <= size) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        uint32_t outside = ~static_cast<uint32_t>(_mm_movemask_epi8(Class::Sse2(v))) & 0xFFFF;
+        if (outside != 0) {
+            return position + __builtin_ctz(outside);
+        }
+        position += 16;
+    }
+    while (position + 32 <= size) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + position));
+        uint32_t outside = ~static_cast<uint32_t>(_mm256_movemask_epi8(Class::Avx2(v)));
+        if (outside != 0) {
+            return position + __builtin_ctz(outside);
+        }
+        position += 32;
+    }
+    // the tail goes through the SSE2 loop, clearing the upper halves first avoids the AVX/SSE transition penalty
+    _mm256_zeroupper();
+    return RunSse2<Class>(data, position, size);
+}
+#endif
+
+using RunFunction = size_t (*)(const char* data, size_t position, size_t size);
+
+// table of kernels, indexed by [level][kernel]
+#ifdef ILYS_X86
+const RunFunction Kernels[3][7] = {
+    {nullptr, RunScalar<WhitespaceClass>, RunScalar<IdentifierClass>, RunScalar<DigitClass>, RunScalar<StringBodyClass>, RunScalar<LineBodyClass>, RunScalar<AsciiClass>},
+    {nullptr, RunSse2<WhitespaceClass>, RunSse2<IdentifierClass>, RunSse2<DigitClass>, RunSse2<StringBodyClass>, RunSse2<LineBodyClass>, RunSse2<AsciiClass>},
+    {nullptr, RunAvx2<WhitespaceClass>, RunAvx2<IdentifierClass>, RunAvx2<DigitClass>, RunAvx2<StringBodyClass>, RunAvx2<LineBodyClass>, RunAvx2<AsciiClass>},
+};
+#else
+const RunFunction Kernels[1][7] = {
+    {nullptr, RunScalar<WhitespaceClass>, RunScalar<IdentifierClass>, RunScalar<DigitClass>, RunScalar<StringBodyClass>, RunScalar<LineBodyClass>, RunScalar<AsciiClass>},
+};
+#endif
+
+// asks CPUID for the best level this machine supports
+ScanLevel DetectScanLevel() {
+#ifdef ILYS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ScanLevel::SSE2;
+    }
+#endif
+    return ScanLevel::SCALAR;
+}
+
+const ScanLevel SupportedLevel = DetectScanLevel();
+ScanLevel ActiveLevel = SupportedLevel;
+
+}
+
+size_t ScanRun(ScanKernel kernel, const char* data, size_t position, size_t size) {
+    return Kernels[static_cast<int>(ActiveLevel)][static_cast<int>(kernel)](data, position, size);
+}
+
+ScanLevel GetScanLevel() {
+    return ActiveLevel;
+}
+
+void SetScanLevel(ScanLevel level) {
+    ActiveLevel = static_cast<int>(level) < static_cast<int>(SupportedLevel) ? level : SupportedLevel;
+}
+
+const char* GetScanLevelName(ScanLevel level) {
+    switch (level) {
+        case ScanLevel::SCALAR: return "scalar";
+        case ScanLevel::SSE2: return "sse2";
+        case ScanLevel::AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+// the character classes we have vectorized run-skipping kernels for
+enum class ScanKernel {
+    NONE,
+    WHITESPACE,  // [ \t\n\r]
+    IDENTIFIER,  // [A-Za-z0-9_\x80-\xff] (every byte of a UTF-8 sequence, see the identifier rule in lexer.cpp)
+    DIGITS,      // [0-9]
+    STRING_BODY, // anything but '"' and '\\'
+    LINE_BODY,   // anything but '\n' (finds line ends, see LineTable)
+    ASCII        // [\x00-\x7f] (skips what ValidateUtf8 doesn't have to decode)
+};
+
+// which instruction set the kernels run with, picked once from CPUID
+enum class ScanLevel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// returns the index of the first byte at or after position (and before size) that is NOT in the kernel's class,
+// or size if the whole rest of the data is in the class
+size_t ScanRun(ScanKernel kernel, const char* data, size_t position, size_t size);
+
+// the level the kernels were chosen for on this machine
+ScanLevel GetScanLevel();
+
+// forces a lower level (ex: SCALAR to compare against the vectorized kernels), never goes above what the CPU supports
+void SetScanLevel(ScanLevel level);
+
+const char* GetScanLevelName(ScanLevel level);
+
+#endif
\ No newline at end of file
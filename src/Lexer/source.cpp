@@ -0,0 +1,128 @@
+#include "source.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// creating a default constructor for an empty buffer
+SourceBuffer::SourceBuffer() {
+    Mapped = nullptr;
+    MappedSize = 0;
+}
+
+// unmapping the file if the buffer was mapped
+SourceBuffer::~SourceBuffer() {
+    if (Mapped != nullptr) {
+        munmap(const_cast<char*>(Mapped), MappedSize);
+    }
+}
+
+// creating a buffer that takes ownership of the given text
+std::shared_ptr<const SourceBuffer> SourceBuffer::FromString(std::string text) {
+    auto buffer = std::make_shared<SourceBuffer>();
+    buffer->Text = std::move(text);
+    return buffer;
+}
+
+// loading a file, mapped when it is a regular file and read in chunks otherwise
+std::shared_ptr<const SourceBuffer> SourceBuffer::FromFile(const std::string& path, std::string* error) {
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        *error = path + ": " + std::strerror(errno);
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+        // pipes, sockets and terminals don't have a size we can map
+        std::shared_ptr<const SourceBuffer> buffer = FromDescriptor(descriptor, error);
+        close(descriptor);
+        return buffer;
+    }
+
+    if (static_cast<uint64_t>(info.st_size) > MaxSize) {
+        *error = path + ": file is larger than 2 GB, the most the lexer can take";
+        close(descriptor);
+        return nullptr;
+    }
+
+    auto buffer = std::make_shared<SourceBuffer>();
+    if (info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            *error = path + ": " + std::strerror(errno);
+            close(descriptor);
+            return nullptr;
+        }
+        // the lexer reads front to back, let the kernel read ahead
+        madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+        buffer->Mapped = static_cast<const char*>(mapping);
+        buffer->MappedSize = info.st_size;
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(descriptor);
+    return buffer;
+}
+
+// reading a descriptor to its end, the chunks are only joined once at the end so the input is never held
+// more than twice (a growing string would hold the old and the new copy on every reallocation)
+std::shared_ptr<const SourceBuffer> SourceBuffer::FromDescriptor(int descriptor, std::string* error) {
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t total = 0;
+    size_t lastSize = ChunkSize;
+
+    while (true) {
+        if (lastSize == ChunkSize) {
+            chunks.push_back(std::make_unique<char[]>(ChunkSize));
+            lastSize = 0;
+        }
+        ssize_t count = read(descriptor, chunks.back().get() + lastSize, ChunkSize - lastSize);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *error = std::string("read failed: ") + std::strerror(errno);
+            return nullptr;
+        }
+        if (count == 0) {
+            break;
+        }
+        lastSize += count;
+        total += count;
+        if (total > MaxSize) {
+            *error = "input is larger than 2 GB, the most the lexer can take";
+            return nullptr;
+        }
+    }
+
+    auto buffer = std::make_shared<SourceBuffer>();
+    buffer->Text.resize(total);
+    size_t offset = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        size_t size = i + 1 == chunks.size() ? lastSize : ChunkSize;
+        std::memcpy(&buffer->Text[offset], chunks[i].get(), size);
+        offset += size;
+        // freeing each chunk as soon as it is copied keeps the peak close to the input size
+        chunks[i].reset();
+    }
+    return buffer;
+}
+
+// getter for a view over the whole text
+std::string_view SourceBuffer::View() const {
+    if (Mapped != nullptr) {
+        return std::string_view(Mapped, MappedSize);
+    }
+    return Text;
+}
+
+// getter for whether the text is a file mapping
+bool SourceBuffer::IsMapped() const {
+    return Mapped != nullptr;
+}
\ No newline at end of file
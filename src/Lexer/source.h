@@ -0,0 +1,46 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// the bytes of one source file, tokens only store offsets into it so it has to outlive them
+// (it is always handed around as a shared_ptr for that reason)
+class SourceBuffer {
+    public:
+        SourceBuffer();
+        ~SourceBuffer();
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+        // creating a buffer that takes ownership of the given text (moved, not copied)
+        static std::shared_ptr<const SourceBuffer> FromString(std::string text);
+
+        // loads a file: regular files are mapped read-only (no copy at all), anything else (pipes, terminals)
+        // goes through FromDescriptor, returns nullptr and fills error if the file can't be read
+        static std::shared_ptr<const SourceBuffer> FromFile(const std::string& path, std::string* error);
+
+        // reads everything from an already open descriptor in fixed size chunks (ex: 0 for stdin)
+        static std::shared_ptr<const SourceBuffer> FromDescriptor(int descriptor, std::string* error);
+
+        // read-only view over the whole source
+        std::string_view View() const;
+
+        // true if the bytes are a memory mapping of the file rather than a heap copy
+        bool IsMapped() const;
+
+        // size of one read() when the input can't be mapped
+        static constexpr size_t ChunkSize = 1 << 20;
+
+        // the largest input FromFile and FromDescriptor take: the lexer's positions and match lengths are ints
+        static constexpr size_t MaxSize = INT32_MAX;
+
+    private:
+        std::string Text;
+        const char* Mapped;
+        size_t MappedSize;
+};
+
+#endif
\ No newline at end of file
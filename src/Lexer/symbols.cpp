@@ -0,0 +1,105 @@
+#include "symbols.h"
+
+// creating an empty table, every shard starts with a small hash table
+SymbolTable::SymbolTable() {
+    for (Shard& shard : Shards) {
+        shard.Slots = std::vector<uint32_t>(64, 0);
+    }
+}
+
+// doubles the hash table of a shard and puts every symbol back in
+void SymbolTable::Grow(Shard& shard) {
+    std::vector<uint32_t> slots(shard.Slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (size_t index = 0; index < shard.Names.size(); index++) {
+        size_t slot = shard.Hashes[index] & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = static_cast<uint32_t>(index + 1);
+    }
+    shard.Slots = std::move(slots);
+}
+
+uint32_t SymbolTable::Intern(std::string_view text, uint64_t hash, std::string_view* name) {
+    size_t shardIndex = hash >> (64 - ShardBits);
+    Shard& shard = Shards[shardIndex];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+
+    // linear probing, the stored hash is compared first so most mismatches never touch the text
+    size_t mask = shard.Slots.size() - 1;
+    size_t slot = hash & mask;
+    while (shard.Slots[slot] != 0) {
+        size_t index = shard.Slots[slot] - 1;
+        if (shard.Hashes[index] == hash && shard.Names[index] == text) {
+            if (name != nullptr) {
+                *name = shard.Names[index];
+            }
+            return static_cast<uint32_t>(((index + 1) << ShardBits) | shardIndex);
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    size_t index = shard.Names.size();
+    shard.Names.push_back(shard.Bytes.CopyString(text));
+    shard.Hashes.push_back(hash);
+    shard.Slots[slot] = static_cast<uint32_t>(index + 1);
+    // keeping the table at most half full
+    if (shard.Names.size() * 2 > shard.Slots.size()) {
+        Grow(shard);
+    }
+
+    if (name != nullptr) {
+        *name = shard.Names[index];
+    }
+    return static_cast<uint32_t>(((index + 1) << ShardBits) | shardIndex);
+}
+
+uint32_t SymbolTable::Intern(std::string_view text) {
+    return Intern(text, HashBytes(text));
+}
+
+std::string_view SymbolTable::Name(uint32_t symbol) const {
+    if (symbol == NoSymbol) {
+        return std::string_view();
+    }
+    const Shard& shard = Shards[symbol & (ShardCount - 1)];
+    size_t index = (symbol >> ShardBits) - 1;
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    return index < shard.Names.size() ? shard.Names[index] : std::string_view();
+}
+
+size_t SymbolTable::GetSymbolCount() const {
+    size_t count = 0;
+    for (const Shard& shard : Shards) {
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        count += shard.Names.size();
+    }
+    return count;
+}
+
+size_t SymbolTable::GetBytesUsed() const {
+    size_t bytes = 0;
+    for (const Shard& shard : Shards) {
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        bytes += shard.Bytes.GetBytesUsed();
+    }
+    return bytes;
+}
+
+uint32_t SymbolCache::Intern(SymbolTable& table, std::string_view text) {
+    uint64_t hash = HashBytes(text);
+    Entry& entry = Entries[hash & (EntryCount - 1)];
+    // the stored name lives in the table's arena and never changes, so reading it needs no lock
+    if (entry.Symbol != SymbolTable::NoSymbol && entry.Hash == hash && entry.Name == text) {
+        return entry.Symbol;
+    }
+    entry.Symbol = table.Intern(text, hash, &entry.Name);
+    entry.Hash = hash;
+    return entry.Symbol;
+}
+
+// forgets every entry (needed whenever the lexer switches to another table)
+void SymbolCache::Clear() {
+    Entries.fill(Entry());
+}
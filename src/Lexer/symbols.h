@@ -0,0 +1,74 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include "../Support/arena.h"
+#include "../Support/hash.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// interning table for one compilation: every distinct identifier (or string literal) is stored once, in an arena,
+// and tokens carry its 32-bit id, so comparing two names is comparing two integers.
+// it is split in shards that each have their own lock, hash table and arena (the top bits of the hash pick the
+// shard), so lexers running on different threads rarely wait for each other
+class SymbolTable {
+    public:
+        // the id of tokens that have no symbol (operators, keywords, ...)
+        static constexpr uint32_t NoSymbol = 0;
+
+        SymbolTable();
+        SymbolTable(const SymbolTable&) = delete;
+        SymbolTable& operator=(const SymbolTable&) = delete;
+
+        // returns the id of text, adding it if it's new (thread safe), hash must be HashBytes(text) and name
+        // (if given) is set to the stored copy of the text
+        uint32_t Intern(std::string_view text, uint64_t hash, std::string_view* name = nullptr);
+        uint32_t Intern(std::string_view text);
+
+        // returns the text of a symbol (thread safe, the view stays valid as long as the table)
+        std::string_view Name(uint32_t symbol) const;
+
+        // number of distinct symbols, and bytes their text takes in the arenas
+        size_t GetSymbolCount() const;
+        size_t GetBytesUsed() const;
+
+        static constexpr int ShardBits = 4;
+        static constexpr size_t ShardCount = size_t(1) << ShardBits;
+
+    private:
+        // one cache line per shard header so two threads locking neighbouring shards don't share a line
+        struct alignas(64) Shard {
+            mutable std::mutex Mutex;
+            Arena Bytes;
+            std::vector<std::string_view> Names;  // index in the shard -> text
+            std::vector<uint64_t> Hashes;         // index in the shard -> hash of the text
+            std::vector<uint32_t> Slots;          // open addressing, index + 1 (0 is an empty slot)
+        };
+
+        Shard Shards[ShardCount];
+
+        static void Grow(Shard& shard);
+};
+
+// small direct-mapped cache in front of a SymbolTable, owned by one lexer (not thread safe): names that come
+// back often are found without taking the shard lock
+class SymbolCache {
+    public:
+        uint32_t Intern(SymbolTable& table, std::string_view text);
+        void Clear();
+
+    private:
+        struct Entry {
+            uint64_t Hash = 0;
+            uint32_t Symbol = SymbolTable::NoSymbol;
+            std::string_view Name;
+        };
+
+        static constexpr size_t EntryCount = 256;
+        std::array<Entry, EntryCount> Entries;
+};
+
+#endif
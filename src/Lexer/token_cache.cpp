@@ -0,0 +1,309 @@
+#include "token_cache.h"
+#include "utf8.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the fixed start of a cache file (native byte order, a file from another kind of machine fails the magic)
+struct CacheHeader {
+    char Magic[8];
+    uint32_t FormatVersion;
+    uint32_t TokenSize;
+    uint64_t RulesVersion;
+    Hash128 SourceHash;
+    uint64_t SourceSize;
+    uint64_t TokenCount;
+    uint64_t UnmatchedCount;
+    uint64_t NameCount;
+};
+
+// a token as it is saved, Name is an index in the names + 1 (0 for tokens without a symbol).
+// the tokens are trusted on a match of the source's size and its 128 bit hash, the source itself isn't compared
+// (that would cost what lexing it does). two different sources of the same size and rules only get each other's
+// tokens if their hashes collide, by chance that takes a directory of around 2^64 entries to become likely, but
+// HashBytes128 isn't cryptographic so a source crafted to collide with one already in a shared cache directory
+// would be given its tokens (still inside its own bounds, every offset is checked against the source on load)
+struct CachedToken {
+    uint32_t Offset;
+    uint32_t Length;
+    uint32_t Name;
+    uint8_t Type;
+    uint8_t Padding[3];
+};
+
+// a name is its first occurrence in the source
+struct CachedName {
+    uint32_t Offset;
+    uint32_t Length;
+};
+
+static constexpr char CacheMagic[8] = {'I', 'L', 'Y', 'S', 'T', 'O', 'K', 1};
+
+static_assert(sizeof(CacheHeader) == 72, "cache files are read with a fixed header size");
+static_assert(sizeof(CacheHeader) % alignof(CachedToken) == 0, "the arrays after the header are meant to stay aligned");
+static_assert(sizeof(CachedToken) == 16, "cache files are read with a fixed token size");
+
+// writes the whole range, retrying short writes
+static bool writeAll(int descriptor, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t count = write(descriptor, bytes, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// creating a cache over a directory, the counters start at zero
+TokenCache::TokenCache(std::string directory)
+    : Directory(std::move(directory)), RulesVersion(RuleSet::GetDefault()->GetVersion()), Hits(0), Misses(0), Stores(0), Temporaries(0) {
+}
+
+std::unique_ptr<TokenCache> TokenCache::Open(const std::string& directory, std::string* error) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        *error = directory + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        *error = directory + ": not a directory";
+        return nullptr;
+    }
+    return std::unique_ptr<TokenCache>(new TokenCache(directory));
+}
+
+// the entry of a source whose hash is known (hashing a large file once is enough for both the name and the header)
+static std::string entryPath(const std::string& directory, Hash128 hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string name(32, '0');
+    for (int i = 15; i >= 0; i--) {
+        name[i] = digits[hash.High & 15];
+        name[i + 16] = digits[hash.Low & 15];
+        hash.High >>= 4;
+        hash.Low >>= 4;
+    }
+    return directory + "/" + name + ".tokens";
+}
+
+std::string TokenCache::GetPath(std::string_view source) const {
+    return entryPath(Directory, HashBytes128(source, RulesVersion));
+}
+
+bool TokenCache::Load(const std::shared_ptr<const SourceBuffer>& source, const std::shared_ptr<SymbolTable>& symbols, TokenStream& stream) {
+    std::string_view text = source->View();
+    Hash128 hash = HashBytes128(text, RulesVersion);
+    int descriptor = open(entryPath(Directory, hash).c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        Misses++;
+        return false;
+    }
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CacheHeader)) {
+        close(descriptor);
+        Misses++;
+        return false;
+    }
+    size_t size = info.st_size;
+    // the whole file is read once, front to back, so it is faulted in up front rather than page by page
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+        Misses++;
+        return false;
+    }
+
+    // anything that doesn't add up (another rule set, a hash collision, a damaged file) is a miss
+    const char* bytes = static_cast<const char*>(mapping);
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    bool valid = std::memcmp(header.Magic, CacheMagic, sizeof(CacheMagic)) == 0 && header.FormatVersion == FormatVersion
+        && header.TokenSize == sizeof(CachedToken) && header.RulesVersion == RulesVersion && header.SourceSize == text.size()
+        && header.SourceHash == hash && header.TokenCount <= size && header.UnmatchedCount <= size
+        && header.NameCount <= size
+        && sizeof(CacheHeader) + header.TokenCount * sizeof(CachedToken) + header.UnmatchedCount * sizeof(uint32_t)
+            + header.NameCount * sizeof(CachedName) == size;
+
+    std::vector<uint32_t> ids;
+    if (valid) {
+        const CachedName* names = reinterpret_cast<const CachedName*>(bytes + size - header.NameCount * sizeof(CachedName));
+        ids.reserve(header.NameCount + 1);
+        ids.push_back(SymbolTable::NoSymbol);
+        stream.MayHaveErrors = false;
+        for (size_t i = 0; i < header.NameCount && valid; i++) {
+            valid = names[i].Offset <= text.size() && names[i].Length <= text.size() - names[i].Offset;
+            if (valid) {
+                // a byte that isn't ASCII is always in a name or a string, so checking each distinct one once
+                // gives the flag the lexer would have set
+                std::string_view name = text.substr(names[i].Offset, names[i].Length);
+                stream.MayHaveErrors = stream.MayHaveErrors || !IsAscii(name);
+                ids.push_back(symbols->Intern(name));
+            }
+        }
+    }
+    if (valid) {
+        const CachedToken* tokens = reinterpret_cast<const CachedToken*>(bytes + sizeof(CacheHeader));
+        // refilled rather than reallocated, a stream reused across files keeps its capacity
+        stream.Tokens.clear();
+        stream.Tokens.reserve(header.TokenCount);
+        stream.Numbers.clear();
+        for (size_t i = 0; i < header.TokenCount && valid; i++) {
+            const CachedToken& token = tokens[i];
+            valid = token.Offset <= text.size() && token.Length <= text.size() - token.Offset && token.Type < TokenTypeCount
+                && token.Name < ids.size();
+            if (!valid) {
+                break;
+            }
+            // numbers aren't stored, decoding one again costs about what reading it back would
+            uint32_t symbol = ids[token.Name];
+            NumberValue value;
+            if (token.Type == static_cast<uint8_t>(TokenType::NUMBER)) {
+                symbol = 0;
+                if (DecodeNumber(text.substr(token.Offset, token.Length), &value)) {
+                    stream.Numbers.push_back(value);
+                    symbol = static_cast<uint32_t>(stream.Numbers.size());
+                }
+                else {
+                    stream.MayHaveErrors = true;
+                }
+            }
+            stream.Tokens.push_back(Token::ConstructToken(static_cast<TokenType>(token.Type), token.Offset, token.Length, symbol));
+        }
+    }
+    if (valid) {
+        // the diagnostics read the source at these, so they have to be in it and in order like a lexer's
+        const char* unmatched = bytes + sizeof(CacheHeader) + header.TokenCount * sizeof(CachedToken);
+        stream.Unmatched.resize(header.UnmatchedCount);
+        if (header.UnmatchedCount > 0) {
+            std::memcpy(stream.Unmatched.data(), unmatched, header.UnmatchedCount * sizeof(uint32_t));
+        }
+        for (size_t i = 0; i < stream.Unmatched.size() && valid; i++) {
+            valid = stream.Unmatched[i] < text.size() && (i == 0 || stream.Unmatched[i - 1] < stream.Unmatched[i]);
+        }
+    }
+    munmap(mapping, size);
+
+    if (!valid) {
+        stream.Tokens.clear();
+        stream.Unmatched.clear();
+        stream.Numbers.clear();
+        stream.MayHaveErrors = false;
+        Misses++;
+        return false;
+    }
+    stream.Source = source;
+    stream.Symbols = symbols;
+    Hits++;
+    return true;
+}
+
+bool TokenCache::Store(const TokenStream& stream, std::string* error) {
+    std::string_view text = stream.GetSource();
+
+    // one name per distinct symbol, in the order they first appear (the symbol of a number is an index into the
+    // stream's Numbers, not a name, the loader decodes the number again)
+    std::unordered_map<uint32_t, uint32_t> names;
+    std::vector<CachedName> nameList;
+    std::vector<CachedToken> tokens(stream.Tokens.size());
+    for (size_t i = 0; i < stream.Tokens.size(); i++) {
+        const Token& token = stream.Tokens[i];
+        CachedToken& cached = tokens[i];
+        std::memset(&cached, 0, sizeof(cached));
+        cached.Offset = token.offset;
+        cached.Length = token.length;
+        cached.Type = static_cast<uint8_t>(token.type);
+        if (token.symbol != SymbolTable::NoSymbol && token.type != TokenType::NUMBER) {
+            auto name = names.emplace(token.symbol, static_cast<uint32_t>(nameList.size() + 1)).first;
+            if (name->second == nameList.size() + 1) {
+                nameList.push_back(CachedName{token.offset, token.length});
+            }
+            cached.Name = name->second;
+        }
+    }
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, CacheMagic, sizeof(CacheMagic));
+    header.FormatVersion = FormatVersion;
+    header.TokenSize = sizeof(CachedToken);
+    header.RulesVersion = RulesVersion;
+    header.SourceHash = HashBytes128(text, RulesVersion);
+    header.SourceSize = text.size();
+    header.TokenCount = tokens.size();
+    header.UnmatchedCount = stream.Unmatched.size();
+    header.NameCount = nameList.size();
+
+    std::string path = entryPath(Directory, header.SourceHash);
+    std::string temporary = path + "." + std::to_string(getpid()) + "." + std::to_string(Temporaries++) + ".tmp";
+    int descriptor = open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (descriptor < 0) {
+        *error = temporary + ": " + std::strerror(errno);
+        return false;
+    }
+    bool written = writeAll(descriptor, &header, sizeof(header)) && writeAll(descriptor, tokens.data(), tokens.size() * sizeof(CachedToken))
+        && writeAll(descriptor, stream.Unmatched.data(), stream.Unmatched.size() * sizeof(uint32_t))
+        && writeAll(descriptor, nameList.data(), nameList.size() * sizeof(CachedName));
+    if (!written) {
+        *error = temporary + ": " + std::strerror(errno);
+    }
+    if (close(descriptor) != 0 && written) {
+        *error = temporary + ": " + std::strerror(errno);
+        written = false;
+    }
+    // rename replaces the entry in one step, a reader has either the old file or the new one
+    if (written && rename(temporary.c_str(), path.c_str()) != 0) {
+        *error = path + ": " + std::strerror(errno);
+        written = false;
+    }
+    if (!written) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    Stores++;
+    return true;
+}
+
+TokenStream TokenCache::Tokenize(std::shared_ptr<const SourceBuffer> source, std::string* error) {
+    return Tokenize(std::move(source), std::make_shared<SymbolTable>(), error);
+}
+
+TokenStream TokenCache::Tokenize(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols, std::string* error) {
+    TokenStream stream;
+    if (Load(source, symbols, stream)) {
+        return stream;
+    }
+    stream = ::Tokenize(std::move(source), std::move(symbols));
+    Store(stream, error);
+    return stream;
+}
+
+// getter for the directory field
+const std::string& TokenCache::GetDirectory() const {
+    return Directory;
+}
+
+// getter for the hits counter
+size_t TokenCache::GetHits() const {
+    return Hits.load();
+}
+
+// getter for the misses counter
+size_t TokenCache::GetMisses() const {
+    return Misses.load();
+}
+
+// getter for the stores counter
+size_t TokenCache::GetStores() const {
+    return Stores.load();
+}
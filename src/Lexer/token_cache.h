@@ -0,0 +1,55 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include "lexer.h"
+
+#include <atomic>
+
+// on-disk cache of token streams, shared by every process pointed at the same directory.
+// a file is named after HashBytes128 of the source seeded with the rule set's version, so an edited source or a
+// changed lexer simply misses (stale files are never read, they can be deleted at any time).
+// the file is the raw arrays of the stream behind a fixed header, it is mapped and copied out in one pass:
+//   CacheHeader | CachedToken[TokenCount] | uint32_t Unmatched[UnmatchedCount] | CachedName[NameCount]
+// symbol ids only mean something in the table that gave them, so tokens store an index into the names instead
+// (a name is the offset and length of its first occurrence in the source) and are interned again on load
+class TokenCache {
+    public:
+        // uses directory as the cache (created if missing), returns nullptr and fills error if it can't be
+        static std::unique_ptr<TokenCache> Open(const std::string& directory, std::string* error);
+
+        // fills stream with the cached tokens of source (interned into symbols) and returns true, or returns
+        // false if there is no valid entry for it
+        bool Load(const std::shared_ptr<const SourceBuffer>& source, const std::shared_ptr<SymbolTable>& symbols, TokenStream& stream);
+
+        // saves stream, written to a temporary file first and renamed over the entry so readers (even in other
+        // processes) never see half a file, returns false and fills error if it can't be written
+        bool Store(const TokenStream& stream, std::string* error);
+
+        // Load, or Tokenize then Store on a miss (a failed store fills error, the tokens are still returned)
+        TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source, std::string* error);
+        TokenStream Tokenize(std::shared_ptr<const SourceBuffer> source, std::shared_ptr<SymbolTable> symbols, std::string* error);
+
+        // path of the entry for a source
+        std::string GetPath(std::string_view source) const;
+
+        const std::string& GetDirectory() const;
+        size_t GetHits() const;
+        size_t GetMisses() const;
+        size_t GetStores() const;
+
+        // bump this whenever the layout of a cache file changes
+        static constexpr uint32_t FormatVersion = 2;
+
+    private:
+        explicit TokenCache(std::string directory);
+
+        std::string Directory;
+        uint64_t RulesVersion;
+        std::atomic<size_t> Hits;
+        std::atomic<size_t> Misses;
+        std::atomic<size_t> Stores;
+        // makes the temporary names of concurrent stores from one process unique (the pid covers other processes)
+        std::atomic<size_t> Temporaries;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef TOKEN_SPEC_H
+#define TOKEN_SPEC_H
+
+// the one list of every token of the language, everything else about tokens is generated from it:
+// the TokenType enum and the name table (tokens.h), the operator rules and dispatch tables (operators.h)
+// and the keyword table (keywords.h)
+//
+//   TOKEN(type, name)           a token with a hand written rule in ConstructLexer (or no rule at all)
+//   OPERATOR(type, name, text)  an operator or a punctuation mark, matched exactly as spelled
+//   KEYWORD(type, name, text)   a reserved word, matched by the identifier rule and looked up in keywords.h
+//
+// to add a token, add one line here (operators and keywords need nothing else)
+#define ILYS_TOKEN_SPEC(TOKEN, OPERATOR, KEYWORD) \
+    TOKEN(E0F_TOKEN, "EOF") \
+    TOKEN(WHITESPACE, "WHITESPACE") \
+    \
+    OPERATOR(OPENBRACKET, "OPEN BRACKET", "[") \
+    OPERATOR(CLOSEBRACKET, "CLOSE BRACKET", "]") \
+    OPERATOR(OPENCURLYBRACKET, "OPEN CURLY BRACKET", "{") \
+    OPERATOR(CLOSECURLYBRACKET, "CLOSE CURLY BRACKET", "}") \
+    OPERATOR(OPENPARENTHESIS, "OPEN PARENTHESIS", "(") \
+    OPERATOR(CLOSEPARENTHESIS, "CLOSE PARENTHESIS", ")") \
+    \
+    OPERATOR(DOT, "DOT", ".") \
+    /* ex: for 0..3 loop (0,1,2,3) */ \
+    OPERATOR(DOTDOT, "DOT DOT", "..") \
+    \
+    TOKEN(NUMBER, "NUMBER") \
+    TOKEN(STRING, "STRING") \
+    TOKEN(IDENTIFIER, "IDENTIFIER") \
+    \
+    OPERATOR(ASSIGNMENT, "ASSIGNMENT", "=") \
+    OPERATOR(EQUALS, "EQUALS", "==") \
+    OPERATOR(NOT, "NOT", "!") \
+    OPERATOR(NOTEQUALS, "NOT EQUALS", "!=") \
+    \
+    OPERATOR(AND, "AND", "&&") \
+    OPERATOR(OR, "OR", "||") \
+    OPERATOR(COLON, "COLON", ":") \
+    OPERATOR(SEMICOLON, "SEMICOLON", ";") \
+    OPERATOR(COMMA, "COMMA", ",") \
+    OPERATOR(QUESTIONMARK, "QUESTION MARK", "?") \
+    \
+    OPERATOR(LESSTHAN, "LESS THAN", "<") \
+    OPERATOR(LESSTHANEQUALS, "LESS THAN OR EQUAL TO", "<=") \
+    OPERATOR(GREATERTHAN, "GREATER THAN", ">") \
+    OPERATOR(GREATERTHANEQUALS, "GREATER THAN OR EQUAL TO", ">=") \
+    \
+    /* incrementation / decrementation */ \
+    OPERATOR(PLUSPLUS, "PLUS PLUS", "++") \
+    OPERATOR(PLUSEQUALS, "PLUS EQUALS", "+=") \
+    OPERATOR(MINUSMINUS, "MINUS MINUS", "--") \
+    OPERATOR(MINUSEQUALS, "MINUS EQUALS", "-=") \
+    OPERATOR(MULTIPLYEQUALS, "MULTIPLY EQUALS", "*=") \
+    OPERATOR(DIVIDEEQUALS, "DIVIDE EQUALS", "/=") \
+    OPERATOR(MODEQUALS, "MOD EQUALS", "%=") \
+    \
+    /* operators */ \
+    OPERATOR(PLUS, "PLUS", "+") \
+    OPERATOR(MINUS, "MINUS", "-") \
+    OPERATOR(MULTIPLY, "MULTIPLY", "*") \
+    OPERATOR(DIVIDE, "DIVIDE", "/") \
+    OPERATOR(MODULO, "MODULO", "%") \
+    \
+    /* bool */ \
+    KEYWORD(TRUE_TOKEN, "TRUE", "true") \
+    KEYWORD(FALSE_TOKEN, "FALSE", "false") \
+    \
+    /* kw */ \
+    KEYWORD(IF, "IF", "if") \
+    KEYWORD(ELSE, "ELSE", "else") \
+    KEYWORD(FROM, "FROM", "from") \
+    /* declare functions */ \
+    KEYWORD(FUNC, "FUNC", "func") \
+    KEYWORD(RETURN, "RETURN", "return") \
+    KEYWORD(LET, "LET", "let") \
+    KEYWORD(CONST, "CONST", "const") \
+    KEYWORD(TYPEOF, "TYPEOF", "typeof") \
+    KEYWORD(NEW, "NEW", "new") \
+    KEYWORD(IMPORT, "IMPORT", "import") \
+    KEYWORD(EXPORT, "EXPORT", "export") \
+    KEYWORD(CLASS, "CLASS", "class") \
+    /* for each loop */ \
+    KEYWORD(FOREVERY, "FOR EACH", "forevery") \
+    KEYWORD(FOR, "FOR", "for") \
+    KEYWORD(WHILE, "WHILE", "while") \
+    KEYWORD(IN, "IN", "in")
+
+// helpers to pick columns out of the spec (an entry that doesn't apply expands to nothing)
+#define ILYS_TOKEN_IGNORE(...)
+
+#endif
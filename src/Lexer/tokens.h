@@ -14,167 +14,75 @@
 #include <algorithm>
 #include <cctype>
 #include <iterator>
+#include <cstdint>
+#include <string_view>
+
+#include "source.h"
+#include "token_spec.h"
+#include "symbols.h"
+#include "numbers.h"
+
+// every token type, in the order of the spec (see token_spec.h)
+enum class TokenType : uint8_t {
+#define ILYS_TOKEN_ENUM(type, ...) type,
+    ILYS_TOKEN_SPEC(ILYS_TOKEN_ENUM, ILYS_TOKEN_ENUM, ILYS_TOKEN_ENUM)
+#undef ILYS_TOKEN_ENUM
+};
 
-enum class TokenType {
-    E0F_TOKEN,
-
-    WHITESPACE,
-    
-    OPENBRACKET,
-    CLOSEBRACKET,
-
-    OPENCURLYBRACKET,
-    CLOSECURLYBRACKET,
-
-    OPENPARENTHESIS,
-    CLOSEPARENTHESIS,
-
-    DOT,
-    DOTDOT, // ex: for 0..3 loop (0,1,2,3)
-
-    NUMBER,
-    STRING,
-
-    IDENTIFIER,
-
-    ASSIGNMENT, // =
-    EQUALS, // ==
-    NOT, // !
-    NOTEQUALS, // !=
-
-    AND,
-    OR,
-    COLON,
-    SEMICOLON,
-    COMMA,
-    QUESTIONMARK,
-    
-    LESSTHAN,
-    LESSTHANEQUALS,
-    GREATERTHAN,
-    GREATERTHANEQUALS,
-
-    //incrementation / decrementation
-    PLUSPLUS,
-    PLUSEQUALS,
-    MINUSMINUS,
-    MINUSEQUALS,
-    MULTIPLYEQUALS,
-    DIVIDEEQUALS,
-    MODEQUALS,
-
-    //operators
-    PLUS,
-    MINUS,
-    MULTIPLY,
-    DIVIDE,
-    MODULO,
-
-    //bool
-    TRUE_TOKEN,
-    FALSE_TOKEN,
-
-    //kw
-    IF,
-    ELSE,
-    FROM,
-    FUNC, // declare functions
-    LET,
-    CONST,
-    TYPEOF,
-    NEW,
-    IMPORT,
-    EXPORT,
-    CLASS,
-    FOREVERY, // for each loop
-    FOR,
-    WHILE,
-    IN
+// printable name of every token type, indexed by the type
+inline constexpr std::string_view TokenNames[] = {
+#define ILYS_TOKEN_NAME(type, name, ...) name,
+    ILYS_TOKEN_SPEC(ILYS_TOKEN_NAME, ILYS_TOKEN_NAME, ILYS_TOKEN_NAME)
+#undef ILYS_TOKEN_NAME
 };
 
+constexpr size_t TokenTypeCount = sizeof(TokenNames) / sizeof(TokenNames[0]);
+
+// a token is only a span of the source (offset + length), the text itself stays in the SourceBuffer
 class Token {
     public:
+        uint32_t offset;
+        uint32_t length;
+        // id in the stream's SymbolTable for identifiers and strings, 1 + the index of the value in the stream's
+        // Numbers for numbers (0 for a number too large for its type), SymbolTable::NoSymbol for anything else
+        uint32_t symbol;
         TokenType type;
-        std::string value;
-
-        static std::string GetType(TokenType type) {
-            switch (type) {
-                case TokenType::E0F_TOKEN: return "EOF";
-                case TokenType::OPENBRACKET: return "OPEN BRACKET";
-                case TokenType::CLOSEBRACKET: return "CLOSE BRACKET";
-                case TokenType::OPENCURLYBRACKET: return "OPEN CURLY BRACKET";
-                case TokenType::CLOSECURLYBRACKET: return "CLOSE CURLY BRACKET";
-                case TokenType::OPENPARENTHESIS: return "OPEN PARENTHESIS";
-                case TokenType::CLOSEPARENTHESIS: return "CLOSE PARENTHESIS";
-                case TokenType::DOT: return "DOT";
-                case TokenType::DOTDOT: return "DOT DOT";
-                case TokenType::NUMBER: return "NUMBER";
-                case TokenType::STRING: return "STRING";
-                case TokenType::IDENTIFIER: return "IDENTIFIER";
-                case TokenType::ASSIGNMENT: return "ASSIGNMENT";
-                case TokenType::EQUALS: return "EQUALS";
-                case TokenType::NOT: return "NOT";
-                case TokenType::NOTEQUALS: return "NOT EQUALS";
-                case TokenType::AND: return "AND";
-                case TokenType::OR: return "OR";
-                case TokenType::COLON: return "COLON";
-                case TokenType::SEMICOLON: return "SEMICOLON";
-                case TokenType::COMMA: return "COMMA";
-                case TokenType::QUESTIONMARK: return "QUESTION MARK";
-                case TokenType::LESSTHAN: return "LESS THAN";
-                case TokenType::LESSTHANEQUALS: return "LESS THAN OR EQUAL TO";
-                case TokenType::GREATERTHAN: return "GREATER THAN";
-                case TokenType::GREATERTHANEQUALS: return "GREATER THAN OR EQUAL TO";
-                case TokenType::PLUSPLUS: return "PLUS PLUS";
-                case TokenType::PLUSEQUALS: return "PLUS EQUALS";
-                case TokenType::MINUSMINUS: return "MINUS MINUS";
-                case TokenType::MINUSEQUALS: return "MINUS EQUALS";
-                case TokenType::MULTIPLYEQUALS: return "MULTIPLY EQUALS";
-                case TokenType::DIVIDEEQUALS: return "DIVIDE EQUALS";
-                case TokenType::MODEQUALS: return "MOD EQUALS";
-                case TokenType::PLUS: return "PLUS";
-                case TokenType::MINUS: return "MINUS";
-                case TokenType::MULTIPLY: return "MULTIPLY";
-                case TokenType::DIVIDE: return "DIVIDE";
-                case TokenType::MODULO: return "MODULO";
-                case TokenType::IF: return "IF";
-                case TokenType::ELSE: return "ELSE";
-                case TokenType::FROM: return "FROM";
-                case TokenType::FUNC: return "FUNC";
-                case TokenType::LET: return "LET";
-                case TokenType::CONST: return "CONST";
-                case TokenType::TYPEOF: return "TYPEOF";
-                case TokenType::NEW: return "NEW";
-                case TokenType::IMPORT: return "IMPORT";
-                case TokenType::EXPORT: return "EXPORT";
-                case TokenType::CLASS: return "CLASS";
-                case TokenType::FOREVERY: return "FOR EACH";
-                case TokenType::FOR: return "FOR";
-                case TokenType::WHILE: return "WHILE";
-                case TokenType::IN: return "IN";
-                case TokenType::TRUE_TOKEN: return "TRUE";
-                case TokenType::FALSE_TOKEN: return "FALSE";
-                case TokenType::WHITESPACE: return "WHITESPACE";
-                // in case I forget to add a token here, let's put a default case
-                default: return "Woopsies, Unknown Token";
-            }
+
+        // returns the printable name of a type (a view of a static table, nothing is allocated)
+        static constexpr std::string_view GetType(TokenType type) {
+            size_t index = static_cast<size_t>(type);
+            // in case a type is ever cast from a bad number, let's keep a default
+            return index < TokenTypeCount ? TokenNames[index] : "Woopsies, Unknown Token";
         }
 
-        
-        static Token ConstructToken(TokenType type, std::string value) {
+        static Token ConstructToken(TokenType type, uint32_t offset, uint32_t length, uint32_t symbol = SymbolTable::NoSymbol) {
             Token token;
             token.type = type;
-            token.value = value;
+            token.offset = offset;
+            token.length = length;
+            token.symbol = symbol;
             return token;
         }
 
-        static void Debug(const Token& token) {
+        // returns the text the token covers in the given source
+        static std::string_view Text(const Token& token, std::string_view source) {
+            return source.substr(token.offset, token.length);
+        }
+
+        // appends the line Debug prints for the token (type, and the text for tokens that carry one)
+        static void AppendDebug(std::string& out, const Token& token, std::string_view source) {
+            out += GetType(token.type);
             if (IsKnown({TokenType::NUMBER, TokenType::STRING, TokenType::IDENTIFIER}, token.type)) {
-                std::cout << GetType(token.type) << ": " << token.value << std::endl;
-            }
-            else {
-                std::cout << GetType(token.type) << std::endl;
+                out += ": ";
+                out += Text(token, source);
             }
+            out += '\n';
+        }
+
+        static void Debug(const Token& token, std::string_view source) {
+            std::string line;
+            AppendDebug(line, token, source);
+            std::cout << line;
         }
 
         static bool IsKnown(std::initializer_list<TokenType> possibilities, TokenType type) {
@@ -187,4 +95,104 @@ class Token {
         }
 };
 
+static_assert(sizeof(Token) <= 16, "tokens are meant to stay small, keep the text in the source buffer");
+
+// the tokens of one source together with the buffer their offsets point into
+class TokenStream {
+    public:
+        std::shared_ptr<const SourceBuffer> Source;
+        std::vector<Token> Tokens;
+        // offsets of the bytes no rule matched (the lexer skipped them one at a time), sorted
+        std::vector<uint32_t> Unmatched;
+        // the table the symbol ids of the tokens point into (may be shared with other streams of the same compilation)
+        std::shared_ptr<SymbolTable> Symbols;
+        // the decoded values of the number tokens, in the order they were lexed (an edit only ever appends to it)
+        std::vector<NumberValue> Numbers;
+        // set if the lexer saw a number that didn't decode or a byte that isn't ASCII (only a hint, an edit that
+        // takes the byte out again leaves it set)
+        bool MayHaveErrors = false;
+
+        // false when CollectDiagnostics is sure to come back empty, so a clean ASCII file never pays for it
+        bool NeedsDiagnostics() const {
+            return MayHaveErrors || !Unmatched.empty();
+        }
+
+        // returns the whole source the tokens point into
+        std::string_view GetSource() const {
+            return Source ? Source->View() : std::string_view();
+        }
+
+        // returns the text of one of the tokens
+        std::string_view Text(const Token& token) const {
+            return Token::Text(token, GetSource());
+        }
+
+        // returns the interned text of an identifier or string token (empty for other tokens)
+        std::string_view Name(const Token& token) const {
+            return Symbols && token.type != TokenType::NUMBER ? Symbols->Name(token.symbol) : std::string_view();
+        }
+
+        // returns the decoded value of a number token (0 for other tokens and for numbers that didn't decode)
+        NumberValue Number(const Token& token) const {
+            return token.type == TokenType::NUMBER && token.symbol != 0 ? Numbers[token.symbol - 1] : NumberValue();
+        }
+
+        // prints every token like Token::Debug does, formatted into one buffer that is written out in large
+        // blocks (no flush and no allocation per token)
+        void Dump(std::ostream& out) const {
+            constexpr size_t BlockSize = 1 << 16;
+            std::string_view source = GetSource();
+            std::string buffer;
+            buffer.reserve(BlockSize + 256);
+            for (const Token& token : Tokens) {
+                Token::AppendDebug(buffer, token, source);
+                if (buffer.size() >= BlockSize) {
+                    out.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            out.write(buffer.data(), buffer.size());
+            out.flush();
+        }
+};
+
+// the same tokens stored as a structure of arrays, for passes that only look at one field (ex: only the types)
+class TokenBuffer {
+    public:
+        std::shared_ptr<const SourceBuffer> Source;
+        std::vector<TokenType> Types;
+        std::vector<uint32_t> Offsets;
+        std::vector<uint32_t> Lengths;
+        std::vector<uint32_t> Symbols;
+
+        static TokenBuffer FromStream(const TokenStream& stream) {
+            TokenBuffer buffer;
+            buffer.Source = stream.Source;
+            buffer.Types.reserve(stream.Tokens.size());
+            buffer.Offsets.reserve(stream.Tokens.size());
+            buffer.Lengths.reserve(stream.Tokens.size());
+            buffer.Symbols.reserve(stream.Tokens.size());
+            for (const Token& token : stream.Tokens) {
+                buffer.Types.push_back(token.type);
+                buffer.Offsets.push_back(token.offset);
+                buffer.Lengths.push_back(token.length);
+                buffer.Symbols.push_back(token.symbol);
+            }
+            return buffer;
+        }
+
+        size_t Size() const {
+            return Types.size();
+        }
+
+        // rebuilds the token at the given index
+        Token At(size_t index) const {
+            return Token::ConstructToken(Types[index], Offsets[index], Lengths[index], Symbols[index]);
+        }
+
+        std::string_view Text(size_t index) const {
+            return Source->View().substr(Offsets[index], Lengths[index]);
+        }
+};
+
 #endif
\ No newline at end of file
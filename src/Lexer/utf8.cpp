@@ -0,0 +1,123 @@
+#include "utf8.h"
+#include "scan.h"
+
+// the range the byte after a lead byte has to be in: narrower than 0x80-0xBF right after E0 (overlongs), ED
+// (surrogates), F0 (overlongs) and F4 (past U+10FFFF), see table 3-7 of the Unicode standard
+static bool secondInRange(unsigned char lead, unsigned char c) {
+    switch (lead) {
+        case 0xE0: return c >= 0xA0 && c <= 0xBF;
+        case 0xED: return c >= 0x80 && c <= 0x9F;
+        case 0xF0: return c >= 0x90 && c <= 0xBF;
+        case 0xF4: return c >= 0x80 && c <= 0x8F;
+        default: return c >= 0x80 && c <= 0xBF;
+    }
+}
+
+char32_t DecodeUtf8(std::string_view text, size_t position, size_t* length) {
+    unsigned char lead = static_cast<unsigned char>(text[position]);
+    *length = 1;
+    if (lead < 0x80) {
+        return lead;
+    }
+    size_t size;
+    char32_t codePoint;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        size = 2;
+        codePoint = lead & 0x1F;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        size = 3;
+        codePoint = lead & 0x0F;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        size = 4;
+        codePoint = lead & 0x07;
+    }
+    else {
+        // a continuation byte, C0 and C1 (only ever overlong) or F5 and up (only ever past U+10FFFF)
+        return InvalidCodePoint;
+    }
+    for (size_t i = 1; i < size; i++) {
+        if (position + i >= text.size()) {
+            *length = i;
+            return InvalidCodePoint;
+        }
+        unsigned char c = static_cast<unsigned char>(text[position + i]);
+        if (i == 1 ? !secondInRange(lead, c) : (c & 0xC0) != 0x80) {
+            *length = i;
+            return InvalidCodePoint;
+        }
+        codePoint = (codePoint << 6) | (c & 0x3F);
+    }
+    *length = size;
+    return codePoint;
+}
+
+void AppendUtf8(std::string& out, char32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        if (codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+            return;
+        }
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint <= 0x10FFFF) {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+size_t ValidateUtf8(std::string_view text, size_t position, size_t* length) {
+    while (true) {
+        position = ScanRun(ScanKernel::ASCII, text.data(), position, text.size());
+        if (position >= text.size()) {
+            return text.size();
+        }
+        // a multibyte run (names in another script, say) is decoded to its end before going back to the kernel
+        while (position < text.size() && static_cast<unsigned char>(text[position]) >= 0x80) {
+            if (DecodeUtf8(text, position, length) == InvalidCodePoint) {
+                return position;
+            }
+            position += *length;
+        }
+    }
+}
+
+size_t CountCodePoints(std::string_view text) {
+    size_t count = 0;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t ascii = ScanRun(ScanKernel::ASCII, text.data(), position, text.size());
+        count += ascii - position;
+        position = ascii;
+        if (position < text.size()) {
+            size_t length;
+            DecodeUtf8(text, position, &length);
+            position += length;
+            count++;
+        }
+    }
+    return count;
+}
+
+bool IsAscii(std::string_view text) {
+    // a name or a short string is cheaper to fold a byte at a time than to hand to the kernel
+    if (text.size() <= 32) {
+        unsigned char bits = 0;
+        for (char c : text) {
+            bits |= static_cast<unsigned char>(c);
+        }
+        return bits < 0x80;
+    }
+    return ScanRun(ScanKernel::ASCII, text.data(), 0, text.size()) >= text.size();
+}
@@ -0,0 +1,31 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// what DecodeUtf8 gives for a sequence that isn't well-formed UTF-8
+constexpr char32_t InvalidCodePoint = 0xFFFFFFFF;
+
+// decodes the code point starting at position and sets length to its bytes. an ill-formed sequence (a stray
+// continuation byte, an overlong encoding, a surrogate, past U+10FFFF or cut short) gives InvalidCodePoint and the
+// length of its longest prefix that could still have been well-formed, at least 1, so skipping length bytes
+// always moves on and a cut sequence is one error, not one per byte
+char32_t DecodeUtf8(std::string_view text, size_t position, size_t* length);
+
+// appends the bytes of a code point, nothing for one that isn't (a surrogate or past U+10FFFF)
+void AppendUtf8(std::string& out, char32_t codePoint);
+
+// returns the offset of the first ill-formed sequence at or after position (and sets length to its bytes, like
+// DecodeUtf8) or text.size() if the rest is valid. runs of ASCII are confirmed by the ASCII scan kernel 16 or 32
+// bytes at a time, only the multibyte sequences are decoded one by one
+size_t ValidateUtf8(std::string_view text, size_t position, size_t* length);
+
+// the number of code points in text, an ill-formed sequence counts as one
+size_t CountCodePoints(std::string_view text);
+
+// true if no byte of text is 0x80 or above (nothing to decode, so nothing that could be ill-formed)
+bool IsAscii(std::string_view text);
+
+#endif
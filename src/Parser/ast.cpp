@@ -0,0 +1,115 @@
+#include "ast.h"
+
+#include <cstdio>
+
+// creating an empty tree, slot 0 is taken so no real node has the id NoNode
+Ast::Ast() {
+    Clear();
+}
+
+void Ast::Clear() {
+    Nodes.clear();
+    Nodes.push_back(Node{NodeKind::ERROR, TokenType::E0F_TOKEN, 0, NoNode, NoNode, NoNode, NoNode});
+    Constants.clear();
+    Root = NoNode;
+}
+
+void Ast::Reserve(size_t nodes) {
+    Nodes.reserve(nodes + 1);
+}
+
+NodeId Ast::Add(NodeKind kind, uint32_t token, NodeId first, NodeId second, NodeId third, TokenType op) {
+    Nodes.push_back(Node{kind, op, token, first, second, third, NoNode});
+    return static_cast<NodeId>(Nodes.size() - 1);
+}
+
+// number of nodes, the empty slot 0 not counted
+size_t Ast::GetNodeCount() const {
+    return Nodes.size() - 1;
+}
+
+// getter for the root field
+NodeId Ast::GetRoot() const {
+    return Root;
+}
+
+// setter for the root field
+void Ast::SetRoot(NodeId root) {
+    Root = root;
+}
+
+uint32_t Ast::AddConstant(ConstantValue value) {
+    Constants.push_back(std::move(value));
+    return static_cast<uint32_t>(Constants.size() - 1);
+}
+
+const ConstantValue& Ast::GetConstant(uint32_t index) const {
+    return Constants[index];
+}
+
+// a constant the way it would be written in the source (strings quoted, their escapes left decoded)
+static void appendConstant(std::string& out, const ConstantValue& constant) {
+    switch (constant.Type) {
+        case ConstantValue::Kind::NUMBER: {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.17g", constant.Number);
+            out += text;
+            break;
+        }
+        case ConstantValue::Kind::BOOLEAN:
+            out += constant.Boolean ? "true" : "false";
+            break;
+        case ConstantValue::Kind::STRING:
+            out += '"';
+            out += constant.Text;
+            out += '"';
+            break;
+    }
+}
+
+void Ast::AppendDebug(std::string& out, const TokenStream& tokens) const {
+    if (Root == NoNode) {
+        return;
+    }
+    // the nodes still to print with their depth, the children of a node are pushed last first
+    std::vector<std::pair<NodeId, size_t>> pending = {{Root, 0}};
+    std::vector<NodeId> children;
+    while (!pending.empty()) {
+        auto [id, depth] = pending.back();
+        pending.pop_back();
+        const Node& node = Nodes[id];
+
+        out.append(depth * 2, ' ');
+        out += NodeNames[static_cast<size_t>(node.Kind)];
+        if (node.Kind == NodeKind::UNARY || node.Kind == NodeKind::POSTFIX || node.Kind == NodeKind::BINARY || node.Kind == NodeKind::ASSIGN) {
+            out += ' ';
+            out += Token::GetType(node.Operator);
+        }
+        switch (node.Kind) {
+            case NodeKind::LET: case NodeKind::CONST: case NodeKind::FUNC: case NodeKind::PARAMETER: case NodeKind::CLASS: case NodeKind::IMPORT:
+            case NodeKind::NUMBER: case NodeKind::STRING: case NodeKind::BOOLEAN: case NodeKind::IDENTIFIER: case NodeKind::MEMBER: case NodeKind::FIELD:
+                out += ' ';
+                out += tokens.Text(tokens.Tokens[node.Token]);
+                break;
+            case NodeKind::CONSTANT:
+                out += ' ';
+                appendConstant(out, Constants[node.First]);
+                out += '\n';
+                continue;
+            default:
+                break;
+        }
+        out += '\n';
+
+        // every child, and every node of the lists among them, in order (a node that isn't in a list has no Next)
+        children.clear();
+        for (NodeId child : {node.First, node.Second, node.Third}) {
+            for (NodeId item = child; item != NoNode; item = Nodes[item].Next) {
+                children.push_back(item);
+            }
+        }
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            pending.push_back({*child, depth + 1});
+        }
+    }
+}
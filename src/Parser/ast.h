@@ -0,0 +1,162 @@
+#ifndef AST_H
+#define AST_H
+
+#include "../Lexer/tokens.h"
+
+// every kind of node, with what its token and its children are (a child that isn't there is NoNode, a list is its
+// first node and the rest follow through Next):
+//
+//   NODE(kind, name)
+#define ILYS_NODE_SPEC(NODE) \
+    NODE(ERROR, "ERROR")                 /* what was left of something that didn't parse, token: where it went wrong */ \
+    NODE(PROGRAM, "PROGRAM")             /* first: list of statements */ \
+    NODE(BLOCK, "BLOCK")                 /* token: '{', first: list of statements */ \
+    NODE(LET, "LET")                     /* token: the name, first: the initializer */ \
+    NODE(CONST, "CONST")                 /* token: the name, first: the initializer */ \
+    NODE(FUNC, "FUNC")                   /* token: the name, first: list of PARAMETER, second: BLOCK */ \
+    NODE(PARAMETER, "PARAMETER")         /* token: the name */ \
+    NODE(CLASS, "CLASS")                 /* token: the name, first: list of LET, CONST and FUNC */ \
+    NODE(IMPORT, "IMPORT")               /* token: the path (a string literal), first: list of PARAMETER (the names) */ \
+    NODE(EXPORT, "EXPORT")               /* token: export, first: the LET, CONST, FUNC or CLASS exported */ \
+    NODE(IF, "IF")                       /* first: condition, second: BLOCK, third: BLOCK or IF of the else */ \
+    NODE(FOR, "FOR")                     /* first: PARAMETER (the loop variable), second: what is looped over, third: BLOCK, \
+                                            operator: .. once the optimizer made it a counted loop over its range */ \
+    NODE(FOREVERY, "FOREVERY")           /* same as FOR */ \
+    NODE(WHILE, "WHILE")                 /* first: condition, second: BLOCK */ \
+    NODE(RETURN, "RETURN")               /* token: return, first: the value (NoNode for none) */ \
+    NODE(EXPRESSION, "EXPRESSION")       /* an expression used as a statement, first: the expression */ \
+    NODE(NUMBER, "NUMBER")               /* token: the literal (its value is TokenStream::Number) */ \
+    NODE(STRING, "STRING")               /* token: the literal */ \
+    NODE(BOOLEAN, "BOOLEAN")             /* token: true or false */ \
+    NODE(IDENTIFIER, "IDENTIFIER")       /* token: the name */ \
+    NODE(ARRAY, "ARRAY")                 /* token: '[', first: list of elements */ \
+    NODE(OBJECT, "OBJECT")               /* token: '{', first: list of FIELD */ \
+    NODE(FIELD, "FIELD")                 /* token: the name, first: the value */ \
+    NODE(UNARY, "UNARY")                 /* operator: - ! ++ -- typeof, first: operand */ \
+    NODE(POSTFIX, "POSTFIX")             /* operator: ++ --, first: operand */ \
+    NODE(BINARY, "BINARY")               /* operator: arithmetic, comparison, && || and .., first and second */ \
+    NODE(ASSIGN, "ASSIGN")               /* operator: = += -= *= /= %=, first: target, second: value */ \
+    NODE(CONDITIONAL, "CONDITIONAL")     /* first ? second : third */ \
+    NODE(CALL, "CALL")                   /* token: '(', first: callee, second: list of arguments */ \
+    NODE(INDEX, "INDEX")                 /* token: '[', first: object, second: index */ \
+    NODE(MEMBER, "MEMBER")               /* token: the member name, first: object */ \
+    NODE(NEW, "NEW")                     /* first: what is constructed (usually a CALL) */ \
+    NODE(CONSTANT, "CONSTANT")           /* a value the optimizer worked out, token: where it came from, first: its index in \
+                                            the Ast's constants (not a node) */
+
+enum class NodeKind : uint8_t {
+#define ILYS_NODE_ENUM(kind, name) kind,
+    ILYS_NODE_SPEC(ILYS_NODE_ENUM)
+#undef ILYS_NODE_ENUM
+};
+
+inline constexpr std::string_view NodeNames[] = {
+#define ILYS_NODE_NAME(kind, name) name,
+    ILYS_NODE_SPEC(ILYS_NODE_NAME)
+#undef ILYS_NODE_NAME
+};
+
+// nodes are referred to by their index in the Ast (0 is never a node, it means "none")
+using NodeId = uint32_t;
+
+constexpr NodeId NoNode = 0;
+
+// one node, all of them the same size so the whole tree is one array
+struct Node {
+    NodeKind Kind;
+    TokenType Operator;
+    // index of the token in the stream (its text, offset and value are found from there)
+    uint32_t Token;
+    NodeId First;
+    NodeId Second;
+    NodeId Third;
+    // the next node of the list this node is in
+    NodeId Next;
+};
+
+static_assert(sizeof(Node) <= 24, "nodes are meant to stay small, the tree is walked by scanning them");
+
+// the value of a CONSTANT node
+struct ConstantValue {
+    enum class Kind : uint8_t {
+        NUMBER,
+        BOOLEAN,
+        STRING
+    };
+
+    Kind Type;
+    bool Boolean;
+    double Number;
+    // the decoded text of a string (no quotes or escapes)
+    std::string Text;
+};
+
+// a parsed program: every node lives in one vector and refers to the others by index, so there are no pointers
+// to chase or fix up, a pass that doesn't care about the shape is a scan of the array, and the whole tree is freed
+// at once. children are always added before their parent, so a node's index is larger than any of its children's
+class Ast {
+    public:
+        Ast();
+
+        // drops every node but keeps the memory (an Ast reused across files allocates once)
+        void Clear();
+        void Reserve(size_t nodes);
+
+        NodeId Add(NodeKind kind, uint32_t token, NodeId first = NoNode, NodeId second = NoNode, NodeId third = NoNode, TokenType op = TokenType::E0F_TOKEN);
+
+        const Node& Get(NodeId id) const {
+            return Nodes[id];
+        }
+
+        Node& Get(NodeId id) {
+            return Nodes[id];
+        }
+
+        size_t GetNodeCount() const;
+        NodeId GetRoot() const;
+        void SetRoot(NodeId root);
+
+        // the index of a new constant, for a CONSTANT node to refer to
+        uint32_t AddConstant(ConstantValue value);
+        const ConstantValue& GetConstant(uint32_t index) const;
+
+        // appends the tree, one node per line indented by depth ("BINARY +", "IDENTIFIER count", ...), walked
+        // without recursion so a very deep tree can be printed too
+        void AppendDebug(std::string& out, const TokenStream& tokens) const;
+
+    private:
+        std::vector<Node> Nodes;
+        std::vector<ConstantValue> Constants;
+        NodeId Root;
+};
+
+// builds a list out of nodes one at a time (the nodes are linked through Next as they are added)
+class NodeList {
+    public:
+        explicit NodeList(Ast& ast) : Tree(ast), Head(NoNode), Tail(NoNode) {
+        }
+
+        void Append(NodeId node) {
+            if (node == NoNode) {
+                return;
+            }
+            if (Tail == NoNode) {
+                Head = node;
+            }
+            else {
+                Tree.Get(Tail).Next = node;
+            }
+            Tail = node;
+        }
+
+        NodeId GetHead() const {
+            return Head;
+        }
+
+    private:
+        Ast& Tree;
+        NodeId Head;
+        NodeId Tail;
+};
+
+#endif
@@ -0,0 +1,553 @@
+#include "parser.h"
+
+#include <array>
+
+// how tightly an infix or postfix operator binds, the higher the tighter (NONE for tokens that aren't one)
+enum class Precedence : uint8_t {
+    NONE,
+    ASSIGNMENT,
+    CONDITIONAL,
+    RANGE,
+    OR,
+    AND,
+    EQUALITY,
+    COMPARISON,
+    SUM,
+    PRODUCT,
+    PREFIX,
+    POSTFIX
+};
+
+constexpr std::array<Precedence, TokenTypeCount> BuildPrecedences() {
+    std::array<Precedence, TokenTypeCount> precedences = {};
+    for (size_t i = 0; i < TokenTypeCount; i++) {
+        switch (static_cast<TokenType>(i)) {
+            case TokenType::ASSIGNMENT: case TokenType::PLUSEQUALS: case TokenType::MINUSEQUALS: case TokenType::MULTIPLYEQUALS:
+            case TokenType::DIVIDEEQUALS: case TokenType::MODEQUALS:
+                precedences[i] = Precedence::ASSIGNMENT;
+                break;
+            case TokenType::QUESTIONMARK: precedences[i] = Precedence::CONDITIONAL; break;
+            case TokenType::DOTDOT: precedences[i] = Precedence::RANGE; break;
+            case TokenType::OR: precedences[i] = Precedence::OR; break;
+            case TokenType::AND: precedences[i] = Precedence::AND; break;
+            case TokenType::EQUALS: case TokenType::NOTEQUALS: precedences[i] = Precedence::EQUALITY; break;
+            case TokenType::LESSTHAN: case TokenType::LESSTHANEQUALS: case TokenType::GREATERTHAN: case TokenType::GREATERTHANEQUALS:
+                precedences[i] = Precedence::COMPARISON;
+                break;
+            case TokenType::PLUS: case TokenType::MINUS: precedences[i] = Precedence::SUM; break;
+            case TokenType::MULTIPLY: case TokenType::DIVIDE: case TokenType::MODULO: precedences[i] = Precedence::PRODUCT; break;
+            case TokenType::OPENPARENTHESIS: case TokenType::OPENBRACKET: case TokenType::DOT: case TokenType::PLUSPLUS:
+            case TokenType::MINUSMINUS:
+                precedences[i] = Precedence::POSTFIX;
+                break;
+            default: precedences[i] = Precedence::NONE; break;
+        }
+    }
+    return precedences;
+}
+
+constexpr std::array<Precedence, TokenTypeCount> Precedences = BuildPrecedences();
+
+// the precedence one step tighter (the right operand of a left to right operator)
+static Precedence tighter(Precedence precedence) {
+    return static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1);
+}
+
+// one parse of one stream, every rule of the grammar is a method (see parser.h for the grammar)
+class Parser {
+    public:
+        Parser(const TokenStream& stream, Ast& ast, std::vector<Diagnostic>& diagnostics)
+            : Stream(stream), Tokens(stream.Tokens), Tree(ast), Diagnostics(diagnostics) {
+            Current = 0;
+            Depth = 0;
+            Panic = false;
+            Errors = 0;
+        }
+
+        NodeId ParseProgram() {
+            NodeList statements(Tree);
+            ParseStatements(statements, false);
+            return Tree.Add(NodeKind::PROGRAM, Current, statements.GetHead());
+        }
+
+        bool HadErrors() const {
+            return Errors > 0;
+        }
+
+    private:
+        const TokenStream& Stream;
+        const std::vector<Token>& Tokens;
+        Ast& Tree;
+        std::vector<Diagnostic>& Diagnostics;
+        // index of the next token
+        uint32_t Current;
+        size_t Depth;
+        // an error was reported and the parser hasn't got back to the start of a statement yet, nothing else is
+        // reported until then (one mistake shouldn't give a cascade of errors)
+        bool Panic;
+        size_t Errors;
+
+        TokenType Peek(size_t k = 0) const {
+            size_t index = Current + k;
+            return index < Tokens.size() ? Tokens[index].type : TokenType::E0F_TOKEN;
+        }
+
+        // moves past the current token (never past the EOF token) and returns its index
+        uint32_t Advance() {
+            uint32_t token = Current;
+            if (Current + 1 < Tokens.size()) {
+                Current++;
+            }
+            return token;
+        }
+
+        bool Match(TokenType type) {
+            if (Peek() != type) {
+                return false;
+            }
+            Advance();
+            return true;
+        }
+
+        // moves past a token that has to be there, or reports it missing and stays where it is
+        void Expect(TokenType type) {
+            if (!Match(type)) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, type);
+            }
+        }
+
+        void Report(DiagnosticCode code, uint32_t token, TokenType expected = TokenType::E0F_TOKEN) {
+            if (Panic) {
+                return;
+            }
+            Panic = true;
+            Errors++;
+            Diagnostic diagnostic{code, static_cast<uint32_t>(Stream.GetSource().size()), 0};
+            if (token < Tokens.size()) {
+                diagnostic.Offset = Tokens[token].offset;
+                diagnostic.Length = Tokens[token].length;
+            }
+            diagnostic.Expected = expected;
+            Diagnostics.push_back(diagnostic);
+        }
+
+        // after an error, skips to what looks like the start of the next statement (a block met on the way is
+        // skipped whole, it most likely belongs to the broken statement: func f(a b) { ... })
+        void Synchronize() {
+            if (!Panic) {
+                return;
+            }
+            Panic = false;
+            while (Peek() != TokenType::E0F_TOKEN) {
+                if (Current > 0 && Tokens[Current - 1].type == TokenType::SEMICOLON) {
+                    return;
+                }
+                switch (Peek()) {
+                    case TokenType::CLOSECURLYBRACKET: case TokenType::LET: case TokenType::CONST: case TokenType::FUNC:
+                    case TokenType::CLASS: case TokenType::IF: case TokenType::FOR: case TokenType::FOREVERY: case TokenType::WHILE:
+                    case TokenType::RETURN:
+                        return;
+                    case TokenType::OPENCURLYBRACKET: {
+                        size_t open = 0;
+                        do {
+                            open += Peek() == TokenType::OPENCURLYBRACKET;
+                            open -= Peek() == TokenType::CLOSECURLYBRACKET;
+                            Advance();
+                        } while (open > 0 && Peek() != TokenType::E0F_TOKEN);
+                        return;
+                    }
+                    default:
+                        Advance();
+                        break;
+                }
+            }
+        }
+
+        // runs a rule one level deeper, or reports NESTING_TOO_DEEP and gives an ERROR node when there are too many
+        template <typename Rule>
+        NodeId Nested(Rule rule) {
+            if (Depth >= MaxParseDepth) {
+                Report(DiagnosticCode::NESTING_TOO_DEEP, Current);
+                return Tree.Add(NodeKind::ERROR, Current);
+            }
+            Depth++;
+            NodeId node = rule();
+            Depth--;
+            return node;
+        }
+
+        // statements up to the end of the file, or up to the '}' of a block
+        void ParseStatements(NodeList& statements, bool block) {
+            while (Peek() != TokenType::E0F_TOKEN && !(block && Peek() == TokenType::CLOSECURLYBRACKET)) {
+                uint32_t start = Current;
+                if (Match(TokenType::SEMICOLON)) {
+                    continue;
+                }
+                // imports and exports only at the top level, in a block they are unexpected tokens
+                if (!block && Peek() == TokenType::IMPORT) {
+                    statements.Append(ParseImport());
+                }
+                else if (!block && Peek() == TokenType::EXPORT) {
+                    statements.Append(ParseExport());
+                }
+                else {
+                    statements.Append(ParseStatement());
+                }
+                Synchronize();
+                // a token no statement can start with ('}' outside of a block), skipped after it was reported
+                if (Current == start) {
+                    Advance();
+                }
+            }
+        }
+
+        NodeId ParseStatement() {
+            switch (Peek()) {
+                case TokenType::LET: return ParseDeclaration(NodeKind::LET);
+                case TokenType::CONST: return ParseDeclaration(NodeKind::CONST);
+                case TokenType::FUNC: return ParseFunction();
+                case TokenType::CLASS: return ParseClass();
+                case TokenType::IF: return ParseIf();
+                case TokenType::FOR: return ParseLoop(NodeKind::FOR);
+                case TokenType::FOREVERY: return ParseLoop(NodeKind::FOREVERY);
+                case TokenType::WHILE: return ParseWhile();
+                case TokenType::RETURN: return ParseReturn();
+                case TokenType::OPENCURLYBRACKET: return ParseBlock();
+                default: {
+                    uint32_t token = Current;
+                    NodeId expression = ParseExpression(Precedence::ASSIGNMENT);
+                    Match(TokenType::SEMICOLON);
+                    return Tree.Add(NodeKind::EXPRESSION, token, expression);
+                }
+            }
+        }
+
+        // import name, ... from "path" [;]
+        NodeId ParseImport() {
+            Advance();
+            NodeList names(Tree);
+            do {
+                uint32_t name = Current;
+                if (!Match(TokenType::IDENTIFIER)) {
+                    Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                    return Tree.Add(NodeKind::ERROR, name);
+                }
+                names.Append(Tree.Add(NodeKind::PARAMETER, name));
+            } while (Match(TokenType::COMMA));
+            Expect(TokenType::FROM);
+            uint32_t path = Current;
+            if (!Match(TokenType::STRING)) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::STRING);
+                return Tree.Add(NodeKind::ERROR, path);
+            }
+            Match(TokenType::SEMICOLON);
+            return Tree.Add(NodeKind::IMPORT, path, names.GetHead());
+        }
+
+        // export let ... | export const ... | export func ... | export class ...
+        NodeId ParseExport() {
+            uint32_t token = Advance();
+            NodeId declaration;
+            switch (Peek()) {
+                case TokenType::LET: declaration = ParseDeclaration(NodeKind::LET); break;
+                case TokenType::CONST: declaration = ParseDeclaration(NodeKind::CONST); break;
+                case TokenType::FUNC: declaration = ParseFunction(); break;
+                case TokenType::CLASS: declaration = ParseClass(); break;
+                default:
+                    Report(DiagnosticCode::UNEXPECTED_TOKEN, Current);
+                    return Tree.Add(NodeKind::ERROR, Current);
+            }
+            return Tree.Add(NodeKind::EXPORT, token, declaration);
+        }
+
+        // { statements }
+        NodeId ParseBlock() {
+            return Nested([this]() {
+                uint32_t open = Current;
+                if (!Match(TokenType::OPENCURLYBRACKET)) {
+                    Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::OPENCURLYBRACKET);
+                    return Tree.Add(NodeKind::ERROR, Current);
+                }
+                NodeList statements(Tree);
+                ParseStatements(statements, true);
+                Expect(TokenType::CLOSECURLYBRACKET);
+                return Tree.Add(NodeKind::BLOCK, open, statements.GetHead());
+            });
+        }
+
+        // let name [= value] [;]   const name = value [;]
+        NodeId ParseDeclaration(NodeKind kind) {
+            Advance();
+            uint32_t name = Current;
+            if (!Match(TokenType::IDENTIFIER)) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                return Tree.Add(NodeKind::ERROR, name);
+            }
+            NodeId value = NoNode;
+            if (Match(TokenType::ASSIGNMENT)) {
+                value = ParseExpression(Precedence::ASSIGNMENT);
+            }
+            else if (kind == NodeKind::CONST) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::ASSIGNMENT);
+            }
+            Match(TokenType::SEMICOLON);
+            return Tree.Add(kind, name, value);
+        }
+
+        // func name(parameter, ...) { statements }
+        NodeId ParseFunction() {
+            Advance();
+            uint32_t name = Current;
+            if (!Match(TokenType::IDENTIFIER)) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                return Tree.Add(NodeKind::ERROR, name);
+            }
+            Expect(TokenType::OPENPARENTHESIS);
+            NodeList parameters(Tree);
+            while (!Panic && Peek() != TokenType::CLOSEPARENTHESIS) {
+                uint32_t parameter = Current;
+                if (!Match(TokenType::IDENTIFIER)) {
+                    Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                    break;
+                }
+                parameters.Append(Tree.Add(NodeKind::PARAMETER, parameter));
+                if (!Match(TokenType::COMMA)) {
+                    break;
+                }
+            }
+            Expect(TokenType::CLOSEPARENTHESIS);
+            NodeId body = ParseBlock();
+            return Tree.Add(NodeKind::FUNC, name, parameters.GetHead(), body);
+        }
+
+        // class name { let, const and func declarations }
+        NodeId ParseClass() {
+            Advance();
+            uint32_t name = Current;
+            if (!Match(TokenType::IDENTIFIER)) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                return Tree.Add(NodeKind::ERROR, name);
+            }
+            Expect(TokenType::OPENCURLYBRACKET);
+            NodeList members(Tree);
+            while (!Panic && Peek() != TokenType::CLOSECURLYBRACKET && Peek() != TokenType::E0F_TOKEN) {
+                uint32_t start = Current;
+                switch (Peek()) {
+                    case TokenType::LET: members.Append(ParseDeclaration(NodeKind::LET)); break;
+                    case TokenType::CONST: members.Append(ParseDeclaration(NodeKind::CONST)); break;
+                    case TokenType::FUNC: members.Append(ParseFunction()); break;
+                    case TokenType::SEMICOLON: Advance(); break;
+                    default: Report(DiagnosticCode::UNEXPECTED_TOKEN, Current); break;
+                }
+                Synchronize();
+                if (Current == start) {
+                    Advance();
+                }
+            }
+            Expect(TokenType::CLOSECURLYBRACKET);
+            return Tree.Add(NodeKind::CLASS, name, members.GetHead());
+        }
+
+        // if condition { statements } [else if ... | else { statements }]
+        NodeId ParseIf() {
+            uint32_t token = Advance();
+            NodeId condition = ParseExpression(Precedence::ASSIGNMENT);
+            NodeId then = ParseBlock();
+            NodeId otherwise = NoNode;
+            if (Match(TokenType::ELSE)) {
+                // a chain of else if is as deep as it is long, so it counts as nesting too
+                otherwise = Peek() == TokenType::IF ? Nested([this]() { return ParseIf(); }) : ParseBlock();
+            }
+            return Tree.Add(NodeKind::IF, token, condition, then, otherwise);
+        }
+
+        // for [name in] iterable { statements }   forevery name in iterable { statements }
+        NodeId ParseLoop(NodeKind kind) {
+            uint32_t token = Advance();
+            NodeId variable = NoNode;
+            if (Peek() == TokenType::IDENTIFIER && Peek(1) == TokenType::IN) {
+                variable = Tree.Add(NodeKind::PARAMETER, Advance());
+                Advance();
+            }
+            else if (kind == NodeKind::FOREVERY) {
+                Report(DiagnosticCode::MISSING_TOKEN, Current, Peek() == TokenType::IDENTIFIER ? TokenType::IN : TokenType::IDENTIFIER);
+            }
+            NodeId iterable = ParseExpression(Precedence::ASSIGNMENT);
+            NodeId body = ParseBlock();
+            return Tree.Add(kind, token, variable, iterable, body);
+        }
+
+        // while condition { statements }
+        NodeId ParseWhile() {
+            uint32_t token = Advance();
+            NodeId condition = ParseExpression(Precedence::ASSIGNMENT);
+            NodeId body = ParseBlock();
+            return Tree.Add(NodeKind::WHILE, token, condition, body);
+        }
+
+        // return [value] [;]
+        NodeId ParseReturn() {
+            uint32_t token = Advance();
+            NodeId value = NoNode;
+            if (Peek() != TokenType::SEMICOLON && Peek() != TokenType::CLOSECURLYBRACKET && Peek() != TokenType::E0F_TOKEN) {
+                value = ParseExpression(Precedence::ASSIGNMENT);
+            }
+            Match(TokenType::SEMICOLON);
+            return Tree.Add(NodeKind::RETURN, token, value);
+        }
+
+        // an expression whose operators all bind at least as tightly as minimum
+        NodeId ParseExpression(Precedence minimum) {
+            return Nested([this, minimum]() {
+                NodeId left = ParsePrefix();
+                while (!Panic) {
+                    TokenType type = Peek();
+                    Precedence precedence = Precedences[static_cast<size_t>(type)];
+                    if (precedence == Precedence::NONE || precedence < minimum) {
+                        break;
+                    }
+                    left = ParseInfix(left, Advance(), type, precedence);
+                }
+                return left;
+            });
+        }
+
+        // comma separated expressions up to close (a comma before it is allowed)
+        NodeId ParseList(TokenType close) {
+            NodeList items(Tree);
+            while (!Panic && Peek() != close && Peek() != TokenType::E0F_TOKEN) {
+                items.Append(ParseExpression(Precedence::ASSIGNMENT));
+                if (!Match(TokenType::COMMA)) {
+                    break;
+                }
+            }
+            Expect(close);
+            return items.GetHead();
+        }
+
+        bool IsAssignable(NodeId node) const {
+            NodeKind kind = Tree.Get(node).Kind;
+            return kind == NodeKind::IDENTIFIER || kind == NodeKind::MEMBER || kind == NodeKind::INDEX || kind == NodeKind::ERROR;
+        }
+
+        // { name: value, ... } (a trailing comma is fine, like in a list)
+        NodeId ParseObject() {
+            uint32_t token = Current;
+            Advance();
+            NodeList fields(Tree);
+            while (!Panic && Peek() != TokenType::CLOSECURLYBRACKET && Peek() != TokenType::E0F_TOKEN) {
+                uint32_t name = Current;
+                if (!Match(TokenType::IDENTIFIER)) {
+                    Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                    break;
+                }
+                Expect(TokenType::COLON);
+                fields.Append(Tree.Add(NodeKind::FIELD, name, ParseExpression(Precedence::ASSIGNMENT)));
+                if (!Match(TokenType::COMMA)) {
+                    break;
+                }
+            }
+            Expect(TokenType::CLOSECURLYBRACKET);
+            return Tree.Add(NodeKind::OBJECT, token, fields.GetHead());
+        }
+
+        // what an expression can start with: literals, names, parentheses, arrays, objects and prefix operators
+        NodeId ParsePrefix() {
+            uint32_t token = Current;
+            TokenType type = Peek();
+            switch (type) {
+                case TokenType::NUMBER: Advance(); return Tree.Add(NodeKind::NUMBER, token);
+                case TokenType::STRING: Advance(); return Tree.Add(NodeKind::STRING, token);
+                case TokenType::IDENTIFIER: Advance(); return Tree.Add(NodeKind::IDENTIFIER, token);
+                case TokenType::TRUE_TOKEN: case TokenType::FALSE_TOKEN: Advance(); return Tree.Add(NodeKind::BOOLEAN, token);
+                case TokenType::OPENPARENTHESIS: {
+                    Advance();
+                    NodeId inner = ParseExpression(Precedence::ASSIGNMENT);
+                    Expect(TokenType::CLOSEPARENTHESIS);
+                    return inner;
+                }
+                case TokenType::OPENBRACKET: {
+                    Advance();
+                    NodeId elements = ParseList(TokenType::CLOSEBRACKET);
+                    return Tree.Add(NodeKind::ARRAY, token, elements);
+                }
+                case TokenType::OPENCURLYBRACKET:
+                    return ParseObject();
+                case TokenType::MINUS: case TokenType::NOT: case TokenType::TYPEOF: case TokenType::PLUSPLUS: case TokenType::MINUSMINUS: {
+                    Advance();
+                    NodeId operand = ParseExpression(Precedence::PREFIX);
+                    if ((type == TokenType::PLUSPLUS || type == TokenType::MINUSMINUS) && !IsAssignable(operand)) {
+                        Report(DiagnosticCode::INVALID_ASSIGNMENT, token);
+                    }
+                    return Tree.Add(NodeKind::UNARY, token, operand, NoNode, NoNode, type);
+                }
+                case TokenType::NEW: {
+                    Advance();
+                    NodeId target = ParseExpression(Precedence::POSTFIX);
+                    return Tree.Add(NodeKind::NEW, token, target);
+                }
+                default:
+                    Report(DiagnosticCode::UNEXPECTED_TOKEN, token);
+                    return Tree.Add(NodeKind::ERROR, token);
+            }
+        }
+
+        // the rest of an expression after left and an infix or postfix operator (already consumed)
+        NodeId ParseInfix(NodeId left, uint32_t token, TokenType type, Precedence precedence) {
+            switch (precedence) {
+                case Precedence::ASSIGNMENT: {
+                    if (!IsAssignable(left)) {
+                        Report(DiagnosticCode::INVALID_ASSIGNMENT, token);
+                    }
+                    NodeId value = ParseExpression(Precedence::ASSIGNMENT);
+                    return Tree.Add(NodeKind::ASSIGN, token, left, value, NoNode, type);
+                }
+                case Precedence::CONDITIONAL: {
+                    NodeId then = ParseExpression(Precedence::ASSIGNMENT);
+                    Expect(TokenType::COLON);
+                    // like the right side of an assignment (a ? b : c = d assigns to c)
+                    NodeId otherwise = ParseExpression(Precedence::ASSIGNMENT);
+                    return Tree.Add(NodeKind::CONDITIONAL, token, left, then, otherwise);
+                }
+                case Precedence::POSTFIX:
+                    switch (type) {
+                        case TokenType::OPENPARENTHESIS: {
+                            NodeId arguments = ParseList(TokenType::CLOSEPARENTHESIS);
+                            return Tree.Add(NodeKind::CALL, token, left, arguments);
+                        }
+                        case TokenType::OPENBRACKET: {
+                            NodeId index = ParseExpression(Precedence::ASSIGNMENT);
+                            Expect(TokenType::CLOSEBRACKET);
+                            return Tree.Add(NodeKind::INDEX, token, left, index);
+                        }
+                        case TokenType::DOT: {
+                            uint32_t name = Current;
+                            if (!Match(TokenType::IDENTIFIER)) {
+                                Report(DiagnosticCode::MISSING_TOKEN, Current, TokenType::IDENTIFIER);
+                                return left;
+                            }
+                            return Tree.Add(NodeKind::MEMBER, name, left);
+                        }
+                        default:
+                            if (!IsAssignable(left)) {
+                                Report(DiagnosticCode::INVALID_ASSIGNMENT, token);
+                            }
+                            return Tree.Add(NodeKind::POSTFIX, token, left, NoNode, NoNode, type);
+                    }
+                default: {
+                    NodeId right = ParseExpression(tighter(precedence));
+                    return Tree.Add(NodeKind::BINARY, token, left, right, NoNode, type);
+                }
+            }
+        }
+};
+
+bool Parse(const TokenStream& tokens, Ast& ast, std::vector<Diagnostic>& diagnostics) {
+    ast.Clear();
+    // a node per token is about right (a few more for statements, fewer for punctuation), so usually the array
+    // is allocated once
+    ast.Reserve(tokens.Tokens.size() + 1);
+    Parser parser(tokens, ast, diagnostics);
+    ast.SetRoot(parser.ParseProgram());
+    return !parser.HadErrors();
+}
@@ -0,0 +1,26 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ast.h"
+#include "../Lexer/diagnostics.h"
+
+// how many expressions and blocks may be nested in one another, deeper than that is NESTING_TOO_DEEP (the parser
+// recurses once per level, this keeps it far from the end of the stack)
+constexpr size_t MaxParseDepth = 1000;
+
+// parses the tokens of a whole file into ast (cleared first, its memory is kept). statements are parsed by
+// recursive descent and expressions by precedence climbing (a Pratt parser), with the precedences below.
+// after an error the parser skips to the next statement, so one run reports every error (appended to
+// diagnostics) and still gives a complete tree, with ERROR nodes where something didn't parse.
+// returns true if there were no errors. import name, ... from "path" and export (before a let, const, func or
+// class) are statements of the top level only.
+//
+//   = += -= *= /= %=    right to left, the left side must be a name, a member or an index
+//   ? :                 right to left
+//   ..                  ranges (for i in 0..10)
+//   ||  &&  == !=  < <= > >=  + -  * / %    left to right, loosest first
+//   - ! ++ -- typeof new                     prefix
+//   () [] . ++ --                            calls, indexes, members and postfix
+bool Parse(const TokenStream& tokens, Ast& ast, std::vector<Diagnostic>& diagnostics);
+
+#endif
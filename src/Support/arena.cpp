@@ -0,0 +1,51 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// creating an empty arena, the first block is only taken on the first allocation
+Arena::Arena(size_t blockSize) {
+    Current = nullptr;
+    Remaining = 0;
+    BlockSize = blockSize;
+    BytesUsed = 0;
+    BytesReserved = 0;
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(Current) % alignment) % alignment;
+    if (Current == nullptr || padding + size > Remaining) {
+        // anything larger than a block gets a block of its own
+        size_t block = std::max(BlockSize, size + alignment);
+        Blocks.push_back(std::unique_ptr<char[]>(new char[block]));
+        Current = Blocks.back().get();
+        Remaining = block;
+        BytesReserved += block;
+        padding = (alignment - reinterpret_cast<uintptr_t>(Current) % alignment) % alignment;
+    }
+
+    char* memory = Current + padding;
+    Current = memory + size;
+    Remaining -= padding + size;
+    BytesUsed += size;
+    return memory;
+}
+
+std::string_view Arena::CopyString(std::string_view text) {
+    char* copy = static_cast<char*>(Allocate(text.size(), 1));
+    if (!text.empty()) {
+        std::memcpy(copy, text.data(), text.size());
+    }
+    return std::string_view(copy, text.size());
+}
+
+// getter for the bytesUsed field
+size_t Arena::GetBytesUsed() const {
+    return BytesUsed;
+}
+
+// getter for the bytesReserved field
+size_t Arena::GetBytesReserved() const {
+    return BytesReserved;
+}
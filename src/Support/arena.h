@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// bump allocator: memory is handed out from large blocks and only given back all at once when the arena dies,
+// so an allocation is a pointer increment (not thread safe, every thread needs its own arena or a lock)
+class Arena {
+    public:
+        explicit Arena(size_t blockSize = 1 << 16);
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&&) = default;
+        Arena& operator=(Arena&&) = default;
+
+        // returns size bytes aligned to alignment (a power of two), never moved or freed before the arena
+        void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        // copies the bytes into the arena and returns a view of the copy
+        std::string_view CopyString(std::string_view text);
+
+        // bytes handed out so far, and bytes taken from the system (the difference is padding and block ends)
+        size_t GetBytesUsed() const;
+        size_t GetBytesReserved() const;
+
+    private:
+        std::vector<std::unique_ptr<char[]>> Blocks;
+        char* Current;
+        size_t Remaining;
+        size_t BlockSize;
+        size_t BytesUsed;
+        size_t BytesReserved;
+};
+
+#endif
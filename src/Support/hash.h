@@ -0,0 +1,123 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// mixes the bits of x so every input bit affects every output bit (the finalizer of MurmurHash3)
+inline uint64_t MixHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// fast non-cryptographic hash of a byte range, 8 bytes per step (not meant to resist crafted collisions)
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed ^ (size * 0x9E3779B97F4A7C15ull);
+    uint64_t tail = 0;
+    if (size >= 8) {
+        size_t i = 0;
+        for (; i + 8 < size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+            hash ^= hash >> 32;
+        }
+        // the last 8 bytes, overlapping the previous word if size isn't a multiple of 8
+        std::memcpy(&tail, bytes + size - 8, 8);
+    }
+    else if (size >= 4) {
+        // two overlapping 4 byte reads cover 4 to 7 bytes without a loop
+        uint32_t first;
+        uint32_t last;
+        std::memcpy(&first, bytes, 4);
+        std::memcpy(&last, bytes + size - 4, 4);
+        tail = (static_cast<uint64_t>(first) << 32) | last;
+    }
+    else if (size > 0) {
+        tail = (static_cast<uint64_t>(bytes[0]) << 16) | (static_cast<uint64_t>(bytes[size / 2]) << 8) | bytes[size - 1];
+    }
+    return MixHash(hash ^ tail);
+}
+
+inline uint64_t HashBytes(std::string_view text, uint64_t seed = 0) {
+    return HashBytes(text.data(), text.size(), seed);
+}
+
+// a 128 bit hash, for when one value stands in for a whole file (two sources only share one by chance about once
+// in 2^128 pairs, a collision somewhere gets likely around 2^64 files, but it isn't cryptographic either: a crafted
+// collision is still possible)
+struct Hash128 {
+    uint64_t Low;
+    uint64_t High;
+
+    bool operator==(const Hash128& other) const {
+        return Low == other.Low && High == other.High;
+    }
+    bool operator!=(const Hash128& other) const {
+        return !(*this == other);
+    }
+};
+
+// MurmurHash3_x64_128 with a 64 bit seed (both lanes start from it), 16 bytes per step
+inline Hash128 HashBytes128(const void* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t c1 = 0x87C37B91114253D5ull;
+    constexpr uint64_t c2 = 0x4CF5AD432745937Full;
+    auto rotate = [](uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    };
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+    size_t blocks = size / 16;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t k1;
+        uint64_t k2;
+        std::memcpy(&k1, bytes + i * 16, 8);
+        std::memcpy(&k2, bytes + i * 16 + 8, 8);
+        h1 ^= rotate(k1 * c1, 31) * c2;
+        h1 = (rotate(h1, 27) + h2) * 5 + 0x52DCE729;
+        h2 ^= rotate(k2 * c2, 33) * c1;
+        h2 = (rotate(h2, 31) + h1) * 5 + 0x38495AB5;
+    }
+
+    // the last 0 to 15 bytes, little endian like the blocks
+    const unsigned char* tail = bytes + blocks * 16;
+    size_t rest = size & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = rest; i > 8; i--) {
+        k2 = (k2 << 8) | tail[i - 1];
+    }
+    for (size_t i = std::min<size_t>(rest, 8); i > 0; i--) {
+        k1 = (k1 << 8) | tail[i - 1];
+    }
+    if (rest > 8) {
+        h2 ^= rotate(k2 * c2, 33) * c1;
+    }
+    if (rest > 0) {
+        h1 ^= rotate(k1 * c1, 31) * c2;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+    h1 += h2;
+    h2 += h1;
+    h1 = MixHash(h1);
+    h2 = MixHash(h2);
+    h1 += h2;
+    h2 += h1;
+    return Hash128{h1, h2};
+}
+
+inline Hash128 HashBytes128(std::string_view text, uint64_t seed = 0) {
+    return HashBytes128(text.data(), text.size(), seed);
+}
+
+#endif
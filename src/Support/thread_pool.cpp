@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <ctime>
+
+double ThreadSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// the pool and the queue of the worker running on this thread (none outside the workers)
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+// starting the workers, each with its own queue
+ThreadPool::ThreadPool(size_t threads) : Pending(0), NextQueue(0), Steals(0) {
+    Stopping = false;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        Queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        Workers.emplace_back([this, i]() {
+            WorkerLoop(i);
+        });
+    }
+}
+
+// finishing the queued tasks and joining the workers
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        Stopping = true;
+    }
+    Wakeup.notify_all();
+    for (std::thread& worker : Workers) {
+        worker.join();
+    }
+}
+
+// getter for the number of workers
+size_t ThreadPool::GetThreadCount() const {
+    return Workers.size();
+}
+
+// getter for the steals counter
+size_t ThreadPool::GetStealCount() const {
+    return Steals.load();
+}
+
+bool ThreadPool::IsWorker() const {
+    return currentPool == this;
+}
+
+bool ThreadPool::RunPending() {
+    std::function<void()> task;
+    if (!IsWorker() || !TryPop(currentQueue, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+    size_t index = currentPool == this ? currentQueue : NextQueue.fetch_add(1, std::memory_order_relaxed) % Queues.size();
+    {
+        std::lock_guard<std::mutex> lock(Queues[index]->Mutex);
+        Queues[index]->Tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        Pending++;
+    }
+    Wakeup.notify_one();
+}
+
+// takes the newest task of the worker's own queue, or else the oldest task of the next queue that has one
+bool ThreadPool::TryPop(size_t index, std::function<void()>& task) {
+    for (size_t i = 0; i < Queues.size(); i++) {
+        WorkQueue& queue = *Queues[(index + i) % Queues.size()];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.Tasks.back());
+            queue.Tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.Tasks.front());
+            queue.Tasks.pop_front();
+            Steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        Pending--;
+        return true;
+    }
+    return false;
+}
+
+// each worker runs tasks until the pool is stopping and every queue is empty
+void ThreadPool::WorkerLoop(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+    while (true) {
+        std::function<void()> task;
+        if (TryPop(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(SleepMutex);
+        Wakeup.wait(lock, [this]() {
+            return Stopping || Pending.load() > 0;
+        });
+        if (Stopping && Pending.load() == 0) {
+            return;
+        }
+    }
+}
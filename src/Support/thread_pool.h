@@ -0,0 +1,88 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// cpu time used by the calling thread so far, in seconds (waiting for a core doesn't count)
+double ThreadSeconds();
+
+// a fixed set of worker threads with work stealing: every worker has its own queue, takes its newest task
+// first and, once its queue is empty, steals the oldest task of another worker, so a worker that got the short
+// tasks helps the ones that got the long ones instead of going idle
+class ThreadPool {
+    public:
+        // 0 threads means one per hardware thread
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // queues a task and returns a future for its result (a task submitted by a worker goes to that
+        // worker's queue, any other to the queues in turn)
+        template <typename Function>
+        auto Submit(Function function) -> std::future<decltype(function())> {
+            using Result = decltype(function());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+            std::future<Result> result = task->get_future();
+            Push([task]() {
+                (*task)();
+            });
+            return result;
+        }
+
+        // waits for a future of a task of this pool. a worker runs queued tasks meanwhile instead of blocking: the
+        // task it waits for may be queued behind it, and if every worker blocked like that the pool would deadlock
+        template <typename Result>
+        Result Wait(std::future<Result>& future) {
+            while (IsWorker() && future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                // nothing left to take means the task is running on another worker, it is only waited out
+                if (!RunPending()) {
+                    std::this_thread::yield();
+                }
+            }
+            return future.get();
+        }
+
+        // true when called from one of this pool's workers
+        bool IsWorker() const;
+
+        // runs one queued task on the calling worker (its own newest, or one stolen), false if none was queued
+        bool RunPending();
+
+        size_t GetThreadCount() const;
+
+        // number of tasks a worker took from another worker's queue so far
+        size_t GetStealCount() const;
+
+    private:
+        // one cache line per queue header so workers locking their own queue don't share a line
+        struct alignas(64) WorkQueue {
+            std::mutex Mutex;
+            std::deque<std::function<void()>> Tasks;
+        };
+
+        std::vector<std::thread> Workers;
+        std::vector<std::unique_ptr<WorkQueue>> Queues;
+        // queued and not yet taken, only raised with SleepMutex held so a worker going to sleep can't miss a task
+        std::atomic<size_t> Pending;
+        std::atomic<size_t> NextQueue;
+        std::atomic<size_t> Steals;
+        std::mutex SleepMutex;
+        std::condition_variable Wakeup;
+        bool Stopping;
+
+        void Push(std::function<void()> task);
+        bool TryPop(size_t index, std::function<void()>& task);
+        void WorkerLoop(size_t index);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "bytecode.h"
+
+void Program::AppendDisassembly(std::string& out) const {
+    for (const std::unique_ptr<Function>& function : Functions) {
+        out += "func ";
+        out += function->Name;
+        out += " (" + std::to_string(function->Parameters) + " parameters, " + std::to_string(function->Registers) + " registers)\n";
+        const std::vector<uint32_t>& code = function->Code;
+        for (size_t position = 0; position < code.size(); position++) {
+            uint32_t instruction = code[position];
+            Opcode op = DecodeOpcode(instruction);
+            std::string line = std::to_string(position);
+            out.append(line.size() < 6 ? 6 - line.size() : 0, ' ');
+            out += line;
+            out += "  ";
+            out += static_cast<size_t>(op) < OpcodeCount ? OpcodeNames[static_cast<size_t>(op)] : "???";
+            switch (OpcodeFormats[static_cast<size_t>(op) < OpcodeCount ? static_cast<size_t>(op) : 0]) {
+                case OperandFormat::NONE:
+                    break;
+                case OperandFormat::A:
+                    out += " " + std::to_string(DecodeA(instruction));
+                    break;
+                case OperandFormat::AB:
+                    out += " " + std::to_string(DecodeA(instruction)) + " " + std::to_string(DecodeB(instruction));
+                    break;
+                case OperandFormat::ABC:
+                    out += " " + std::to_string(DecodeA(instruction)) + " " + std::to_string(DecodeB(instruction)) + " " + std::to_string(DecodeC(instruction));
+                    break;
+                case OperandFormat::ABx:
+                    out += " " + std::to_string(DecodeA(instruction)) + " " + std::to_string(DecodeBx(instruction));
+                    if (op == Opcode::LOADK && DecodeBx(instruction) < function->Constants.size()) {
+                        out += "  ; ";
+                        AppendValue(out, function->Constants[DecodeBx(instruction)], 1);
+                    }
+                    else if (op == Opcode::GETGLOBAL || op == Opcode::SETGLOBAL) {
+                        uint32_t slot = DecodeBx(instruction);
+                        if (slot >= GlobalBase && slot - GlobalBase < Globals.size()) {
+                            out += "  ; " + Globals[slot - GlobalBase];
+                        }
+                        else if (auto linked = Linked.find(slot); linked != Linked.end()) {
+                            out += "  ; " + linked->second;
+                        }
+                    }
+                    break;
+                case OperandFormat::AsBx:
+                    out += " " + std::to_string(DecodeA(instruction));
+                    if (op == Opcode::LOADINT) {
+                        out += " " + std::to_string(DecodeSBx(instruction));
+                    }
+                    else {
+                        out += " -> " + std::to_string(position + 1 + DecodeSBx(instruction));
+                    }
+                    break;
+                case OperandFormat::sBx:
+                    out += " -> " + std::to_string(position + 1 + DecodeSBx(instruction));
+                    break;
+                case OperandFormat::ABField:
+                    // the name is the one of a field site, its index in the next word
+                    out += " " + std::to_string(DecodeA(instruction)) + " " + std::to_string(DecodeB(instruction));
+                    if (position + 1 < code.size()) {
+                        position++;
+                        if (code[position] < function->FieldSites.size()) {
+                            out += "  ; .";
+                            out += function->FieldSites[code[position]].Name;
+                        }
+                    }
+                    break;
+                case OperandFormat::ABJump:
+                    // the jump is the next word, relative to the word after it
+                    out += " " + std::to_string(DecodeA(instruction)) + " " + std::to_string(DecodeB(instruction));
+                    if (position + 1 < code.size()) {
+                        position++;
+                        out += " -> " + std::to_string(position + 1 + static_cast<int32_t>(code[position]));
+                    }
+                    break;
+            }
+            out += '\n';
+        }
+    }
+}
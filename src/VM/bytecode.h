@@ -0,0 +1,180 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "heap.h"
+#include "shape.h"
+
+#include <memory>
+#include <unordered_map>
+
+// every instruction of the VM. an instruction is one 32-bit word: the opcode in the low byte, then A, B and C
+// (a byte each, registers of the running function unless said otherwise) or A and Bx (16 bits, sBx when it is
+// a signed jump, relative to the next instruction). the JUMPIFNOT* ones take a second word, the jump as a
+// signed 32-bit number, and GETFIELD and SETFIELD one with the index of their field site (the field's name and the
+// inline cache of the instruction, see FieldSite). R(x) is a register, K(x) a constant, G(x) a global and F(x) the
+// name of a field site.
+//
+//   OPCODE(name, format)
+#define ILYS_OPCODE_SPEC(OPCODE) \
+    OPCODE(MOVE, AB)             /* R(A) = R(B) */ \
+    OPCODE(LOADK, ABx)           /* R(A) = K(Bx) */ \
+    OPCODE(LOADINT, AsBx)        /* R(A) = sBx, small whole numbers without a constant */ \
+    OPCODE(LOADNIL, A)           /* R(A) = nil */ \
+    OPCODE(LOADTRUE, A)          /* R(A) = true */ \
+    OPCODE(LOADFALSE, A)         /* R(A) = false */ \
+    OPCODE(GETGLOBAL, ABx)       /* R(A) = G(Bx) */ \
+    OPCODE(SETGLOBAL, ABx)       /* G(Bx) = R(A) */ \
+    /* arithmetic (PLUS also joins strings, when either side is one) */ \
+    OPCODE(ADD, ABC)             /* R(A) = R(B) + R(C) */ \
+    OPCODE(SUB, ABC)             /* R(A) = R(B) - R(C) */ \
+    OPCODE(MUL, ABC)             /* R(A) = R(B) * R(C) */ \
+    OPCODE(DIV, ABC)             /* R(A) = R(B) / R(C) */ \
+    OPCODE(MOD, ABC)             /* R(A) = R(B) % R(C) */ \
+    /* comparisons (> and >= are < and <= with B and C swapped) */ \
+    OPCODE(EQ, ABC)              /* R(A) = R(B) == R(C) */ \
+    OPCODE(NE, ABC)              /* R(A) = R(B) != R(C) */ \
+    OPCODE(LT, ABC)              /* R(A) = R(B) < R(C) */ \
+    OPCODE(LE, ABC)              /* R(A) = R(B) <= R(C) */ \
+    OPCODE(NEG, AB)              /* R(A) = -R(B) */ \
+    OPCODE(NOT, AB)              /* R(A) = !R(B) */ \
+    OPCODE(TYPEOF, AB)           /* R(A) = typeof R(B) */ \
+    OPCODE(INC, A)               /* R(A)++ */ \
+    OPCODE(DEC, A)               /* R(A)-- */ \
+    OPCODE(JUMP, sBx)            /* jump by sBx */ \
+    OPCODE(JUMPIFFALSE, AsBx)    /* jump by sBx if R(A) is false (also how && short-circuits) */ \
+    OPCODE(JUMPIFTRUE, AsBx)     /* jump by sBx if R(A) is true (how || short-circuits) */ \
+    /* superinstructions: a comparison and the branch on it */ \
+    OPCODE(JUMPIFNOTEQ, ABJump)  /* jump if !(R(A) == R(B)) */ \
+    OPCODE(JUMPIFNOTNE, ABJump)  /* jump if !(R(A) != R(B)) */ \
+    OPCODE(JUMPIFNOTLT, ABJump)  /* jump if !(R(A) < R(B)) */ \
+    OPCODE(JUMPIFNOTLE, ABJump)  /* jump if !(R(A) <= R(B)) */ \
+    /* superinstructions of for i in a..b: R(A) counts from a to R(A + 1) = b, R(A + 2) is i */ \
+    OPCODE(FORPREP, AsBx)        /* jump by sBx if R(A) > R(A + 1), else R(A + 2) = R(A) */ \
+    OPCODE(FORLOOP, AsBx)        /* R(A)++, if R(A) <= R(A + 1) then R(A + 2) = R(A) and jump by sBx */ \
+    /* for x in array (or string): R(A) is what is looped over, R(A + 1) the index, R(A + 2) is x */ \
+    /* (a string gives one code point at a time, the index is a byte offset moved past all its bytes) */ \
+    OPCODE(ITERATE, AsBx)        /* jump by sBx at the end, else R(A + 2) = R(A)[R(A + 1)++] */ \
+    OPCODE(NEWARRAY, ABx)        /* R(A) = [] with room for Bx elements */ \
+    OPCODE(APPEND, AB)           /* R(A) gets R(B) at its end */ \
+    OPCODE(RANGE, ABC)           /* R(A) = [R(B), ..., R(C)] */ \
+    OPCODE(GETINDEX, ABC)        /* R(A) = R(B)[R(C)] */ \
+    OPCODE(SETINDEX, ABC)        /* R(A)[R(B)] = R(C) */ \
+    OPCODE(NEWOBJECT, ABx)       /* R(A) = {} with room for Bx fields */ \
+    OPCODE(GETFIELD, ABField)    /* R(A) = R(B).F(next word), nil if it has no such field */ \
+    OPCODE(SETFIELD, ABField)    /* R(A).F(next word) = R(B) */ \
+    OPCODE(CALL, AB)             /* R(A) = R(A)(R(A + 1), ..., R(A + B)), the callee's registers start at A + 1 */ \
+    OPCODE(RETURN, A)            /* returns R(A) */ \
+    OPCODE(RETURNNIL, NONE)      /* returns nil */
+
+enum class Opcode : uint8_t {
+#define ILYS_OPCODE_ENUM(name, format) name,
+    ILYS_OPCODE_SPEC(ILYS_OPCODE_ENUM)
+#undef ILYS_OPCODE_ENUM
+};
+
+inline constexpr std::string_view OpcodeNames[] = {
+#define ILYS_OPCODE_NAME(name, format) #name,
+    ILYS_OPCODE_SPEC(ILYS_OPCODE_NAME)
+#undef ILYS_OPCODE_NAME
+};
+
+constexpr size_t OpcodeCount = sizeof(OpcodeNames) / sizeof(OpcodeNames[0]);
+
+// which operands an instruction has (for the disassembler, the VM knows each one's)
+enum class OperandFormat : uint8_t {
+    NONE,
+    A,
+    AB,
+    ABC,
+    ABx,
+    AsBx,
+    sBx,
+    ABJump,
+    ABField
+};
+
+inline constexpr OperandFormat OpcodeFormats[] = {
+#define ILYS_OPCODE_FORMAT(name, format) OperandFormat::format,
+    ILYS_OPCODE_SPEC(ILYS_OPCODE_FORMAT)
+#undef ILYS_OPCODE_FORMAT
+};
+
+// sBx is stored as sBx + JumpBias in the 16 bits of Bx, so it goes from -JumpBias to MaxShortJump
+constexpr int32_t JumpBias = 0x7FFF;
+constexpr int32_t MaxShortJump = 0xFFFF - JumpBias;
+
+constexpr uint32_t EncodeABC(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+    return static_cast<uint32_t>(op) | (a << 8) | (b << 16) | (c << 24);
+}
+
+constexpr uint32_t EncodeABx(Opcode op, uint32_t a, uint32_t bx) {
+    return static_cast<uint32_t>(op) | (a << 8) | (bx << 16);
+}
+
+constexpr Opcode DecodeOpcode(uint32_t instruction) {
+    return static_cast<Opcode>(instruction & 0xFF);
+}
+
+constexpr uint32_t DecodeA(uint32_t instruction) {
+    return (instruction >> 8) & 0xFF;
+}
+
+constexpr uint32_t DecodeB(uint32_t instruction) {
+    return (instruction >> 16) & 0xFF;
+}
+
+constexpr uint32_t DecodeC(uint32_t instruction) {
+    return instruction >> 24;
+}
+
+constexpr uint32_t DecodeBx(uint32_t instruction) {
+    return instruction >> 16;
+}
+
+constexpr int32_t DecodeSBx(uint32_t instruction) {
+    return static_cast<int32_t>(instruction >> 16) - JumpBias;
+}
+
+// a compiled function: its code and constants, and for every word of code the bytes of source it came from
+// (only read to report a runtime error)
+struct Function {
+    std::string Name;
+    std::vector<uint32_t> Code;
+    std::vector<Value> Constants;
+    struct Span {
+        uint32_t Offset;
+        uint32_t Length;
+    };
+    std::vector<Span> Spans;
+    uint32_t Parameters = 0;
+    // registers a call needs (the parameters are the first ones), at most 256
+    uint32_t Registers = 0;
+    // one per GETFIELD and SETFIELD, their caches are filled by every run of the function (in any VM)
+    std::vector<FieldSite> FieldSites;
+};
+
+// everything Compile gives for one file: its functions (the first one is the top level of the file), the names
+// of its globals (the VM gives each one a slot, in this order) and the objects its constants point to
+class Program {
+    public:
+        std::vector<std::unique_ptr<Function>> Functions;
+        // the natives first for a file compiled alone, only what the file declares for a module of a build
+        std::vector<std::string> Globals;
+        // slot of the first of Globals: 0 alone, past the natives and the globals of the modules before it in a
+        // build (see ModuleLink)
+        uint32_t GlobalBase = 0;
+        // the slots of a module's globals that aren't its own (the natives and what it imports), by slot, with
+        // their names
+        std::unordered_map<uint32_t, std::string> Linked;
+        Heap Constants{Heap::Kind::CONSTANTS};
+
+        const Function* GetMain() const {
+            return Functions.empty() ? nullptr : Functions.front().get();
+        }
+
+        // appends every function, one instruction per line: "  12  ADD 3 1 2", with jump targets worked out
+        // and constants shown
+        void AppendDisassembly(std::string& out) const;
+};
+
+#endif
@@ -0,0 +1,1134 @@
+#include "compiler.h"
+#include "natives.h"
+#include "../Lexer/utf8.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+// the instruction of every operator token that is one (the compound assignments give the instruction of their
+// operator), swapped when it is the instruction of the mirrored comparison (a > b is b < a)
+struct OperatorInstruction {
+    Opcode Op;
+    bool Swapped;
+    bool Valid;
+};
+
+constexpr std::array<OperatorInstruction, TokenTypeCount> BuildOperatorInstructions() {
+    std::array<OperatorInstruction, TokenTypeCount> instructions = {};
+    for (size_t i = 0; i < TokenTypeCount; i++) {
+        OperatorInstruction instruction = {Opcode::MOVE, false, true};
+        switch (static_cast<TokenType>(i)) {
+            case TokenType::PLUS: case TokenType::PLUSEQUALS: instruction.Op = Opcode::ADD; break;
+            case TokenType::MINUS: case TokenType::MINUSEQUALS: instruction.Op = Opcode::SUB; break;
+            case TokenType::MULTIPLY: case TokenType::MULTIPLYEQUALS: instruction.Op = Opcode::MUL; break;
+            case TokenType::DIVIDE: case TokenType::DIVIDEEQUALS: instruction.Op = Opcode::DIV; break;
+            case TokenType::MODULO: case TokenType::MODEQUALS: instruction.Op = Opcode::MOD; break;
+            case TokenType::EQUALS: instruction.Op = Opcode::EQ; break;
+            case TokenType::NOTEQUALS: instruction.Op = Opcode::NE; break;
+            case TokenType::LESSTHAN: instruction.Op = Opcode::LT; break;
+            case TokenType::LESSTHANEQUALS: instruction.Op = Opcode::LE; break;
+            case TokenType::GREATERTHAN: instruction = {Opcode::LT, true, true}; break;
+            case TokenType::GREATERTHANEQUALS: instruction = {Opcode::LE, true, true}; break;
+            default: instruction.Valid = false; break;
+        }
+        instructions[i] = instruction;
+    }
+    return instructions;
+}
+
+constexpr std::array<OperatorInstruction, TokenTypeCount> OperatorInstructions = BuildOperatorInstructions();
+
+// the compare-and-branch superinstruction of a comparison, MOVE for anything else
+static Opcode branchOf(Opcode op) {
+    switch (op) {
+        case Opcode::EQ: return Opcode::JUMPIFNOTEQ;
+        case Opcode::NE: return Opcode::JUMPIFNOTNE;
+        case Opcode::LT: return Opcode::JUMPIFNOTLT;
+        case Opcode::LE: return Opcode::JUMPIFNOTLE;
+        default: return Opcode::MOVE;
+    }
+}
+
+// the let, const, func or class a statement of the top level declares a global with (through its export), NoNode
+// if it declares none
+static NodeId globalDeclaration(const Ast& ast, NodeId statement) {
+    NodeId id = ast.Get(statement).Kind == NodeKind::EXPORT ? ast.Get(statement).First : statement;
+    NodeKind kind = ast.Get(id).Kind;
+    return kind == NodeKind::LET || kind == NodeKind::CONST || kind == NodeKind::FUNC || kind == NodeKind::CLASS ? id : NoNode;
+}
+
+std::vector<uint32_t> CollectGlobals(const TokenStream& tokens, const Ast& ast) {
+    std::vector<uint32_t> globals;
+    std::unordered_set<uint32_t> seen;
+    for (NodeId statement = ast.Get(ast.GetRoot()).First; statement != NoNode; statement = ast.Get(statement).Next) {
+        NodeId id = globalDeclaration(ast, statement);
+        if (id != NoNode && seen.insert(tokens.Tokens[ast.Get(id).Token].symbol).second) {
+            globals.push_back(ast.Get(id).Token);
+        }
+    }
+    return globals;
+}
+
+std::string DecodeString(std::string_view literal) {
+    std::string text;
+    if (literal.size() >= 2) {
+        literal = literal.substr(1, literal.size() - 2);
+    }
+    text.reserve(literal.size());
+    for (size_t i = 0; i < literal.size(); i++) {
+        if (literal[i] != '\\' || i + 1 == literal.size()) {
+            text += literal[i];
+            continue;
+        }
+        switch (literal[++i]) {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            case 'r': text += '\r'; break;
+            case '0': text += '\0'; break;
+            case '\\': text += '\\'; break;
+            case '"': text += '"'; break;
+            case 'u': {
+                size_t end = literal.find('}', i);
+                size_t digits = end - i - 2;
+                char32_t codePoint = 0;
+                bool valid = i + 1 < literal.size() && literal[i + 1] == '{' && end != std::string_view::npos && digits >= 1 && digits <= 6;
+                for (size_t j = i + 2; valid && j < end; j++) {
+                    char c = literal[j];
+                    int nibble = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+                    valid = nibble >= 0;
+                    codePoint = codePoint * 16 + nibble;
+                }
+                size_t before = text.size();
+                if (valid) {
+                    AppendUtf8(text, codePoint);
+                }
+                if (text.size() == before) {
+                    // not a code point (a surrogate, say), kept as written like an unknown escape
+                    text += '\\';
+                    text += 'u';
+                    break;
+                }
+                i = end;
+                break;
+            }
+            default:
+                text += '\\';
+                text += literal[i];
+                break;
+        }
+    }
+    return text;
+}
+
+// a register number that isn't one: the value of the expression isn't needed
+constexpr uint32_t NoTarget = UINT32_MAX;
+
+constexpr uint32_t MaxRegisters = 256;
+constexpr uint32_t MaxConstants = 1 << 16;
+
+// one compilation of one file, every kind of node has a method (see compiler.h)
+class Compiler {
+    public:
+        Compiler(const TokenStream& stream, const Ast& ast, Program& program, std::vector<Diagnostic>& diagnostics, const CompileOptions& options)
+            : Stream(stream), Tokens(stream.Tokens), Tree(ast), Output(program), Diagnostics(diagnostics), Options(options) {
+            State = nullptr;
+            Errors = 0;
+        }
+
+        bool CompileProgram() {
+            const Node& root = Tree.Get(Tree.GetRoot());
+            DeclareGlobals(root);
+            FunctionState main(NewFunction("<main>"), nullptr, root.Token);
+            State = &main;
+            for (NodeId statement = root.First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                CompileStatement(statement);
+            }
+            Emit(EncodeABC(Opcode::RETURNNIL, 0, 0, 0), root.Token);
+            State = nullptr;
+            return Errors == 0;
+        }
+
+    private:
+        struct Local {
+            uint32_t Symbol;
+            uint32_t Register;
+            bool Constant;
+        };
+
+        // what was there when a block started, given back at its end
+        struct Scope {
+            size_t Locals;
+            uint32_t FreeRegister;
+        };
+
+        // the function being compiled (and through Enclosing the ones it is in)
+        struct FunctionState {
+            FunctionState(Function* code, FunctionState* enclosing, uint32_t token) : Code(code), Enclosing(enclosing), Token(token) {
+            }
+
+            Function* Code;
+            FunctionState* Enclosing;
+            uint32_t Token;
+            std::vector<Local> Locals;
+            std::vector<Scope> Scopes;
+            // registers below it hold locals or temporaries still in use
+            uint32_t FreeRegister = 0;
+            // FUNCTION_TOO_LARGE was reported already
+            bool TooLarge = false;
+            // constant index of every number (by its bits) and string literal (by its symbol) already added
+            std::unordered_map<uint64_t, uint32_t> Numbers;
+            std::unordered_map<uint32_t, uint32_t> Strings;
+            // and of every string the optimizer made (by its text)
+            std::unordered_map<std::string, uint32_t> Texts;
+        };
+
+        struct Global {
+            uint32_t Slot;
+            bool Constant;
+        };
+
+        enum class NameKind {
+            LOCAL,
+            GLOBAL,
+            NONE
+        };
+
+        // what a name refers to: a register for a local, a slot for a global (NONE was reported already)
+        struct Name {
+            NameKind Kind;
+            uint32_t Index;
+            bool Constant;
+        };
+
+        // a jump still to be pointed at its target: the word that holds it, and whether that is the whole word
+        // (JUMPIFNOT*) or its Bx
+        struct Jump {
+            size_t Position;
+            bool Wide;
+        };
+
+        const TokenStream& Stream;
+        const std::vector<Token>& Tokens;
+        const Ast& Tree;
+        Program& Output;
+        std::vector<Diagnostic>& Diagnostics;
+        CompileOptions Options;
+        FunctionState* State;
+        std::unordered_map<uint32_t, Global> Globals;
+        // the decoded text of every string literal (by symbol), shared by the functions of the program
+        std::unordered_map<uint32_t, Value> Strings;
+        // every field name (by symbol) interned in the shape table, so the fields of objects are found by comparing
+        // pointers
+        std::unordered_map<uint32_t, std::string_view> Names;
+        // the strings the optimizer made (by their text)
+        std::unordered_map<std::string, Value> Texts;
+        size_t Errors;
+
+        void Report(DiagnosticCode code, uint32_t token) {
+            Errors++;
+            Diagnostic diagnostic{code, static_cast<uint32_t>(Stream.GetSource().size()), 0};
+            if (token < Tokens.size()) {
+                diagnostic.Offset = Tokens[token].offset;
+                diagnostic.Length = Tokens[token].length;
+            }
+            Diagnostics.push_back(diagnostic);
+        }
+
+        void ReportTooLarge() {
+            if (!State->TooLarge) {
+                State->TooLarge = true;
+                Report(DiagnosticCode::FUNCTION_TOO_LARGE, State->Token);
+            }
+        }
+
+        Function* NewFunction(std::string name) {
+            Output.Functions.push_back(std::make_unique<Function>());
+            Output.Functions.back()->Name = std::move(name);
+            return Output.Functions.back().get();
+        }
+
+        // the natives, then every let, const, func and class at the top level of the file (those are the globals,
+        // declared before anything is compiled so a function can call one defined after it). a module of a build
+        // gives its own globals the slots after its GlobalBase, in the order of CollectGlobals (a native's name
+        // too, a module can't change the natives of the others), and its imports the slots of their exporters
+        void DeclareGlobals(const Node& root) {
+            const ModuleLink* link = Options.Link;
+            const std::vector<NativeEntry>& natives = GetNatives();
+            for (uint32_t slot = 0; slot < natives.size(); slot++) {
+                Globals[Stream.Symbols->Intern(natives[slot].Name)] = Global{slot, true};
+                if (link) {
+                    Output.Linked[slot] = std::string(natives[slot].Name);
+                }
+                else {
+                    Output.Globals.emplace_back(natives[slot].Name);
+                }
+            }
+            if (link) {
+                Output.GlobalBase = link->GlobalBase;
+                for (uint32_t token : CollectGlobals(Stream, Tree)) {
+                    Globals[Tokens[token].symbol] = Global{Output.GlobalBase + static_cast<uint32_t>(Output.Globals.size()), false};
+                    Output.Globals.emplace_back(Stream.Text(Tokens[token]));
+                }
+                DeclareImports(root, *link);
+            }
+            bool overflowed = false;
+            for (NodeId statement = root.First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                NodeId id = globalDeclaration(Tree, statement);
+                if (id == NoNode) {
+                    continue;
+                }
+                const Node& node = Tree.Get(id);
+                uint32_t symbol = Tokens[node.Token].symbol;
+                auto found = Globals.find(symbol);
+                bool constant = node.Kind != NodeKind::LET;
+                if (found == Globals.end()) {
+                    found = Globals.emplace(symbol, Global{Output.GlobalBase + static_cast<uint32_t>(Output.Globals.size()), constant}).first;
+                    Output.Globals.emplace_back(Stream.Text(Tokens[node.Token]));
+                }
+                found->second.Constant = constant;
+                if (found->second.Slot >= MaxGlobals && !overflowed) {
+                    overflowed = true;
+                    Report(DiagnosticCode::TOO_MANY_GLOBALS, node.Token);
+                }
+            }
+        }
+
+        // every name of every import statement gets the slot its module exports it at (and is a constant here)
+        void DeclareImports(const Node& root, const ModuleLink& link) {
+            std::unordered_set<uint32_t> imported;
+            size_t index = 0;
+            for (NodeId statement = root.First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                if (Tree.Get(statement).Kind != NodeKind::IMPORT || index >= link.Imports.size()) {
+                    continue;
+                }
+                const ModuleExports& exports = *link.Imports[index++];
+                for (NodeId name = Tree.Get(statement).First; name != NoNode; name = Tree.Get(name).Next) {
+                    uint32_t token = Tree.Get(name).Token;
+                    uint32_t symbol = Tokens[token].symbol;
+                    auto exported = exports.find(symbol);
+                    auto found = Globals.find(symbol);
+                    if (exported == exports.end()) {
+                        Report(DiagnosticCode::NOT_EXPORTED, token);
+                    }
+                    else if (!imported.insert(symbol).second || (found != Globals.end() && found->second.Slot >= Output.GlobalBase)) {
+                        Report(DiagnosticCode::IMPORT_CONFLICT, token);
+                    }
+                    else {
+                        Globals[symbol] = Global{exported->second, true};
+                        Output.Linked[exported->second] = Stream.Text(Tokens[token]);
+                    }
+                }
+            }
+        }
+
+        // true at the top level of the file, outside of any block (where declarations make globals)
+        bool IsTopLevel() const {
+            return State->Enclosing == nullptr && State->Scopes.empty();
+        }
+
+        size_t Emit(uint32_t instruction, uint32_t token) {
+            Function* code = State->Code;
+            code->Code.push_back(instruction);
+            if (token < Tokens.size()) {
+                code->Spans.push_back(Function::Span{Tokens[token].offset, Tokens[token].length});
+            }
+            else {
+                code->Spans.push_back(Function::Span{static_cast<uint32_t>(Stream.GetSource().size()), 0});
+            }
+            return code->Code.size() - 1;
+        }
+
+        size_t Here() const {
+            return State->Code->Code.size();
+        }
+
+        Jump EmitJump(Opcode op, uint32_t a, uint32_t token) {
+            return Jump{Emit(EncodeABx(op, a, 0), token), false};
+        }
+
+        // a compare-and-branch, the jump is its second word
+        Jump EmitBranch(Opcode op, uint32_t a, uint32_t b, uint32_t token) {
+            Emit(EncodeABC(op, a, b, 0), token);
+            return Jump{Emit(0, token), true};
+        }
+
+        void PatchJumpTo(Jump jump, size_t target) {
+            int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(jump.Position + 1);
+            uint32_t& word = State->Code->Code[jump.Position];
+            if (jump.Wide) {
+                word = static_cast<uint32_t>(static_cast<int32_t>(offset));
+            }
+            else if (offset < -JumpBias || offset > MaxShortJump) {
+                ReportTooLarge();
+            }
+            else {
+                word = (word & 0xFFFF) | (static_cast<uint32_t>(offset + JumpBias) << 16);
+            }
+        }
+
+        void PatchJump(Jump jump) {
+            PatchJumpTo(jump, Here());
+        }
+
+        void PatchJumps(const std::vector<Jump>& jumps) {
+            for (Jump jump : jumps) {
+                PatchJump(jump);
+            }
+        }
+
+        uint32_t AllocateRegister() {
+            uint32_t reg = State->FreeRegister++;
+            if (State->FreeRegister > MaxRegisters) {
+                ReportTooLarge();
+                reg = MaxRegisters - 1;
+            }
+            State->Code->Registers = std::max(State->Code->Registers, std::min(State->FreeRegister, MaxRegisters));
+            return reg;
+        }
+
+        uint32_t AddConstant(Value value) {
+            std::vector<Value>& constants = State->Code->Constants;
+            if (constants.size() >= MaxConstants) {
+                ReportTooLarge();
+                return 0;
+            }
+            constants.push_back(value);
+            return static_cast<uint32_t>(constants.size() - 1);
+        }
+
+        uint32_t NumberConstant(double number) {
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            auto found = State->Numbers.find(bits);
+            if (found != State->Numbers.end()) {
+                return found->second;
+            }
+            uint32_t constant = AddConstant(Value::FromNumber(number));
+            State->Numbers[bits] = constant;
+            return constant;
+        }
+
+        uint32_t StringConstant(uint32_t token) {
+            uint32_t symbol = Tokens[token].symbol;
+            auto found = State->Strings.find(symbol);
+            if (found != State->Strings.end()) {
+                return found->second;
+            }
+            auto text = Strings.find(symbol);
+            if (text == Strings.end()) {
+                text = Strings.emplace(symbol, Output.Constants.NewString(DecodeString(Stream.Text(Tokens[token])))).first;
+            }
+            uint32_t constant = AddConstant(text->second);
+            State->Strings[symbol] = constant;
+            return constant;
+        }
+
+        // a string the optimizer worked out (see optimizer.h)
+        uint32_t TextConstant(const std::string& text) {
+            auto found = State->Texts.find(text);
+            if (found != State->Texts.end()) {
+                return found->second;
+            }
+            auto string = Texts.find(text);
+            if (string == Texts.end()) {
+                string = Texts.emplace(text, Output.Constants.NewString(text)).first;
+            }
+            uint32_t constant = AddConstant(string->second);
+            State->Texts[text] = constant;
+            return constant;
+        }
+
+        // the name of a field, the one copy the shape table has of it
+        std::string_view FieldName(uint32_t token) {
+            uint32_t symbol = Tokens[token].symbol;
+            auto name = Names.find(symbol);
+            if (name == Names.end()) {
+                name = Names.emplace(symbol, GetShapes().InternName(Stream.Text(Tokens[token]))).first;
+            }
+            return name->second;
+        }
+
+        // GETFIELD or SETFIELD, the next word is the index of a field site of its own (so its cache only sees the
+        // objects this instruction does)
+        void EmitField(Opcode op, uint32_t a, uint32_t b, std::string_view name, uint32_t token) {
+            Emit(EncodeABC(op, a, b, 0), token);
+            Emit(static_cast<uint32_t>(State->Code->FieldSites.size()), token);
+            State->Code->FieldSites.emplace_back(name);
+        }
+
+        void BeginScope() {
+            State->Scopes.push_back(Scope{State->Locals.size(), State->FreeRegister});
+        }
+
+        void EndScope() {
+            Scope scope = State->Scopes.back();
+            State->Scopes.pop_back();
+            State->Locals.resize(scope.Locals);
+            State->FreeRegister = scope.FreeRegister;
+        }
+
+        void DeclareLocal(uint32_t token, uint32_t reg, bool constant) {
+            State->Locals.push_back(Local{Tokens[token].symbol, reg, constant});
+        }
+
+        static const Local* FindLocal(const FunctionState* state, uint32_t symbol) {
+            for (auto local = state->Locals.rbegin(); local != state->Locals.rend(); ++local) {
+                if (local->Symbol == symbol) {
+                    return &*local;
+                }
+            }
+            return nullptr;
+        }
+
+        // the innermost local of that name in this function, else a global, else an error (a local of a function
+        // around this one would need a closure)
+        Name Resolve(uint32_t token) {
+            uint32_t symbol = Tokens[token].symbol;
+            if (const Local* local = FindLocal(State, symbol)) {
+                return Name{NameKind::LOCAL, local->Register, local->Constant};
+            }
+            for (const FunctionState* enclosing = State->Enclosing; enclosing != nullptr; enclosing = enclosing->Enclosing) {
+                if (FindLocal(enclosing, symbol)) {
+                    Report(DiagnosticCode::NOT_SUPPORTED, token);
+                    return Name{NameKind::NONE, 0, false};
+                }
+            }
+            auto global = Globals.find(symbol);
+            if (global != Globals.end()) {
+                return Name{NameKind::GLOBAL, global->second.Slot, global->second.Constant};
+            }
+            Report(DiagnosticCode::UNDEFINED_NAME, token);
+            return Name{NameKind::NONE, 0, false};
+        }
+
+        // Resolve for a name about to be assigned to
+        Name ResolveTarget(uint32_t token) {
+            Name name = Resolve(token);
+            if (name.Kind != NameKind::NONE && name.Constant) {
+                Report(DiagnosticCode::CONSTANT_ASSIGNMENT, token);
+            }
+            return name;
+        }
+
+        void EmitLoadName(const Name& name, uint32_t target, uint32_t token) {
+            if (name.Kind == NameKind::LOCAL && name.Index != target) {
+                Emit(EncodeABC(Opcode::MOVE, target, name.Index, 0), token);
+            }
+            else if (name.Kind == NameKind::GLOBAL) {
+                Emit(EncodeABx(Opcode::GETGLOBAL, target, name.Index), token);
+            }
+        }
+
+        void EmitNumber(double number, uint32_t target, uint32_t token) {
+            if (number == std::floor(number) && number >= -JumpBias && number <= MaxShortJump && !(number == 0 && std::signbit(number))) {
+                Emit(EncodeABx(Opcode::LOADINT, target, static_cast<uint32_t>(static_cast<int32_t>(number) + JumpBias)), token);
+            }
+            else {
+                Emit(EncodeABx(Opcode::LOADK, target, NumberConstant(number)), token);
+            }
+        }
+
+        void CompileStatement(NodeId id) {
+            const Node& node = Tree.Get(id);
+            switch (node.Kind) {
+                case NodeKind::LET: case NodeKind::CONST: CompileDeclaration(node); break;
+                case NodeKind::FUNC: case NodeKind::CLASS: CompileFunctionDeclaration(node); break;
+                case NodeKind::IF: CompileIf(node); break;
+                case NodeKind::FOR: case NodeKind::FOREVERY: CompileLoop(node); break;
+                case NodeKind::WHILE: CompileWhile(node); break;
+                case NodeKind::BLOCK: CompileBlock(id); break;
+                case NodeKind::RETURN: CompileReturn(node); break;
+                case NodeKind::EXPRESSION: CompileEffect(node.First); break;
+                case NodeKind::EXPORT: CompileStatement(node.First); break;
+                case NodeKind::IMPORT:
+                    // (its names were declared with the globals)
+                    if (!Options.Link) {
+                        Report(DiagnosticCode::NOT_SUPPORTED, node.Token);
+                    }
+                    break;
+                default: break;
+            }
+        }
+
+        void CompileBlock(NodeId id) {
+            BeginScope();
+            for (NodeId statement = Tree.Get(id).First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                CompileStatement(statement);
+            }
+            EndScope();
+        }
+
+        // let name [= value]   const name = value
+        void CompileDeclaration(const Node& node) {
+            uint32_t mark = State->FreeRegister;
+            uint32_t reg = AllocateRegister();
+            if (node.First != NoNode) {
+                CompileInto(node.First, reg);
+            }
+            else {
+                Emit(EncodeABC(Opcode::LOADNIL, reg, 0, 0), node.Token);
+            }
+            if (IsTopLevel()) {
+                Emit(EncodeABx(Opcode::SETGLOBAL, reg, Globals[Tokens[node.Token].symbol].Slot), node.Token);
+                State->FreeRegister = mark;
+            }
+            else {
+                // declared after its value, so let x = x + 1 reads the x from outside
+                DeclareLocal(node.Token, reg, node.Kind == NodeKind::CONST);
+            }
+        }
+
+        // func name(parameters) { body } or class name { members }, a constant holding the function object
+        void CompileFunctionDeclaration(const Node& node) {
+            Value function = node.Kind == NodeKind::CLASS ? CompileClass(node) : CompileFunction(node);
+            uint32_t mark = State->FreeRegister;
+            uint32_t reg = AllocateRegister();
+            Emit(EncodeABx(Opcode::LOADK, reg, AddConstant(function)), node.Token);
+            if (IsTopLevel()) {
+                Emit(EncodeABx(Opcode::SETGLOBAL, reg, Globals[Tokens[node.Token].symbol].Slot), node.Token);
+                State->FreeRegister = mark;
+            }
+            else {
+                DeclareLocal(node.Token, reg, true);
+            }
+        }
+
+        Value CompileFunction(const Node& node) {
+            Function* code = NewFunction(std::string(Stream.Text(Tokens[node.Token])));
+            FunctionState state(code, State, node.Token);
+            State = &state;
+            BeginScope();
+            for (NodeId parameter = node.First; parameter != NoNode; parameter = Tree.Get(parameter).Next) {
+                DeclareLocal(Tree.Get(parameter).Token, AllocateRegister(), false);
+                code->Parameters++;
+            }
+            // CALL has 8 bits for the count
+            if (code->Parameters > 255) {
+                ReportTooLarge();
+            }
+            for (NodeId statement = Tree.Get(node.Second).First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                CompileStatement(statement);
+            }
+            Emit(EncodeABC(Opcode::RETURNNIL, 0, 0, 0), node.Token);
+            State = state.Enclosing;
+            return Output.Constants.NewFunction(code);
+        }
+
+        // a class is the function that makes its objects (new Name() calls it): every let and const of the class
+        // is a field set to its value (worked out anew for each object), every func a field holding the function
+        Value CompileClass(const Node& node) {
+            Function* code = NewFunction(std::string(Stream.Text(Tokens[node.Token])));
+            FunctionState state(code, State, node.Token);
+            State = &state;
+            BeginScope();
+            uint32_t object = AllocateRegister();
+            size_t count = 0;
+            for (NodeId member = node.First; member != NoNode; member = Tree.Get(member).Next) {
+                count++;
+            }
+            Emit(EncodeABx(Opcode::NEWOBJECT, object, static_cast<uint32_t>(std::min<size_t>(count, 0xFFFF))), node.Token);
+            for (NodeId id = node.First; id != NoNode; id = Tree.Get(id).Next) {
+                const Node& member = Tree.Get(id);
+                uint32_t value = AllocateRegister();
+                if (member.Kind == NodeKind::FUNC) {
+                    Emit(EncodeABx(Opcode::LOADK, value, AddConstant(CompileFunction(member))), member.Token);
+                }
+                else if (member.First != NoNode) {
+                    CompileInto(member.First, value);
+                }
+                else {
+                    Emit(EncodeABC(Opcode::LOADNIL, value, 0, 0), member.Token);
+                }
+                EmitField(Opcode::SETFIELD, object, value, FieldName(member.Token), member.Token);
+                State->FreeRegister = object + 1;
+            }
+            Emit(EncodeABC(Opcode::RETURN, object, 0, 0), node.Token);
+            State = state.Enclosing;
+            return Output.Constants.NewFunction(code);
+        }
+
+        void CompileIf(const Node& node) {
+            std::vector<Jump> otherwise;
+            CompileCondition(node.First, otherwise);
+            CompileBlock(node.Second);
+            if (node.Third == NoNode) {
+                PatchJumps(otherwise);
+                return;
+            }
+            Jump end = EmitJump(Opcode::JUMP, 0, node.Token);
+            PatchJumps(otherwise);
+            CompileStatement(node.Third);
+            PatchJump(end);
+        }
+
+        void CompileWhile(const Node& node) {
+            size_t top = Here();
+            std::vector<Jump> exits;
+            CompileCondition(node.First, exits);
+            CompileBlock(node.Second);
+            PatchJumpTo(EmitJump(Opcode::JUMP, 0, node.Token), top);
+            PatchJumps(exits);
+        }
+
+        // for [name in] array { } goes through the elements (forevery is the same), and so does for [name in] a..b
+        // { } through the array of the range, unless the optimizer marked it to count from a to b (both included)
+        // instead. three registers in a row: the counter (or what is looped over), the limit (or the index) and
+        // the variable
+        void CompileLoop(const Node& node) {
+            const Node& iterable = Tree.Get(node.Second);
+            BeginScope();
+            uint32_t base = AllocateRegister();
+            AllocateRegister();
+            uint32_t variable = AllocateRegister();
+
+            if (node.Operator == TokenType::DOTDOT) {
+                CompileInto(iterable.First, base);
+                CompileInto(iterable.Second, base + 1);
+                if (node.First != NoNode) {
+                    DeclareLocal(Tree.Get(node.First).Token, variable, false);
+                }
+                if (Options.Superinstructions) {
+                    Jump skip = EmitJump(Opcode::FORPREP, base, iterable.Token);
+                    size_t body = Here();
+                    CompileBlock(node.Third);
+                    PatchJumpTo(EmitJump(Opcode::FORLOOP, base, iterable.Token), body);
+                    PatchJump(skip);
+                }
+                else {
+                    size_t top = Here();
+                    uint32_t test = AllocateRegister();
+                    Emit(EncodeABC(Opcode::LE, test, base, base + 1), iterable.Token);
+                    Jump exit = EmitJump(Opcode::JUMPIFFALSE, test, iterable.Token);
+                    State->FreeRegister--;
+                    Emit(EncodeABC(Opcode::MOVE, variable, base, 0), iterable.Token);
+                    CompileBlock(node.Third);
+                    Emit(EncodeABC(Opcode::INC, base, 0, 0), iterable.Token);
+                    PatchJumpTo(EmitJump(Opcode::JUMP, 0, iterable.Token), top);
+                    PatchJump(exit);
+                }
+            }
+            else {
+                CompileInto(node.Second, base);
+                Emit(EncodeABx(Opcode::LOADINT, base + 1, JumpBias), node.Token);
+                if (node.First != NoNode) {
+                    DeclareLocal(Tree.Get(node.First).Token, variable, false);
+                }
+                size_t top = Here();
+                Jump exit = EmitJump(Opcode::ITERATE, base, iterable.Token);
+                CompileBlock(node.Third);
+                PatchJumpTo(EmitJump(Opcode::JUMP, 0, node.Token), top);
+                PatchJump(exit);
+            }
+            EndScope();
+        }
+
+        void CompileReturn(const Node& node) {
+            if (node.First == NoNode) {
+                Emit(EncodeABC(Opcode::RETURNNIL, 0, 0, 0), node.Token);
+                return;
+            }
+            uint32_t mark = State->FreeRegister;
+            Emit(EncodeABC(Opcode::RETURN, CompileOperand(node.First), 0, 0), node.Token);
+            State->FreeRegister = mark;
+        }
+
+        // an expression whose value isn't used (assignments and increments then skip making one)
+        void CompileEffect(NodeId id) {
+            const Node& node = Tree.Get(id);
+            if (node.Kind == NodeKind::ASSIGN) {
+                CompileAssign(node, NoTarget);
+                return;
+            }
+            if (node.Kind == NodeKind::POSTFIX || (node.Kind == NodeKind::UNARY && (node.Operator == TokenType::PLUSPLUS || node.Operator == TokenType::MINUSMINUS))) {
+                CompileIncrement(node, NoTarget);
+                return;
+            }
+            uint32_t mark = State->FreeRegister;
+            CompileInto(id, AllocateRegister());
+            State->FreeRegister = mark;
+        }
+
+        // appends to exits the jumps taken when the condition is false: a comparison becomes one
+        // compare-and-branch, a && b the jumps of a then those of b, a constant nothing or a jump
+        void CompileCondition(NodeId id, std::vector<Jump>& exits) {
+            const Node& node = Tree.Get(id);
+            if (node.Kind == NodeKind::BINARY && node.Operator == TokenType::AND) {
+                CompileCondition(node.First, exits);
+                CompileCondition(node.Second, exits);
+                return;
+            }
+            if (node.Kind == NodeKind::CONSTANT) {
+                const ConstantValue& constant = Tree.GetConstant(node.First);
+                if (constant.Type == ConstantValue::Kind::BOOLEAN && !constant.Boolean) {
+                    exits.push_back(EmitJump(Opcode::JUMP, 0, node.Token));
+                }
+                return;
+            }
+            uint32_t mark = State->FreeRegister;
+            OperatorInstruction instruction = OperatorInstructions[static_cast<size_t>(node.Operator)];
+            if (Options.Superinstructions && node.Kind == NodeKind::BINARY && instruction.Valid && branchOf(instruction.Op) != Opcode::MOVE) {
+                uint32_t left = CompileOperand(node.First);
+                uint32_t right = CompileOperand(node.Second);
+                if (instruction.Swapped) {
+                    std::swap(left, right);
+                }
+                exits.push_back(EmitBranch(branchOf(instruction.Op), left, right, node.Token));
+            }
+            else {
+                exits.push_back(EmitJump(Opcode::JUMPIFFALSE, CompileOperand(id), node.Token));
+            }
+            State->FreeRegister = mark;
+        }
+
+        // a register holding the value: a local's own register, or a new temporary (given back with the rest
+        // when the caller resets FreeRegister)
+        uint32_t CompileOperand(NodeId id) {
+            const Node& node = Tree.Get(id);
+            if (node.Kind == NodeKind::IDENTIFIER) {
+                Name name = Resolve(node.Token);
+                if (name.Kind == NameKind::LOCAL) {
+                    return name.Index;
+                }
+                uint32_t reg = AllocateRegister();
+                EmitLoadName(name, reg, node.Token);
+                return reg;
+            }
+            uint32_t reg = AllocateRegister();
+            CompileInto(id, reg);
+            return reg;
+        }
+
+        // kinds that read all of their operands before they write their target, so the target can be a local the
+        // expression reads (x = x + 1 straight into x). every other kind is only compiled into a register nothing
+        // else reads
+        bool WritesTargetLast(const Node& node) const {
+            switch (node.Kind) {
+                case NodeKind::NUMBER: case NodeKind::STRING: case NodeKind::BOOLEAN: case NodeKind::IDENTIFIER: case NodeKind::INDEX:
+                case NodeKind::MEMBER: case NodeKind::CONSTANT:
+                    return true;
+                case NodeKind::BINARY:
+                    return node.Operator != TokenType::AND && node.Operator != TokenType::OR;
+                case NodeKind::UNARY:
+                    return node.Operator != TokenType::PLUSPLUS && node.Operator != TokenType::MINUSMINUS;
+                default:
+                    return false;
+            }
+        }
+
+        void CompileInto(NodeId id, uint32_t target) {
+            const Node& node = Tree.Get(id);
+            uint32_t mark = State->FreeRegister;
+            switch (node.Kind) {
+                case NodeKind::NUMBER:
+                    EmitNumber(Stream.Number(Tokens[node.Token]).ToDouble(), target, node.Token);
+                    break;
+                case NodeKind::STRING:
+                    Emit(EncodeABx(Opcode::LOADK, target, StringConstant(node.Token)), node.Token);
+                    break;
+                case NodeKind::BOOLEAN: {
+                    bool value = Tokens[node.Token].type == TokenType::TRUE_TOKEN;
+                    Emit(EncodeABC(value ? Opcode::LOADTRUE : Opcode::LOADFALSE, target, 0, 0), node.Token);
+                    break;
+                }
+                case NodeKind::IDENTIFIER:
+                    EmitLoadName(Resolve(node.Token), target, node.Token);
+                    break;
+                case NodeKind::CONSTANT: {
+                    const ConstantValue& constant = Tree.GetConstant(node.First);
+                    if (constant.Type == ConstantValue::Kind::NUMBER) {
+                        EmitNumber(constant.Number, target, node.Token);
+                    }
+                    else if (constant.Type == ConstantValue::Kind::BOOLEAN) {
+                        Emit(EncodeABC(constant.Boolean ? Opcode::LOADTRUE : Opcode::LOADFALSE, target, 0, 0), node.Token);
+                    }
+                    else {
+                        Emit(EncodeABx(Opcode::LOADK, target, TextConstant(constant.Text)), node.Token);
+                    }
+                    break;
+                }
+                case NodeKind::ARRAY: {
+                    size_t count = 0;
+                    for (NodeId element = node.First; element != NoNode; element = Tree.Get(element).Next) {
+                        count++;
+                    }
+                    Emit(EncodeABx(Opcode::NEWARRAY, target, static_cast<uint32_t>(std::min<size_t>(count, 0xFFFF))), node.Token);
+                    for (NodeId element = node.First; element != NoNode; element = Tree.Get(element).Next) {
+                        Emit(EncodeABC(Opcode::APPEND, target, CompileOperand(element), 0), Tree.Get(element).Token);
+                        State->FreeRegister = mark;
+                    }
+                    break;
+                }
+                case NodeKind::OBJECT: {
+                    size_t count = 0;
+                    for (NodeId field = node.First; field != NoNode; field = Tree.Get(field).Next) {
+                        count++;
+                    }
+                    Emit(EncodeABx(Opcode::NEWOBJECT, target, static_cast<uint32_t>(std::min<size_t>(count, 0xFFFF))), node.Token);
+                    for (NodeId id = node.First; id != NoNode; id = Tree.Get(id).Next) {
+                        const Node& field = Tree.Get(id);
+                        EmitField(Opcode::SETFIELD, target, CompileOperand(field.First), FieldName(field.Token), field.Token);
+                        State->FreeRegister = mark;
+                    }
+                    break;
+                }
+                case NodeKind::UNARY:
+                    if (node.Operator == TokenType::PLUSPLUS || node.Operator == TokenType::MINUSMINUS) {
+                        CompileIncrement(node, target);
+                        break;
+                    }
+                    {
+                        Opcode op = node.Operator == TokenType::MINUS ? Opcode::NEG : node.Operator == TokenType::NOT ? Opcode::NOT : Opcode::TYPEOF;
+                        Emit(EncodeABC(op, target, CompileOperand(node.First), 0), node.Token);
+                    }
+                    break;
+                case NodeKind::POSTFIX:
+                    CompileIncrement(node, target);
+                    break;
+                case NodeKind::BINARY:
+                    CompileBinary(node, target);
+                    break;
+                case NodeKind::ASSIGN:
+                    CompileAssign(node, target);
+                    break;
+                case NodeKind::CONDITIONAL: {
+                    std::vector<Jump> otherwise;
+                    CompileCondition(node.First, otherwise);
+                    CompileInto(node.Second, target);
+                    Jump end = EmitJump(Opcode::JUMP, 0, node.Token);
+                    PatchJumps(otherwise);
+                    CompileInto(node.Third, target);
+                    PatchJump(end);
+                    break;
+                }
+                case NodeKind::CALL:
+                    CompileCall(node.First, node.Second, node.Token, target);
+                    break;
+                case NodeKind::NEW: {
+                    // new Name(arguments) calls what Name is (a class makes an object), new Name is new Name()
+                    const Node& constructed = Tree.Get(node.First);
+                    if (constructed.Kind == NodeKind::CALL) {
+                        CompileCall(constructed.First, constructed.Second, constructed.Token, target);
+                    }
+                    else {
+                        CompileCall(node.First, NoNode, node.Token, target);
+                    }
+                    break;
+                }
+                case NodeKind::INDEX: {
+                    uint32_t object = CompileOperand(node.First);
+                    uint32_t index = CompileOperand(node.Second);
+                    Emit(EncodeABC(Opcode::GETINDEX, target, object, index), node.Token);
+                    break;
+                }
+                case NodeKind::MEMBER:
+                    EmitField(Opcode::GETFIELD, target, CompileOperand(node.First), FieldName(node.Token), node.Token);
+                    break;
+                default:
+                    break;
+            }
+            State->FreeRegister = mark;
+        }
+
+        void CompileBinary(const Node& node, uint32_t target) {
+            if (node.Operator == TokenType::AND || node.Operator == TokenType::OR) {
+                // the value of a && b is a if a is false and b otherwise, b is only worked out when needed
+                CompileInto(node.First, target);
+                Jump end = EmitJump(node.Operator == TokenType::AND ? Opcode::JUMPIFFALSE : Opcode::JUMPIFTRUE, target, node.Token);
+                CompileInto(node.Second, target);
+                PatchJump(end);
+                return;
+            }
+            uint32_t left = CompileOperand(node.First);
+            uint32_t right = CompileOperand(node.Second);
+            if (node.Operator == TokenType::DOTDOT) {
+                Emit(EncodeABC(Opcode::RANGE, target, left, right), node.Token);
+                return;
+            }
+            OperatorInstruction instruction = OperatorInstructions[static_cast<size_t>(node.Operator)];
+            if (instruction.Swapped) {
+                std::swap(left, right);
+            }
+            Emit(EncodeABC(instruction.Op, target, left, right), node.Token);
+        }
+
+        // the callee goes in a register with the arguments in the ones after it, where the call leaves its result
+        // (the target itself when it is the last register taken, which saves a MOVE)
+        void CompileCall(NodeId calleeId, NodeId arguments, uint32_t token, uint32_t target) {
+            uint32_t mark = State->FreeRegister;
+            uint32_t base = target != NoTarget && target + 1 == State->FreeRegister ? target : AllocateRegister();
+            const Node& callee = Tree.Get(calleeId);
+            CompileInto(calleeId, base);
+            uint32_t count = 0;
+            for (NodeId argument = arguments; argument != NoNode; argument = Tree.Get(argument).Next) {
+                CompileInto(argument, AllocateRegister());
+                count++;
+            }
+            if (count > 255) {
+                ReportTooLarge();
+            }
+            // errors in the call point at the name of what is called when it has one (a const the optimizer
+            // replaced still has its name)
+            bool named = callee.Kind == NodeKind::IDENTIFIER || callee.Kind == NodeKind::MEMBER
+                || (callee.Kind == NodeKind::CONSTANT && Tokens[callee.Token].type == TokenType::IDENTIFIER);
+            Emit(EncodeABC(Opcode::CALL, base, count & 0xFF, 0), named ? callee.Token : token);
+            if (base != target && target != NoTarget) {
+                Emit(EncodeABC(Opcode::MOVE, target, base, 0), token);
+            }
+            State->FreeRegister = mark;
+        }
+
+        // name = value, name op= value, array[index] = value, object.name = value, ... (the value is left in target
+        // if there is one)
+        void CompileAssign(const Node& node, uint32_t target) {
+            const Node& left = Tree.Get(node.First);
+            bool compound = node.Operator != TokenType::ASSIGNMENT;
+            Opcode op = OperatorInstructions[static_cast<size_t>(node.Operator)].Op;
+            uint32_t mark = State->FreeRegister;
+            switch (left.Kind) {
+                case NodeKind::IDENTIFIER: {
+                    Name name = ResolveTarget(left.Token);
+                    if (name.Kind == NameKind::LOCAL) {
+                        if (compound) {
+                            Emit(EncodeABC(op, name.Index, name.Index, CompileOperand(node.Second)), node.Token);
+                        }
+                        else if (WritesTargetLast(Tree.Get(node.Second))) {
+                            CompileInto(node.Second, name.Index);
+                        }
+                        else {
+                            uint32_t value = AllocateRegister();
+                            CompileInto(node.Second, value);
+                            Emit(EncodeABC(Opcode::MOVE, name.Index, value, 0), node.Token);
+                        }
+                        if (target != NoTarget) {
+                            Emit(EncodeABC(Opcode::MOVE, target, name.Index, 0), node.Token);
+                        }
+                    }
+                    else if (name.Kind == NameKind::GLOBAL) {
+                        uint32_t value = target != NoTarget ? target : AllocateRegister();
+                        if (compound) {
+                            Emit(EncodeABx(Opcode::GETGLOBAL, value, name.Index), left.Token);
+                            Emit(EncodeABC(op, value, value, CompileOperand(node.Second)), node.Token);
+                        }
+                        else {
+                            CompileInto(node.Second, value);
+                        }
+                        Emit(EncodeABx(Opcode::SETGLOBAL, value, name.Index), node.Token);
+                    }
+                    break;
+                }
+                case NodeKind::INDEX: {
+                    uint32_t object = CompileOperand(left.First);
+                    uint32_t index = CompileOperand(left.Second);
+                    uint32_t value;
+                    if (compound) {
+                        value = target != NoTarget ? target : AllocateRegister();
+                        Emit(EncodeABC(Opcode::GETINDEX, value, object, index), left.Token);
+                        Emit(EncodeABC(op, value, value, CompileOperand(node.Second)), node.Token);
+                    }
+                    else if (target != NoTarget) {
+                        value = target;
+                        CompileInto(node.Second, value);
+                    }
+                    else {
+                        value = CompileOperand(node.Second);
+                    }
+                    Emit(EncodeABC(Opcode::SETINDEX, object, index, value), node.Token);
+                    break;
+                }
+                case NodeKind::MEMBER: {
+                    uint32_t object = CompileOperand(left.First);
+                    std::string_view name = FieldName(left.Token);
+                    uint32_t value;
+                    if (compound) {
+                        value = target != NoTarget ? target : AllocateRegister();
+                        EmitField(Opcode::GETFIELD, value, object, name, left.Token);
+                        Emit(EncodeABC(op, value, value, CompileOperand(node.Second)), node.Token);
+                    }
+                    else if (target != NoTarget) {
+                        value = target;
+                        CompileInto(node.Second, value);
+                    }
+                    else {
+                        value = CompileOperand(node.Second);
+                    }
+                    EmitField(Opcode::SETFIELD, object, value, name, node.Token);
+                    break;
+                }
+                default:
+                    Report(DiagnosticCode::NOT_SUPPORTED, left.Token);
+                    break;
+            }
+            State->FreeRegister = mark;
+        }
+
+        // ++ and -- before or after a name, an index or a field, target gets the value after (before) or before (after)
+        void CompileIncrement(const Node& node, uint32_t target) {
+            Opcode step = node.Operator == TokenType::PLUSPLUS ? Opcode::INC : Opcode::DEC;
+            bool prefix = node.Kind == NodeKind::UNARY;
+            const Node& operand = Tree.Get(node.First);
+            uint32_t mark = State->FreeRegister;
+            uint32_t reg;
+            switch (operand.Kind) {
+                case NodeKind::IDENTIFIER: {
+                    Name name = ResolveTarget(operand.Token);
+                    if (name.Kind == NameKind::NONE) {
+                        return;
+                    }
+                    reg = name.Kind == NameKind::LOCAL ? name.Index : AllocateRegister();
+                    if (name.Kind == NameKind::GLOBAL) {
+                        Emit(EncodeABx(Opcode::GETGLOBAL, reg, name.Index), operand.Token);
+                    }
+                    if (!prefix && target != NoTarget) {
+                        Emit(EncodeABC(Opcode::MOVE, target, reg, 0), node.Token);
+                    }
+                    Emit(EncodeABC(step, reg, 0, 0), node.Token);
+                    if (name.Kind == NameKind::GLOBAL) {
+                        Emit(EncodeABx(Opcode::SETGLOBAL, reg, name.Index), node.Token);
+                    }
+                    break;
+                }
+                case NodeKind::INDEX: {
+                    uint32_t object = CompileOperand(operand.First);
+                    uint32_t index = CompileOperand(operand.Second);
+                    reg = AllocateRegister();
+                    Emit(EncodeABC(Opcode::GETINDEX, reg, object, index), operand.Token);
+                    if (!prefix && target != NoTarget) {
+                        Emit(EncodeABC(Opcode::MOVE, target, reg, 0), node.Token);
+                    }
+                    Emit(EncodeABC(step, reg, 0, 0), node.Token);
+                    Emit(EncodeABC(Opcode::SETINDEX, object, index, reg), node.Token);
+                    break;
+                }
+                case NodeKind::MEMBER: {
+                    uint32_t object = CompileOperand(operand.First);
+                    std::string_view name = FieldName(operand.Token);
+                    reg = AllocateRegister();
+                    EmitField(Opcode::GETFIELD, reg, object, name, operand.Token);
+                    if (!prefix && target != NoTarget) {
+                        Emit(EncodeABC(Opcode::MOVE, target, reg, 0), node.Token);
+                    }
+                    Emit(EncodeABC(step, reg, 0, 0), node.Token);
+                    EmitField(Opcode::SETFIELD, object, reg, name, node.Token);
+                    break;
+                }
+                default:
+                    Report(DiagnosticCode::NOT_SUPPORTED, operand.Token);
+                    return;
+            }
+            if (prefix && target != NoTarget) {
+                Emit(EncodeABC(Opcode::MOVE, target, reg, 0), node.Token);
+            }
+            State->FreeRegister = mark;
+        }
+};
+
+bool Compile(const TokenStream& tokens, const Ast& ast, Program& program, std::vector<Diagnostic>& diagnostics, const CompileOptions& options) {
+    if (ast.GetRoot() == NoNode || !tokens.Symbols) {
+        return false;
+    }
+    Compiler compiler(tokens, ast, program, diagnostics, options);
+    return compiler.CompileProgram();
+}
@@ -0,0 +1,52 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "bytecode.h"
+#include "../Parser/ast.h"
+#include "../Lexer/diagnostics.h"
+
+#include <unordered_map>
+
+// GETGLOBAL and SETGLOBAL have 16 bits for the slot
+constexpr uint32_t MaxGlobals = 1 << 16;
+
+// the names a module exports (by symbol) and the slot of each one
+using ModuleExports = std::unordered_map<uint32_t, uint32_t>;
+
+// how a file is compiled as one module of a build (see modules.h): every module's globals live in one set of
+// slots, so an imported name is the exporter's global itself (a constant for the importer), with nothing to copy
+// or look up at run time, and the importer sees what the exporter assigns to it later
+struct ModuleLink {
+    // slot of the file's first global, after the natives and the globals of every module before it
+    uint32_t GlobalBase = 0;
+    // the exports of the module each import statement of the file names, in the order of the statements
+    std::vector<const ModuleExports*> Imports;
+};
+
+struct CompileOptions {
+    // compare-and-branch for conditions that are a comparison and FORPREP/FORLOOP for the range loops the
+    // optimizer made counted, off gives the plain instructions instead (same results, to measure what they save)
+    bool Superinstructions = true;
+    // null for a file on its own, where an import is NOT_SUPPORTED
+    const ModuleLink* Link = nullptr;
+};
+
+// compiles a parsed file (it must have parsed without errors, and may have been optimized, see optimizer.h) into
+// program (which has to be empty): one function for the top level and one per func, with registers given out like
+// a stack (every local keeps one for its block, temporaries are taken and given back by each expression).
+// names are resolved here: a local of the function, else a global (a let, const or func at the top level of the
+// file, a name it imports with options.Link, or a native function, see natives.h), else UNDEFINED_NAME. a function can't use the locals of the
+// function around it (there are no closures yet, that is NOT_SUPPORTED).
+// returns true if there were no errors (appended to diagnostics)
+bool Compile(const TokenStream& tokens, const Ast& ast, Program& program, std::vector<Diagnostic>& diagnostics, const CompileOptions& options = CompileOptions());
+
+// the globals a file declares as a module (every let, const, func and class of its top level, exported or not), the
+// token of each name's first declaration, in the order Compile gives them their slots from ModuleLink::GlobalBase
+std::vector<uint32_t> CollectGlobals(const TokenStream& tokens, const Ast& ast);
+
+// the text of a string literal: its quotes taken off and the escapes \n \t \r \0 \\ and \" turned into what they
+// stand for, \u{...} (1 to 6 hex digits) into the UTF-8 of its code point (any other backslash, and a \u{...} that
+// isn't a code point, is kept as it is)
+std::string DecodeString(std::string_view literal);
+
+#endif
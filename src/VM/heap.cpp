@@ -0,0 +1,356 @@
+#include "heap.h"
+#include "shape.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+// objects bigger than this part of the nursery start old (copying them out again would cost more than it saves)
+constexpr size_t LargeObjectShare = 8;
+
+static size_t roundUp(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// what an old object costs, with what its elements or fields take
+static size_t footprint(const Object* object) {
+    switch (object->Type) {
+        case ValueType::ARRAY: return object->Size + static_cast<const ArrayObject*>(object)->Elements.capacity() * sizeof(Value);
+        case ValueType::OBJECT: return object->Size + static_cast<const InstanceObject*>(object)->Slots.capacity() * sizeof(Value);
+        default: return object->Size;
+    }
+}
+
+void GcStats::Merge(const GcStats& other) {
+    MinorCollections += other.MinorCollections;
+    MajorCollections += other.MajorCollections;
+    AllocatedBytes += other.AllocatedBytes;
+    PromotedBytes += other.PromotedBytes;
+    FreedBytes += other.FreedBytes;
+    MinorSeconds += other.MinorSeconds;
+    MajorSeconds += other.MajorSeconds;
+    LongestPause = std::max(LongestPause, other.LongestPause);
+    for (size_t i = 0; i < 5; i++) {
+        Pauses[i] += other.Pauses[i];
+    }
+}
+
+void GcStats::PrintText(std::ostream& out) const {
+    out << "GC stats: " << std::fixed << std::setprecision(1) << AllocatedBytes / 1048576.0 << " MB allocated, "
+        << PromotedBytes / 1048576.0 << " MB promoted (" << (AllocatedBytes > 0 ? PromotedBytes * 100.0 / AllocatedBytes : 0)
+        << "%), " << FreedBytes / 1048576.0 << " MB freed by major collections\n";
+    out << "  " << MinorCollections << " minor collections in " << std::setprecision(3) << MinorSeconds * 1e3 << " ms, "
+        << MajorCollections << " major in " << MajorSeconds * 1e3 << " ms, longest pause " << LongestPause * 1e3 << " ms\n";
+    out << "  pauses: " << Pauses[0] << " under 10 us, " << Pauses[1] << " under 100 us, " << Pauses[2] << " under 1 ms, "
+        << Pauses[3] << " under 10 ms, " << Pauses[4] << " longer\n";
+}
+
+Heap::Heap(Kind kind) : HeapKind(kind) {
+    NurserySize = 0;
+    NurseryTop = nullptr;
+    NurseryEnd = nullptr;
+    NurseryObjects = 0;
+    OldBytes = 0;
+    NextMajor = 0;
+    Marking = false;
+    if (kind == Kind::COLLECTED) {
+        SetNurserySize(DefaultNurserySize);
+    }
+}
+
+Heap::~Heap() {
+    Clear();
+}
+
+void Heap::SetNurserySize(size_t bytes) {
+    Clear();
+    NurserySize = roundUp(std::max<size_t>(bytes, 256));
+    Nursery = std::make_unique<uint64_t[]>(NurserySize / 8);
+    NurseryTop = reinterpret_cast<char*>(Nursery.get());
+    NurseryEnd = NurseryTop + NurserySize;
+    NextMajor = std::max(OldBytes * 2, NurserySize * 8);
+}
+
+void Heap::SetRootScanner(RootScanner scanner) {
+    Scanner = std::move(scanner);
+}
+
+size_t Heap::GetObjectCount() const {
+    return NurseryObjects + OldObjects.size();
+}
+
+const GcStats& Heap::GetStats() const {
+    return Stats;
+}
+
+void Heap::ResetStats() {
+    Stats = GcStats();
+}
+
+void* Heap::AllocateSlow(size_t size) {
+    if (HeapKind == Kind::CONSTANTS || size > NurserySize / LargeObjectShare) {
+        Stats.AllocatedBytes += size;
+        return AllocateOld(size);
+    }
+    Collect();
+    return Allocate(size);
+}
+
+void* Heap::AllocateOld(size_t size) {
+    void* memory = ::operator new(size);
+    OldObjects.push_back(static_cast<Object*>(memory));
+    OldBytes += size;
+    return memory;
+}
+
+// makes a T of size bytes (its header filled in, the rest as T's constructor leaves it) wherever Allocate puts it
+template <typename T>
+static T* construct(void* memory, ValueType type, size_t size, const char* nurseryStart, const char* nurseryEnd, bool constant) {
+    T* object = new (memory) T();
+    object->Type = type;
+    object->Where = constant ? Generation::PERMANENT : memory >= nurseryStart && memory < nurseryEnd ? Generation::NURSERY : Generation::OLD;
+    object->Marked = false;
+    object->Remembered = false;
+    object->Size = static_cast<uint32_t>(size);
+    object->Forward = nullptr;
+    return object;
+}
+
+StringObject* Heap::NewStringOfLength(size_t length) {
+    size_t size = roundUp(sizeof(StringObject) + length);
+    void* memory = Allocate(size);
+    const char* start = reinterpret_cast<const char*>(Nursery.get());
+    StringObject* string = construct<StringObject>(memory, ValueType::STRING, size, start, start + NurserySize, HeapKind == Kind::CONSTANTS);
+    string->Length = static_cast<uint32_t>(length);
+    return string;
+}
+
+Value Heap::NewString(std::string_view text) {
+    StringObject* string = NewStringOfLength(text.size());
+    std::memcpy(string->GetChars(), text.data(), text.size());
+    return Value::FromObject(string);
+}
+
+Value Heap::NewArray(size_t capacity) {
+    void* memory = Allocate(roundUp(sizeof(ArrayObject)));
+    const char* start = reinterpret_cast<const char*>(Nursery.get());
+    ArrayObject* array = construct<ArrayObject>(memory, ValueType::ARRAY, roundUp(sizeof(ArrayObject)), start, start + NurserySize, HeapKind == Kind::CONSTANTS);
+    array->Elements.reserve(capacity);
+    if (array->Where == Generation::NURSERY) {
+        NurseryOwners.push_back(array);
+    }
+    return Value::FromObject(array);
+}
+
+Value Heap::NewInstance(size_t capacity) {
+    void* memory = Allocate(roundUp(sizeof(InstanceObject)));
+    const char* start = reinterpret_cast<const char*>(Nursery.get());
+    InstanceObject* instance = construct<InstanceObject>(memory, ValueType::OBJECT, roundUp(sizeof(InstanceObject)), start, start + NurserySize, HeapKind == Kind::CONSTANTS);
+    instance->Layout = GetShapes().GetRoot();
+    instance->Slots.reserve(capacity);
+    if (instance->Where == Generation::NURSERY) {
+        NurseryOwners.push_back(instance);
+    }
+    return Value::FromObject(instance);
+}
+
+// functions and natives are few and live as long as the program, so they start old
+Value Heap::NewFunction(const Function* code) {
+    size_t size = roundUp(sizeof(FunctionObject));
+    Stats.AllocatedBytes += size;
+    FunctionObject* function = construct<FunctionObject>(AllocateOld(size), ValueType::FUNCTION, size, nullptr, nullptr, HeapKind == Kind::CONSTANTS);
+    function->Code = code;
+    return Value::FromObject(function);
+}
+
+Value Heap::NewNative(NativeFunction call, std::string_view name, int arity) {
+    size_t size = roundUp(sizeof(NativeObject));
+    Stats.AllocatedBytes += size;
+    NativeObject* native = construct<NativeObject>(AllocateOld(size), ValueType::NATIVE, size, nullptr, nullptr, HeapKind == Kind::CONSTANTS);
+    native->Call = call;
+    native->Name = name;
+    native->Arity = arity;
+    return Value::FromObject(native);
+}
+
+void Heap::Remember(Object* container) {
+    container->Remembered = true;
+    RememberedSet.push_back(container);
+}
+
+void Heap::VisitRoot(Value& value) {
+    if (Marking) {
+        Mark(value);
+    }
+    else {
+        Evacuate(value);
+    }
+}
+
+// the values an object holds: moved out of the nursery by a minor collection, marked by a major one
+void Heap::VisitFields(Object* object) {
+    if (object->Type == ValueType::ARRAY) {
+        for (Value& element : static_cast<ArrayObject*>(object)->Elements) {
+            Marking ? Mark(element) : Evacuate(element);
+        }
+    }
+    else if (object->Type == ValueType::OBJECT) {
+        for (Value& slot : static_cast<InstanceObject*>(object)->Slots) {
+            Marking ? Mark(slot) : Evacuate(slot);
+        }
+    }
+}
+
+// copies a nursery object to the old generation and leaves the address of the copy behind (the nursery one is
+// then an empty shell, its elements went with the copy)
+Object* Heap::Promote(Object* object) {
+    void* memory = AllocateOld(object->Size);
+    Object* copy;
+    switch (object->Type) {
+        case ValueType::ARRAY: copy = new (memory) ArrayObject(std::move(*static_cast<ArrayObject*>(object))); break;
+        case ValueType::OBJECT: copy = new (memory) InstanceObject(std::move(*static_cast<InstanceObject*>(object))); break;
+        default:
+            std::memcpy(memory, object, object->Size);
+            copy = static_cast<Object*>(memory);
+            break;
+    }
+    copy->Where = Generation::OLD;
+    OldBytes += footprint(copy) - copy->Size;
+    object->Forward = copy;
+    Stats.PromotedBytes += object->Size;
+    Pending.push_back(copy);
+    return copy;
+}
+
+void Heap::Evacuate(Value& value) {
+    if (!value.IsObject()) {
+        return;
+    }
+    Object* object = value.AsObject();
+    if (object->Where != Generation::NURSERY) {
+        return;
+    }
+    value = Value::FromObject(object->Forward ? object->Forward : Promote(object));
+}
+
+void Heap::Mark(const Value& value) {
+    if (!value.IsObject()) {
+        return;
+    }
+    Object* object = value.AsObject();
+    if (object->Where == Generation::OLD && !object->Marked) {
+        object->Marked = true;
+        Pending.push_back(object);
+    }
+}
+
+void Heap::Destroy(Object* object) {
+    if (object->Type == ValueType::ARRAY) {
+        static_cast<ArrayObject*>(object)->~ArrayObject();
+    }
+    else if (object->Type == ValueType::OBJECT) {
+        static_cast<InstanceObject*>(object)->~InstanceObject();
+    }
+}
+
+void Heap::RecordPause(double seconds, bool major) {
+    (major ? Stats.MajorCollections : Stats.MinorCollections)++;
+    (major ? Stats.MajorSeconds : Stats.MinorSeconds) += seconds;
+    Stats.LongestPause = std::max(Stats.LongestPause, seconds);
+    size_t bucket = 0;
+    for (double limit = 1e-5; bucket < 4 && seconds >= limit; limit *= 10) {
+        bucket++;
+    }
+    Stats.Pauses[bucket]++;
+}
+
+void Heap::Collect(bool major) {
+    if (HeapKind == Kind::CONSTANTS) {
+        return;
+    }
+    CollectMinor();
+    if (major || OldBytes >= NextMajor) {
+        CollectMajor();
+    }
+}
+
+// copies what the roots and the remembered set reach out of the nursery, then what that reaches, and so on
+void Heap::CollectMinor() {
+    auto start = std::chrono::steady_clock::now();
+    if (Scanner) {
+        Scanner(*this);
+    }
+    for (Object* container : RememberedSet) {
+        container->Remembered = false;
+        VisitFields(container);
+    }
+    RememberedSet.clear();
+    while (!Pending.empty()) {
+        Object* object = Pending.back();
+        Pending.pop_back();
+        VisitFields(object);
+    }
+    for (Object* owner : NurseryOwners) {
+        if (!owner->Forward) {
+            Destroy(owner);
+        }
+    }
+    NurseryOwners.clear();
+    NurseryTop = reinterpret_cast<char*>(Nursery.get());
+    NurseryObjects = 0;
+    RecordPause(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), false);
+}
+
+// marks the old generation from the roots and frees what isn't marked (right after a minor collection, so the
+// nursery is empty and nothing old is remembered)
+void Heap::CollectMajor() {
+    auto start = std::chrono::steady_clock::now();
+    Marking = true;
+    if (Scanner) {
+        Scanner(*this);
+    }
+    while (!Pending.empty()) {
+        Object* object = Pending.back();
+        Pending.pop_back();
+        VisitFields(object);
+    }
+    Marking = false;
+
+    size_t live = 0;
+    auto kept = OldObjects.begin();
+    for (Object* object : OldObjects) {
+        if (object->Marked) {
+            object->Marked = false;
+            live += footprint(object);
+            *kept++ = object;
+        }
+        else {
+            Stats.FreedBytes += footprint(object);
+            Destroy(object);
+            ::operator delete(object);
+        }
+    }
+    OldObjects.erase(kept, OldObjects.end());
+    OldBytes = live;
+    NextMajor = std::max(live * 2, NurserySize * 8);
+    RecordPause(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), true);
+}
+
+void Heap::Clear() {
+    for (Object* owner : NurseryOwners) {
+        Destroy(owner);
+    }
+    NurseryOwners.clear();
+    NurseryTop = reinterpret_cast<char*>(Nursery.get());
+    NurseryObjects = 0;
+    for (Object* object : OldObjects) {
+        Destroy(object);
+        ::operator delete(object);
+    }
+    OldObjects.clear();
+    RememberedSet.clear();
+    OldBytes = 0;
+    NextMajor = NurserySize * 8;
+}
@@ -0,0 +1,141 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "value.h"
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+
+// bytes of the nursery by default, small enough to stay in the cache while it fills
+constexpr size_t DefaultNurserySize = 1 << 20;
+
+// what the collector did, added up over the life of a heap (the pauses are wall clock time)
+struct GcStats {
+    uint64_t MinorCollections = 0;
+    uint64_t MajorCollections = 0;
+    // bytes of objects made (not counting what arrays and objects allocate for their elements and fields)
+    uint64_t AllocatedBytes = 0;
+    // bytes copied out of the nursery because they were still reachable
+    uint64_t PromotedBytes = 0;
+    // bytes of old objects freed by the major collections
+    uint64_t FreedBytes = 0;
+    double MinorSeconds = 0;
+    double MajorSeconds = 0;
+    double LongestPause = 0;
+    // how many pauses took under 10 us, 100 us, 1 ms, 10 ms and longer
+    uint64_t Pauses[5] = {};
+
+    void Merge(const GcStats& other);
+
+    void PrintText(std::ostream& out) const;
+};
+
+// where the objects of a run live. a new object is bumped out of the nursery (a pointer increment, nothing to
+// free one by one); when it is full the nursery is collected: whatever the roots and the remembered set still
+// reach is copied to the old generation and the rest of the nursery is reused as it is, so a temporary that
+// died costs nothing (arrays and objects that die there have their elements freed, strings have nothing to
+// free). objects too large for the nursery start old. once the old generation has doubled since the last time,
+// it is marked from the roots and swept.
+//
+// the collector is precise: it only looks at the values the root scanner gives it (the VM's registers and
+// globals) and at the objects those reach, so an object only referred to from C++ has to be in a register before
+// the next allocation, and a nursery object may have moved after one. an old object given a pointer to a
+// nursery object has to go through WriteBarrier, or the next minor collection won't see that pointer.
+//
+// a heap of constants (Program::Constants) never collects, its objects live as long as it does
+class Heap {
+    public:
+        enum class Kind {
+            CONSTANTS,
+            COLLECTED
+        };
+
+        explicit Heap(Kind kind = Kind::COLLECTED);
+        Heap(const Heap&) = delete;
+        Heap& operator=(const Heap&) = delete;
+        ~Heap();
+
+        Value NewString(std::string_view text);
+        // a string of length uninitialized characters, for the caller to fill in right away
+        StringObject* NewStringOfLength(size_t length);
+        Value NewArray(size_t capacity = 0);
+        Value NewInstance(size_t capacity = 0);
+        Value NewFunction(const Function* code);
+        Value NewNative(NativeFunction call, std::string_view name, int arity);
+
+        // called by a collection with the heap to give every root to (through VisitRoot)
+        using RootScanner = std::function<void(Heap& heap)>;
+
+        void SetRootScanner(RootScanner scanner);
+
+        // a root the scanner found: it is updated if what it points to moves
+        void VisitRoot(Value& value);
+
+        // container is about to hold value, remembers container if that's an old to nursery pointer
+        void WriteBarrier(Object* container, const Value& value) {
+            if (container->Where == Generation::OLD && !container->Remembered && value.IsObject() && value.AsObject()->Where == Generation::NURSERY) {
+                Remember(container);
+            }
+        }
+
+        // a minor collection, then a major one if major is true or the old generation has grown enough
+        void Collect(bool major = false);
+
+        // frees every object (the stats are kept)
+        void Clear();
+
+        // frees every object (Clear) and starts a nursery of that size
+        void SetNurserySize(size_t bytes);
+
+        size_t GetObjectCount() const;
+        const GcStats& GetStats() const;
+        // starts the stats over, for a heap reused by another run
+        void ResetStats();
+
+    private:
+        Kind HeapKind;
+        RootScanner Scanner;
+        std::unique_ptr<uint64_t[]> Nursery;
+        size_t NurserySize;
+        char* NurseryTop;
+        char* NurseryEnd;
+        // arrays and objects in the nursery (their elements are freed if they die there)
+        std::vector<Object*> NurseryOwners;
+        size_t NurseryObjects;
+        std::vector<Object*> OldObjects;
+        size_t OldBytes;
+        // a major collection runs once OldBytes reaches it
+        size_t NextMajor;
+        std::vector<Object*> RememberedSet;
+        // objects promoted (minor) or marked (major) whose fields haven't been visited yet
+        std::vector<Object*> Pending;
+        bool Marking;
+        GcStats Stats;
+
+        // size is a multiple of 8
+        void* Allocate(size_t size) {
+            if (static_cast<size_t>(NurseryEnd - NurseryTop) >= size) {
+                void* memory = NurseryTop;
+                NurseryTop += size;
+                NurseryObjects++;
+                Stats.AllocatedBytes += size;
+                return memory;
+            }
+            return AllocateSlow(size);
+        }
+
+        void* AllocateSlow(size_t size);
+        void* AllocateOld(size_t size);
+        void Remember(Object* container);
+        void CollectMinor();
+        void CollectMajor();
+        Object* Promote(Object* object);
+        void Evacuate(Value& value);
+        void Mark(const Value& value);
+        void VisitFields(Object* object);
+        static void Destroy(Object* object);
+        void RecordPause(double seconds, bool major);
+};
+
+#endif
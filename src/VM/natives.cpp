@@ -0,0 +1,55 @@
+#include "natives.h"
+#include "vm.h"
+
+#include <ctime>
+
+static bool nativePrint(VirtualMachine& vm, Value* arguments, uint32_t count, Value& result) {
+    std::string& out = vm.GetOutput();
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0) {
+            out += ' ';
+        }
+        AppendValue(out, arguments[i]);
+    }
+    out += '\n';
+    result = Value::Nil();
+    return true;
+}
+
+static bool nativeLen(VirtualMachine&, Value* arguments, uint32_t, Value& result) {
+    if (arguments[0].IsObjectOf(ValueType::ARRAY)) {
+        result = Value::FromNumber(static_cast<double>(AsArray(arguments[0])->Elements.size()));
+        return true;
+    }
+    // the length of a string is in bytes, the same offsets indexing takes
+    if (arguments[0].IsObjectOf(ValueType::STRING)) {
+        result = Value::FromNumber(static_cast<double>(AsString(arguments[0])->Length));
+        return true;
+    }
+    return false;
+}
+
+static bool nativePush(VirtualMachine& vm, Value* arguments, uint32_t, Value& result) {
+    if (!arguments[0].IsObjectOf(ValueType::ARRAY)) {
+        return false;
+    }
+    vm.GetHeap().WriteBarrier(arguments[0].AsObject(), arguments[1]);
+    AsArray(arguments[0])->Elements.push_back(arguments[1]);
+    result = arguments[0];
+    return true;
+}
+
+static bool nativeClock(VirtualMachine&, Value*, uint32_t, Value& result) {
+    result = Value::FromNumber(static_cast<double>(std::clock()) / CLOCKS_PER_SEC);
+    return true;
+}
+
+const std::vector<NativeEntry>& GetNatives() {
+    static const std::vector<NativeEntry> natives = {
+        {"print", nativePrint, -1},
+        {"len", nativeLen, 1},
+        {"push", nativePush, 2},
+        {"clock", nativeClock, 0}
+    };
+    return natives;
+}
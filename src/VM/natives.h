@@ -0,0 +1,21 @@
+#ifndef NATIVES_H
+#define NATIVES_H
+
+#include "value.h"
+
+// a function every program can call without declaring it (a constant global of that name)
+struct NativeEntry {
+    std::string_view Name;
+    NativeFunction Call;
+    // -1 for any number of arguments
+    int Arity;
+};
+
+// print(values...)     writes the values separated by spaces and a newline to the VM's output
+// len(array | string)  number of elements, or of bytes for a string (not code points: "é" is 2, and s[i] and
+//                      the loop counter of for c in s are byte offsets too, see ITERATE and GETINDEX)
+// push(array, value)   appends value and returns the array
+// clock()              seconds of cpu time, to time things from inside a program
+const std::vector<NativeEntry>& GetNatives();
+
+#endif
@@ -0,0 +1,646 @@
+#include "optimizer.h"
+#include "compiler.h"
+#include "value.h"
+
+#include <chrono>
+#include <iomanip>
+#include <unordered_map>
+
+// strings made by folding longer than this are left to the run (a const doubled a few dozen times would
+// otherwise fill the memory of the compiler)
+constexpr size_t MaxFoldedLength = 4096;
+
+constexpr uint32_t NoConstant = UINT32_MAX;
+
+// the passes over one file (see optimizer.h), each one a method
+class Optimizer {
+    public:
+        Optimizer(const TokenStream& stream, Ast& ast) : Stream(stream), Tokens(stream.Tokens), Tree(ast) {
+            FunctionDepth = 0;
+            Rewrites = 0;
+        }
+
+        // runs one pass, returns how many nodes it rewrote
+        uint64_t Run(Pass pass) {
+            Rewrites = 0;
+            switch (pass) {
+                case Pass::PROPAGATE: Propagate(); break;
+                case Pass::FOLD: Fold(); break;
+                case Pass::SIMPLIFY: Simplify(); break;
+                case Pass::BRANCHES: PruneBranches(); break;
+                case Pass::RANGES: LowerRanges(); break;
+            }
+            return Rewrites;
+        }
+
+    private:
+        // a local the propagation walk has seen: a const's value if it is known, else NoConstant (it only hides the
+        // names outside of it)
+        struct Binding {
+            uint32_t Symbol;
+            int FunctionDepth;
+            uint32_t Constant;
+        };
+
+        const TokenStream& Stream;
+        const std::vector<Token>& Tokens;
+        Ast& Tree;
+        // how many times each name is declared at the top level, and the value of the top level consts seen so far
+        // that are declared once
+        std::unordered_map<uint32_t, uint32_t> Declarations;
+        std::unordered_map<uint32_t, uint32_t> Globals;
+        std::vector<Binding> Bindings;
+        std::vector<size_t> Scopes;
+        int FunctionDepth;
+        uint64_t Rewrites;
+
+        uint32_t SymbolOf(const Node& node) const {
+            return Tokens[node.Token].symbol;
+        }
+
+        // the value of a literal or a CONSTANT, false for anything else
+        bool ConstantOf(NodeId id, ConstantValue& value) const {
+            const Node& node = Tree.Get(id);
+            switch (node.Kind) {
+                case NodeKind::NUMBER:
+                    value = ConstantValue{ConstantValue::Kind::NUMBER, false, Stream.Number(Tokens[node.Token]).ToDouble(), {}};
+                    return true;
+                case NodeKind::BOOLEAN:
+                    value = ConstantValue{ConstantValue::Kind::BOOLEAN, Tokens[node.Token].type == TokenType::TRUE_TOKEN, 0, {}};
+                    return true;
+                case NodeKind::STRING:
+                    value = ConstantValue{ConstantValue::Kind::STRING, false, 0, DecodeString(Stream.Text(Tokens[node.Token]))};
+                    return true;
+                case NodeKind::CONSTANT:
+                    value = Tree.GetConstant(node.First);
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool IsConstant(NodeId id) const {
+            NodeKind kind = Tree.Get(id).Kind;
+            return kind == NodeKind::NUMBER || kind == NodeKind::BOOLEAN || kind == NodeKind::STRING || kind == NodeKind::CONSTANT;
+        }
+
+        // nil and false are false, the constants are never nil
+        static bool IsTruthy(const ConstantValue& value) {
+            return value.Type != ConstantValue::Kind::BOOLEAN || value.Boolean;
+        }
+
+        static ConstantValue Number(double number) {
+            return ConstantValue{ConstantValue::Kind::NUMBER, false, number, {}};
+        }
+
+        static ConstantValue Boolean(bool boolean) {
+            return ConstantValue{ConstantValue::Kind::BOOLEAN, boolean, 0, {}};
+        }
+
+        static ConstantValue String(std::string text) {
+            return ConstantValue{ConstantValue::Kind::STRING, false, 0, std::move(text)};
+        }
+
+        // how print shows a constant that isn't a string (what "a" + value joins)
+        static std::string TextOf(const ConstantValue& value) {
+            std::string text;
+            AppendValue(text, value.Type == ConstantValue::Kind::NUMBER ? Value::FromNumber(value.Number) : Value::FromBoolean(value.Boolean));
+            return text;
+        }
+
+        // what the VM gives for - ! typeof on a constant, false where it would be an error
+        static bool ComputeUnary(TokenType op, const ConstantValue& operand, ConstantValue& result) {
+            switch (op) {
+                case TokenType::MINUS:
+                    if (operand.Type != ConstantValue::Kind::NUMBER) {
+                        return false;
+                    }
+                    result = Number(-operand.Number);
+                    return true;
+                case TokenType::NOT:
+                    result = Boolean(!IsTruthy(operand));
+                    return true;
+                case TokenType::TYPEOF:
+                    result = String(operand.Type == ConstantValue::Kind::NUMBER ? "number" : operand.Type == ConstantValue::Kind::STRING ? "string" : "boolean");
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // what the VM gives for an arithmetic or comparison operator on two constants, false where it would be an
+        // error (and for && || .., which aren't worked out here)
+        static bool ComputeBinary(TokenType op, const ConstantValue& left, const ConstantValue& right, ConstantValue& result) {
+            bool numbers = left.Type == ConstantValue::Kind::NUMBER && right.Type == ConstantValue::Kind::NUMBER;
+            bool strings = left.Type == ConstantValue::Kind::STRING && right.Type == ConstantValue::Kind::STRING;
+            double x = left.Number;
+            double y = right.Number;
+            switch (op) {
+                case TokenType::PLUS:
+                    if (numbers) {
+                        result = Number(x + y);
+                        return true;
+                    }
+                    if (left.Type != ConstantValue::Kind::STRING && right.Type != ConstantValue::Kind::STRING) {
+                        return false;
+                    }
+                    {
+                        std::string text = left.Type == ConstantValue::Kind::STRING ? left.Text : TextOf(left);
+                        text += right.Type == ConstantValue::Kind::STRING ? right.Text : TextOf(right);
+                        if (text.size() > MaxFoldedLength) {
+                            return false;
+                        }
+                        result = String(std::move(text));
+                    }
+                    return true;
+                case TokenType::MINUS: result = Number(x - y); return numbers;
+                case TokenType::MULTIPLY: result = Number(x * y); return numbers;
+                case TokenType::DIVIDE: result = Number(x / y); return numbers;
+                case TokenType::MODULO: result = Number(numbers ? RemainderOf(x, y) : 0); return numbers;
+                case TokenType::EQUALS: case TokenType::NOTEQUALS: {
+                    bool equal = left.Type == right.Type && (numbers ? x == y : strings ? left.Text == right.Text : left.Boolean == right.Boolean);
+                    result = Boolean(equal == (op == TokenType::EQUALS));
+                    return true;
+                }
+                case TokenType::LESSTHAN: result = Boolean(numbers ? x < y : left.Text < right.Text); return numbers || strings;
+                case TokenType::LESSTHANEQUALS: result = Boolean(numbers ? x <= y : left.Text <= right.Text); return numbers || strings;
+                case TokenType::GREATERTHAN: result = Boolean(numbers ? x > y : left.Text > right.Text); return numbers || strings;
+                case TokenType::GREATERTHANEQUALS: result = Boolean(numbers ? x >= y : left.Text >= right.Text); return numbers || strings;
+                default:
+                    return false;
+            }
+        }
+
+        // the value of an expression made only of constants and operators on them, without rewriting anything
+        // (what a const is set to, worked out even when the fold pass is off)
+        bool Evaluate(NodeId id, ConstantValue& value) const {
+            const Node& node = Tree.Get(id);
+            ConstantValue left;
+            ConstantValue right;
+            switch (node.Kind) {
+                case NodeKind::UNARY:
+                    return Evaluate(node.First, left) && ComputeUnary(node.Operator, left, value);
+                case NodeKind::BINARY:
+                    if (node.Operator == TokenType::AND || node.Operator == TokenType::OR) {
+                        if (!Evaluate(node.First, left)) {
+                            return false;
+                        }
+                        if (IsTruthy(left) == (node.Operator == TokenType::OR)) {
+                            value = std::move(left);
+                            return true;
+                        }
+                        return Evaluate(node.Second, value);
+                    }
+                    return Evaluate(node.First, left) && Evaluate(node.Second, right) && ComputeBinary(node.Operator, left, right, value);
+                case NodeKind::CONDITIONAL:
+                    return Evaluate(node.First, left) && Evaluate(IsTruthy(left) ? node.Second : node.Third, value);
+                default:
+                    return ConstantOf(id, value);
+            }
+        }
+
+        // turns the node into a CONSTANT (its place in the tree is kept, and its token for the errors)
+        void Replace(NodeId id, ConstantValue value) {
+            uint32_t constant = Tree.AddConstant(std::move(value));
+            Node& node = Tree.Get(id);
+            node.Kind = NodeKind::CONSTANT;
+            node.Operator = TokenType::E0F_TOKEN;
+            node.First = constant;
+            node.Second = NoNode;
+            node.Third = NoNode;
+            Rewrites++;
+        }
+
+        // puts a copy of the node from in the place of the node to (from is one of its children, so its own
+        // children still come before it)
+        void ReplaceWith(NodeId to, NodeId from) {
+            Node copy = Tree.Get(from);
+            copy.Next = Tree.Get(to).Next;
+            Tree.Get(to) = copy;
+            Rewrites++;
+        }
+
+        // a block with nothing in it, in the place of the node
+        void ReplaceWithEmpty(NodeId id) {
+            Node& node = Tree.Get(id);
+            node.Kind = NodeKind::BLOCK;
+            node.Operator = TokenType::E0F_TOKEN;
+            node.First = NoNode;
+            node.Second = NoNode;
+            node.Third = NoNode;
+            Rewrites++;
+        }
+
+        // --- propagate: walks the tree in the order the compiler does, keeping the locals in scope ---
+
+        void Propagate() {
+            // a file without a const has nothing to propagate, and finding that out is a scan instead of a walk
+            bool constants = false;
+            for (NodeId id = 1; id <= Tree.GetNodeCount() && !constants; id++) {
+                constants = Tree.Get(id).Kind == NodeKind::CONST;
+            }
+            if (!constants) {
+                return;
+            }
+            NodeId root = Tree.GetRoot();
+            for (NodeId statement = Tree.Get(root).First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                const Node& node = Tree.Get(Tree.Get(statement).Kind == NodeKind::EXPORT ? Tree.Get(statement).First : statement);
+                if (node.Kind == NodeKind::LET || node.Kind == NodeKind::CONST || node.Kind == NodeKind::FUNC || node.Kind == NodeKind::CLASS) {
+                    Declarations[SymbolOf(node)]++;
+                }
+            }
+            for (NodeId statement = Tree.Get(root).First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                PropagateStatement(statement);
+            }
+        }
+
+        bool IsTopLevel() const {
+            return FunctionDepth == 0 && Scopes.empty();
+        }
+
+        void BeginScope() {
+            Scopes.push_back(Bindings.size());
+        }
+
+        void EndScope() {
+            Bindings.resize(Scopes.back());
+            Scopes.pop_back();
+        }
+
+        void Bind(uint32_t token, uint32_t constant) {
+            Bindings.push_back(Binding{Tokens[token].symbol, FunctionDepth, constant});
+        }
+
+        // the value a name read here is known to have, NoConstant if it isn't known (a local of this function that
+        // isn't a const, one of a function around this one, or a global that isn't a const set before)
+        uint32_t Lookup(uint32_t symbol) const {
+            for (auto binding = Bindings.rbegin(); binding != Bindings.rend(); ++binding) {
+                if (binding->Symbol == symbol) {
+                    return binding->FunctionDepth == FunctionDepth ? binding->Constant : NoConstant;
+                }
+            }
+            auto global = Globals.find(symbol);
+            return global != Globals.end() ? global->second : NoConstant;
+        }
+
+        void PropagateStatement(NodeId id) {
+            const Node& node = Tree.Get(id);
+            switch (node.Kind) {
+                case NodeKind::LET: case NodeKind::CONST: {
+                    if (node.First != NoNode) {
+                        PropagateExpression(node.First);
+                    }
+                    uint32_t constant = NoConstant;
+                    ConstantValue value;
+                    bool known = node.Kind == NodeKind::CONST && Evaluate(node.First, value);
+                    if (known) {
+                        constant = Tree.AddConstant(std::move(value));
+                    }
+                    if (!IsTopLevel()) {
+                        Bind(node.Token, constant);
+                    }
+                    else if (known && Declarations[SymbolOf(node)] == 1) {
+                        Globals[SymbolOf(node)] = constant;
+                    }
+                    break;
+                }
+                case NodeKind::FUNC:
+                    PropagateFunction(node);
+                    if (!IsTopLevel()) {
+                        Bind(node.Token, NoConstant);
+                    }
+                    break;
+                case NodeKind::CLASS:
+                    // the members are fields, not locals: a name in them is looked up outside of the class
+                    FunctionDepth++;
+                    for (NodeId member = node.First; member != NoNode; member = Tree.Get(member).Next) {
+                        const Node& field = Tree.Get(member);
+                        if (field.Kind == NodeKind::FUNC) {
+                            PropagateFunction(field);
+                        }
+                        else if (field.First != NoNode) {
+                            PropagateExpression(field.First);
+                        }
+                    }
+                    FunctionDepth--;
+                    if (!IsTopLevel()) {
+                        Bind(node.Token, NoConstant);
+                    }
+                    break;
+                case NodeKind::IF:
+                    PropagateExpression(node.First);
+                    PropagateStatement(node.Second);
+                    if (node.Third != NoNode) {
+                        PropagateStatement(node.Third);
+                    }
+                    break;
+                case NodeKind::FOR: case NodeKind::FOREVERY:
+                    BeginScope();
+                    PropagateExpression(node.Second);
+                    if (node.First != NoNode) {
+                        Bind(Tree.Get(node.First).Token, NoConstant);
+                    }
+                    PropagateStatement(node.Third);
+                    EndScope();
+                    break;
+                case NodeKind::WHILE:
+                    PropagateExpression(node.First);
+                    PropagateStatement(node.Second);
+                    break;
+                case NodeKind::BLOCK:
+                    BeginScope();
+                    for (NodeId statement = node.First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                        PropagateStatement(statement);
+                    }
+                    EndScope();
+                    break;
+                case NodeKind::RETURN: case NodeKind::EXPRESSION:
+                    if (node.First != NoNode) {
+                        PropagateExpression(node.First);
+                    }
+                    break;
+                case NodeKind::EXPORT:
+                    PropagateStatement(node.First);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // the parameters and the statements of the body share a scope, like in the compiler
+        void PropagateFunction(const Node& node) {
+            FunctionDepth++;
+            BeginScope();
+            for (NodeId parameter = node.First; parameter != NoNode; parameter = Tree.Get(parameter).Next) {
+                Bind(Tree.Get(parameter).Token, NoConstant);
+            }
+            for (NodeId statement = Tree.Get(node.Second).First; statement != NoNode; statement = Tree.Get(statement).Next) {
+                PropagateStatement(statement);
+            }
+            EndScope();
+            FunctionDepth--;
+        }
+
+        // replaces the names read in the expression (a name assigned to or incremented is left for the compiler,
+        // which reports it if it is a const)
+        void PropagateExpression(NodeId id) {
+            const Node& node = Tree.Get(id);
+            switch (node.Kind) {
+                case NodeKind::IDENTIFIER: {
+                    uint32_t constant = Lookup(SymbolOf(node));
+                    if (constant != NoConstant) {
+                        Tree.Get(id).Kind = NodeKind::CONSTANT;
+                        Tree.Get(id).First = constant;
+                        Rewrites++;
+                    }
+                    break;
+                }
+                case NodeKind::ASSIGN:
+                    PropagateTarget(node.First);
+                    PropagateExpression(node.Second);
+                    break;
+                case NodeKind::UNARY: case NodeKind::POSTFIX:
+                    if (node.Operator == TokenType::PLUSPLUS || node.Operator == TokenType::MINUSMINUS) {
+                        PropagateTarget(node.First);
+                    }
+                    else {
+                        PropagateExpression(node.First);
+                    }
+                    break;
+                case NodeKind::CONSTANT:
+                    break;
+                default:
+                    for (NodeId child : {node.First, node.Second, node.Third}) {
+                        for (NodeId item = child; item != NoNode; item = Tree.Get(item).Next) {
+                            PropagateExpression(item);
+                        }
+                    }
+                    break;
+            }
+        }
+
+        // only what a target indexes or takes a member of is read
+        void PropagateTarget(NodeId id) {
+            const Node& node = Tree.Get(id);
+            if (node.Kind == NodeKind::INDEX) {
+                PropagateExpression(node.First);
+                PropagateExpression(node.Second);
+            }
+            else if (node.Kind == NodeKind::MEMBER) {
+                PropagateExpression(node.First);
+            }
+        }
+
+        // --- the other passes are scans of the array: a node's children come before it, so they are done first ---
+
+        void Fold() {
+            ConstantValue left;
+            ConstantValue right;
+            ConstantValue result;
+            for (NodeId id = 1; id <= Tree.GetNodeCount(); id++) {
+                const Node& node = Tree.Get(id);
+                if (node.Kind == NodeKind::UNARY) {
+                    if (IsConstant(node.First) && ConstantOf(node.First, left) && ComputeUnary(node.Operator, left, result)) {
+                        Replace(id, std::move(result));
+                    }
+                }
+                else if (node.Kind == NodeKind::BINARY && (node.Operator == TokenType::AND || node.Operator == TokenType::OR)) {
+                    // true && x is x and false && x is false, whatever x is
+                    if (IsConstant(node.First) && ConstantOf(node.First, left)) {
+                        ReplaceWith(id, IsTruthy(left) == (node.Operator == TokenType::OR) ? node.First : node.Second);
+                    }
+                }
+                else if (node.Kind == NodeKind::BINARY) {
+                    if (IsConstant(node.First) && IsConstant(node.Second) && ConstantOf(node.First, left) && ConstantOf(node.Second, right)
+                        && ComputeBinary(node.Operator, left, right, result)) {
+                        Replace(id, std::move(result));
+                    }
+                }
+            }
+        }
+
+        // the number constant value, false if the node isn't one
+        bool IsNumber(NodeId id, double value) const {
+            const Node& node = Tree.Get(id);
+            if (node.Kind == NodeKind::NUMBER) {
+                return Stream.Number(Tokens[node.Token]).ToDouble() == value;
+            }
+            if (node.Kind == NodeKind::CONSTANT) {
+                const ConstantValue& constant = Tree.GetConstant(node.First);
+                return constant.Type == ConstantValue::Kind::NUMBER && constant.Number == value && !std::signbit(constant.Number);
+            }
+            return false;
+        }
+
+        // true if the expression can only give a number (or fail): arithmetic other than +, a + of two numbers, - and
+        // ++ --. the left operands of a chain of + are followed in a loop, so a long sum doesn't recurse that deep
+        bool IsNumeric(NodeId id) const {
+            while (true) {
+                const Node& node = Tree.Get(id);
+                switch (node.Kind) {
+                    case NodeKind::NUMBER: case NodeKind::POSTFIX:
+                        return true;
+                    case NodeKind::CONSTANT:
+                        return Tree.GetConstant(node.First).Type == ConstantValue::Kind::NUMBER;
+                    case NodeKind::UNARY:
+                        return node.Operator != TokenType::NOT && node.Operator != TokenType::TYPEOF;
+                    case NodeKind::BINARY:
+                        if (node.Operator != TokenType::PLUS) {
+                            return node.Operator == TokenType::MINUS || node.Operator == TokenType::MULTIPLY || node.Operator == TokenType::DIVIDE
+                                || node.Operator == TokenType::MODULO;
+                        }
+                        if (!IsNumeric(node.Second)) {
+                            return false;
+                        }
+                        id = node.First;
+                        break;
+                    default:
+                        return false;
+                }
+            }
+        }
+
+        // x * 1 is x only if x can't be anything but a number (a string would have been a TYPE_MISMATCH), so that is
+        // only worked out for the nodes that would be simplified if it is. x + 0 isn't x (-0 + 0 is 0)
+        void Simplify() {
+            for (NodeId id = 1; id <= Tree.GetNodeCount(); id++) {
+                const Node& node = Tree.Get(id);
+                switch (node.Kind) {
+                    case NodeKind::UNARY: {
+                        const Node& operand = Tree.Get(node.First);
+                        if (node.Operator == TokenType::MINUS && operand.Kind == NodeKind::UNARY && operand.Operator == TokenType::MINUS && IsNumeric(operand.First)) {
+                            ReplaceWith(id, operand.First);
+                        }
+                        else if (node.Operator == TokenType::NOT && operand.Kind == NodeKind::BINARY
+                                 && (operand.Operator == TokenType::EQUALS || operand.Operator == TokenType::NOTEQUALS)) {
+                            // !(a == b) is a != b, even for NaN
+                            TokenType flipped = operand.Operator == TokenType::EQUALS ? TokenType::NOTEQUALS : TokenType::EQUALS;
+                            ReplaceWith(id, node.First);
+                            Tree.Get(id).Operator = flipped;
+                        }
+                        break;
+                    }
+                    case NodeKind::BINARY:
+                        if (node.Operator == TokenType::MULTIPLY) {
+                            if (IsNumber(node.Second, 1) && IsNumeric(node.First)) {
+                                ReplaceWith(id, node.First);
+                            }
+                            else if (IsNumber(node.First, 1) && IsNumeric(node.Second)) {
+                                ReplaceWith(id, node.Second);
+                            }
+                        }
+                        else if (node.Operator == TokenType::DIVIDE || node.Operator == TokenType::MINUS) {
+                            if (IsNumber(node.Second, node.Operator == TokenType::DIVIDE ? 1 : 0) && IsNumeric(node.First)) {
+                                ReplaceWith(id, node.First);
+                            }
+                        }
+                        break;
+                    case NodeKind::IF: case NodeKind::WHILE: case NodeKind::CONDITIONAL: {
+                        // only the truth of a condition matters, and !!x is as true as x
+                        const Node& condition = Tree.Get(node.First);
+                        if (condition.Kind == NodeKind::UNARY && condition.Operator == TokenType::NOT) {
+                            const Node& inner = Tree.Get(condition.First);
+                            if (inner.Kind == NodeKind::UNARY && inner.Operator == TokenType::NOT) {
+                                Tree.Get(id).First = inner.First;
+                                Rewrites++;
+                            }
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+        }
+
+        // the truth of a constant condition, false if it isn't one
+        bool IsConstantCondition(NodeId id, bool& truthy) const {
+            ConstantValue value;
+            if (!ConstantOf(id, value)) {
+                return false;
+            }
+            truthy = IsTruthy(value);
+            return true;
+        }
+
+        void PruneBranches() {
+            for (NodeId id = 1; id <= Tree.GetNodeCount(); id++) {
+                const Node& node = Tree.Get(id);
+                bool truthy;
+                if ((node.Kind != NodeKind::IF && node.Kind != NodeKind::WHILE && node.Kind != NodeKind::CONDITIONAL) || !IsConstantCondition(node.First, truthy)) {
+                    continue;
+                }
+                if (node.Kind == NodeKind::CONDITIONAL) {
+                    ReplaceWith(id, truthy ? node.Second : node.Third);
+                }
+                else if (node.Kind == NodeKind::IF && truthy) {
+                    ReplaceWith(id, node.Second);
+                }
+                else if (node.Kind == NodeKind::IF && node.Third != NoNode) {
+                    ReplaceWith(id, node.Third);
+                }
+                else if (!truthy) {
+                    ReplaceWithEmpty(id);
+                }
+            }
+        }
+
+        // the compiler gives a for marked this way a counter and a limit in registers (FORPREP/FORLOOP), unmarked
+        // it makes the array of the range and goes through it like any other
+        void LowerRanges() {
+            for (NodeId id = 1; id <= Tree.GetNodeCount(); id++) {
+                Node& node = Tree.Get(id);
+                if ((node.Kind == NodeKind::FOR || node.Kind == NodeKind::FOREVERY) && node.Operator != TokenType::DOTDOT) {
+                    const Node& iterable = Tree.Get(node.Second);
+                    if (iterable.Kind == NodeKind::BINARY && iterable.Operator == TokenType::DOTDOT) {
+                        node.Operator = TokenType::DOTDOT;
+                        Rewrites++;
+                    }
+                }
+            }
+        }
+};
+
+void OptimizeStats::Merge(const OptimizeStats& other) {
+    Files += other.Files;
+    Nodes += other.Nodes;
+    for (size_t i = 0; i < PassCount; i++) {
+        Rewrites[i] += other.Rewrites[i];
+        Seconds[i] += other.Seconds[i];
+    }
+}
+
+void OptimizeStats::PrintText(std::ostream& out) const {
+    double total = 0;
+    for (double seconds : Seconds) {
+        total += seconds;
+    }
+    out << "Optimizer stats: " << Files << " files, " << Nodes << " nodes in " << std::fixed << std::setprecision(3) << total * 1e3 << " ms\n";
+    for (size_t i = 0; i < PassCount; i++) {
+        out << "  " << std::left << std::setw(10) << PassNames[i] << std::right << std::setw(9) << Rewrites[i] << " rewrites "
+            << std::setw(9) << Seconds[i] * 1e3 << " ms\n";
+    }
+}
+
+void Optimize(const TokenStream& tokens, Ast& ast, const OptimizeOptions& options, OptimizeStats* stats) {
+    if (ast.GetRoot() == NoNode || !tokens.Symbols) {
+        return;
+    }
+    Optimizer optimizer(tokens, ast);
+    if (stats) {
+        stats->Files++;
+        stats->Nodes += ast.GetNodeCount();
+    }
+    for (size_t i = 0; i < PassCount; i++) {
+        Pass pass = static_cast<Pass>(i);
+        if (!options.IsEnabled(pass)) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        uint64_t rewrites = optimizer.Run(pass);
+        if (stats) {
+            stats->Rewrites[i] += rewrites;
+            stats->Seconds[i] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "../Parser/ast.h"
+
+#include <iosfwd>
+
+// every pass of the optimizer, in the order they run (each one can be turned off with --no-<name>):
+//
+//   PASS(kind, name)
+#define ILYS_PASS_SPEC(PASS) \
+    PASS(PROPAGATE, "propagate")   /* a const whose value is known is replaced by it where it is read */ \
+    PASS(FOLD, "fold")             /* operators on constants are worked out (1 + 2, "a" + 1, !true, x ? y : z, ...) */ \
+    PASS(SIMPLIFY, "simplify")     /* x * 1, x / 1, x - 0 and -(-x) of a number are x, !(a == b) is a != b, !!x tested is x */ \
+    PASS(BRANCHES, "branches")     /* if true / if false keep the branch that runs, while false goes */ \
+    PASS(RANGES, "ranges")         /* for over a..b counts from a to b instead of looping over the array a..b makes */
+
+enum class Pass : uint8_t {
+#define ILYS_PASS_ENUM(kind, name) kind,
+    ILYS_PASS_SPEC(ILYS_PASS_ENUM)
+#undef ILYS_PASS_ENUM
+};
+
+inline constexpr std::string_view PassNames[] = {
+#define ILYS_PASS_NAME(kind, name) name,
+    ILYS_PASS_SPEC(ILYS_PASS_NAME)
+#undef ILYS_PASS_NAME
+};
+
+constexpr size_t PassCount = sizeof(PassNames) / sizeof(PassNames[0]);
+
+struct OptimizeOptions {
+    // one bit per pass (by Pass), all on by default
+    uint32_t Passes = (1u << PassCount) - 1;
+
+    bool IsEnabled(Pass pass) const {
+        return (Passes >> static_cast<uint32_t>(pass) & 1) != 0;
+    }
+
+    void SetEnabled(Pass pass, bool enabled) {
+        uint32_t bit = 1u << static_cast<uint32_t>(pass);
+        Passes = enabled ? Passes | bit : Passes & ~bit;
+    }
+};
+
+// what every pass did, added up over the files optimized
+struct OptimizeStats {
+    uint64_t Files = 0;
+    uint64_t Nodes = 0;
+    // nodes each pass rewrote, and the cpu time it took
+    uint64_t Rewrites[PassCount] = {};
+    double Seconds[PassCount] = {};
+
+    void Merge(const OptimizeStats& other);
+
+    void PrintText(std::ostream& out) const;
+};
+
+// rewrites a parsed file (it must have parsed without errors) in place with the passes the options leave on, each
+// one a walk of the tree in the order above. nothing is rewritten that the program could tell apart from what it
+// was: a value is only worked out when the VM would work out the same one without an error (1 / 0 is folded, 1 + true
+// and "a" < 1 are left for the run to report), x * 1 is only x when x can only be a number, and a const is only
+// replaced where it can't be read before it is set (after its declaration in the same function, or in a function
+// declared after it at the top level).
+// two things do change: a branch that can never run isn't compiled at all (so a name it uses that doesn't exist
+// isn't reported), and a counted loop doesn't make the array of its range (so a range too long to be one runs).
+// stats (if not null) gets what each pass did added to it
+void Optimize(const TokenStream& tokens, Ast& ast, const OptimizeOptions& options, OptimizeStats* stats = nullptr);
+
+#endif
@@ -0,0 +1,95 @@
+#include "shape.h"
+
+#include <iomanip>
+#include <ostream>
+
+const Shape* Shape::GetParent() const {
+    return Parent;
+}
+
+std::string_view Shape::GetName() const {
+    return Name;
+}
+
+uint32_t Shape::GetSlotCount() const {
+    return SlotCount;
+}
+
+// walks up to the empty shape, only a cache miss gets here
+uint32_t Shape::Find(std::string_view name) const {
+    for (const Shape* shape = this; shape->Parent; shape = shape->Parent) {
+        if (shape->Name.data() == name.data()) {
+            return shape->SlotCount - 1;
+        }
+    }
+    return NoSlot;
+}
+
+std::vector<std::string_view> Shape::GetFieldNames() const {
+    std::vector<std::string_view> names(SlotCount);
+    for (const Shape* shape = this; shape->Parent; shape = shape->Parent) {
+        names[shape->SlotCount - 1] = shape->Name;
+    }
+    return names;
+}
+
+ShapeTable::ShapeTable() {
+    Shapes.push_back(std::make_unique<Shape>());
+}
+
+const Shape* ShapeTable::GetRoot() const {
+    // (made by the constructor and never moved, no lock needed)
+    return Shapes.front().get();
+}
+
+std::string_view ShapeTable::InternName(std::string_view name) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    // the nodes of the set don't move, so neither do the texts the views point into
+    return *Names.emplace(name).first;
+}
+
+const Shape* ShapeTable::AddField(const Shape* shape, std::string_view name, bool* created) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto [found, added] = shape->Transitions.emplace(name.data(), nullptr);
+    *created = added;
+    if (added) {
+        std::unique_ptr<Shape> child = std::make_unique<Shape>();
+        child->Parent = shape;
+        child->Name = name;
+        child->SlotCount = shape->SlotCount + 1;
+        found->second = child.get();
+        Shapes.push_back(std::move(child));
+    }
+    return found->second;
+}
+
+size_t ShapeTable::GetShapeCount() const {
+    std::lock_guard<std::mutex> lock(Mutex);
+    return Shapes.size();
+}
+
+ShapeTable& GetShapes() {
+    // a function local static is built exactly once even if several threads get here first
+    static ShapeTable table;
+    return table;
+}
+
+void ShapeStats::Merge(const ShapeStats& other) {
+    MonomorphicHits += other.MonomorphicHits;
+    PolymorphicHits += other.PolymorphicHits;
+    Misses += other.Misses;
+    MegamorphicMisses += other.MegamorphicMisses;
+    Transitions += other.Transitions;
+    ShapesCreated += other.ShapesCreated;
+}
+
+void ShapeStats::PrintText(std::ostream& out) const {
+    uint64_t accesses = MonomorphicHits + PolymorphicHits + Misses;
+    auto percent = [accesses](uint64_t count) {
+        return accesses > 0 ? count * 100.0 / accesses : 0.0;
+    };
+    out << "Shape stats: " << accesses << " field accesses, " << std::fixed << std::setprecision(1) << percent(MonomorphicHits + PolymorphicHits)
+        << "% inline cache hits (" << percent(MonomorphicHits) << "% monomorphic, " << percent(PolymorphicHits) << "% polymorphic)\n";
+    out << "  " << Misses << " misses (" << MegamorphicMisses << " at megamorphic sites), " << Transitions << " fields added, "
+        << ShapesCreated << " new shapes (" << GetShapes().GetShapeCount() << " in all)\n";
+}
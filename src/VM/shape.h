@@ -0,0 +1,184 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// a field that isn't there (Shape::Find)
+constexpr uint32_t NoSlot = UINT32_MAX;
+
+// the layout objects share (a hidden class): the names of their fields in the order they were set, each one's
+// value being in the slot of that index. shapes make a tree from the empty one, adding a field to an object moves
+// it to a child of its shape (a transition), so objects whose fields were set in the same order (every object of
+// a class, say) have the very same shape and a field access only has to compare it (see FieldSite).
+// shapes never change once made and are never freed, so a pointer to one stays good in any VM and any thread
+class Shape {
+    public:
+        // null for the empty shape
+        const Shape* GetParent() const;
+        // the field this shape added to its parent's, the last slot (interned, see ShapeTable::InternName)
+        std::string_view GetName() const;
+        uint32_t GetSlotCount() const;
+
+        // the slot of the field named name (interned, fields compare by address), NoSlot if there is none
+        uint32_t Find(std::string_view name) const;
+
+        // the names of every slot, in order
+        std::vector<std::string_view> GetFieldNames() const;
+
+    private:
+        friend class ShapeTable;
+
+        const Shape* Parent = nullptr;
+        std::string_view Name;
+        uint32_t SlotCount = 0;
+        // the children made so far, by the address of the name they add (the table's mutex guards it)
+        mutable std::unordered_map<const char*, const Shape*> Transitions;
+};
+
+// every shape and interned field name of the process, see GetShapes
+class ShapeTable {
+    public:
+        ShapeTable();
+        ShapeTable(const ShapeTable&) = delete;
+        ShapeTable& operator=(const ShapeTable&) = delete;
+
+        const Shape* GetRoot() const;
+
+        // the one copy of a field name that compiled programs and shapes share, so names compare by address
+        std::string_view InternName(std::string_view name);
+
+        // the shape of an object of shape with the field name added after the others (name interned), made the
+        // first time it is asked for (and created set to true then)
+        const Shape* AddField(const Shape* shape, std::string_view name, bool* created);
+
+        size_t GetShapeCount() const;
+
+    private:
+        mutable std::mutex Mutex;
+        std::unordered_set<std::string> Names;
+        std::vector<std::unique_ptr<Shape>> Shapes;
+};
+
+// the table of the process, made the first time it is asked for
+ShapeTable& GetShapes();
+
+// how many ways an inline cache has: a site that has seen more shapes than this is megamorphic and looks the
+// field up every time after
+constexpr size_t FieldCacheWays = 4;
+
+// the inline cache of one GETFIELD or SETFIELD (the word after the instruction is its index in
+// Function::FieldSites). a way is 0 while empty, else one word so it reads and fills atomically (a program can
+// run on several threads at once, in several VMs, and they share its caches): the shape in the low 48 bits (the
+// other bits of a pointer are 0, and so are the low 3 of a shape's), the slot of the field in the top 16 (a field
+// past MaxCachedSlot isn't cached), and
+//   TransitionBit:  a SETFIELD that adds the field, the shape is the one it moves the object to (its parent is
+//                   the shape it comes from, the field is its last slot)
+//   PolymorphicBit: set in the first way once another one is filled, so a monomorphic hit is a single compare
+//                   of the first way with the shape (see IsMonomorphicHit)
+// ways are filled in order and never evicted
+struct FieldSite {
+    std::string_view Name;
+    mutable std::atomic<uint64_t> Ways[FieldCacheWays];
+
+    explicit FieldSite(std::string_view name) : Name(name) {
+        for (std::atomic<uint64_t>& way : Ways) {
+            way.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    FieldSite(const FieldSite& other) : Name(other.Name) {
+        for (size_t i = 0; i < FieldCacheWays; i++) {
+            Ways[i].store(other.Ways[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr uint32_t MaxCachedSlot = 0xFFFF;
+    static constexpr uint64_t TransitionBit = 1;
+    static constexpr uint64_t PolymorphicBit = 2;
+    static constexpr uint64_t ShapeBits = 0x0000FFFFFFFFFFFF;
+
+    static uint64_t FieldWay(const Shape* shape, uint32_t slot) {
+        return reinterpret_cast<uintptr_t>(shape) | (static_cast<uint64_t>(slot) << 48);
+    }
+
+    static uint64_t TransitionWay(const Shape* shape) {
+        return reinterpret_cast<uintptr_t>(shape) | TransitionBit;
+    }
+
+    static const Shape* ShapeOf(uint64_t way) {
+        return reinterpret_cast<const Shape*>(static_cast<uintptr_t>(way & ShapeBits & ~(TransitionBit | PolymorphicBit)));
+    }
+
+    static uint32_t SlotOf(uint64_t way) {
+        return static_cast<uint32_t>(way >> 48);
+    }
+
+    // way (the first one) has the field of shape and the site never saw another shape
+    static bool IsMonomorphicHit(uint64_t way, const Shape* shape) {
+        return (way & ShapeBits) == reinterpret_cast<uintptr_t>(shape);
+    }
+
+    // the way with the field of an object of shape, 0 if there is none (a SETFIELD also takes the way adding
+    // the field to it)
+    uint64_t FindWay(const Shape* shape, bool adding) const {
+        for (const std::atomic<uint64_t>& slot : Ways) {
+            uint64_t way = slot.load(std::memory_order_relaxed);
+            if (way == 0) {
+                break;
+            }
+            if (!(way & TransitionBit) ? ShapeOf(way) == shape : adding && ShapeOf(way)->GetParent() == shape) {
+                return way;
+            }
+        }
+        return 0;
+    }
+
+    // puts way in the first empty way, false if there is none left (the site is megamorphic)
+    bool Fill(uint64_t way) const {
+        for (size_t i = 0; i < FieldCacheWays; i++) {
+            // (a failed exchange leaves what the way holds in expected: another thread may have filled it the same)
+            uint64_t expected = 0;
+            if (Ways[i].compare_exchange_strong(expected, way, std::memory_order_relaxed)) {
+                if (i > 0) {
+                    Ways[0].fetch_or(PolymorphicBit, std::memory_order_relaxed);
+                }
+                return true;
+            }
+            if ((expected & ~PolymorphicBit) == way) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// what the field accesses of a run did, added up over the runs of a VM until ResetStats
+struct ShapeStats {
+    // a cache of one way had the shape
+    uint64_t MonomorphicHits = 0;
+    // a cache of several ways had it
+    uint64_t PolymorphicHits = 0;
+    // the field was looked up in the shape (and the cache filled, if it had an empty way left)
+    uint64_t Misses = 0;
+    // misses at a site whose ways were all taken
+    uint64_t MegamorphicMisses = 0;
+    // fields added to an object, moving it to another shape
+    uint64_t Transitions = 0;
+    // shapes that didn't exist before a transition of the run asked for them
+    uint64_t ShapesCreated = 0;
+
+    void Merge(const ShapeStats& other);
+
+    void PrintText(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "value.h"
+#include "bytecode.h"
+#include "shape.h"
+
+#include <charconv>
+#include <cmath>
+
+bool ValuesEqual(const Value& left, const Value& right) {
+    if (left.IsNumber() && right.IsNumber()) {
+        return left.AsNumber() == right.AsNumber();
+    }
+    if (left.IsIdentical(right)) {
+        return true;
+    }
+    return left.IsObjectOf(ValueType::STRING) && right.IsObjectOf(ValueType::STRING) && AsString(left)->GetText() == AsString(right)->GetText();
+}
+
+std::string_view GetTypeName(const Value& value) {
+    switch (value.GetType()) {
+        case ValueType::NIL: return "nil";
+        case ValueType::BOOLEAN: return "boolean";
+        case ValueType::NUMBER: return "number";
+        case ValueType::STRING: return "string";
+        case ValueType::ARRAY: return "array";
+        case ValueType::OBJECT: return "object";
+        default: return "function";
+    }
+}
+
+// whole numbers print as integers (3, not 3.0), the others in the shortest form that reads back the same
+static void appendNumber(std::string& out, double number) {
+    char buffer[32];
+    std::to_chars_result result;
+    if (number == std::floor(number) && std::fabs(number) < 1e15) {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<int64_t>(number));
+    }
+    else {
+        result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    }
+    out.append(buffer, result.ptr - buffer);
+}
+
+void AppendValue(std::string& out, const Value& value, int depth) {
+    switch (value.GetType()) {
+        case ValueType::NIL: out += "nil"; break;
+        case ValueType::BOOLEAN: out += value.AsBoolean() ? "true" : "false"; break;
+        case ValueType::NUMBER: appendNumber(out, value.AsNumber()); break;
+        case ValueType::STRING:
+            if (depth > 0) {
+                out += '"';
+                out += AsString(value)->GetText();
+                out += '"';
+            }
+            else {
+                out += AsString(value)->GetText();
+            }
+            break;
+        case ValueType::ARRAY: {
+            if (depth >= 6) {
+                out += "[...]";
+                break;
+            }
+            out += '[';
+            const std::vector<Value>& elements = AsArray(value)->Elements;
+            for (size_t i = 0; i < elements.size(); i++) {
+                out += i > 0 ? ", " : "";
+                AppendValue(out, elements[i], depth + 1);
+            }
+            out += ']';
+            break;
+        }
+        case ValueType::OBJECT: {
+            if (depth >= 6) {
+                out += "{...}";
+                break;
+            }
+            out += '{';
+            const InstanceObject* instance = AsInstance(value);
+            std::vector<std::string_view> names = instance->Layout->GetFieldNames();
+            for (size_t i = 0; i < names.size(); i++) {
+                out += i > 0 ? ", " : "";
+                out += names[i];
+                out += ": ";
+                AppendValue(out, instance->Slots[i], depth + 1);
+            }
+            out += '}';
+            break;
+        }
+        case ValueType::FUNCTION:
+            out += "<func ";
+            out += AsFunction(value)->Code->Name;
+            out += '>';
+            break;
+        case ValueType::NATIVE:
+            out += "<native ";
+            out += AsNative(value)->Name;
+            out += '>';
+            break;
+    }
+}
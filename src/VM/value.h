@@ -0,0 +1,239 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// what a value is, the order of the heap types matters (every type from STRING on is an Object*)
+enum class ValueType : uint8_t {
+    NIL,
+    BOOLEAN,
+    NUMBER,
+    STRING,
+    ARRAY,
+    OBJECT,
+    FUNCTION,
+    NATIVE
+};
+
+// where an object lives (see heap.h): the nursery until it survives a collection, then the old generation.
+// constants of a program are never collected
+enum class Generation : uint8_t {
+    NURSERY,
+    OLD,
+    PERMANENT
+};
+
+// every object starts with this, so a Value's pointer can be cast to the right one by its type
+struct Object {
+    ValueType Type;
+    Generation Where;
+    // reached by the major collection in progress
+    bool Marked;
+    // an old object in the remembered set (it was given a pointer to a nursery object since the last collection)
+    bool Remembered;
+    // bytes of the object itself (not what it points to), a multiple of 8
+    uint32_t Size;
+    // where a nursery object was copied to, once it has been (null before)
+    Object* Forward;
+};
+
+// one value of the language in 64 bits, copied around by value. a double is itself, every other value hides in
+// the payload of a quiet NaN no arithmetic makes (bit 50 set, which the default NaN of the hardware and any NaN
+// made from a number the VM holds don't have): nil, false and true are small payloads, and with the sign bit
+// set too the low 48 bits are an Object*
+class Value {
+    public:
+        // nil
+        Value() : Bits(NilBits) {
+        }
+
+        static Value Nil() {
+            return Value(NilBits);
+        }
+
+        static Value FromBoolean(bool boolean) {
+            return Value(boolean ? TrueBits : FalseBits);
+        }
+
+        static Value FromNumber(double number) {
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            return Value(bits);
+        }
+
+        static Value FromObject(Object* object) {
+            return Value(PointerTag | reinterpret_cast<uintptr_t>(object));
+        }
+
+        bool IsNumber() const {
+            return (Bits & QuietNan) != QuietNan;
+        }
+
+        bool IsObject() const {
+            return (Bits & PointerTag) == PointerTag;
+        }
+
+        bool IsNil() const {
+            return Bits == NilBits;
+        }
+
+        bool IsBoolean() const {
+            return (Bits | 1) == TrueBits;
+        }
+
+        // an object of that type (type is STRING or one after it)
+        bool IsObjectOf(ValueType type) const {
+            return IsObject() && AsObject()->Type == type;
+        }
+
+        double AsNumber() const {
+            double number;
+            std::memcpy(&number, &Bits, sizeof(number));
+            return number;
+        }
+
+        bool AsBoolean() const {
+            return Bits == TrueBits;
+        }
+
+        Object* AsObject() const {
+            return reinterpret_cast<Object*>(static_cast<uintptr_t>(Bits & PointerMask));
+        }
+
+        ValueType GetType() const {
+            if (IsNumber()) {
+                return ValueType::NUMBER;
+            }
+            if (IsObject()) {
+                return AsObject()->Type;
+            }
+            return Bits == NilBits ? ValueType::NIL : ValueType::BOOLEAN;
+        }
+
+        // nil and false are false, everything else (0 and "" too) is true
+        bool IsTruthy() const {
+            return Bits != NilBits && Bits != FalseBits;
+        }
+
+        // the same 64 bits: the same object, or the same number (not NaN, and 0 isn't -0)
+        bool IsIdentical(Value other) const {
+            return Bits == other.Bits;
+        }
+
+    private:
+        static constexpr uint64_t QuietNan = 0x7FFC000000000000;
+        static constexpr uint64_t SignBit = 0x8000000000000000;
+        static constexpr uint64_t PointerTag = SignBit | QuietNan;
+        static constexpr uint64_t PointerMask = 0x0000FFFFFFFFFFFF;
+        static constexpr uint64_t NilBits = QuietNan | 1;
+        static constexpr uint64_t FalseBits = QuietNan | 2;
+        static constexpr uint64_t TrueBits = QuietNan | 3;
+
+        explicit Value(uint64_t bits) : Bits(bits) {
+        }
+
+        uint64_t Bits;
+};
+
+static_assert(sizeof(Value) == 8, "a value is one word");
+
+struct Function;
+class Shape;
+class VirtualMachine;
+
+// a function of the runtime written in C++: gets its arguments and sets result, returns false if an argument
+// had the wrong type (reported as TYPE_MISMATCH at the call)
+using NativeFunction = bool (*)(VirtualMachine& vm, Value* arguments, uint32_t count, Value& result);
+
+// the characters follow the object in the same allocation, so a string is one block with nothing to free
+struct StringObject : Object {
+    uint32_t Length;
+
+    const char* GetChars() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+
+    char* GetChars() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+
+    std::string_view GetText() const {
+        return std::string_view(GetChars(), Length);
+    }
+};
+
+struct ArrayObject : Object {
+    std::vector<Value> Elements;
+};
+
+// what { } and new make: its shape names the fields, in the order they were first set, and has the slot of each
+// one (an index in Slots), objects whose fields were set in the same order share it (see shape.h)
+struct InstanceObject : Object {
+    const Shape* Layout;
+    std::vector<Value> Slots;
+};
+
+struct FunctionObject : Object {
+    const Function* Code;
+};
+
+struct NativeObject : Object {
+    NativeFunction Call;
+    std::string_view Name;
+    // -1 for any number of arguments
+    int Arity;
+};
+
+inline StringObject* AsString(const Value& value) {
+    return static_cast<StringObject*>(value.AsObject());
+}
+
+inline ArrayObject* AsArray(const Value& value) {
+    return static_cast<ArrayObject*>(value.AsObject());
+}
+
+inline InstanceObject* AsInstance(const Value& value) {
+    return static_cast<InstanceObject*>(value.AsObject());
+}
+
+inline FunctionObject* AsFunction(const Value& value) {
+    return static_cast<FunctionObject*>(value.AsObject());
+}
+
+inline NativeObject* AsNative(const Value& value) {
+    return static_cast<NativeObject*>(value.AsObject());
+}
+
+// the remainder of x / y with the sign of x, like fmod, but with an integer division when both are whole numbers
+// that fit one (the common case, and several times faster than fmod)
+inline double RemainderOf(double x, double y) {
+    constexpr double limit = 9007199254740992.0;
+    if (x > -limit && x < limit && y > -limit && y < limit) {
+        int64_t left = static_cast<int64_t>(x);
+        int64_t right = static_cast<int64_t>(y);
+        if (left == x && right == y && right != 0) {
+            int64_t result = left % right;
+            return result == 0 && x < 0 ? -0.0 : static_cast<double>(result);
+        }
+    }
+    return std::fmod(x, y);
+}
+
+// same type and same value, strings by their text and the other objects by identity
+bool ValuesEqual(const Value& left, const Value& right);
+
+// what typeof gives ("nil", "boolean", "number", "string", "array", "object", "function")
+std::string_view GetTypeName(const Value& value);
+
+// appends the value the way print shows it: whole numbers without a fraction, strings as they are at the top
+// and quoted inside arrays and objects, those nested deeper than a few levels (or inside themselves) as [...]
+// and {...}
+void AppendValue(std::string& out, const Value& value, int depth = 0);
+
+#endif
@@ -0,0 +1,621 @@
+#include "vm.h"
+#include "natives.h"
+#include "../Lexer/utf8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ranges longer than this are an error rather than an allocation that can't succeed
+constexpr double MaxRangeLength = 1 << 28;
+
+// what a string yields for a sequence that isn't well-formed UTF-8 (or an index in the middle of one)
+constexpr std::string_view ReplacementCharacter = "\xEF\xBF\xBD";
+
+// the code point of text starting at byte index, length is set to how far to move on (so an ill-formed
+// sequence is still skipped as one), a string made of what this returns is always well-formed
+static std::string_view codePointAt(std::string_view text, size_t index, size_t* length) {
+    if (DecodeUtf8(text, index, length) == InvalidCodePoint) {
+        return ReplacementCharacter;
+    }
+    return text.substr(index, *length);
+}
+
+// creating a VM, the register stack is allocated once here and never moves (frames point into it)
+VirtualMachine::VirtualMachine() {
+    Stack.resize(StackSize, Value::Nil());
+    Frames.reserve(MaxCallDepth);
+    Output = nullptr;
+    Failed = nullptr;
+    StackTop = Stack.data();
+    StackHigh = Stack.data();
+    Objects.SetRootScanner([this](Heap& heap) {
+        ScanRoots(heap);
+    });
+}
+
+// the registers of every frame (everything under StackTop) and the globals. registers above the top are left
+// over from calls that returned, they are cleared so a value there never outlives what it points to
+void VirtualMachine::ScanRoots(Heap& heap) {
+    for (Value* value = Stack.data(); value < StackTop; value++) {
+        heap.VisitRoot(*value);
+    }
+    std::fill(StackTop, std::max(StackTop, StackHigh), Value::Nil());
+    StackHigh = StackTop;
+    for (Value& global : Globals) {
+        heap.VisitRoot(global);
+    }
+}
+
+Heap& VirtualMachine::GetHeap() {
+    return Objects;
+}
+
+const ShapeStats& VirtualMachine::GetShapeStats() const {
+    return Shapes;
+}
+
+void VirtualMachine::ResetStats() {
+    Objects.ResetStats();
+    Shapes = ShapeStats();
+}
+
+std::string& VirtualMachine::GetOutput() {
+    return *Output;
+}
+
+const char* VirtualMachine::GetDispatchName() {
+    return ILYS_COMPUTED_GOTO ? "computed goto" : "switch";
+}
+
+bool VirtualMachine::Run(const Program& program, std::string& output, Diagnostic* error) {
+    return RunModules({&program}, output, error);
+}
+
+// the natives take the first slots of every program, in the order of GetNatives (see DeclareGlobals)
+bool VirtualMachine::RunModules(const std::vector<const Program*>& modules, std::string& output, Diagnostic* error, size_t* failed) {
+    // what is left on the stack points into the heap being cleared
+    std::fill(Stack.data(), std::max(StackTop, StackHigh), Value::Nil());
+    Objects.Clear();
+    const std::vector<NativeEntry>& natives = GetNatives();
+    size_t slots = natives.size();
+    for (const Program* program : modules) {
+        slots = std::max(slots, program->GlobalBase + program->Globals.size());
+    }
+    Globals.assign(slots, Value::Nil());
+    for (size_t slot = 0; slot < natives.size(); slot++) {
+        Globals[slot] = Objects.NewNative(natives[slot].Call, natives[slot].Name, natives[slot].Arity);
+    }
+    Output = &output;
+    bool ran = true;
+    for (size_t i = 0; i < modules.size() && ran; i++) {
+        const Function* main = modules[i]->GetMain();
+        ran = !main || Execute(main, error);
+        Frames.clear();
+        if (!ran && failed) {
+            // the module the failed function belongs to
+            *failed = i;
+            for (size_t j = 0; j < modules.size(); j++) {
+                for (const std::unique_ptr<Function>& function : modules[j]->Functions) {
+                    *failed = function.get() == Failed ? j : *failed;
+                }
+            }
+        }
+    }
+    Output = nullptr;
+    return ran;
+}
+
+// the body of every instruction is written once, between VM_CASE(name) and VM_NEXT(), and becomes either a
+// label of the computed goto table or a case of the switch
+#if ILYS_COMPUTED_GOTO
+#define VM_CASE(name) label_##name:
+#define VM_NEXT() \
+    do { \
+        instruction = *ip++; \
+        goto *labels[instruction & 0xFF]; \
+    } while (0)
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() continue
+#endif
+
+#define VM_A DecodeA(instruction)
+#define VM_B DecodeB(instruction)
+#define VM_C DecodeC(instruction)
+#define VM_ERROR(code) \
+    do { \
+        failure = DiagnosticCode::code; \
+        goto fail; \
+    } while (0)
+
+// an instruction on two numbers that gives a number
+#define VM_ARITHMETIC(name, expression) \
+    VM_CASE(name) { \
+        const Value& left = registers[VM_B]; \
+        const Value& right = registers[VM_C]; \
+        if (!left.IsNumber() || !right.IsNumber()) { \
+            VM_ERROR(TYPE_MISMATCH); \
+        } \
+        double x = left.AsNumber(); \
+        double y = right.AsNumber(); \
+        registers[VM_A] = Value::FromNumber(expression); \
+        VM_NEXT(); \
+    }
+
+// a comparison of two numbers or two strings, sets result
+#define VM_COMPARE(left, right, op, result) \
+    if (left.IsNumber() && right.IsNumber()) { \
+        result = left.AsNumber() op right.AsNumber(); \
+    } \
+    else if (left.IsObjectOf(ValueType::STRING) && right.IsObjectOf(ValueType::STRING)) { \
+        result = AsString(left)->GetText() op AsString(right)->GetText(); \
+    } \
+    else { \
+        VM_ERROR(TYPE_MISMATCH); \
+    }
+
+#define VM_ORDER(name, op) \
+    VM_CASE(name) { \
+        const Value& left = registers[VM_B]; \
+        const Value& right = registers[VM_C]; \
+        bool result; \
+        VM_COMPARE(left, right, op, result); \
+        registers[VM_A] = Value::FromBoolean(result); \
+        VM_NEXT(); \
+    }
+
+// compare-and-branch: the jump is the next word
+#define VM_BRANCH_ORDER(name, op) \
+    VM_CASE(name) { \
+        const Value& left = registers[VM_A]; \
+        const Value& right = registers[VM_B]; \
+        bool result; \
+        VM_COMPARE(left, right, op, result); \
+        int32_t offset = static_cast<int32_t>(*ip++); \
+        if (!result) { \
+            ip += offset; \
+        } \
+        VM_NEXT(); \
+    }
+
+#define VM_BRANCH_EQUALITY(name, equal) \
+    VM_CASE(name) { \
+        const Value& left = registers[VM_A]; \
+        const Value& right = registers[VM_B]; \
+        bool same = left.IsNumber() && right.IsNumber() ? left.AsNumber() == right.AsNumber() : ValuesEqual(left, right); \
+        int32_t offset = static_cast<int32_t>(*ip++); \
+        if (same != equal) { \
+            ip += offset; \
+        } \
+        VM_NEXT(); \
+    }
+
+// returns to the caller with result in its register, or ends the run from the top level (a plain block, VM_NEXT
+// is a continue with the switch)
+#define VM_RETURN(value) \
+    { \
+        Value result = value; \
+        if (Frames.empty()) { \
+            return true; \
+        } \
+        const Frame& frame = Frames.back(); \
+        function = frame.Code; \
+        ip = frame.Ip; \
+        registers = frame.Registers; \
+        constants = function->Constants.data(); \
+        StackTop = registers + function->Registers; \
+        registers[frame.Result] = result; \
+        Frames.pop_back(); \
+        VM_NEXT(); \
+    }
+
+bool VirtualMachine::Execute(const Function* main, Diagnostic* error) {
+    const Function* function = main;
+    const uint32_t* ip = function->Code.data();
+    const Value* constants = function->Constants.data();
+    Value* registers = Stack.data();
+    Value* globals = Globals.data();
+    Value* stackEnd = Stack.data() + Stack.size();
+    StackTop = registers + function->Registers;
+    StackHigh = std::max(StackHigh, StackTop);
+    uint32_t instruction;
+    DiagnosticCode failure = DiagnosticCode::TYPE_MISMATCH;
+
+#if ILYS_COMPUTED_GOTO
+    static const void* const labels[256] = {
+#define ILYS_OPCODE_LABEL(name, format) &&label_##name,
+        ILYS_OPCODE_SPEC(ILYS_OPCODE_LABEL)
+#undef ILYS_OPCODE_LABEL
+    };
+    VM_NEXT();
+#else
+    while (true) {
+        instruction = *ip++;
+        switch (DecodeOpcode(instruction)) {
+#endif
+
+    VM_CASE(MOVE) {
+        registers[VM_A] = registers[VM_B];
+        VM_NEXT();
+    }
+    VM_CASE(LOADK) {
+        registers[VM_A] = constants[DecodeBx(instruction)];
+        VM_NEXT();
+    }
+    VM_CASE(LOADINT) {
+        registers[VM_A] = Value::FromNumber(DecodeSBx(instruction));
+        VM_NEXT();
+    }
+    VM_CASE(LOADNIL) {
+        registers[VM_A] = Value::Nil();
+        VM_NEXT();
+    }
+    VM_CASE(LOADTRUE) {
+        registers[VM_A] = Value::FromBoolean(true);
+        VM_NEXT();
+    }
+    VM_CASE(LOADFALSE) {
+        registers[VM_A] = Value::FromBoolean(false);
+        VM_NEXT();
+    }
+    VM_CASE(GETGLOBAL) {
+        registers[VM_A] = globals[DecodeBx(instruction)];
+        VM_NEXT();
+    }
+    VM_CASE(SETGLOBAL) {
+        globals[DecodeBx(instruction)] = registers[VM_A];
+        VM_NEXT();
+    }
+    VM_CASE(ADD) {
+        const Value& left = registers[VM_B];
+        const Value& right = registers[VM_C];
+        if (left.IsNumber() && right.IsNumber()) {
+            registers[VM_A] = Value::FromNumber(left.AsNumber() + right.AsNumber());
+            VM_NEXT();
+        }
+        bool leftString = left.IsObjectOf(ValueType::STRING);
+        bool rightString = right.IsObjectOf(ValueType::STRING);
+        if (leftString && rightString) {
+            // made first and filled after: making it may move both strings, the registers have where they went
+            StringObject* joined = Objects.NewStringOfLength(size_t(AsString(left)->Length) + AsString(right)->Length);
+            std::string_view first = AsString(registers[VM_B])->GetText();
+            std::string_view second = AsString(registers[VM_C])->GetText();
+            std::memcpy(joined->GetChars(), first.data(), first.size());
+            std::memcpy(joined->GetChars() + first.size(), second.data(), second.size());
+            registers[VM_A] = Value::FromObject(joined);
+            VM_NEXT();
+        }
+        if (!leftString && !rightString) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        std::string text;
+        AppendValue(text, left);
+        AppendValue(text, right);
+        registers[VM_A] = Objects.NewString(text);
+        VM_NEXT();
+    }
+    VM_ARITHMETIC(SUB, x - y)
+    VM_ARITHMETIC(MUL, x * y)
+    VM_ARITHMETIC(DIV, x / y)
+    VM_ARITHMETIC(MOD, RemainderOf(x, y))
+    VM_CASE(EQ) {
+        const Value& left = registers[VM_B];
+        const Value& right = registers[VM_C];
+        registers[VM_A] = Value::FromBoolean(left.IsNumber() && right.IsNumber() ? left.AsNumber() == right.AsNumber() : ValuesEqual(left, right));
+        VM_NEXT();
+    }
+    VM_CASE(NE) {
+        const Value& left = registers[VM_B];
+        const Value& right = registers[VM_C];
+        registers[VM_A] = Value::FromBoolean(!(left.IsNumber() && right.IsNumber() ? left.AsNumber() == right.AsNumber() : ValuesEqual(left, right)));
+        VM_NEXT();
+    }
+    VM_ORDER(LT, <)
+    VM_ORDER(LE, <=)
+    VM_CASE(NEG) {
+        const Value& operand = registers[VM_B];
+        if (!operand.IsNumber()) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        registers[VM_A] = Value::FromNumber(-operand.AsNumber());
+        VM_NEXT();
+    }
+    VM_CASE(NOT) {
+        registers[VM_A] = Value::FromBoolean(!registers[VM_B].IsTruthy());
+        VM_NEXT();
+    }
+    VM_CASE(TYPEOF) {
+        registers[VM_A] = Objects.NewString(GetTypeName(registers[VM_B]));
+        VM_NEXT();
+    }
+    VM_CASE(INC) {
+        Value& operand = registers[VM_A];
+        if (!operand.IsNumber()) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        operand = Value::FromNumber(operand.AsNumber() + 1);
+        VM_NEXT();
+    }
+    VM_CASE(DEC) {
+        Value& operand = registers[VM_A];
+        if (!operand.IsNumber()) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        operand = Value::FromNumber(operand.AsNumber() - 1);
+        VM_NEXT();
+    }
+    VM_CASE(JUMP) {
+        ip += DecodeSBx(instruction);
+        VM_NEXT();
+    }
+    VM_CASE(JUMPIFFALSE) {
+        if (!registers[VM_A].IsTruthy()) {
+            ip += DecodeSBx(instruction);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(JUMPIFTRUE) {
+        if (registers[VM_A].IsTruthy()) {
+            ip += DecodeSBx(instruction);
+        }
+        VM_NEXT();
+    }
+    VM_BRANCH_EQUALITY(JUMPIFNOTEQ, true)
+    VM_BRANCH_EQUALITY(JUMPIFNOTNE, false)
+    VM_BRANCH_ORDER(JUMPIFNOTLT, <)
+    VM_BRANCH_ORDER(JUMPIFNOTLE, <=)
+    VM_CASE(FORPREP) {
+        Value* loop = registers + VM_A;
+        if (!loop[0].IsNumber() || !loop[1].IsNumber()) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        // not a > b, so a NaN bound loops no times, like the empty array a..b makes
+        if (!(loop[0].AsNumber() <= loop[1].AsNumber())) {
+            ip += DecodeSBx(instruction);
+        }
+        else {
+            loop[2] = loop[0];
+        }
+        VM_NEXT();
+    }
+    VM_CASE(FORLOOP) {
+        // the counter and the limit are registers the program can't name, they are still numbers
+        Value* loop = registers + VM_A;
+        double next = loop[0].AsNumber() + 1;
+        loop[0] = Value::FromNumber(next);
+        if (next <= loop[1].AsNumber()) {
+            loop[2] = loop[0];
+            ip += DecodeSBx(instruction);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(ITERATE) {
+        Value* loop = registers + VM_A;
+        size_t index = static_cast<size_t>(loop[1].AsNumber());
+        if (loop[0].IsObjectOf(ValueType::ARRAY)) {
+            const std::vector<Value>& elements = AsArray(loop[0])->Elements;
+            if (index >= elements.size()) {
+                ip += DecodeSBx(instruction);
+                VM_NEXT();
+            }
+            loop[2] = elements[index];
+        }
+        else if (loop[0].IsObjectOf(ValueType::STRING)) {
+            std::string_view text = AsString(loop[0])->GetText();
+            if (index >= text.size()) {
+                ip += DecodeSBx(instruction);
+                VM_NEXT();
+            }
+            // one code point at a time, the counter is the byte offset of the next one
+            size_t length;
+            loop[2] = Objects.NewString(codePointAt(text, index, &length));
+            loop[1] = Value::FromNumber(static_cast<double>(index + length));
+            VM_NEXT();
+        }
+        else {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        loop[1] = Value::FromNumber(static_cast<double>(index + 1));
+        VM_NEXT();
+    }
+    VM_CASE(NEWARRAY) {
+        registers[VM_A] = Objects.NewArray(DecodeBx(instruction));
+        VM_NEXT();
+    }
+    VM_CASE(APPEND) {
+        ArrayObject* array = AsArray(registers[VM_A]);
+        Objects.WriteBarrier(array, registers[VM_B]);
+        array->Elements.push_back(registers[VM_B]);
+        VM_NEXT();
+    }
+    VM_CASE(RANGE) {
+        const Value& first = registers[VM_B];
+        const Value& last = registers[VM_C];
+        if (!first.IsNumber() || !last.IsNumber()) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        double length = last.AsNumber() >= first.AsNumber() ? std::floor(last.AsNumber() - first.AsNumber()) + 1 : 0;
+        if (length > MaxRangeLength) {
+            VM_ERROR(INDEX_OUT_OF_RANGE);
+        }
+        double start = first.AsNumber();
+        Value range = Objects.NewArray(static_cast<size_t>(length));
+        for (size_t i = 0; i < static_cast<size_t>(length); i++) {
+            AsArray(range)->Elements.push_back(Value::FromNumber(start + static_cast<double>(i)));
+        }
+        registers[VM_A] = range;
+        VM_NEXT();
+    }
+    VM_CASE(GETINDEX) {
+        const Value& object = registers[VM_B];
+        const Value& index = registers[VM_C];
+        if (!index.IsNumber() || !(object.IsObjectOf(ValueType::ARRAY) || object.IsObjectOf(ValueType::STRING))) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        double position = index.AsNumber();
+        if (object.IsObjectOf(ValueType::ARRAY)) {
+            const std::vector<Value>& elements = AsArray(object)->Elements;
+            if (!(position >= 0 && position < elements.size()) || position != std::floor(position)) {
+                VM_ERROR(INDEX_OUT_OF_RANGE);
+            }
+            registers[VM_A] = elements[static_cast<size_t>(position)];
+        }
+        else {
+            std::string_view text = AsString(object)->GetText();
+            if (!(position >= 0 && position < text.size()) || position != std::floor(position)) {
+                VM_ERROR(INDEX_OUT_OF_RANGE);
+            }
+            // the index is a byte offset (like len), the whole code point starting there is what it gives
+            size_t length;
+            registers[VM_A] = Objects.NewString(codePointAt(text, static_cast<size_t>(position), &length));
+        }
+        VM_NEXT();
+    }
+    VM_CASE(SETINDEX) {
+        const Value& object = registers[VM_A];
+        const Value& index = registers[VM_B];
+        if (!index.IsNumber() || !object.IsObjectOf(ValueType::ARRAY)) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        std::vector<Value>& elements = AsArray(object)->Elements;
+        double position = index.AsNumber();
+        if (!(position >= 0 && position < elements.size()) || position != std::floor(position)) {
+            VM_ERROR(INDEX_OUT_OF_RANGE);
+        }
+        Objects.WriteBarrier(object.AsObject(), registers[VM_C]);
+        elements[static_cast<size_t>(position)] = registers[VM_C];
+        VM_NEXT();
+    }
+    VM_CASE(NEWOBJECT) {
+        registers[VM_A] = Objects.NewInstance(DecodeBx(instruction));
+        VM_NEXT();
+    }
+    VM_CASE(GETFIELD) {
+        const Value& object = registers[VM_B];
+        const FieldSite& site = function->FieldSites[*ip++];
+        if (!object.IsObjectOf(ValueType::OBJECT)) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        const InstanceObject* instance = AsInstance(object);
+        // the shape of a monomorphic site, then every shape the site saw, then a lookup in the shape
+        uint64_t way = site.Ways[0].load(std::memory_order_relaxed);
+        if (FieldSite::IsMonomorphicHit(way, instance->Layout)) {
+            Shapes.MonomorphicHits++;
+            registers[VM_A] = instance->Slots[FieldSite::SlotOf(way)];
+            VM_NEXT();
+        }
+        // (no loop around VM_NEXT: with the switch it is a continue)
+        if ((way = site.FindWay(instance->Layout, false)) != 0) {
+            Shapes.PolymorphicHits++;
+            registers[VM_A] = instance->Slots[FieldSite::SlotOf(way)];
+            VM_NEXT();
+        }
+        uint32_t slot = instance->Layout->Find(site.Name);
+        registers[VM_A] = slot == NoSlot ? Value::Nil() : instance->Slots[slot];
+        Shapes.Misses++;
+        if (slot != NoSlot && slot <= FieldSite::MaxCachedSlot && !site.Fill(FieldSite::FieldWay(instance->Layout, slot))) {
+            Shapes.MegamorphicMisses++;
+        }
+        VM_NEXT();
+    }
+    VM_CASE(SETFIELD) {
+        const Value& object = registers[VM_A];
+        const FieldSite& site = function->FieldSites[*ip++];
+        if (!object.IsObjectOf(ValueType::OBJECT)) {
+            VM_ERROR(TYPE_MISMATCH);
+        }
+        InstanceObject* instance = AsInstance(object);
+        Objects.WriteBarrier(instance, registers[VM_B]);
+        // a way either has the shape (the field is there) or the shape adding the field moves the object to
+        uint64_t first = site.Ways[0].load(std::memory_order_relaxed);
+        if (FieldSite::IsMonomorphicHit(first, instance->Layout)) {
+            Shapes.MonomorphicHits++;
+            instance->Slots[FieldSite::SlotOf(first)] = registers[VM_B];
+            VM_NEXT();
+        }
+        if (uint64_t way = site.FindWay(instance->Layout, true)) {
+            (first & FieldSite::PolymorphicBit ? Shapes.PolymorphicHits : Shapes.MonomorphicHits)++;
+            if (way & FieldSite::TransitionBit) {
+                instance->Slots.push_back(registers[VM_B]);
+                instance->Layout = FieldSite::ShapeOf(way);
+                Shapes.Transitions++;
+            }
+            else {
+                instance->Slots[FieldSite::SlotOf(way)] = registers[VM_B];
+            }
+            VM_NEXT();
+        }
+        Shapes.Misses++;
+        uint32_t slot = instance->Layout->Find(site.Name);
+        uint64_t way;
+        if (slot != NoSlot) {
+            instance->Slots[slot] = registers[VM_B];
+            way = slot <= FieldSite::MaxCachedSlot ? FieldSite::FieldWay(instance->Layout, slot) : 0;
+        }
+        else {
+            bool created;
+            instance->Layout = GetShapes().AddField(instance->Layout, site.Name, &created);
+            instance->Slots.push_back(registers[VM_B]);
+            Shapes.Transitions++;
+            Shapes.ShapesCreated += created;
+            way = FieldSite::TransitionWay(instance->Layout);
+        }
+        if (way != 0 && !site.Fill(way)) {
+            Shapes.MegamorphicMisses++;
+        }
+        VM_NEXT();
+    }
+    VM_CASE(CALL) {
+        uint32_t callee = VM_A;
+        uint32_t count = VM_B;
+        const Value& target = registers[callee];
+        if (target.IsObjectOf(ValueType::FUNCTION)) {
+            const Function* code = AsFunction(target)->Code;
+            if (count != code->Parameters) {
+                VM_ERROR(WRONG_ARGUMENT_COUNT);
+            }
+            Value* base = registers + callee + 1;
+            if (Frames.size() >= MaxCallDepth || base + code->Registers > stackEnd) {
+                VM_ERROR(STACK_OVERFLOW);
+            }
+            Frames.push_back(Frame{function, ip, registers, callee});
+            function = code;
+            ip = code->Code.data();
+            constants = code->Constants.data();
+            registers = base;
+            StackTop = base + code->Registers;
+            StackHigh = std::max(StackHigh, StackTop);
+            VM_NEXT();
+        }
+        if (target.IsObjectOf(ValueType::NATIVE)) {
+            const NativeObject* native = AsNative(target);
+            if (native->Arity >= 0 && count != static_cast<uint32_t>(native->Arity)) {
+                VM_ERROR(WRONG_ARGUMENT_COUNT);
+            }
+            Value result;
+            if (!native->Call(*this, registers + callee + 1, count, result)) {
+                VM_ERROR(TYPE_MISMATCH);
+            }
+            registers[callee] = result;
+            VM_NEXT();
+        }
+        VM_ERROR(NOT_CALLABLE);
+    }
+    VM_CASE(RETURN) VM_RETURN(registers[VM_A])
+    VM_CASE(RETURNNIL) VM_RETURN(Value::Nil())
+
+#if !ILYS_COMPUTED_GOTO
+        }
+    }
+#endif
+
+fail:
+    Failed = function;
+    // the span of the instruction that failed (ip is past its first word)
+    const Function::Span& span = function->Spans[ip - 1 - function->Code.data()];
+    if (error) {
+        *error = Diagnostic{failure, span.Offset, span.Length};
+    }
+    return false;
+}
@@ -0,0 +1,79 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "../Lexer/diagnostics.h"
+
+// 1: every instruction ends with an indirect jump through a table of label addresses (a GNU extension, so each
+// instruction gets its own branch to predict), 0: a switch in a loop (one shared branch, but standard C++).
+// on by default where the compiler has it, build with -DILYS_COMPUTED_GOTO=0 for the switch anyway
+#ifndef ILYS_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define ILYS_COMPUTED_GOTO 1
+#else
+#define ILYS_COMPUTED_GOTO 0
+#endif
+#endif
+
+// calls nested deeper than this are STACK_OVERFLOW (as are calls that would run past the register stack)
+constexpr size_t MaxCallDepth = 10000;
+constexpr size_t StackSize = 1 << 18;
+
+// runs compiled programs: one stack of registers (a call's registers start right after its callee's register in
+// the caller, so the arguments are already in place), the globals of the program and a heap for the values it
+// makes (the registers in use and the globals are the roots of its collections). not thread safe, every thread
+// needs its own
+class VirtualMachine {
+    public:
+        VirtualMachine();
+        VirtualMachine(const VirtualMachine&) = delete;
+        VirtualMachine& operator=(const VirtualMachine&) = delete;
+
+        // runs the top level of program to its end (or to a return), what print writes is appended to output.
+        // returns false on a runtime error, with error set to it (the globals and the heap of one run are dropped
+        // at the start of the next, either way)
+        bool Run(const Program& program, std::string& output, Diagnostic* error);
+
+        // runs the top levels of the modules of a build (see ModuleLink) one after the other, in one set of
+        // globals, stopping at the first runtime error: error is set to it and failed (if not null) to the index of
+        // the module whose code it was in (a function of another module may have been called)
+        bool RunModules(const std::vector<const Program*>& modules, std::string& output, Diagnostic* error, size_t* failed = nullptr);
+
+        // for the natives (one that makes more than one object has to keep the first in a register, see heap.h)
+        Heap& GetHeap();
+        std::string& GetOutput();
+
+        // what the field accesses of the runs did (the collector's are the heap's)
+        const ShapeStats& GetShapeStats() const;
+        // starts the stats of the heap and of the field accesses over, for a VM reused by another run
+        void ResetStats();
+
+        // "computed goto" or "switch", see ILYS_COMPUTED_GOTO
+        static const char* GetDispatchName();
+
+    private:
+        // a call in progress: what to go back to when the function it called returns
+        struct Frame {
+            const Function* Code;
+            const uint32_t* Ip;
+            Value* Registers;
+            uint32_t Result;
+        };
+
+        std::vector<Value> Stack;
+        // past the registers of the running function, and the highest that has been since the last collection
+        Value* StackTop;
+        Value* StackHigh;
+        std::vector<Value> Globals;
+        std::vector<Frame> Frames;
+        Heap Objects;
+        ShapeStats Shapes;
+        std::string* Output;
+        // the function the last runtime error was in
+        const Function* Failed;
+
+        void ScanRoots(Heap& heap);
+        bool Execute(const Function* main, Diagnostic* error);
+};
+
+#endif
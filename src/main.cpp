@@ -1,4 +1,27 @@
 #include "Lexer/lexer.h"
+#include "Lexer/generator.h"
+#include "Lexer/parallel.h"
+#include "Lexer/incremental.h"
+#include "Lexer/token_cache.h"
+#include "Lexer/diagnostics.h"
+#include "Lexer/scan.h"
+#include "Lexer/utf8.h"
+#include "Driver/driver.h"
+#include "Driver/modules.h"
+#include "Driver/server.h"
+#include "Parser/parser.h"
+#include "VM/compiler.h"
+#include "VM/optimizer.h"
+#include "VM/vm.h"
+#include "Benchmarks/corpus.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
 
 // holding expected tokens
 struct ExpectedToken {
@@ -7,87 +30,1227 @@ struct ExpectedToken {
 };
 
 // function to compare generated tokens with expected tokens
-bool compareTokens(const std::vector<Token>& generatedTokens, const std::vector<ExpectedToken>& expectedTokens) {
+bool compareTokens(const TokenStream& generated, const std::vector<ExpectedToken>& expectedTokens) {
+    const std::vector<Token>& generatedTokens = generated.Tokens;
     if (generatedTokens.size() != expectedTokens.size()) {
         return false;
     }
     for (size_t i = 0; i < generatedTokens.size(); i++) {
-        if (generatedTokens[i].type != expectedTokens[i].type || generatedTokens[i].value != expectedTokens[i].value) {
+        if (Token::GetType(generatedTokens[i].type) != expectedTokens[i].type || generated.Text(generatedTokens[i]) != expectedTokens[i].value) {
             return false;
         }
     }
     return true;
 }
 
-// Creating a function to read testcase1.ilys and compile it
-int compileTestcase1() {
-    // Opening the binary file
-    std::ifstream file("../Test_Cases/testcase1.ilys", std::ios::binary);
-    
-    if (!file.is_open()) {
-        std::cerr << "Error: testcase1.ilys file" << std::endl;
-        return 1;
+// function to compare the tokens produced by two different lexing engines
+bool compareTokenStreams(const TokenStream& left, const TokenStream& right) {
+    if (left.Tokens.size() != right.Tokens.size() || left.Unmatched != right.Unmatched) {
+        return false;
+    }
+    for (size_t i = 0; i < left.Tokens.size(); i++) {
+        if (left.Tokens[i].type != right.Tokens[i].type || left.Text(left.Tokens[i]) != right.Text(right.Tokens[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// checks that identifiers and strings carry a symbol that names their text, one symbol per distinct text, and
+// that numbers carry the value DecodeNumber gives (or symbol 0 when it doesn't decode)
+bool checkSymbols(const TokenStream& stream) {
+    std::unordered_map<std::string_view, uint32_t> symbols;
+    std::unordered_map<uint32_t, std::string_view> names;
+    for (const Token& token : stream.Tokens) {
+        std::string_view text = stream.Text(token);
+        if (token.type == TokenType::NUMBER) {
+            NumberValue value;
+            bool valid = DecodeNumber(text, &value);
+            if (valid != (token.symbol != 0) || token.symbol > stream.Numbers.size() || (valid && !stream.Number(token).IsSame(value))) {
+                return false;
+            }
+            continue;
+        }
+        bool named = token.type == TokenType::IDENTIFIER || token.type == TokenType::STRING;
+        if (!named) {
+            if (token.symbol != SymbolTable::NoSymbol) {
+                return false;
+            }
+            continue;
+        }
+        if (token.symbol == SymbolTable::NoSymbol || stream.Name(token) != text) {
+            return false;
+        }
+        auto symbol = symbols.emplace(text, token.symbol).first;
+        auto name = names.emplace(token.symbol, text).first;
+        if (symbol->second != token.symbol || name->second != text) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// checks that a stream CollectDiagnostics would find something in is one the driver doesn't skip (the flag of
+// the lexer may be set without cause, never missing)
+bool flagsItsErrors(const TokenStream& stream) {
+    return stream.NeedsDiagnostics() || CollectDiagnostics(stream).empty();
+}
+
+// checks DecodeNumber on the edges of every literal form, and on random decimals against strtoll / strtod
+int checkNumbers() {
+    struct Expected {
+        const char* Text;
+        bool Valid;
+        bool Float;
+        double Value;
+    };
+    const Expected cases[] = {
+        {"0", true, false, 0}, {"42", true, false, 42}, {"1_000_000", true, false, 1e6}, {"9223372036854775807", true, false, 9223372036854775807.0},
+        {"9223372036854775808", false, false, 0}, {"0x1F", true, false, 31}, {"0XfF_fF", true, false, 65535}, {"0b1010", true, false, 10},
+        {"0xFFFFFFFFFFFFFFFF", true, false, -1}, {"0x1_0000_0000_0000_0000", false, false, 0}, {"0b2", false, false, 0}, {"0x", false, false, 0},
+        {"3.25", true, true, 3.25}, {"1_0.2_5", true, true, 10.25}, {"99999999999999999999.5", true, true, 99999999999999999999.5},
+        {"1_", false, false, 0}, {"1_.5", false, false, 0}, {"1.", false, false, 0}, {"-1", false, false, 0}, {"1e5", false, false, 0}
+    };
+    int failures = 0;
+    for (const Expected& expected : cases) {
+        NumberValue value;
+        bool valid = DecodeNumber(expected.Text, &value);
+        if (valid != expected.Valid || (valid && (value.IsFloat() != expected.Float || value.ToDouble() != expected.Value))) {
+            std::cerr << "Number mismatch on literal: " << expected.Text << std::endl;
+            failures++;
+        }
     }
 
-    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    unsigned int seed = 7;
+    for (int i = 0; i < 100000; i++) {
+        std::string text;
+        int digits = 1 + i % 19;
+        for (int d = 0; d < digits; d++) {
+            seed = seed * 1103515245 + 12345;
+            text += static_cast<char>('0' + (seed >> 16) % 10);
+            if (i % 3 == 0 && d == digits / 2) {
+                text += '.';
+            }
+        }
+        if (text.back() == '.') {
+            text += '5';
+        }
+        NumberValue value;
+        bool valid = DecodeNumber(text, &value);
+        bool same;
+        if (text.find('.') == std::string::npos) {
+            // strtoll saturates where DecodeNumber refuses
+            errno = 0;
+            long long expected = std::strtoll(text.c_str(), nullptr, 10);
+            same = errno == ERANGE ? !valid : valid && !value.IsFloat() && value.GetInteger() == expected;
+        }
+        else {
+            same = valid && value.IsFloat() && value.GetFloat() == std::strtod(text.c_str(), nullptr);
+        }
+        if (!same) {
+            std::cerr << "Number mismatch on literal: " << text << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
 
-    // Converting the bytes to a string representing the source code
-    std::string sourceCode(bytes.begin(), bytes.end());
+// checks DecodeUtf8 on the edges of every sequence length, ValidateUtf8 and CountCodePoints at every scan level
+// against decoding every byte, and that names and strings in other scripts lex (and are located) as such
+int checkUtf8() {
+    struct Expected {
+        const char* Text;
+        char32_t CodePoint;
+        size_t Length;
+    };
+    const Expected cases[] = {
+        {"a", 'a', 1}, {"\x7f", 0x7F, 1}, {"\xc2\x80", 0x80, 2}, {"é", 0xE9, 2}, {"\xdf\xbf", 0x7FF, 2}, {"\xe0\xa0\x80", 0x800, 3}, {"€", 0x20AC, 3},
+        {"\xef\xbf\xbf", 0xFFFF, 3}, {"😀", 0x1F600, 4}, {"\xf4\x8f\xbf\xbf", 0x10FFFF, 4}, {"\x80", InvalidCodePoint, 1}, {"\xc0\xaf", InvalidCodePoint, 1},
+        {"\xc1\xbf", InvalidCodePoint, 1}, {"\xe0\x9f\xbf", InvalidCodePoint, 1}, {"\xed\xa0\x80", InvalidCodePoint, 1}, {"\xf0\x8f\xbf\xbf", InvalidCodePoint, 1},
+        {"\xf4\x90\x80\x80", InvalidCodePoint, 1}, {"\xf5\x80", InvalidCodePoint, 1}, {"\xe2\x82", InvalidCodePoint, 2}, {"\xe2\x82x", InvalidCodePoint, 2},
+        {"\xf0\x9f\x98", InvalidCodePoint, 3}, {"\xc3\xc3\xa9", InvalidCodePoint, 1}
+    };
+    int failures = 0;
+    for (const Expected& expected : cases) {
+        size_t length;
+        std::string bytes;
+        if (DecodeUtf8(expected.Text, 0, &length) != expected.CodePoint || length != expected.Length) {
+            std::cerr << "UTF-8 mismatch on sequence: " << expected.Text << std::endl;
+            failures++;
+        }
+        AppendUtf8(bytes, expected.CodePoint);
+        if (expected.CodePoint != InvalidCodePoint && bytes != std::string_view(expected.Text).substr(0, length)) {
+            std::cerr << "UTF-8 mismatch encoding: " << expected.Text << std::endl;
+            failures++;
+        }
+    }
 
-    // Tokenizing the source code
-    std::vector<Token> tokens = Tokenize(sourceCode);
+    // mostly ASCII with multibyte sequences, cut ones and stray bytes here and there, so the kernels see blocks
+    // of both
+    const char* pieces[] = {"abcdefghijklmnopq", "let x = 1;\n", "é", "名前", "😀", "\xff", "\xe2\x82", "\xed\xa0\x80", "\xc3", "\x80\x80"};
+    ScanLevel best = GetScanLevel();
+    unsigned int seed = 11;
+    for (int i = 0; i < 2000; i++) {
+        std::string text;
+        for (int piece = 0; piece < i % 40; piece++) {
+            seed = seed * 1103515245 + 12345;
+            text += pieces[(seed >> 16) % 4 == 0 ? (seed >> 20) % 10 : (seed >> 20) % 2];
+        }
+        std::vector<std::pair<size_t, size_t>> expected;
+        size_t count = 0;
+        for (size_t position = 0, length; position < text.size(); position += length, count++) {
+            if (DecodeUtf8(text, position, &length) == InvalidCodePoint) {
+                expected.emplace_back(position, length);
+            }
+        }
+        for (int level = 0; level <= static_cast<int>(best); level++) {
+            SetScanLevel(static_cast<ScanLevel>(level));
+            std::vector<std::pair<size_t, size_t>> found;
+            size_t length;
+            for (size_t position = ValidateUtf8(text, 0, &length); position < text.size(); position = ValidateUtf8(text, position + length, &length)) {
+                found.emplace_back(position, length);
+            }
+            if (found != expected || CountCodePoints(text) != count) {
+                std::cerr << "UTF-8 validation mismatch (" << GetScanLevelName(static_cast<ScanLevel>(level)) << ") on: " << text << std::endl;
+                failures++;
+            }
+        }
+        SetScanLevel(best);
+    }
 
-    // Debugging each token in the tokens vector
-    for (Token token : tokens) {
-        token.Debug(token);
+    TokenStream tokens = Tokenize("let 名前 = \"héllo\"; naïve+é1");
+    const std::vector<ExpectedToken> names = {
+        {"LET", "let"}, {"IDENTIFIER", "名前"}, {"ASSIGNMENT", "="}, {"STRING", "\"héllo\""}, {"SEMICOLON", ";"},
+        {"IDENTIFIER", "naïve"}, {"PLUS", "+"}, {"IDENTIFIER", "é1"}, {"EOF", ""}
+    };
+    if (!compareTokens(tokens, names) || !CollectDiagnostics(tokens).empty()) {
+        std::cerr << "UTF-8 names didn't lex as names" << std::endl;
+        failures++;
+    }
+    // one error per ill-formed run, columns in code points and names quoted as they are
+    std::string source = "let é = \xff\xfe; \"\xe2\x82\"\nlet 名前";
+    TokenStream invalid = Tokenize(source);
+    std::vector<Diagnostic> diagnostics = CollectDiagnostics(invalid);
+    diagnostics.push_back(Diagnostic{DiagnosticCode::UNDEFINED_NAME, static_cast<uint32_t>(source.size() - 6), 6});
+    std::string out;
+    AppendDiagnostics(out, "t", LineTable(source), diagnostics);
+    if (out != "t:1:9: error E0023: invalid UTF-8 \"\\xff\\xfe\"\nt:1:14: error E0023: invalid UTF-8 \"\\xe2\\x82\"\nt:2:5: error E0008: undefined name \"名前\"\n") {
+        std::cerr << "UTF-8 diagnostics mismatch: " << out << std::endl;
+        failures++;
     }
+    return failures;
+}
 
-    return 0;
+// builds a pseudo random source out of pieces of the language (the same seed always gives the same source)
+std::string randomSource(unsigned int seed, int pieces) {
+    static const std::vector<std::string> fragments = {
+        "(", ")", "[", "]", "{", "}", "=", "==", "!", "!=", "<", "<=", ">", ">=", "&&", "||",
+        ".", "..", ":", ";", "?", ",", "+", "++", "+=", "-", "--", "-=", "*", "*=", "/", "/=", "%", "%=",
+        "0", "7", "42", "8.3", "12.", ".5", "-3", "- 3", "-\n4", " ", "  ", "\t", "\n", "\r\n",
+        "0x1F", "0xff_ff", "0b101", "0b2", "0x", "1_000", "1_", "12_3.4_5", "9223372036854775808", "0x1_0000_0000_0000_0000",
+        "x", "_tmp1", "if", "else", "for", "forevery", "fore", "in", "int", "true", "false", "let", "letter",
+        "return", "returns",
+        "\"\"", "\"text\"", "\"say \\\"hi\\\"\"", "\"a\\\\b\"", "\"multi\nline\"",
+        "é", "名前", "naïve", "\"héllo\"", "€", "😀", "\xff", "\xe2\x82", "\xc3"
+    };
+    std::string source;
+    for (int i = 0; i < pieces; i++) {
+        seed = seed * 1103515245 + 12345;
+        source += fragments[(seed >> 16) % fragments.size()];
+    }
+    return source;
 }
 
-// Creating a function to read testcase2.ilys and compile it
-int compileTestcase2() {
-    // Opening the binary file
-    std::ifstream file("../Test_Cases/testcase2.ilys", std::ios::binary);
+// appends a tree on one line, ex: (LET x (BINARY PLUS 1 2)), leaves are their text
+void appendTree(std::string& out, const Ast& ast, const TokenStream& tokens, NodeId id) {
+    const Node& node = ast.Get(id);
+    if (node.Kind == NodeKind::NUMBER || node.Kind == NodeKind::STRING || node.Kind == NodeKind::BOOLEAN || node.Kind == NodeKind::IDENTIFIER) {
+        out += tokens.Text(tokens.Tokens[node.Token]);
+        return;
+    }
+    out += '(';
+    out += NodeNames[static_cast<size_t>(node.Kind)];
+    if (node.Kind == NodeKind::UNARY || node.Kind == NodeKind::POSTFIX || node.Kind == NodeKind::BINARY || node.Kind == NodeKind::ASSIGN) {
+        out += ' ';
+        out += Token::GetType(node.Operator);
+    }
+    if (node.Kind == NodeKind::LET || node.Kind == NodeKind::CONST || node.Kind == NodeKind::FUNC || node.Kind == NodeKind::PARAMETER
+        || node.Kind == NodeKind::CLASS || node.Kind == NodeKind::MEMBER || node.Kind == NodeKind::FIELD || node.Kind == NodeKind::IMPORT) {
+        out += ' ';
+        out += tokens.Text(tokens.Tokens[node.Token]);
+    }
+    for (NodeId child : {node.First, node.Second, node.Third}) {
+        for (NodeId item = child; item != NoNode; item = ast.Get(item).Next) {
+            out += ' ';
+            appendTree(out, ast, tokens, item);
+        }
+    }
+    out += ')';
+}
 
-    if (!file.is_open()) {
-        std::cerr << "Error: testcase2.ilys file" << std::endl;
-        return 1;
+// checks that every child of every node comes before it and has exactly one parent (the tree is a tree)
+bool checkTreeShape(const Ast& ast) {
+    std::vector<uint8_t> parents(ast.GetNodeCount() + 1, 0);
+    for (NodeId id = 1; id <= ast.GetNodeCount(); id++) {
+        const Node& node = ast.Get(id);
+        for (NodeId child : {node.First, node.Second, node.Third}) {
+            for (NodeId item = child; item != NoNode; item = ast.Get(item).Next) {
+                if (item >= id || parents[item]++ > 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return ast.GetRoot() == ast.GetNodeCount() && parents[ast.GetRoot()] == 0;
+}
+
+// the pull API against Tokenize: NextToken one token at a time, Peek(k) at every step with k up to and past the
+// end of the lookahead ring (16 tokens, so it has to grow) and past the EOF token, and GenerateTokens in a
+// build with coroutines (-std=c++20)
+int checkStreaming(const std::vector<std::string>& sources) {
+    int failures = 0;
+    auto same = [](const Token& left, const Token& right) {
+        return left.type == right.type && left.offset == right.offset && left.length == right.length;
+    };
+    for (const std::string& source : sources) {
+        std::shared_ptr<const SourceBuffer> buffer = SourceBuffer::FromString(source);
+        const std::vector<Token> expected = Tokenize(buffer).Tokens;
+        Token end = Token::ConstructToken(TokenType::E0F_TOKEN, source.size(), 0);
+        auto at = [&](size_t index) {
+            return index < expected.size() ? expected[index] : end;
+        };
+
+        std::unique_ptr<Lexer> lexer = ConstructLexer(buffer);
+        bool matched = true;
+        for (size_t i = 0; i <= expected.size() && matched; i++) {
+            for (size_t k : {size_t(1), size_t(15), size_t(16), size_t(40)}) {
+                matched = matched && same(lexer->Peek(k), at(i + k));
+            }
+            matched = matched && same(lexer->Peek(0), at(i)) && same(lexer->NextToken(), at(i));
+        }
+        if (!matched) {
+            std::cerr << "Streaming lexer mismatch on source: " << source << std::endl;
+            failures++;
+        }
+
+#if defined(__cpp_impl_coroutine)
+        lexer = ConstructLexer(buffer);
+        size_t index = 0;
+        matched = true;
+        for (const Token& token : GenerateTokens(lexer.get())) {
+            matched = matched && same(token, at(index++));
+        }
+        if (!matched || index != expected.size()) {
+            std::cerr << "Token generator mismatch on source: " << source << std::endl;
+            failures++;
+        }
+#endif
+    }
+    return failures;
+}
+
+// checks the parser: precedences and statements against their expected trees, error recovery, very deep
+// nesting, the benchmark corpora (which must parse without errors) and every source of the lexer checks
+int checkParser(const std::vector<std::string>& sources) {
+    int failures = 0;
+    const std::pair<const char*, const char*> cases[] = {
+        {"a = b + c * d", "(EXPRESSION (ASSIGN ASSIGNMENT a (BINARY PLUS b (BINARY MULTIPLY c d))))"},
+        {"a - b - c", "(EXPRESSION (BINARY MINUS (BINARY MINUS a b) c))"},
+        {"a = b += c", "(EXPRESSION (ASSIGN ASSIGNMENT a (ASSIGN PLUS EQUALS b c)))"},
+        {"-a * !b", "(EXPRESSION (BINARY MULTIPLY (UNARY MINUS a) (UNARY NOT b)))"},
+        {"a || b && c == d < e + f", "(EXPRESSION (BINARY OR a (BINARY AND b (BINARY EQUALS c (BINARY LESS THAN d (BINARY PLUS e f))))))"},
+        {"a ? b : c ? d : e", "(EXPRESSION (CONDITIONAL a b (CONDITIONAL c d e)))"},
+        {"x.y[0](1, 2).z++", "(EXPRESSION (POSTFIX PLUS PLUS (MEMBER z (CALL (INDEX (MEMBER y x) 0) 1 2))))"},
+        {"(1 + 2) * 3;", "(EXPRESSION (BINARY MULTIPLY (BINARY PLUS 1 2) 3))"},
+        {"typeof a == b", "(EXPRESSION (BINARY EQUALS (UNARY TYPEOF a) b))"},
+        {"let v = new P(1).q", "(LET v (NEW (MEMBER q (CALL P 1))))"},
+        {"const l = [1, -2, \"s\", true,]", "(CONST l (ARRAY 1 (UNARY MINUS 2) \"s\" true))"},
+        {"for i in 0..n + 1 { }", "(FOR (PARAMETER i) (BINARY DOT DOT 0 (BINARY PLUS n 1)) (BLOCK))"},
+        {"for 0..3 { x; }", "(FOR (BINARY DOT DOT 0 3) (BLOCK (EXPRESSION x)))"},
+        {"forevery a in b { }", "(FOREVERY (PARAMETER a) b (BLOCK))"},
+        {"while a < 3 { a++; }", "(WHILE (BINARY LESS THAN a 3) (BLOCK (EXPRESSION (POSTFIX PLUS PLUS a))))"},
+        {"if a { } else if b { } else { c; }", "(IF a (BLOCK) (IF b (BLOCK) (BLOCK (EXPRESSION c))))"},
+        {"func f(a, b) { a; }", "(FUNC f (PARAMETER a) (PARAMETER b) (BLOCK (EXPRESSION a)))"},
+        {"func f() { return; return a + 1 }", "(FUNC f (BLOCK (RETURN) (RETURN (BINARY PLUS a 1))))"},
+        {"class C { let x = 1; func m() { } }", "(CLASS C (LET x 1) (FUNC m (BLOCK)))"},
+        {"let o = {a: 1, b: {}, c: [x],}", "(LET o (OBJECT (FIELD a 1) (FIELD b (OBJECT)) (FIELD c (ARRAY x))))"},
+        {"import a, b from \"m\"; export func f() { } export let x", "(IMPORT \"m\" (PARAMETER a) (PARAMETER b)) (EXPORT (FUNC f (BLOCK))) (EXPORT (LET x))"},
+        // error recovery: the broken statement becomes an ERROR node and the next one still parses
+        {"let = 5; let y = 2;", "(ERROR) (LET y 2)"},
+        {"a = (1 + ; b", "(EXPRESSION (ASSIGN ASSIGNMENT a (BINARY PLUS 1 (ERROR)))) (EXPRESSION b)"},
+        {"} x", "(EXPRESSION (ERROR)) (EXPRESSION x)"},
+        {"{ import a from \"m\" } x", "(BLOCK (EXPRESSION (ERROR))) (EXPRESSION x)"},
+        {"export 1; x", "(ERROR) (EXPRESSION x)"},
+    };
+    for (const auto& [source, expected] : cases) {
+        TokenStream tokens = Tokenize(source);
+        Ast ast;
+        std::vector<Diagnostic> diagnostics;
+        bool parsed = Parse(tokens, ast, diagnostics);
+        std::string tree;
+        for (NodeId statement = ast.Get(ast.GetRoot()).First; statement != NoNode; statement = ast.Get(statement).Next) {
+            tree += tree.empty() ? "" : " ";
+            appendTree(tree, ast, tokens, statement);
+        }
+        bool broken = std::string(expected).find("ERROR") != std::string::npos;
+        if (tree != expected || parsed == broken || diagnostics.size() != (broken ? 1 : 0) || !checkTreeShape(ast)) {
+            std::cerr << "Parser mismatch on source: " << source << " gave " << tree << std::endl;
+            failures++;
+        }
+    }
+
+    // nesting far deeper than MaxParseDepth is an error (not a crash), a long chain of left to right operators
+    // is no nesting at all and a very deep tree still prints (the indentation makes that quadratic, so not too deep)
+    std::string chain = "x";
+    for (int i = 0; i < 3000; i++) {
+        chain += " + x";
+    }
+    // (the count is whether there are errors, an else if chain that deep is cut every MaxParseDepth links)
+    const std::pair<std::string, size_t> deep[] = {
+        {std::string(100000, '(') + "x" + std::string(100000, ')'), 1},
+        {std::string(100000, '-') + "x", 1},
+        {"if a { } " + [] {
+            std::string elses;
+            for (int i = 0; i < 5000; i++) {
+                elses += "else if a { } ";
+            }
+            return elses;
+        }(), 1},
+        {chain, 0}
+    };
+    for (const auto& [source, errors] : deep) {
+        TokenStream tokens = Tokenize(source);
+        Ast ast;
+        std::vector<Diagnostic> diagnostics;
+        Parse(tokens, ast, diagnostics);
+        std::string dump;
+        ast.AppendDebug(dump, tokens);
+        if (diagnostics.empty() != (errors == 0) || (errors > 0 && diagnostics[0].Code != DiagnosticCode::NESTING_TOO_DEEP) || !checkTreeShape(ast)) {
+            std::cerr << "Parser mismatch on a deeply nested source of " << source.size() << " bytes" << std::endl;
+            failures++;
+        }
+    }
+
+    for (CorpusMix mix : GetCorpusMixes()) {
+        TokenStream tokens = Tokenize(GenerateCorpus(mix, 64 << 10));
+        Ast ast;
+        std::vector<Diagnostic> diagnostics;
+        if (!Parse(tokens, ast, diagnostics) || !checkTreeShape(ast)) {
+            std::cerr << "Parser errors on the " << GetCorpusMixName(mix) << " corpus" << std::endl;
+            failures++;
+        }
+    }
+
+    // random sources are mostly errors, the parser has to get through them with a well formed tree
+    for (const std::string& source : sources) {
+        TokenStream tokens = Tokenize(source);
+        Ast ast;
+        std::vector<Diagnostic> diagnostics;
+        Parse(tokens, ast, diagnostics);
+        if (!checkTreeShape(ast)) {
+            std::cerr << "Parser gave a broken tree on source: " << source << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// compiles a source and runs it, with or without the superinstructions and with the optimizer passes given: the
+// code of the first compile error, or of the runtime error, or 0 with what the program printed in output
+static DiagnosticCode compileAndRun(VirtualMachine& vm, const std::string& source, bool superinstructions, const OptimizeOptions& optimize,
+                                    std::string& output, OptimizeStats* stats = nullptr) {
+    TokenStream tokens = Tokenize(source);
+    Ast ast;
+    std::vector<Diagnostic> diagnostics;
+    if (!Parse(tokens, ast, diagnostics)) {
+        return diagnostics[0].Code;
+    }
+    Optimize(tokens, ast, optimize, stats);
+    Program program;
+    CompileOptions options;
+    options.Superinstructions = superinstructions;
+    if (!Compile(tokens, ast, program, diagnostics, options)) {
+        return diagnostics[0].Code;
+    }
+    Diagnostic error;
+    if (!vm.Run(program, output, &error)) {
+        return error.Code;
+    }
+    return DiagnosticCode{};
+}
+
+// runs small programs through the compiler and the VM, both with and without the superinstructions and the
+// optimizer, and programs that have to fail with a given compile or runtime error
+int checkVm() {
+    int failures = 0;
+    const std::pair<const char*, const char*> cases[] = {
+        {"func fib(n) { if n < 2 { return n } return fib(n - 1) + fib(n - 2) } print(fib(20))", "6765\n"},
+        {"let s = 0; for i in 1..10 { s += i } print(s)", "55\n"},
+        {"let n = 0; for 3..1 { n++ } for 2..2 { n += 10 } print(n)", "10\n"},
+        {"func f() { let s = 0; for i in 0..4 { for j in i..4 { s += j } } return s } print(f())", "40\n"},
+        {"let i = 0; while i < 5 { i++ } print(i, i++, i, ++i, i--, --i)", "5 5 6 7 7 5\n"},
+        {"let a = [1, 2, [3]]; a[0] += 5; a[2][0] = \"x\"; push(a, false); print(a, len(a))", "[6, 2, [\"x\"], false] 4\n"},
+        {"let s = \"\"; for c in \"abc\" { s = c + s } print(s, len(s), \"n=\" + 1.5)", "cba 3 n=1.5\n"},
+        {"let t = 0; for v in [4, 5, 6] { t = t * 10 + v } print(t)", "456\n"},
+        // strings are looped over by code point and indexed by byte, an index inside a sequence gives U+FFFD
+        {"let s = \"\"; let n = 0; for c in \"é€😀a\" { s += c + \"|\"; n++ } print(s, n, len(\"é\"), \"é€\"[0], \"é€\"[1] == \"\\u{FFFD}\", \"é€\"[2])",
+            "é|€|😀|a| 4 2 é true €\n"},
+        {"let 名前 = \"héllo\\u{1F600}\\u{e9}\"; const naïve = \"\\u{D800}\\u{}\"; print(名前, len(名前), naïve)", "héllo😀é 12 \\u{D800}\\u{}\n"},
+        {"func none() { } print(1 && 2, false || \"d\", false && none(), 0 || 1, !none(), !0)", "2 d false 0 true false\n"},
+        {"let x = 3; print(x > 2 ? \"big\" : \"small\", x < 2 ? 1 : x == 3 ? 2 : 3)", "big 2\n"},
+        {"print(7 % 3, -7 % 3, 7.5 % 2, 1 / 4, 0.1 + 0.2, 1000000 * 1000000 * 1000000000)", "1 -1 1.5 0.25 0.30000000000000004 1e+21\n"},
+        {"print(typeof 1, typeof \"s\", typeof [], typeof print, typeof true)", "number string array function boolean\n"},
+        {"const k = 2; func g(a, b) { return a * k - b } print(g(5, 1), g(1, 5) <= -3, 2 != 2, \"a\" == \"a\")", "9 true false true\n"},
+        {"func f(n) { if n > 0 { if n > 5 { return \"big\" } return \"small\" } } print(f(9), f(1), f(0))", "big small nil\n"},
+        {"let i = 0; while true { i++; if i >= 3 && i != 4 { return } } print(i)", ""},
+        {"let o = {x: 1, y: [2]}; o.x += 4; o.z = o.y; o.y[0]++; print(o, o.w, typeof o, o.x++, ++o.x)", "{x: 7, y: [3], z: [3]} nil object 5 7\n"},
+        {"class P { let x = 1; let y = [x]; func sum(p) { return p.x + p.y[0] } } const x = 5; let p = new P(); p.x = 2; print(p.sum(p), new P, P().y)",
+            "7 {x: 1, y: [5], sum: <func sum>} [5]\n"},
+        // enough garbage for collections, with old arrays and objects given young values (the write barrier) and
+        // strings moved while they are being joined
+        {"let keep = []; let o = {}; for i in 0..30000 { push(keep, \"s\" + i); o.last = [i]; let t = [i, {v: i}]; keep[i] = keep[i] + \"!\" }"
+         " let n = 0; for s in keep { n += len(s) } print(keep[12345], o.last, n)", "s12345! [30000] 198897\n"},
+        {"func tree(d) { if d == 0 { return [] } return [tree(d - 1), tree(d - 1)] } let a = tree(12); let b = 0; for i in 1..20 { b += len(tree(8)) }"
+         " func count(t) { let c = 1; for s in t { c += count(s) } return c } print(count(a), b)", "8191 40\n"},
+    };
+    const std::pair<const char*, DiagnosticCode> errors[] = {
+        {"print(y)", DiagnosticCode::UNDEFINED_NAME},
+        {"const c = 1; c = 2", DiagnosticCode::CONSTANT_ASSIGNMENT},
+        {"func f() { let a = 1; func g() { return a } }", DiagnosticCode::NOT_SUPPORTED},
+        {"let n = 1; n.x = 2", DiagnosticCode::TYPE_MISMATCH},
+        {"print(1 + true)", DiagnosticCode::TYPE_MISMATCH},
+        {"let a = [1]; print(a[1])", DiagnosticCode::INDEX_OUT_OF_RANGE},
+        {"func f(n) { return f(n + 1) } f(0)", DiagnosticCode::STACK_OVERFLOW},
+        {"func f(a) { } f(1, 2)", DiagnosticCode::WRONG_ARGUMENT_COUNT},
+        {"let n = 1; n()", DiagnosticCode::NOT_CALLABLE},
+        {"let s = \"s\"; print(s * 1)", DiagnosticCode::TYPE_MISMATCH},
+        {"const c = 1; c++", DiagnosticCode::CONSTANT_ASSIGNMENT},
+        {"const f = 1; f()", DiagnosticCode::NOT_CALLABLE},
+        {"for i in \"a\"..\"b\" { }", DiagnosticCode::TYPE_MISMATCH},
+        {"import a from \"m\"", DiagnosticCode::NOT_SUPPORTED},
+    };
+    OptimizeOptions optimized;
+    OptimizeOptions unoptimized;
+    unoptimized.Passes = 0;
+
+    // the default nursery, then one so small that nearly every allocation collects
+    VirtualMachine vm;
+    for (size_t nursery : {DefaultNurserySize, size_t(1024)}) {
+        vm.GetHeap().SetNurserySize(nursery);
+        for (bool superinstructions : {true, false}) {
+            for (const OptimizeOptions* optimize : {&optimized, &unoptimized}) {
+                for (const auto& [source, expected] : cases) {
+                    std::string output;
+                    DiagnosticCode code = compileAndRun(vm, source, superinstructions, *optimize, output);
+                    if (code != DiagnosticCode{} || output != expected) {
+                        std::cerr << "VM mismatch on source: " << source << " gave " << output << " (error " << static_cast<int>(code) << ")" << std::endl;
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    if (vm.GetHeap().GetStats().MinorCollections == 0 || vm.GetHeap().GetStats().MajorCollections == 0) {
+        std::cerr << "VM never collected its heap" << std::endl;
+        failures++;
+    }
+    for (bool superinstructions : {true, false}) {
+        for (const OptimizeOptions* optimize : {&optimized, &unoptimized}) {
+            for (const auto& [source, expected] : errors) {
+                std::string output;
+                if (compileAndRun(vm, source, superinstructions, *optimize, output) != expected) {
+                    std::cerr << "VM didn't give error " << static_cast<int>(expected) << " on source: " << source << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+// programs whose field accesses see one shape, a few and too many to cache: they have to print the same as
+// without the caches, and the shape stats have to say which it was (the field names are only used here, so
+// the shapes they make are new the first time)
+int checkShapes() {
+    int failures = 0;
+    struct ShapeCase {
+        const char* Source;
+        const char* Expected;
+        bool Monomorphic;
+        bool Polymorphic;
+        bool Megamorphic;
+    };
+    const ShapeCase cases[] = {
+        {"class ShapeCheck { let sx = 1; let sy = 2 } let t = 0; for i in 1..100 { let c = new ShapeCheck(); c.sx = i; t += c.sx + c.sy } print(t)",
+            "5250\n", true, false, false},
+        {"func get(o) { return o.pa } let t = 0; for i in 1..100 { t += get({pa: 1}) + get({pb: 0, pa: 2}) + get({pc: 0, pb: 0, pa: 3}) } print(t)",
+            "600\n", true, true, false},
+        {"func get(o) { return o.qa } let t = 0; for i in 1..10 { for o in [{qa: 1}, {q1: 0, qa: 1}, {q2: 0, qa: 1}, {q3: 0, qa: 1}, {q4: 0, qa: 1},"
+         " {q5: 0, qa: 1}] { t += get(o) } } print(t, get({q1: 0}))", "60 nil\n", true, true, true},
+        // a site adding a field to objects of two shapes, and setting it where it is already there
+        {"func add(o, v) { o.fn = v } let a = {fz: 1}; let b = {fy: 2, fz: 3}; for o in [a, b, {fz: 0}, {fy: 0, fz: 0}] { add(o, 4) } add(a, 5);"
+         " a.fa = 6; b.fa = 7; print(a, b)", "{fz: 1, fn: 5, fa: 6} {fy: 2, fz: 3, fn: 4, fa: 7}\n", false, true, false},
+    };
+    OptimizeOptions optimize;
+    VirtualMachine vm;
+    for (bool superinstructions : {true, false}) {
+        for (const ShapeCase& shapeCase : cases) {
+            std::string output;
+            vm.ResetStats();
+            DiagnosticCode code = compileAndRun(vm, shapeCase.Source, superinstructions, optimize, output);
+            const ShapeStats& stats = vm.GetShapeStats();
+            if (code != DiagnosticCode{} || output != shapeCase.Expected) {
+                std::cerr << "Shape mismatch on source: " << shapeCase.Source << " gave " << output << " (error " << static_cast<int>(code) << ")" << std::endl;
+                failures++;
+            }
+            else if ((stats.MonomorphicHits > 0) != shapeCase.Monomorphic || (stats.PolymorphicHits > 0) != shapeCase.Polymorphic ||
+                     (stats.MegamorphicMisses > 0) != shapeCase.Megamorphic) {
+                std::cerr << "Shape stats mismatch on source: " << shapeCase.Source << std::endl;
+                stats.PrintText(std::cerr);
+                failures++;
+            }
+        }
+    }
+    // the objects of a class share one shape for each field set so far, made by the first run only
+    size_t shapes = GetShapes().GetShapeCount();
+    std::string output;
+    compileAndRun(vm, cases[0].Source, true, optimize, output);
+    if (GetShapes().GetShapeCount() != shapes || vm.GetShapeStats().ShapesCreated != 0) {
+        std::cerr << "Objects of a class didn't share their shapes" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// programs with something for every optimizer pass to rewrite, run with every pass, with none and with each one
+// left out: they have to print the same every time, and every pass has to have rewritten something
+int checkOptimizer() {
+    int failures = 0;
+    const std::pair<const char*, const char*> cases[] = {
+        {"const a = 2; const b = a * 3 + 1; func f(x) { return x * b - a } print(f(1), b, a + \"\" + b, -a * -b)", "5 7 27 14\n"},
+        {"func early() { return k } print(early()); const k = 4; func late(k) { return k } func later() { return k + 1 }"
+         " { let k = 1; k++; print(early(), late(9), later(), k) }", "nil\n4 9 5 2\n"},
+        {"print(1 / 0, -1 / 0, 0 / 0 == 0 / 0, 7 % -3, 1 / (-0 * 1), \"a\" + 1.5 + true, 1 + 2 + \"x\", \"b\" < \"a\", typeof (1 + 2), !0, 2 == \"2\")",
+            "inf -inf false 1 -inf a1.5true 3x false number false false\n"},
+        {"let x = 3; let z = -0; print(x * 1, 1 * x, x / 1, x - 0, -(-x), 1 / (z * 1), 1 / (z - 0), !(x == 3), !(x != 3), \"s\" + 0)",
+            "3 3 3 3 3 -inf -inf false true s0\n"},
+        {"let n = 0; let q = 5; if true { n += 1 } else { n += 100 } if false { n += 10 } else if 1 { n += 2 } while false { n = -1 }"
+         " const debug = false; if debug { print(\"debug\") } if !!q { n += 4 } print(n, true ? \"t\" : \"f\", false && q, true || q, true && q)",
+            "7 t false true 5\n"},
+        {"let r = 0; for i in 1..3 { i = i * 10; r += i } for i in 3..1 { r = -1 } for 0..0.5 { r += 100 } for 0..(0 / 0) { r = -5 }"
+         " func sum(n) { let s = 0; for i in 1..n { s += i } return s } print(r, len(0..4), sum(100))", "160 5 5050\n"},
+    };
+
+    std::vector<OptimizeOptions> variants(2);
+    variants[1].Passes = 0;
+    for (size_t i = 0; i < PassCount; i++) {
+        variants.emplace_back();
+        variants.back().SetEnabled(static_cast<Pass>(i), false);
+    }
+    VirtualMachine vm;
+    OptimizeStats stats;
+    for (const auto& [source, expected] : cases) {
+        for (size_t variant = 0; variant < variants.size(); variant++) {
+            std::string output;
+            DiagnosticCode code = compileAndRun(vm, source, true, variants[variant], output, variant == 0 ? &stats : nullptr);
+            if (code != DiagnosticCode{} || output != expected) {
+                std::cerr << "Optimizer mismatch (passes " << variants[variant].Passes << ") on source: " << source << " gave " << output
+                          << " (error " << static_cast<int>(code) << ")" << std::endl;
+                failures++;
+            }
+        }
     }
+    for (size_t i = 0; i < PassCount; i++) {
+        if (stats.Rewrites[i] == 0) {
+            std::cerr << "Optimizer pass " << PassNames[i] << " never rewrote anything" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
 
-    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    std::string sourceCode(bytes.begin(), bytes.end());
-    std::vector<Token> tokens = Tokenize(sourceCode);
-    for (Token token : tokens) {
-        token.Debug(token);
+// builds small graphs of modules (written to a temporary directory) on pools of one and of four threads: what the
+// first file prints when it runs with what it imports, or the errors of every module (as "file:code"), and its
+// bytecode have to be the same either way, and no module may be loaded twice
+int checkModules() {
+    struct ModuleCase {
+        std::vector<std::pair<const char*, const char*>> Files;
+        const char* Expected;
+    };
+    const ModuleCase cases[] = {
+        // a diamond (d is imported three times, loaded and run once), an exported let assigned by its module and
+        // read by the importers, and a module's own len that the others don't see
+        {{{"main.ilys", "import b from \"b\"; import c from \"c\"; import total from \"d\"; print(b(), c(), total, len([1]))"},
+          {"b.ilys", "import add from \"d\"; export func b() { return add(1) } print(\"b\", len(\"ab\"))"},
+          {"c.ilys", "import add, total, size from \"sub/../d\"; export func c() { add(10); return total } print(\"c\", size)"},
+          {"d.ilys", "print(\"d\"); export let total = 0; export func add(n) { total += n; return total } func len(x) { return -1 }"
+                     " export const size = len(\"abc\")"}},
+         "d\nb 2\nc -1\n1 11 11 1\n"},
+        {{{"a.ilys", "import b from \"b\" export func a() { }"}, {"b.ilys", "import c from \"c\" export func b() { }"},
+          {"c.ilys", "import a from \"a\" export func c() { }"}},
+         "a.ilys:19 b.ilys:19 c.ilys:18"},
+        {{{"main.ilys", "import x from \"nowhere\""}}, "main.ilys:17"},
+        {{{"main.ilys", "import y from \"e\""}, {"e.ilys", "export let x = 1"}}, "main.ilys:20"},
+        {{{"main.ilys", "import x from \"e\"; import x from \"e\"; let y = x"}, {"e.ilys", "export let x = 1; export let y = 2"}}, "main.ilys:21"},
+        {{{"main.ilys", "import f from \"f\" f()"}, {"f.ilys", "export func f() { return g }"}}, "f.ilys:8 main.ilys:19"},
+        {{{"main.ilys", "import f from \"r\"; print(1); f()"}, {"r.ilys", "export func f() { return [][1] }"}}, "1\nr.ilys:15"},
+        {{{"main.ilys", "import x from \"e\"; x = 2"}, {"e.ilys", "export let x = 1"}}, "main.ilys:9"},
+    };
+
+    int failures = 0;
+    char directory[] = "/tmp/ilys-modules-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "Error: could not create a directory for the module checks" << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < std::size(cases); i++) {
+        std::filesystem::path folder = std::filesystem::path(directory) / std::to_string(i);
+        std::filesystem::create_directories(folder);
+        for (const auto& [name, source] : cases[i].Files) {
+            std::ofstream(folder / name) << source;
+        }
+        std::string results[2];
+        std::string bytecode[2];
+        for (size_t threads : {1, 4}) {
+            std::string& result = results[threads == 4];
+            ThreadPool pool(threads);
+            ModuleGraph graph(std::make_shared<SymbolTable>());
+            size_t entry = graph.Build({(folder / cases[i].Files[0].first).string()}, pool, ModuleOptions())[0];
+            if (graph.GetStats().Modules != graph.GetModuleCount() || graph.GetModuleCount() > cases[i].Files.size() + 1) {
+                std::cerr << "Module loaded twice in module case " << i << std::endl;
+                failures++;
+            }
+            graph.GetModule(entry).Code.AppendDisassembly(bytecode[threads == 4]);
+            if (graph.GetModule(entry).Compiled) {
+                std::vector<size_t> order = graph.GetRunOrder(entry);
+                std::vector<const Program*> programs;
+                for (size_t index : order) {
+                    programs.push_back(&graph.GetModule(index).Code);
+                }
+                VirtualMachine vm;
+                Diagnostic error;
+                size_t failed = 0;
+                if (!vm.RunModules(programs, result, &error, &failed)) {
+                    result += std::filesystem::path(graph.GetModule(order[failed]).Path).filename().string() + ":" + std::to_string(static_cast<int>(error.Code));
+                }
+                continue;
+            }
+            std::vector<std::string> errors;
+            for (size_t index = 0; index < graph.GetModuleCount(); index++) {
+                const Module& module = graph.GetModule(index);
+                for (const Diagnostic& diagnostic : module.Diagnostics) {
+                    errors.push_back(std::filesystem::path(module.Path).filename().string() + ":" + std::to_string(static_cast<int>(diagnostic.Code)));
+                }
+            }
+            std::sort(errors.begin(), errors.end());
+            for (const std::string& error : errors) {
+                result += (result.empty() ? "" : " ") + error;
+            }
+        }
+        if (results[0] != cases[i].Expected || results[1] != cases[i].Expected || bytecode[0] != bytecode[1]) {
+            std::cerr << "Module mismatch on case " << i << ": gave " << results[0] << " and " << results[1] << std::endl;
+            failures++;
+        }
     }
-    return 0;
+    std::filesystem::remove_all(directory);
+    return failures;
 }
 
-// Creating a function to read testcase3.ilys and compile it
-int compileTestcase3() {
-    // Opening the binary file
-    std::ifstream file("../Test_Cases/testcase3.ilys", std::ios::binary);
+// serves from a thread on a socket in a temporary directory: a run through the server prints what the same run
+// of a session of its own prints, again once its tokens are kept, then with the file edited, and a request that
+// isn't a run of the driver fails without stopping the server
+// the parallel lexer called from workers of its own pool (every worker waiting for chunks queued behind it would
+// deadlock if they blocked), then the driver on a file large enough that it lexes it in chunks
+int checkParallel() {
+    int failures = 0;
+    std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(GenerateCorpus(CorpusMix::MIXED, 2 * DefaultParallelChunkSize + 4096));
+    TokenStream expected = Tokenize(source);
+
+    ThreadPool pool(2);
+    std::vector<std::future<TokenStream>> nested;
+    for (int i = 0; i < 4; i++) {
+        nested.push_back(pool.Submit([&source, &pool]() {
+            return TokenizeParallel(source, pool, 1 << 16);
+        }));
+    }
+    for (std::future<TokenStream>& tokens : nested) {
+        if (tokens.wait_for(std::chrono::seconds(60)) != std::future_status::ready) {
+            // the workers are stuck, the pool can't be joined either
+            std::cerr << "Parallel lexer deadlocked on the workers of its pool" << std::endl;
+            std::_Exit(1);
+        }
+        TokenStream parallel = tokens.get();
+        if (!compareTokenStreams(expected, parallel) || !checkSymbols(parallel)) {
+            std::cerr << "Parallel lexer mismatch on a worker of its pool" << std::endl;
+            failures++;
+        }
+    }
+
+    char directory[] = "/tmp/ilys-parallel-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "Error: could not create a directory for the parallel checks" << std::endl;
+        return failures + 1;
+    }
+    std::string file = std::string(directory) + "/large.ilys";
+    std::ofstream(file, std::ios::binary) << source->View();
+    DriverOptions options;
+    std::string error;
+    std::unique_ptr<DriverSession> session;
+    if (ParseDriverOptions({"--jobs", "2", file}, options, &error)) {
+        session = DriverSession::Open(options, false, &error);
+    }
+    std::ostringstream out;
+    std::ostringstream err;
+    std::string dump;
+    for (const Token& token : expected.Tokens) {
+        Token::AppendDebug(dump, token, expected.GetSource());
+    }
+    if (!session || session->Run(options, out, err) != 0 || out.str() != dump) {
+        std::cerr << "Driver mismatch on a file lexed in chunks " << error << std::endl;
+        failures++;
+    }
+    std::filesystem::remove_all(directory);
+    return failures;
+}
 
-    if (!file.is_open()) {
-        std::cerr << "Error: testcase3.ilys file" << std::endl;
+int checkServer() {
+    char directory[] = "/tmp/ilys-server-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "Error: could not create a directory for the server checks" << std::endl;
         return 1;
     }
+    std::string socket = std::string(directory) + "/server.sock";
+    std::string file = std::string(directory) + "/main.ilys";
+    std::ostringstream log;
+    DriverOptions serverOptions;
+    serverOptions.Threads = 2;
+    std::thread server([&]() {
+        RunServer(socket, serverOptions, log);
+    });
+
+    // what a session of its own prints for the arguments (its totals, which have timings, are left out)
+    auto expected = [](const std::vector<std::string>& arguments, int& status) {
+        DriverOptions options;
+        std::string error;
+        if (!ParseDriverOptions(arguments, options, &error)) {
+            status = 1;
+            return std::string();
+        }
+        std::unique_ptr<DriverSession> session = DriverSession::Open(options, false, &error);
+        std::ostringstream out;
+        std::ostringstream err;
+        status = session->Run(options, out, err);
+        return out.str();
+    };
+    const std::vector<std::pair<const char*, std::vector<std::string>>> requests = {
+        {"let x = 6 print(x * 7)", {"--run", file}},
+        {"let x = 6 print(x * 7)", {"--run", file}},
+        {"let x = 6 print(x * 7)", {"--bytecode", file}},
+        {"let x = 7 print(x * 7)", {"--run", file}},
+        {"let x = 7 print(x * 7)", {file}},
+        {"print(y)", {"--run", file}},
+        {"print(1)", {"--run", "--no-such-option", file}},
+        {"print(1)", {"--run", std::string(directory) + "/missing.ilys"}},
+    };
+
+    int failures = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        std::ofstream(file) << requests[i].first;
+        ServerReply reply;
+        std::string error;
+        bool sent = false;
+        // the server may not be listening yet
+        for (int attempt = 0; attempt < 200 && !sent; attempt++) {
+            sent = SendRequest(socket, RequestKind::RUN, requests[i].second, reply, &error);
+            if (!sent) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        int status = 1;
+        std::string output = expected(requests[i].second, status);
+        if (!sent || reply.Output != output || reply.Status != status) {
+            std::cerr << "Server mismatch on request " << i << ": " << (sent ? reply.Output + reply.Errors : error) << std::endl;
+            failures++;
+        }
+    }
+    ServerReply reply;
+    std::string error;
+    if (!SendRequest(socket, RequestKind::STOP, {}, reply, &error) || reply.Errors.find("Served " + std::to_string(requests.size()) + " runs") != 0) {
+        std::cerr << "Server did not stop: " << error << reply.Errors << std::endl;
+        failures++;
+    }
+    server.join();
+    std::filesystem::remove_all(directory);
+    return failures;
+}
+
+// the DFA lexer against the regex one and the parallel one, with the symbols of both checked, true if the
+// source lexed the same by every one of them
+bool lexesTheSame(const std::string& source, ThreadPool& pool) {
+    TokenStream tokens = Tokenize(source);
+    TokenStream regex = TokenizeRegex(source);
+    if (!compareTokenStreams(tokens, regex) || tokens.MayHaveErrors != regex.MayHaveErrors) {
+        std::cerr << "Lexer mismatch (" << GetScanLevelName(GetScanLevel()) << ") on source: " << source << std::endl;
+        return false;
+    }
+    if (!checkSymbols(tokens)) {
+        std::cerr << "Symbol mismatch (" << GetScanLevelName(GetScanLevel()) << ") on source: " << source << std::endl;
+        return false;
+    }
+    TokenStream parallel = TokenizeParallel(SourceBuffer::FromString(source), pool, 16);
+    if (!compareTokenStreams(tokens, parallel) || !checkSymbols(parallel) || tokens.MayHaveErrors != parallel.MayHaveErrors) {
+        std::cerr << "Parallel lexer mismatch (" << GetScanLevelName(GetScanLevel()) << ") on source: " << source << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// runs the DFA lexer and the regex lexer on the same sources and reports every source where they disagree, then
+// every other check of the tree: prints how many sources every engine agreed on and a line for each check
+int differentialTest() {
+    std::vector<std::string> sources;
+    for (const char* path : {"../Test_Cases/testcase1.ilys", "../Test_Cases/testcase2.ilys", "../Test_Cases/testcase3.ilys"}) {
+        std::string error;
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromFile(path, &error);
+        if (source) {
+            sources.emplace_back(source->View());
+        }
+    }
+    for (unsigned int seed = 1; seed <= 500; seed++) {
+        sources.push_back(randomSource(seed, 40));
+    }
+
+    for (unsigned int seed = 1; seed <= 100; seed++) {
+        sources.push_back(randomSource(seed, 400));
+    }
+
+    // the parallel lexer is checked with tiny chunks so even the small sources get split. all of it runs once
+    // for every scan level the CPU has, so the kernels of each one meet the DFA and the regex engine (a source
+    // failing at any level counts once), then the level the lexer had is put back
+    ThreadPool pool(4);
+    ScanLevel best = GetScanLevel();
+    std::vector<bool> agreed(sources.size(), true);
+    std::string levels;
+    for (int level = 0; level <= static_cast<int>(best); level++) {
+        SetScanLevel(static_cast<ScanLevel>(level));
+        levels += (level > 0 ? ", " : "") + std::string(GetScanLevelName(static_cast<ScanLevel>(level)));
+        for (size_t i = 0; i < sources.size(); i++) {
+            agreed[i] = lexesTheSame(sources[i], pool) && agreed[i];
+        }
+    }
+    SetScanLevel(best);
+    size_t lexed = std::count(agreed.begin(), agreed.end(), true);
+
+    // every other check counts its own failures, printed one line each after the sources
+    int incremental = 0;
+    int diagnostics = 0;
+    int tokenCache = 0;
+    // edits right after a token whose match looked further than its end, then random edits applied one after
+    // the other, each re-lexed incrementally and compared with a full Tokenize
+    std::unique_ptr<Lexer> lexer(ConstructLexer(SourceBuffer::FromString("")));
+    std::vector<std::pair<std::string, TextEdit>> edits = {
+        {"5.x", {2, 0, "3"}}, {"- \n x", {4, 1, "4"}}, {"a b", {1, 1, ""}}, {"\"a\" \"b\"", {2, 3, ""}}, {"x.", {2, 0, "."}},
+        {"\"a b c", {6, 0, "\""}}, {"a b @", {2, 1, "d"}}
+    };
+    for (const auto& [text, edit] : edits) {
+        TokenStream tokens = Tokenize(text);
+        Relex(lexer.get(), tokens, edit);
+        if (!compareTokenStreams(tokens, Tokenize(std::string(tokens.GetSource())))) {
+            std::cerr << "Incremental lexer mismatch on source: " << tokens.GetSource() << std::endl;
+            incremental++;
+        }
+    }
+    // converging on the last token, with an unmatched byte after it the re-lex never got to
+    RelexStats stats;
+    TokenStream tail = Tokenize("a b @");
+    Relex(lexer.get(), tail, TextEdit{2, 1, "d"}, &stats);
+    if (!stats.Converged || stats.RelexedTokens != 1) {
+        std::cerr << "Incremental lexer didn't converge on the last token of: " << tail.GetSource() << std::endl;
+        incremental++;
+    }
+    for (unsigned int seed = 1; seed <= 200; seed++) {
+        TokenStream tokens = Tokenize(randomSource(seed, 60));
+        unsigned int state = seed;
+        for (int step = 0; step < 10; step++) {
+            state = state * 1103515245 + 12345;
+            TextEdit edit;
+            edit.Offset = (state >> 8) % (tokens.GetSource().size() + 1);
+            edit.RemovedLength = (state >> 4) % 4;
+            edit.InsertedText = randomSource(state, (state >> 12) % 3);
+
+            Relex(lexer.get(), tokens, edit);
+            if (!compareTokenStreams(tokens, Tokenize(std::string(tokens.GetSource()))) || !checkSymbols(tokens) || !flagsItsErrors(tokens)) {
+                std::cerr << "Incremental lexer mismatch on source: " << tokens.GetSource() << std::endl;
+                incremental++;
+                break;
+            }
+        }
+    }
+
+    // the same random edits on a stream kept in tiny chunks, so they keep landing on, across and between cuts
+    // (a lone quote or a backslash before a newline makes the chunks after it lex differently)
+    for (unsigned int seed = 1; seed <= 200; seed++) {
+        IncrementalStream chunked(Tokenize(randomSource(seed, 200)), 8 + seed % 32);
+        unsigned int state = seed;
+        for (int step = 0; step < 20; step++) {
+            state = state * 1103515245 + 12345;
+            TextEdit edit;
+            edit.Offset = (state >> 8) % (chunked.GetSize() + 1);
+            edit.RemovedLength = (state >> 4) % 6;
+            edit.InsertedText = (state >> 20) % 5 == 0 ? "\"" : (state >> 20) % 5 == 1 ? "\\\n" : randomSource(state, (state >> 12) % 3);
+
+            chunked.Relex(lexer.get(), edit);
+            TokenStream tokens = chunked.ToStream();
+            if (!compareTokenStreams(tokens, Tokenize(std::string(tokens.GetSource()))) || !checkSymbols(tokens) || !flagsItsErrors(tokens) ||
+                chunked.GetSize() != tokens.GetSource().size() || chunked.GetTokenCount() + 1 != tokens.Tokens.size()) {
+                std::cerr << "Incremental lexer mismatch on chunked source: " << tokens.GetSource() << std::endl;
+                incremental++;
+                break;
+            }
+        }
+    }
+    // an edit in a long file only re-lexes its own line, until an opening quote takes the rest of the file along
+    std::string lines;
+    for (int i = 0; i < 1000; i++) {
+        lines += "x = " + std::to_string(i) + "\n";
+    }
+    IncrementalStream document(Tokenize(lines), 64);
+    uint32_t middle = static_cast<uint32_t>(lines.size() / 2);
+    document.Relex(lexer.get(), TextEdit{middle, 0, "y "}, &stats);
+    bool local = stats.Converged && stats.RelexedTokens <= 3 && document.GetChunkCount() > 50;
+    // a quote near the end that closes once one opens in the middle, turning half the file into a string
+    document.Relex(lexer.get(), TextEdit{static_cast<uint32_t>(document.GetSize() - 2), 0, "\""});
+    document.Relex(lexer.get(), TextEdit{middle, 0, "\""});
+    bool quoted = document.GetTokenCount() < 2000;
+    document.Relex(lexer.get(), TextEdit{static_cast<uint32_t>(document.GetSize() - 3), 1, ""});
+    document.Relex(lexer.get(), TextEdit{middle, 3, ""});
+    TokenStream restored = document.ToStream();
+    if (!local || !quoted || !compareTokenStreams(restored, Tokenize(lines))) {
+        std::cerr << "Incremental lexer didn't keep an edit to its chunk in a long file" << std::endl;
+        incremental++;
+    }
+
+    // one number rewritten over and over, so the values it leaves behind get packed away
+    TokenStream rewritten = Tokenize("x = 1");
+    for (int step = 0; step < 20; step++) {
+        Relex(lexer.get(), rewritten, TextEdit{4, 1, std::to_string(step % 10)});
+        if (!checkSymbols(rewritten) || rewritten.Numbers.size() > 2 * rewritten.Tokens.size()) {
+            std::cerr << "Incremental lexer mismatch on source: " << rewritten.GetSource() << std::endl;
+            incremental++;
+            break;
+        }
+    }
+
+    int numbers = checkNumbers();
+    int utf8 = checkUtf8();
+
+    // the line table against counting newlines by hand, and the diagnostics against the unmatched bytes
+    for (const std::string& source : sources) {
+        LineTable lines(source);
+        uint32_t line = 1;
+        uint32_t column = 1;
+        bool located = true;
+        // (a column is a code point, so it only moves at the first byte of one)
+        size_t next = 0;
+        for (size_t offset = 0; offset < source.size() && located; offset++) {
+            SourceLocation location = lines.Locate(static_cast<uint32_t>(offset));
+            located = location.Line == line && location.Column == column;
+            if (source[offset] == '\n') {
+                line++;
+                column = 1;
+                next = offset + 1;
+            }
+            else if (offset == next) {
+                size_t length;
+                DecodeUtf8(source, offset, &length);
+                next = offset + length;
+                column++;
+            }
+        }
+        TokenStream tokens = Tokenize(source);
+        // the lexer flags exactly the sources with a byte that isn't ASCII or a number that doesn't decode
+        bool undecoded = std::any_of(tokens.Tokens.begin(), tokens.Tokens.end(), [](const Token& token) {
+            return token.type == TokenType::NUMBER && token.symbol == 0;
+        });
+        located = located && tokens.MayHaveErrors == (!IsAscii(source) || undecoded) && flagsItsErrors(tokens);
+        size_t covered = 0;
+        uint32_t previous = 0;
+        for (const Diagnostic& diagnostic : CollectDiagnostics(tokens)) {
+            located = located && diagnostic.Offset >= previous;
+            previous = diagnostic.Offset;
+            if (diagnostic.Code == DiagnosticCode::NUMBER_OUT_OF_RANGE) {
+                NumberValue value;
+                located = located && !DecodeNumber(std::string_view(source).substr(diagnostic.Offset, diagnostic.Length), &value);
+                continue;
+            }
+            if (diagnostic.Code == DiagnosticCode::INVALID_UTF8) {
+                size_t length;
+                located = located && DecodeUtf8(source, diagnostic.Offset, &length) == InvalidCodePoint;
+                continue;
+            }
+            for (uint32_t offset = diagnostic.Offset; offset < diagnostic.Offset + diagnostic.Length; offset++) {
+                located = located && covered < tokens.Unmatched.size() && tokens.Unmatched[covered++] == offset;
+            }
+        }
+        if (!located || covered != tokens.Unmatched.size() || lines.GetLineCount() != line) {
+            std::cerr << "Diagnostic mismatch on source: " << source << std::endl;
+            diagnostics++;
+        }
+    }
+
+    // every source through an empty cache (a store) and again (a hit that must give the same stream)
+    char directory[] = "/tmp/ilys-cache-XXXXXX";
+    std::string error;
+    std::unique_ptr<TokenCache> cache = mkdtemp(directory) ? TokenCache::Open(directory, &error) : nullptr;
+    if (!cache) {
+        std::cerr << "Error: could not create a cache directory " << error << std::endl;
+        tokenCache++;
+    }
+    for (size_t i = 0; cache && i < sources.size(); i++) {
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString(sources[i]);
+        std::string storeError;
+        TokenStream tokens = cache->Tokenize(source, &storeError);
+        TokenStream cached;
+        if (!storeError.empty() || !cache->Load(source, std::make_shared<SymbolTable>(), cached) || !compareTokenStreams(tokens, cached) || !checkSymbols(cached)
+            || cached.MayHaveErrors != tokens.MayHaveErrors) {
+            std::cerr << "Token cache mismatch on source: " << sources[i] << " " << storeError << std::endl;
+            tokenCache++;
+        }
+    }
+    // an entry whose unmatched bytes point past the source (the header and the hash still fine) is a miss
+    if (cache) {
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::FromString("a @ b");
+        std::string storeError;
+        TokenStream tokens = cache->Tokenize(source, &storeError);
+        uint64_t tokenCount = 0;
+        std::fstream entry(cache->GetPath(source->View()), std::ios::in | std::ios::out | std::ios::binary);
+        // (TokenCount is the sixth field of the 72 byte header, the unmatched offsets follow the tokens)
+        entry.seekg(48);
+        entry.read(reinterpret_cast<char*>(&tokenCount), sizeof(tokenCount));
+        uint32_t damaged = 1000;
+        entry.seekp(72 + tokenCount * 16);
+        entry.write(reinterpret_cast<const char*>(&damaged), sizeof(damaged));
+        entry.close();
+        TokenStream cached;
+        if (tokens.Unmatched.size() != 1 || cache->Load(source, std::make_shared<SymbolTable>(), cached)) {
+            std::cerr << "Token cache loaded an entry with damaged unmatched offsets" << std::endl;
+            tokenCache++;
+        }
+    }
+    if (cache) {
+        std::filesystem::remove_all(directory);
+    }
 
-    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    std::string sourceCode(bytes.begin(), bytes.end());
-    std::vector<Token> tokens = Tokenize(sourceCode);
-    for (Token token : tokens) {
-        token.Debug(token);
+    const std::pair<const char*, int> checks[] = {
+        {"incremental lexer", incremental},
+        {"numbers", numbers},
+        {"utf-8", utf8},
+        {"diagnostics", diagnostics},
+        {"token cache", tokenCache},
+        {"streaming lexer", checkStreaming(sources)},
+        {"parser", checkParser(sources)},
+        {"vm", checkVm()},
+        {"shapes", checkShapes()},
+        {"optimizer", checkOptimizer()},
+        {"modules", checkModules()},
+        {"parallel lexer", checkParallel()},
+        {"server", checkServer()},
+    };
+    bool passed = lexed == sources.size();
+    std::cout << lexed << "/" << sources.size() << " sources lexed the same by every engine (" << levels << ")" << std::endl;
+    for (const auto& [name, failures] : checks) {
+        std::cout << "  " << name << ": " << (failures == 0 ? "ok" : std::to_string(failures) + " failed") << std::endl;
+        passed = passed && failures == 0;
     }
-    return 0;
+    return passed ? 0 : 1;
 }
 
-int main() {
-    compileTestcase1();
-    std::cout << std::endl;
-    compileTestcase2();
-    std::cout << std::endl;
-    compileTestcase3();
-    return 0;
-}
\ No newline at end of file
+// prints how to run the driver
+void printUsage() {
+    std::cerr << "usage: ilys [--jobs N] [--cache directory] [--quiet] [--ast | --bytecode | --run] [--no-superinstructions]\n"
+              << "            [--no-optimize | --no-<pass> ...] [--optimizer-stats] [--module-stats] [--stats | --stats-json]\n"
+              << "            [--runtime-stats]\n"
+              << "            <file | directory | -> ...\n"
+              << "       ilys --serve socket [--jobs N] [--cache directory]\n"
+              << "       ilys --client socket [options] <file | directory> ...\n"
+              << "       ilys --stop-server socket\n"
+              << "       ilys --differential\n"
+              << "  directories are searched for .ilys files, the tokens of every file are printed in the order given\n"
+              << "  --jobs N          lexing threads (default: one per hardware thread)\n"
+              << "  --cache directory keeps the tokens of every file lexed, keyed by its content (or ILYS_TOKEN_CACHE)\n"
+              << "  --quiet           only prints the totals\n"
+              << "  --ast             parses every file and prints its syntax tree instead of its tokens\n"
+              << "  --bytecode        compiles every file and prints its bytecode instead of its tokens\n"
+              << "  --run             compiles and runs every file, prints what it printed instead of its tokens\n"
+              << "                    (both load and compile what the files import once, and run it before them)\n"
+              << "  --no-superinstructions  compiles without the compare-and-branch and range loop instructions\n"
+              << "  --no-optimize     compiles every file as it was parsed, --no-<pass> leaves one optimizer pass out\n"
+              << "                    (passes: propagate, fold, simplify, branches, ranges)\n"
+              << "  --optimizer-stats with --bytecode or --run, prints what every optimizer pass did after the totals\n"
+              << "  --module-stats    with --bytecode or --run, prints how the modules were built after the totals\n"
+              << "  --stats           prints what every lexer rule cost after the totals (--stats-json: as JSON),\n"
+              << "                    needs a build with -DILYS_LEXER_STATS=1\n"
+              << "  --runtime-stats   with --run, prints what the garbage collector and the inline caches of field\n"
+              << "                    accesses did after the totals\n"
+              << "  --serve socket    keeps the lexers, symbols and tokens warm in a server listening on a Unix socket,\n"
+              << "                    --client socket sends it a command line and prints what it printed (paths are\n"
+              << "                    taken from the client's directory), --stop-server stops it" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--differential") {
+        return differentialTest();
+    }
+
+    DriverOptions options;
+    if (std::getenv("ILYS_TOKEN_CACHE")) {
+        options.CacheDirectory = std::getenv("ILYS_TOKEN_CACHE");
+    }
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    std::string mode = arguments.empty() ? "" : arguments[0];
+    if ((mode == "--serve" || mode == "--client" || mode == "--stop-server") && arguments.size() < 2) {
+        std::cerr << "Error: " << mode << " needs a socket" << std::endl;
+        return 1;
+    }
+    if (mode == "--client") {
+        return RunClient(arguments[1], std::vector<std::string>(arguments.begin() + 2, arguments.end()));
+    }
+    if (mode == "--stop-server") {
+        ServerReply reply;
+        std::string error;
+        if (!SendRequest(arguments[1], RequestKind::STOP, {}, reply, &error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        std::cerr << reply.Errors;
+        return 0;
+    }
+    std::string socket;
+    if (mode == "--serve") {
+        socket = arguments[1];
+        arguments.erase(arguments.begin(), arguments.begin() + 2);
+    }
+    if (std::find(arguments.begin(), arguments.end(), "--help") != arguments.end() || std::find(arguments.begin(), arguments.end(), "-h") != arguments.end()) {
+        printUsage();
+        return 0;
+    }
+    std::string error;
+    if (!ParseDriverOptions(arguments, options, &error)) {
+        std::cerr << "Error: " << error << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    if (!socket.empty() && !options.Paths.empty()) {
+        std::cerr << "Error: --serve takes no files, its clients send them" << std::endl;
+        return 1;
+    }
+    if (!socket.empty()) {
+        return RunServer(socket, options);
+    }
+    if (options.Paths.empty()) {
+        printUsage();
+        return 1;
+    }
+    return RunDriver(options);
+}